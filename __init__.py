@@ -7,6 +7,7 @@ Features:
 - Configurable power output (0-100%)
 - Background service task for non-blocking operation
 - Statistics tracking and monitoring
+- Built-in zero-export PI controller driven by a grid power sensor
 
 Compatible with both:
 - ESPHome (via this component)
@@ -16,9 +17,15 @@ Author: GitHub Copilot
 Date: 2025-10-27
 """
 
+import hashlib
+from urllib.parse import quote
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 from esphome import automation
+from esphome.components import sensor
+from esphome.components.esp32 import add_idf_sdkconfig_option
 from esphome.const import (
     CONF_ID,
 )
@@ -32,26 +39,220 @@ InverterTentekComponent = inverter_tentek_ns.class_(
 # Actions
 SetPowerAction = inverter_tentek_ns.class_("SetPowerAction", automation.Action)
 
+# Used by the sensor, text_sensor and binary_sensor platforms
+CONF_INVERTER_TENTEK_ID = "inverter_tentek_id"
+
 # Configuration key definitions (define our own constants)
 CONF_EMAIL = "email"
 CONF_PASSWORD = "password"
 CONF_DEVICE_SN = "device_sn"
+CONF_ADDITIONAL_DEVICES = "additional_devices"
+CONF_BASE_URLS = "base_urls"
 CONF_OUTPUT_POWER = "output_power"
 CONF_REQUEST_TIMEOUT = "request_timeout"
 CONF_MAX_RETRY_COUNT = "max_retry_count"
+CONF_ARENA_IN_PSRAM = "arena_in_psram"
+CONF_SESSION_LIFETIME = "session_lifetime"
+CONF_DNS_TTL = "dns_ttl"
+CONF_RESTORE_STATE = "restore_state"
+CONF_RETRY_POLICY = "retry_policy"
+CONF_MAX_RETRIES = "max_retries"
+CONF_INITIAL_DELAY = "initial_delay"
+CONF_MAX_DELAY = "max_delay"
+CONF_CIRCUIT_BREAKER = "circuit_breaker"
+CONF_FAILURE_THRESHOLD = "failure_threshold"
+CONF_OPEN_DURATION = "open_duration"
+CONF_COMMAND_DEADLINE = "command_deadline"
+CONF_DEADLINE = "deadline"
+CONF_ZERO_EXPORT = "zero_export"
+CONF_GRID_POWER_SENSOR = "grid_power_sensor"
+CONF_TARGET_EXPORT = "target_export"
+CONF_RATED_POWER = "rated_power"
+CONF_KP = "kp"
+CONF_KI = "ki"
+CONF_MIN_OUTPUT = "min_output"
+CONF_MAX_OUTPUT = "max_output"
+CONF_OUTPUT_STEP = "output_step"
+CONF_TRANSMISSION_POLICY = "transmission_policy"
+CONF_RATE_LIMIT = "rate_limit"
+CONF_BURST = "burst"
+CONF_REFILL_INTERVAL = "refill_interval"
+CONF_HEDGING = "hedging"
+CONF_ENABLED = "enabled"
+CONF_MIN_DELAY = "min_delay"
+CONF_DEADBAND = "deadband"
+CONF_ERROR_INTEGRAL_THRESHOLD = "error_integral_threshold"
+CONF_MAX_SILENT_INTERVAL = "max_silent_interval"
+
+SetPowerErrorClass = cg.global_ns.enum("set_power_error_class_t")
+# YAML key -> error class, defaults match SET_POWER_RETRY_POLICY_DEFAULT()
+ERROR_CLASSES = {
+    "network": (SetPowerErrorClass.SET_POWER_ERROR_CLASS_NETWORK, "1s", "30s"),
+    "http_5xx": (SetPowerErrorClass.SET_POWER_ERROR_CLASS_HTTP_5XX, "2s", "60s"),
+    "unknown_result": (SetPowerErrorClass.SET_POWER_ERROR_CLASS_UNKNOWN_RESULT, "1s", "10s"),
+}
+
+
+def retry_policy_schema(initial_delay, max_delay):
+    return cv.Schema(
+        {
+            cv.Optional(CONF_MAX_RETRIES, default=3): cv.int_range(min=0, max=10),
+            cv.Optional(CONF_INITIAL_DELAY, default=initial_delay): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_MAX_DELAY, default=max_delay): cv.positive_time_period_milliseconds,
+        }
+    )
+
+
+def validate_zero_export(config):
+    if config[CONF_MIN_OUTPUT] >= config[CONF_MAX_OUTPUT]:
+        raise cv.Invalid(f"{CONF_MIN_OUTPUT} must be lower than {CONF_MAX_OUTPUT}")
+    return config
+
+
+ZERO_EXPORT_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Required(CONF_GRID_POWER_SENSOR): cv.use_id(sensor.Sensor),
+            cv.Required(CONF_RATED_POWER): cv.All(cv.power, cv.Range(min=1.0)),
+            cv.Optional(CONF_TARGET_EXPORT, default="0W"): cv.power,
+            cv.Optional(CONF_KP, default=0.3): cv.float_range(min=0.0),
+            cv.Optional(CONF_KI, default=0.05): cv.float_range(min=0.0),
+            cv.Optional(CONF_MIN_OUTPUT, default=0): cv.int_range(min=0, max=100),
+            cv.Optional(CONF_MAX_OUTPUT, default=100): cv.int_range(min=0, max=100),
+            cv.Optional(CONF_OUTPUT_STEP, default=1): cv.int_range(min=1, max=50),
+        }
+    ),
+    validate_zero_export,
+)
+
+# Must match SIGNATURE_KEY in set_power_service.c
+SIGNATURE_KEY = "1f80ca5871919371ea71716cae4841bd"
+SIGNATURE_TABLE_SIZE = 101  # One signature per power level 0..100
+# Must match SET_POWER_SERVICE_MAX_DEVICES in set_power_service.h
+MAX_DEVICES = 6
+# Must match SET_POWER_SERVICE_MAX_ENDPOINTS in set_power_service.h
+MAX_ENDPOINTS = 3
+
+
+def signature_table(device_sn):
+    """Precompute set-power MD5 signature digests for every power level"""
+    # quote() leaves A-Z a-z 0-9 - _ . ~ unescaped, same as url_encode() in C
+    encoded_sn = quote(device_sn, safe="")
+    return [
+        hashlib.md5(
+            f"deviceSn={encoded_sn}&outputPower={power}{SIGNATURE_KEY}".encode()
+        ).digest()
+        for power in range(SIGNATURE_TABLE_SIZE)
+    ]
+
+
+def add_signature_table(table_name, device_sn):
+    """Emit a device's signature table as a flash-resident global"""
+    rows = ",\n".join(
+        "  {" + ", ".join(f"0x{b:02x}" for b in digest) + "}"
+        for digest in signature_table(device_sn)
+    )
+    cg.add_global(
+        cg.RawStatement(
+            f"static const uint8_t {table_name}[{SIGNATURE_TABLE_SIZE}][16] = {{\n{rows}\n}};"
+        )
+    )
+    return cg.RawExpression(table_name)
+
+
+def validate_base_url(value):
+    """Cloud API base URL as parsed by parse_base_url() in C"""
+    value = cv.string(value)
+    if not value.startswith("http://"):
+        raise cv.Invalid("Only http:// base URLs are supported")
+    if len(value) >= 64:
+        raise cv.Invalid("Base URL must be shorter than 64 characters")
+    return value
+
+
+def validate_devices(config):
+    serials = [config[CONF_DEVICE_SN]] + config[CONF_ADDITIONAL_DEVICES]
+    if len(set(serials)) != len(serials):
+        raise cv.Invalid(f"{CONF_DEVICE_SN} and {CONF_ADDITIONAL_DEVICES} must be unique")
+    return config
+
+
+# One block per account; each block runs its own service instance
+MULTI_CONF = True
 
 # Component configuration schema
-CONFIG_SCHEMA = cv.Schema(
+CONFIG_SCHEMA = cv.All(cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(InverterTentekComponent),
         cv.Required(CONF_EMAIL): cv.string,
         cv.Required(CONF_PASSWORD): cv.string,
         cv.Required(CONF_DEVICE_SN): cv.string,
+        cv.Optional(CONF_ADDITIONAL_DEVICES, default=[]): cv.All(
+            cv.ensure_list(cv.string), cv.Length(max=MAX_DEVICES - 1)
+        ),
+        cv.Optional(CONF_BASE_URLS, default=[]): cv.All(
+            cv.ensure_list(validate_base_url), cv.Length(max=MAX_ENDPOINTS)
+        ),
         cv.Optional(CONF_OUTPUT_POWER, default=100): cv.int_range(min=0, max=100),
         cv.Optional(CONF_REQUEST_TIMEOUT, default="10s"): cv.positive_time_period_milliseconds,
         cv.Optional(CONF_MAX_RETRY_COUNT, default=3): cv.int_range(min=0, max=10),
+        cv.Optional(CONF_ARENA_IN_PSRAM, default=False): cv.boolean,
+        cv.Optional(CONF_SESSION_LIFETIME): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_DNS_TTL, default="5min"): cv.All(
+            cv.positive_time_period_milliseconds, cv.Range(min=cv.TimePeriod(seconds=10))
+        ),
+        cv.Optional(CONF_RESTORE_STATE, default=True): cv.boolean,
+        cv.Optional(CONF_COMMAND_DEADLINE): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_RETRY_POLICY, default={}): cv.Schema(
+            {
+                cv.Optional(name): retry_policy_schema(initial_delay, max_delay)
+                for name, (_, initial_delay, max_delay) in ERROR_CLASSES.items()
+            }
+        ),
+        cv.Optional(CONF_CIRCUIT_BREAKER, default={}): cv.Schema(
+            {
+                cv.Optional(CONF_FAILURE_THRESHOLD, default=5): cv.int_range(min=0, max=100),
+                cv.Optional(CONF_OPEN_DURATION, default="60s"): cv.positive_time_period_milliseconds,
+            }
+        ),
+        cv.Optional(CONF_RATE_LIMIT, default={}): cv.Schema(
+            {
+                cv.Optional(CONF_BURST, default=0): cv.int_range(min=0, max=100),
+                cv.Optional(CONF_REFILL_INTERVAL, default="6s"): cv.positive_time_period_milliseconds,
+            }
+        ),
+        cv.Optional(CONF_HEDGING, default={}): cv.Schema(
+            {
+                cv.Optional(CONF_ENABLED, default=False): cv.boolean,
+                cv.Optional(CONF_MIN_DELAY, default="500ms"): cv.positive_time_period_milliseconds,
+            }
+        ),
+        cv.Optional(CONF_TRANSMISSION_POLICY, default={}): cv.Schema(
+            {
+                cv.Optional(CONF_DEADBAND, default=0): cv.int_range(min=0, max=100),
+                cv.Optional(CONF_ERROR_INTEGRAL_THRESHOLD, default=0.0): cv.float_range(min=0.0),
+                cv.Optional(CONF_MAX_SILENT_INTERVAL, default="0s"): cv.positive_time_period_milliseconds,
+            }
+        ),
+        cv.Optional(CONF_ZERO_EXPORT): ZERO_EXPORT_SCHEMA,
     }
-).extend(cv.COMPONENT_SCHEMA)
+).extend(cv.COMPONENT_SCHEMA), validate_devices)
+
+
+def validate_devices_across_blocks(config):
+    """An inverter must not be driven by two blocks (two sessions, one persisted state key)"""
+    serials = [
+        device_sn
+        for block in fv.full_config.get().get("inverter_tentek", [])
+        for device_sn in [block[CONF_DEVICE_SN]] + block[CONF_ADDITIONAL_DEVICES]
+    ]
+    for device_sn in [config[CONF_DEVICE_SN]] + config[CONF_ADDITIONAL_DEVICES]:
+        if serials.count(device_sn) > 1:
+            raise cv.Invalid(f"Device {device_sn} is configured in more than one inverter_tentek block")
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = validate_devices_across_blocks
 
 
 async def to_code(config):
@@ -66,9 +267,71 @@ async def to_code(config):
     cg.add(var.set_email(config[CONF_EMAIL]))
     cg.add(var.set_password(config[CONF_PASSWORD]))
     cg.add(var.set_device_sn(config[CONF_DEVICE_SN]))
+    for base_url in config[CONF_BASE_URLS]:
+        cg.add(var.add_base_url(base_url))
     cg.add(var.set_output_power(config[CONF_OUTPUT_POWER]))
     cg.add(var.set_request_timeout(config[CONF_REQUEST_TIMEOUT]))
     cg.add(var.set_max_retry_count(config[CONF_MAX_RETRY_COUNT]))
+    if CONF_SESSION_LIFETIME in config:
+        cg.add(var.set_session_lifetime(config[CONF_SESSION_LIFETIME]))
+    cg.add(var.set_dns_ttl(config[CONF_DNS_TTL]))
+    cg.add(var.set_restore_state(config[CONF_RESTORE_STATE]))
+
+    # Error classes without a retry_policy entry use the defaults with max_retry_count
+    for name, policy in config[CONF_RETRY_POLICY].items():
+        cg.add(
+            var.set_retry_policy(
+                ERROR_CLASSES[name][0],
+                policy[CONF_MAX_RETRIES],
+                policy[CONF_INITIAL_DELAY],
+                policy[CONF_MAX_DELAY],
+            )
+        )
+    if CONF_COMMAND_DEADLINE in config:
+        cg.add(var.set_command_deadline(config[CONF_COMMAND_DEADLINE]))
+    breaker = config[CONF_CIRCUIT_BREAKER]
+    cg.add(var.set_circuit_breaker(breaker[CONF_FAILURE_THRESHOLD], breaker[CONF_OPEN_DURATION]))
+    rate_limit = config[CONF_RATE_LIMIT]
+    cg.add(var.set_rate_limit(rate_limit[CONF_BURST], rate_limit[CONF_REFILL_INTERVAL]))
+    hedging = config[CONF_HEDGING]
+    cg.add(var.set_hedging(hedging[CONF_ENABLED], hedging[CONF_MIN_DELAY]))
+    policy = config[CONF_TRANSMISSION_POLICY]
+    cg.add(
+        var.set_transmission_policy(
+            policy[CONF_DEADBAND],
+            policy[CONF_ERROR_INTEGRAL_THRESHOLD],
+            policy[CONF_MAX_SILENT_INTERVAL],
+        )
+    )
+
+    # Closed-loop output control from a grid power meter
+    if CONF_ZERO_EXPORT in config:
+        zero_export = config[CONF_ZERO_EXPORT]
+        grid_sensor = await cg.get_variable(zero_export[CONF_GRID_POWER_SENSOR])
+        cg.add(var.set_grid_power_sensor(grid_sensor))
+        cg.add(var.set_target_export(zero_export[CONF_TARGET_EXPORT]))
+        cg.add(var.set_rated_power(zero_export[CONF_RATED_POWER]))
+        cg.add(var.set_pi_gains(zero_export[CONF_KP], zero_export[CONF_KI]))
+        cg.add(
+            var.set_controller_output(
+                zero_export[CONF_MIN_OUTPUT],
+                zero_export[CONF_MAX_OUTPUT],
+                zero_export[CONF_OUTPUT_STEP],
+            )
+        )
+
+    # Place the service working arena in PSRAM (boards with external RAM)
+    if config[CONF_ARENA_IN_PSRAM]:
+        cg.add_build_flag("-DSET_POWER_SERVICE_ARENA_IN_PSRAM=1")
+        add_idf_sdkconfig_option("CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY", True)
+
+    # Device SNs are known at build time: ship the signature tables in flash
+    table = add_signature_table(f"{config[CONF_ID]}_signature_table", config[CONF_DEVICE_SN])
+    cg.add(var.set_signature_table(table))
+    # Further inverters of the account share the login, session and connection
+    for index, device_sn in enumerate(config[CONF_ADDITIONAL_DEVICES], start=1):
+        table = add_signature_table(f"{config[CONF_ID]}_signature_table_{index}", device_sn)
+        cg.add(var.add_device(device_sn, table))
 
 
 # Action: Set Power Output
@@ -79,6 +342,8 @@ async def to_code(config):
         {
             cv.GenerateID(): cv.use_id(InverterTentekComponent),
             cv.Required(CONF_OUTPUT_POWER): cv.templatable(cv.int_range(min=0, max=100)),
+            cv.Optional(CONF_DEADLINE): cv.templatable(cv.positive_time_period_milliseconds),
+            cv.Optional(CONF_DEVICE_SN): cv.templatable(cv.string),
         }
     ),
 )
@@ -89,5 +354,11 @@ async def inverter_set_power_to_code(config, action_id, template_arg, args):
     
     template_ = await cg.templatable(config[CONF_OUTPUT_POWER], args, int)
     cg.add(var.set_power(template_))
+    if CONF_DEADLINE in config:
+        template_ = await cg.templatable(config[CONF_DEADLINE], args, cg.uint32)
+        cg.add(var.set_deadline(template_))
+    if CONF_DEVICE_SN in config:
+        template_ = await cg.templatable(config[CONF_DEVICE_SN], args, cg.std_string)
+        cg.add(var.set_device_sn(template_))
     
     return var
@@ -0,0 +1,254 @@
+/**
+ * @file api_response_parser.c
+ * @brief Incremental parser for MIC POWER API JSON responses
+ */
+
+#include "api_response_parser.h"
+#include <string.h>
+
+/* Role of the next token inside the top-level object */
+enum {
+    ROLE_NONE,          // Before the top-level object
+    ROLE_EXPECT_KEY,    // After '{' or ','
+    ROLE_IN_KEY,        // Inside a key string
+    ROLE_AFTER_KEY,     // Key done, waiting for ':'
+    ROLE_EXPECT_VALUE,  // After ':'
+    ROLE_IN_VALUE,      // Inside (or skipping) a value
+    ROLE_DONE,          // Top-level object closed
+};
+
+/* Top-level fields we extract */
+enum {
+    FIELD_NONE,
+    FIELD_RESULT,
+    FIELD_MSG,
+};
+
+#define RESULT_MAX_DIGITS   9   // Keeps result_code within int32_t
+
+void api_response_parser_reset(api_response_parser_t *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+}
+
+static void add_result_digit(api_response_parser_t *parser, char c)
+{
+    if (parser->digits >= RESULT_MAX_DIGITS || (parser->digits == 1 && parser->result_code == 0)) {
+        parser->result_invalid = true;  // Too long, or a leading zero such as "02"
+        return;
+    }
+    parser->result_code = parser->result_code * 10 + (c - '0');
+    parser->digits++;
+}
+
+static void finish_result(api_response_parser_t *parser)
+{
+    parser->in_number = false;
+    if (parser->digits > 0) {
+        parser->has_result = true;
+        if (parser->negative) {
+            parser->result_code = -parser->result_code;
+        }
+    }
+}
+
+static void finish_key(api_response_parser_t *parser)
+{
+    parser->role = ROLE_AFTER_KEY;
+    if (parser->key_len >= API_RESPONSE_KEY_MAX) {
+        parser->field = FIELD_NONE;  // Too long to be a field we care about
+        return;
+    }
+    parser->key[parser->key_len] = '\0';
+    if (strcmp(parser->key, "result") == 0) {
+        parser->field = FIELD_RESULT;
+    } else if (strcmp(parser->key, "msg") == 0) {
+        parser->field = FIELD_MSG;
+    } else {
+        parser->field = FIELD_NONE;
+    }
+}
+
+static void feed_string_char(api_response_parser_t *parser, char c)
+{
+    if (parser->depth != 1) {
+        return;
+    }
+    
+    if (parser->role == ROLE_IN_KEY) {
+        if (parser->key_len < API_RESPONSE_KEY_MAX - 1) {
+            parser->key[parser->key_len++] = c;
+        } else {
+            parser->key_len = API_RESPONSE_KEY_MAX;  // Mark as overflowed
+        }
+    } else if (parser->role == ROLE_IN_VALUE) {
+        if (parser->field == FIELD_MSG) {
+            if (parser->msg_len < API_RESPONSE_MSG_MAX - 1) {
+                parser->msg[parser->msg_len++] = c;
+                parser->msg[parser->msg_len] = '\0';
+            }
+        } else if (parser->field == FIELD_RESULT) {
+            // Tolerate "result":"0"
+            if (c >= '0' && c <= '9') {
+                add_result_digit(parser, c);
+            } else if (c == '-' && parser->digits == 0) {
+                parser->negative = true;
+            } else {
+                parser->result_invalid = true;
+            }
+        }
+    }
+}
+
+void api_response_parser_feed(api_response_parser_t *parser, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && parser->role != ROLE_DONE; i++) {
+        char c = data[i];
+        
+        if (parser->in_string) {
+            if (parser->escape) {
+                parser->escape = false;
+                feed_string_char(parser, c);
+            } else if (c == '\\') {
+                parser->escape = true;
+            } else if (c == '"') {
+                parser->in_string = false;
+                if (parser->depth == 1) {
+                    if (parser->role == ROLE_IN_KEY) {
+                        finish_key(parser);
+                    } else if (parser->role == ROLE_IN_VALUE && parser->field == FIELD_RESULT) {
+                        finish_result(parser);
+                    }
+                }
+            } else {
+                feed_string_char(parser, c);
+            }
+            continue;
+        }
+        
+        if (parser->in_number) {
+            if (c >= '0' && c <= '9') {
+                add_result_digit(parser, c);
+                continue;
+            }
+            finish_result(parser);
+            // Fall through and handle the terminating character
+        }
+        
+        switch (c) {
+            case '{':
+            case '[':
+                if (parser->depth < UINT8_MAX) {
+                    parser->depth++;
+                }
+                if (parser->depth == 1 && c == '{' && parser->role == ROLE_NONE) {
+                    parser->role = ROLE_EXPECT_KEY;
+                } else if (parser->depth == 2 && parser->role == ROLE_EXPECT_VALUE) {
+                    parser->role = ROLE_IN_VALUE;  // Nested value, skipped
+                }
+                break;
+                
+            case '}':
+            case ']':
+                if (parser->depth > 0) {
+                    parser->depth--;
+                    if (parser->depth == 0 && parser->role != ROLE_NONE) {
+                        parser->role = ROLE_DONE;
+                    }
+                }
+                break;
+                
+            case '"':
+                parser->in_string = true;
+                if (parser->depth == 1) {
+                    if (parser->role == ROLE_EXPECT_KEY) {
+                        parser->role = ROLE_IN_KEY;
+                        parser->key_len = 0;
+                    } else if (parser->role == ROLE_EXPECT_VALUE) {
+                        parser->role = ROLE_IN_VALUE;
+                    }
+                }
+                break;
+                
+            case ':':
+                if (parser->depth == 1 && parser->role == ROLE_AFTER_KEY) {
+                    parser->role = ROLE_EXPECT_VALUE;
+                }
+                break;
+                
+            case ',':
+                if (parser->depth == 1) {
+                    parser->role = ROLE_EXPECT_KEY;
+                    parser->field = FIELD_NONE;
+                }
+                break;
+                
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                break;
+                
+            default:
+                if (parser->depth == 1 && parser->role == ROLE_EXPECT_VALUE) {
+                    parser->role = ROLE_IN_VALUE;
+                    if (parser->field == FIELD_RESULT) {
+                        if (c >= '0' && c <= '9') {
+                            parser->in_number = true;
+                            add_result_digit(parser, c);
+                        } else if (c == '-') {
+                            parser->in_number = true;
+                            parser->negative = true;
+                        }
+                    }
+                }
+                break;
+        }
+    }
+}
+
+api_result_t api_response_parser_result(const api_response_parser_t *parser)
+{
+    bool has_result = parser->has_result || (parser->in_number && parser->digits > 0);
+    
+    if (!has_result) {
+        return API_RESULT_MISSING;
+    }
+    if (parser->result_invalid) {
+        return API_RESULT_UNKNOWN;
+    }
+    
+    int32_t code = parser->result_code;
+    if (parser->in_number && parser->negative) {
+        code = -code;  // Body ended right after the number
+    }
+    
+    switch (code) {
+        case 0:
+            return API_RESULT_SUCCESS;
+        case 2:
+            return API_RESULT_DEVICE_OFFLINE;
+        case 10000:
+            return API_RESULT_SESSION_EXPIRED;
+        default:
+            return API_RESULT_UNKNOWN;
+    }
+}
+
+const char *api_result_to_name(api_result_t result)
+{
+    switch (result) {
+        case API_RESULT_SUCCESS:
+            return "success";
+        case API_RESULT_DEVICE_OFFLINE:
+            return "device offline";
+        case API_RESULT_SESSION_EXPIRED:
+            return "session expired";
+        case API_RESULT_UNKNOWN:
+            return "unknown result";
+        case API_RESULT_MISSING:
+            return "missing result";
+        default:
+            return "invalid";
+    }
+}
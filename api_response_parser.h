@@ -0,0 +1,96 @@
+/**
+ * @file api_response_parser.h
+ * @brief Incremental parser for MIC POWER API JSON responses
+ *
+ * The cloud API answers every request with a small JSON object such as
+ * {"result":0,"msg":"success","obj":{...}}. This parser is fed the body in
+ * arbitrary chunks (as delivered by HTTP_EVENT_ON_DATA, including de-chunked
+ * transfer-encoding data) and extracts the top-level "result" code and "msg"
+ * string in a single pass, without buffering the body.
+ *
+ * Only top-level keys are considered, so a nested "result" inside "obj"
+ * does not affect the outcome, and the numeric value is matched exactly
+ * ("result":02 or "result":10000 are never mistaken for "result":0).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define API_RESPONSE_KEY_MAX    16      // Longest top-level key tracked
+#define API_RESPONSE_MSG_MAX    64      // Captured "msg" length (truncated)
+
+/**
+ * @brief Typed API result code
+ */
+typedef enum {
+    API_RESULT_SUCCESS,          /*!< "result":0 */
+    API_RESULT_DEVICE_OFFLINE,   /*!< "result":2 */
+    API_RESULT_SESSION_EXPIRED,  /*!< "result":10000 */
+    API_RESULT_UNKNOWN,          /*!< Any other result code */
+    API_RESULT_MISSING,          /*!< No top-level "result" field in the body */
+} api_result_t;
+
+/**
+ * @brief Parser state (one per in-flight request)
+ */
+typedef struct {
+    uint8_t depth;               /*!< Current object/array nesting depth */
+    uint8_t role;                /*!< Role of the next top-level token */
+    uint8_t field;               /*!< Field whose value is being parsed */
+    bool in_string;              /*!< Inside a string literal */
+    bool escape;                 /*!< Previous string character was a backslash */
+    bool in_number;              /*!< Inside the "result" number */
+    bool negative;               /*!< "result" number has a leading minus */
+    uint8_t digits;              /*!< Digits parsed for "result" */
+    uint8_t key_len;             /*!< Length of key being captured */
+    char key[API_RESPONSE_KEY_MAX];  /*!< Current top-level key */
+
+    bool has_result;             /*!< A top-level "result" value was parsed */
+    bool result_invalid;         /*!< "result" was not a plain integer (too long, leading zero) */
+    int32_t result_code;         /*!< Parsed "result" value */
+    uint8_t msg_len;             /*!< Length of captured "msg" */
+    char msg[API_RESPONSE_MSG_MAX];  /*!< Captured "msg" value (NUL terminated) */
+} api_response_parser_t;
+
+/**
+ * @brief Reset parser for a new response body
+ *
+ * @param parser Parser to reset
+ */
+void api_response_parser_reset(api_response_parser_t *parser);
+
+/**
+ * @brief Feed a chunk of the response body
+ *
+ * @param parser Parser state
+ * @param data Chunk data (not NUL terminated)
+ * @param len Chunk length in bytes
+ */
+void api_response_parser_feed(api_response_parser_t *parser, const char *data, size_t len);
+
+/**
+ * @brief Get the typed result after the body has been fed
+ *
+ * @param parser Parser state
+ * @return Typed API result
+ */
+api_result_t api_response_parser_result(const api_response_parser_t *parser);
+
+/**
+ * @brief Get a printable name for a typed result
+ *
+ * @param result Typed API result
+ * @return Static string
+ */
+const char *api_result_to_name(api_result_t result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+"""
+Status binary sensors for the Tentek/MIC POWER inverter component
+"""
+
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import binary_sensor
+from esphome.const import DEVICE_CLASS_CONNECTIVITY
+
+from . import CONF_INVERTER_TENTEK_ID, InverterTentekComponent
+
+DEPENDENCIES = ["inverter_tentek"]
+
+CONF_AUTHENTICATED = "authenticated"
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_INVERTER_TENTEK_ID): cv.use_id(InverterTentekComponent),
+        cv.Optional(CONF_AUTHENTICATED): binary_sensor.binary_sensor_schema(
+            device_class=DEVICE_CLASS_CONNECTIVITY,
+        ),
+    }
+)
+
+
+async def to_code(config):
+    """Generate C++ code"""
+    parent = await cg.get_variable(config[CONF_INVERTER_TENTEK_ID])
+    cg.add(parent.set_publish_statistics(True))
+
+    if CONF_AUTHENTICATED in config:
+        sens = await binary_sensor.new_binary_sensor(config[CONF_AUTHENTICATED])
+        cg.add(parent.set_authenticated_binary_sensor(sens))
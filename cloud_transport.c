@@ -0,0 +1,107 @@
+/**
+ * @file cloud_transport.c
+ * @brief Dispatch of cloud transport operations to the backend
+ */
+
+#include "cloud_transport.h"
+#include <stddef.h>
+
+cloud_conn_t *cloud_conn_open(const cloud_transport_t *transport, cloud_header_cb_t on_header,
+                              cloud_body_cb_t on_body, void *ctx)
+{
+    cloud_conn_t *conn = transport->open(transport);
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    conn->transport = transport;
+    conn->state = CLOUD_CONN_IDLE;
+    conn->on_header = on_header;
+    conn->on_body = on_body;
+    conn->ctx = ctx;
+
+    return conn;
+}
+
+esp_err_t cloud_conn_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms)
+{
+    if (conn->state != CLOUD_CONN_IDLE) {
+        conn->err = ESP_ERR_INVALID_STATE;
+        conn->state = CLOUD_CONN_FAILED;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    conn->status_code = 0;
+    conn->err = ESP_OK;
+    conn->reused = false;
+    conn->start_us = 0;
+    conn->resolved_us = 0;
+    conn->connected_us = 0;
+    conn->first_byte_us = 0;
+
+    return conn->transport->start(conn, request, timeout_ms);
+}
+
+bool cloud_conn_busy(const cloud_conn_t *conn)
+{
+    return conn->state == CLOUD_CONN_BUSY;
+}
+
+int cloud_conn_add_fds(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us)
+{
+    if (conn->transport->add_fds == NULL) {
+        return max_fd;
+    }
+
+    return conn->transport->add_fds(conn, read_fds, write_fds, max_fd, wake_us);
+}
+
+void cloud_conn_process(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds)
+{
+    if (conn->transport->process != NULL) {
+        conn->transport->process(conn, read_fds, write_fds);
+    }
+}
+
+void cloud_conn_finish(cloud_conn_t *conn)
+{
+    conn->transport->finish(conn);
+    conn->state = CLOUD_CONN_IDLE;
+}
+
+void cloud_conn_abort(cloud_conn_t *conn)
+{
+    conn->transport->abort(conn);
+    conn->state = CLOUD_CONN_IDLE;
+    conn->open = false;
+}
+
+void cloud_conn_close(cloud_conn_t *conn)
+{
+    if (conn != NULL) {
+        conn->transport->close(conn);
+    }
+}
+
+esp_err_t cloud_transport_watch_host(const cloud_transport_t *transport, const char *host, uint32_t ttl_ms)
+{
+    if (transport->watch_host == NULL) {
+        return ESP_OK;
+    }
+
+    return transport->watch_host(transport, host, ttl_ms);
+}
+
+void cloud_transport_unwatch_host(const cloud_transport_t *transport, const char *host)
+{
+    if (transport->unwatch_host != NULL) {
+        transport->unwatch_host(transport, host);
+    }
+}
+
+void cloud_transport_destroy(cloud_transport_t *transport)
+{
+    if (transport != NULL && transport->destroy != NULL) {
+        transport->destroy(transport);
+    }
+}
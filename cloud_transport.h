@@ -0,0 +1,264 @@
+/**
+ * @file cloud_transport.h
+ * @brief Pluggable transport for the cloud API requests of set_power_service
+ *
+ * The service describes each request (method, host, path, headers, body)
+ * and gets the status, the response headers and the streamed body back
+ * through callbacks. How the bytes travel is up to the backend:
+ *  - cloud_transport_socket(): non-blocking sockets driven by select() (default)
+ *  - cloud_transport_esp_http(): esp_http_client, one blocking request at a time
+ *  - cloud_transport_record_create(): another backend, with every exchange
+ *    appended to a file
+ *  - cloud_transport_replay_create(): answers from such a file, no network
+ *  - mock_cloud_transport() (host build): the mock cloud, served in-process
+ *
+ * A connection carries one request at a time and moves through the same
+ * states for every backend:
+ *
+ *   IDLE -> BUSY -> DONE / FAILED -> (cloud_conn_finish) IDLE
+ *
+ * A connection is not tied to one server: a request to another host or
+ * port than the previous one is sent on a new connection.
+ *
+ * Backends that answer without waiting (a blocking client, a replay) go
+ * from cloud_conn_start() straight to DONE or FAILED. Backends that wait
+ * add their sockets to the owner's select() sets and/or name the time at
+ * which they want to be processed again.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/select.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Request header
+ */
+typedef struct {
+    const char *key;
+    const char *value;
+} cloud_header_t;
+
+/**
+ * @brief Request, only read during cloud_conn_start()
+ *
+ * Host and Content-Length headers are added by the backend.
+ */
+typedef struct {
+    const char *method;              /*!< "POST" or "GET" */
+    const char *host;                /*!< Host name or address */
+    uint16_t port;                   /*!< TCP port */
+    const char *path;                /*!< Absolute path */
+    const cloud_header_t *headers;
+    size_t header_count;
+    const char *body;                /*!< Request body (NULL = none) */
+    size_t body_len;
+} cloud_request_t;
+
+/**
+ * @brief Connection state
+ */
+typedef enum {
+    CLOUD_CONN_IDLE,                 /*!< No request */
+    CLOUD_CONN_BUSY,                 /*!< Request under way */
+    CLOUD_CONN_DONE,                 /*!< Complete response received */
+    CLOUD_CONN_FAILED,               /*!< Request failed, see err */
+} cloud_conn_state_t;
+
+/**
+ * @brief Called for every response header
+ */
+typedef void (*cloud_header_cb_t)(void *ctx, const char *key, const char *value);
+
+/**
+ * @brief Called with each piece of the (de-chunked) response body
+ */
+typedef void (*cloud_body_cb_t)(void *ctx, const char *data, size_t len);
+
+typedef struct cloud_transport cloud_transport_t;
+
+/**
+ * @brief Connection; backends embed it as the first member of their own connection
+ */
+typedef struct {
+    const cloud_transport_t *transport;
+    cloud_conn_state_t state;
+    bool open;                       /*!< Holds a connection the next request can reuse */
+
+    cloud_header_cb_t on_header;
+    cloud_body_cb_t on_body;
+    void *ctx;
+
+    /* Outcome of the last request (valid in DONE and FAILED) */
+    int status_code;                 /*!< HTTP status of the response */
+    esp_err_t err;                   /*!< Failure reason when FAILED */
+    bool reused;                     /*!< Request went out on an already open connection */
+    int64_t start_us;                /*!< Start of the attempt that produced the outcome */
+    int64_t resolved_us;             /*!< Peer address known (0 = reused, or not reported by the backend) */
+    int64_t connected_us;            /*!< Connection established (0 = reused) */
+    int64_t first_byte_us;           /*!< First response byte (0 = none) */
+} cloud_conn_t;
+
+/**
+ * @brief Backend operations
+ */
+struct cloud_transport {
+    const char *name;
+
+    /** Allocate an idle connection (base fields are set by cloud_conn_open()) */
+    cloud_conn_t *(*open)(const cloud_transport_t *transport);
+    /** Start a request on an IDLE connection, first dropping a connection open to another
+     *  host or port; on failure the connection is FAILED */
+    esp_err_t (*start)(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms);
+    /** Add sockets to wait on and lower *wake_us to when processing is due (optional) */
+    int (*add_fds)(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us);
+    /** Advance the connection after select() returned or a wake time passed (optional) */
+    void (*process)(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds);
+    /** Return a DONE or FAILED connection to IDLE */
+    void (*finish)(cloud_conn_t *conn);
+    /** Abort a request in any state, dropping the connection */
+    void (*abort)(cloud_conn_t *conn);
+    /** Close and free the connection */
+    void (*close)(cloud_conn_t *conn);
+    /** Free the transport itself (NULL for static transports) */
+    void (*destroy)(cloud_transport_t *transport);
+    /** Keep a host name resolved ahead of requests, for ttl_ms at a time (optional) */
+    esp_err_t (*watch_host)(const cloud_transport_t *transport, const char *host, uint32_t ttl_ms);
+    /** Undo one watch_host() (optional) */
+    void (*unwatch_host)(const cloud_transport_t *transport, const char *host);
+
+    void *ctx;                       /*!< Backend data */
+};
+
+/**
+ * @brief Open a connection on a transport
+ *
+ * @param on_header Header callback (NULL = none)
+ * @param on_body Body callback (NULL = body discarded)
+ * @param ctx Passed to the callbacks
+ * @return Connection, or NULL if out of memory
+ */
+cloud_conn_t *cloud_conn_open(const cloud_transport_t *transport, cloud_header_cb_t on_header,
+                              cloud_body_cb_t on_body, void *ctx);
+
+/**
+ * @brief Start a request
+ *
+ * @param timeout_ms Time allowed for the whole request
+ * @return ESP_OK if the request is under way or already complete; otherwise
+ *         the connection is FAILED with the same error
+ */
+esp_err_t cloud_conn_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms);
+
+/**
+ * @brief Check whether a request is under way
+ */
+bool cloud_conn_busy(const cloud_conn_t *conn);
+
+/**
+ * @brief Add the connection's sockets to the select() sets
+ *
+ * @param wake_us Lowered to the time the connection must be processed at
+ *                (timeouts, simulated latency), even without socket activity
+ * @return Highest descriptor in the sets (max of @p max_fd and the connection's)
+ */
+int cloud_conn_add_fds(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us);
+
+/**
+ * @brief Advance the connection after select() returned
+ */
+void cloud_conn_process(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds);
+
+/**
+ * @brief Return a DONE or FAILED connection to IDLE
+ */
+void cloud_conn_finish(cloud_conn_t *conn);
+
+/**
+ * @brief Abort a request in any state, dropping the connection
+ */
+void cloud_conn_abort(cloud_conn_t *conn);
+
+/**
+ * @brief Close and free a connection (NULL is ignored)
+ */
+void cloud_conn_close(cloud_conn_t *conn);
+
+/**
+ * @brief Have the backend resolve a host ahead of its requests and keep it resolved
+ *
+ * Backends that resolve names themselves (or need none) ignore this.
+ *
+ * @param ttl_ms How long a resolved address is used before it is resolved again
+ * @return ESP_OK, or an error if the backend cannot watch one more host
+ */
+esp_err_t cloud_transport_watch_host(const cloud_transport_t *transport, const char *host, uint32_t ttl_ms);
+
+/**
+ * @brief Undo one cloud_transport_watch_host()
+ */
+void cloud_transport_unwatch_host(const cloud_transport_t *transport, const char *host);
+
+/**
+ * @brief Free a transport created by one of the *_create() functions (NULL is ignored)
+ */
+void cloud_transport_destroy(cloud_transport_t *transport);
+
+/**
+ * @brief Non-blocking socket transport (HTTP/1.1 keep-alive, http:// only)
+ *
+ * A request that fails on a reused connection before any response byte
+ * arrived most likely hit a connection the server had dropped; it is sent
+ * once more on a new connection. Host names are resolved through the DNS
+ * cache (dns_cache.h); watched hosts are kept resolved in the background.
+ */
+const cloud_transport_t *cloud_transport_socket(void);
+
+/**
+ * @brief esp_http_client transport
+ *
+ * Each request runs to completion inside cloud_conn_start(), so the service
+ * task does not take setpoints while it waits for the cloud. esp_http_client
+ * resolves host names itself, without the DNS cache.
+ */
+const cloud_transport_t *cloud_transport_esp_http(void);
+
+/**
+ * @brief Record every exchange of another transport to a file
+ *
+ * Requests (headers and body) and responses (status, headers, body and
+ * timing) are appended as text; the file can be read back with
+ * cloud_transport_replay_create().
+ *
+ * Not thread-safe: one service instance per record transport.
+ *
+ * @param inner Transport doing the actual requests (must outlive the recorder)
+ * @param path File to write (truncated)
+ * @return Transport, or NULL if the file cannot be opened
+ */
+cloud_transport_t *cloud_transport_record_create(const cloud_transport_t *inner, const char *path);
+
+/**
+ * @brief Answer requests from a recording, without network
+ *
+ * Each request gets the first unused recorded exchange with the same
+ * method and path; once all of them were used they are served again from
+ * the start. Not thread-safe: one service instance per replay transport.
+ *
+ * @param path Recording written by cloud_transport_record_create()
+ * @param realtime Answer after the recorded connect/first byte/total times
+ *                 instead of at once
+ * @return Transport, or NULL if the file cannot be read
+ */
+cloud_transport_t *cloud_transport_replay_create(const char *path, bool realtime);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,211 @@
+/**
+ * @file cloud_transport_esp_http.c
+ * @brief Cloud transport over esp_http_client (blocking)
+ */
+
+#include "cloud_transport.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "CLOUD_ESP_HTTP";
+
+#define ESP_HTTP_URL_SIZE       192
+#define ESP_HTTP_MAX_HEADERS    12      // Headers of one request, deleted before the next one
+#define ESP_HTTP_KEY_SIZE       32
+
+typedef struct {
+    cloud_conn_t base;
+    esp_http_client_handle_t client;
+    bool connected;                  // ON_CONNECTED seen during this attempt
+    char header_keys[ESP_HTTP_MAX_HEADERS][ESP_HTTP_KEY_SIZE];
+    size_t header_key_count;
+} esp_http_conn_t;
+
+static esp_err_t esp_http_event_handler(esp_http_client_event_t *evt)
+{
+    esp_http_conn_t *hc = evt->user_data;
+    cloud_conn_t *conn = &hc->base;
+
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            hc->connected = true;
+            conn->connected_us = esp_timer_get_time();
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (conn->first_byte_us == 0) {
+                conn->first_byte_us = esp_timer_get_time();
+            }
+            if (conn->on_header != NULL) {
+                conn->on_header(conn->ctx, evt->header_key, evt->header_value);
+            }
+            break;
+        case HTTP_EVENT_ON_DATA:
+            if (conn->first_byte_us == 0) {
+                conn->first_byte_us = esp_timer_get_time();
+            }
+            if (conn->on_body != NULL) {
+                conn->on_body(conn->ctx, evt->data, (size_t)evt->data_len);
+            }
+            break;
+        case HTTP_EVENT_DISCONNECTED:
+            conn->open = false;
+            break;
+        default:
+            break;
+    }
+
+    return ESP_OK;
+}
+
+static cloud_conn_t *esp_http_open(const cloud_transport_t *transport)
+{
+    esp_http_conn_t *hc = calloc(1, sizeof(*hc));
+    return (hc != NULL) ? &hc->base : NULL;
+}
+
+/**
+ * @brief Replace the headers of the previous request with those of @p request
+ */
+static esp_err_t set_headers(esp_http_conn_t *hc, const cloud_request_t *request)
+{
+    for (size_t i = 0; i < hc->header_key_count; i++) {
+        esp_http_client_delete_header(hc->client, hc->header_keys[i]);
+    }
+    hc->header_key_count = 0;
+
+    for (size_t i = 0; i < request->header_count; i++) {
+        const cloud_header_t *header = &request->headers[i];
+        if (hc->header_key_count == ESP_HTTP_MAX_HEADERS || strlen(header->key) >= ESP_HTTP_KEY_SIZE) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = esp_http_client_set_header(hc->client, header->key, header->value);
+        if (err != ESP_OK) {
+            return err;
+        }
+        strcpy(hc->header_keys[hc->header_key_count++], header->key);
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Run one attempt of the request to completion
+ */
+static esp_err_t perform(esp_http_conn_t *hc)
+{
+    cloud_conn_t *conn = &hc->base;
+
+    hc->connected = false;
+    conn->start_us = esp_timer_get_time();
+    conn->connected_us = 0;
+    conn->first_byte_us = 0;
+    conn->open = true;  // Cleared by a DISCONNECTED event
+
+    esp_err_t err = esp_http_client_perform(hc->client);
+    conn->reused = !hc->connected;
+
+    return err;
+}
+
+static esp_err_t esp_http_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms)
+{
+    esp_http_conn_t *hc = (esp_http_conn_t *)conn;
+    char url[ESP_HTTP_URL_SIZE];
+
+    int len = snprintf(url, sizeof(url), "http://%s:%u%s", request->host, request->port, request->path);
+    esp_err_t err = (len > 0 && (size_t)len < sizeof(url)) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+
+    if (err == ESP_OK && hc->client == NULL) {
+        esp_http_client_config_t config = {
+            .url = url,
+            .timeout_ms = (int)timeout_ms,
+            .event_handler = esp_http_event_handler,
+            .user_data = hc,
+            .buffer_size = 512,
+            .buffer_size_tx = 512,
+            .keep_alive_enable = true,
+        };
+        hc->client = esp_http_client_init(&config);
+        if (hc->client == NULL) {
+            err = ESP_ERR_NO_MEM;
+        }
+    } else if (err == ESP_OK) {
+        err = esp_http_client_set_url(hc->client, url);
+        esp_http_client_set_timeout_ms(hc->client, (int)timeout_ms);
+    }
+    if (err == ESP_OK) {
+        bool get = (strcmp(request->method, "GET") == 0);
+        esp_http_client_set_method(hc->client, get ? HTTP_METHOD_GET : HTTP_METHOD_POST);
+        esp_http_client_set_post_field(hc->client, request->body, (int)request->body_len);
+        err = set_headers(hc, request);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up request to %s: %s", request->path, esp_err_to_name(err));
+        conn->err = err;
+        conn->state = CLOUD_CONN_FAILED;
+        return err;
+    }
+
+    err = perform(hc);
+    if (err != ESP_OK && conn->reused && conn->first_byte_us == 0) {
+        // Most likely a keep-alive connection the server had dropped
+        ESP_LOGW(TAG, "Keep-alive connection lost (%s), reconnecting...", esp_err_to_name(err));
+        esp_http_client_close(hc->client);
+        err = perform(hc);
+    }
+
+    if (err == ESP_OK) {
+        conn->status_code = esp_http_client_get_status_code(hc->client);
+        conn->state = CLOUD_CONN_DONE;
+    } else {
+        esp_http_client_close(hc->client);
+        conn->open = false;
+        conn->err = err;
+        conn->state = CLOUD_CONN_FAILED;
+    }
+
+    return err;
+}
+
+static void esp_http_finish(cloud_conn_t *conn)
+{
+    // Nothing to do: the client keeps or drops its connection by itself
+}
+
+static void esp_http_abort(cloud_conn_t *conn)
+{
+    esp_http_conn_t *hc = (esp_http_conn_t *)conn;
+
+    if (hc->client != NULL) {
+        esp_http_client_close(hc->client);
+    }
+}
+
+static void esp_http_close(cloud_conn_t *conn)
+{
+    esp_http_conn_t *hc = (esp_http_conn_t *)conn;
+
+    if (hc->client != NULL) {
+        esp_http_client_cleanup(hc->client);
+    }
+    free(hc);
+}
+
+static const cloud_transport_t s_esp_http_transport = {
+    .name = "esp_http_client",
+    .open = esp_http_open,
+    .start = esp_http_start,
+    .finish = esp_http_finish,
+    .abort = esp_http_abort,
+    .close = esp_http_close,
+};
+
+const cloud_transport_t *cloud_transport_esp_http(void)
+{
+    return &s_esp_http_transport;
+}
@@ -0,0 +1,672 @@
+/**
+ * @file cloud_transport_record.c
+ * @brief Record cloud exchanges to a file and replay them without network
+ *
+ * A recording is text, one exchange after the other:
+ *
+ *   EXCHANGE POST /v1/user/login
+ *   > Content-Type: application/x-www-form-urlencoded      (request headers)
+ *   REQUEST-BODY 98
+ *   <98 bytes>
+ *   RESULT status=200 err=0x0 reused=0 connect_us=812 ttfb_us=20311 total_us=20420 dns_us=35
+ *   < Set-Cookie: JSESSIONID=...; Path=/                   (response headers)
+ *   BODY 49
+ *   <49 bytes>
+ *   END
+ *
+ * dns_us (name resolution) is missing in older recordings. Lines starting
+ * with '#' are comments. Only what fits in the per-connection
+ * buffers is recorded; longer headers or bodies are cut (and flagged with
+ * "# truncated").
+ */
+
+#include "cloud_transport.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CLOUD_RECORD";
+
+#define RECORD_TEXT_SIZE        1024    // Request headers, request body, response headers and body (each)
+#define RECORD_LINE_SIZE        1024    // Longest line read back from a recording
+#define RECORD_PATH_SIZE        128
+
+/* ---------------------------------------------------------------------------
+ * Recorder
+ * ------------------------------------------------------------------------- */
+
+typedef struct {
+    cloud_transport_t transport;
+    const cloud_transport_t *inner;
+    FILE *file;
+    uint32_t exchanges;
+} recorder_t;
+
+typedef struct {
+    char data[RECORD_TEXT_SIZE];
+    size_t len;
+} record_text_t;
+
+typedef struct {
+    cloud_conn_t base;
+    cloud_conn_t *inner;
+    recorder_t *recorder;
+    bool pending;                    // Exchange in progress, not written yet
+    bool truncated;
+    char method[8];
+    char path[RECORD_PATH_SIZE];
+    record_text_t request_headers;
+    record_text_t request_body;
+    record_text_t response_headers;
+    record_text_t response_body;
+} record_conn_t;
+
+/**
+ * @brief Append to a text buffer, cutting what does not fit
+ */
+static void text_append(record_conn_t *rc, record_text_t *text, const char *data, size_t len)
+{
+    size_t room = sizeof(text->data) - text->len;
+    if (len > room) {
+        len = room;
+        rc->truncated = true;
+    }
+    memcpy(text->data + text->len, data, len);
+    text->len += len;
+}
+
+static void text_append_header(record_conn_t *rc, record_text_t *text, const char *key, const char *value)
+{
+    text_append(rc, text, key, strlen(key));
+    text_append(rc, text, ": ", 2);
+    text_append(rc, text, value, strlen(value));
+    text_append(rc, text, "\n", 1);
+}
+
+static void record_on_header(void *ctx, const char *key, const char *value)
+{
+    record_conn_t *rc = ctx;
+
+    text_append_header(rc, &rc->response_headers, key, value);
+    if (rc->base.on_header != NULL) {
+        rc->base.on_header(rc->base.ctx, key, value);
+    }
+}
+
+static void record_on_body(void *ctx, const char *data, size_t len)
+{
+    record_conn_t *rc = ctx;
+
+    text_append(rc, &rc->response_body, data, len);
+    if (rc->base.on_body != NULL) {
+        rc->base.on_body(rc->base.ctx, data, len);
+    }
+}
+
+/**
+ * @brief Copy the state of the inner connection
+ */
+static void record_sync(record_conn_t *rc)
+{
+    const cloud_conn_t *inner = rc->inner;
+    cloud_conn_t *conn = &rc->base;
+
+    conn->state = inner->state;
+    conn->open = inner->open;
+    conn->status_code = inner->status_code;
+    conn->err = inner->err;
+    conn->reused = inner->reused;
+    conn->start_us = inner->start_us;
+    conn->resolved_us = inner->resolved_us;
+    conn->connected_us = inner->connected_us;
+    conn->first_byte_us = inner->first_byte_us;
+}
+
+/**
+ * @brief Write each line of a text buffer with a prefix
+ */
+static void write_lines(FILE *file, const char *prefix, const record_text_t *text)
+{
+    size_t pos = 0;
+
+    while (pos < text->len) {
+        const char *lf = memchr(text->data + pos, '\n', text->len - pos);
+        size_t line_len = (lf != NULL) ? (size_t)(lf - (text->data + pos)) : text->len - pos;
+        fprintf(file, "%s%.*s\n", prefix, (int)line_len, text->data + pos);
+        pos += line_len + 1;
+    }
+}
+
+/**
+ * @brief Append the finished exchange to the recording
+ */
+static void write_exchange(record_conn_t *rc)
+{
+    const cloud_conn_t *conn = &rc->base;
+    FILE *file = rc->recorder->file;
+    int64_t start_us = conn->start_us;
+
+    rc->pending = false;
+
+    fprintf(file, "EXCHANGE %s %s\n", rc->method, rc->path);
+    if (rc->truncated) {
+        fprintf(file, "# truncated\n");
+    }
+    write_lines(file, "> ", &rc->request_headers);
+    fprintf(file, "REQUEST-BODY %u\n", (unsigned)rc->request_body.len);
+    fwrite(rc->request_body.data, 1, rc->request_body.len, file);
+    fprintf(file, "\n");
+
+    fprintf(file, "RESULT status=%d err=0x%x reused=%d connect_us=%" PRId64 " ttfb_us=%" PRId64 " total_us=%" PRId64 " dns_us=%" PRId64 "\n",
+            conn->status_code, (unsigned)conn->err, conn->reused ? 1 : 0,
+            (conn->connected_us != 0) ? conn->connected_us - start_us : 0,
+            (conn->first_byte_us != 0) ? conn->first_byte_us - start_us : 0,
+            esp_timer_get_time() - start_us,
+            (conn->resolved_us != 0) ? conn->resolved_us - start_us : 0);
+    write_lines(file, "< ", &rc->response_headers);
+    fprintf(file, "BODY %u\n", (unsigned)rc->response_body.len);
+    fwrite(rc->response_body.data, 1, rc->response_body.len, file);
+    fprintf(file, "\nEND\n");
+
+    // Keep what was recorded so far if the program does not exit cleanly
+    fflush(file);
+    rc->recorder->exchanges++;
+}
+
+/**
+ * @brief Write the exchange once the inner request ended
+ */
+static void record_update(record_conn_t *rc)
+{
+    record_sync(rc);
+
+    if (rc->pending && (rc->base.state == CLOUD_CONN_DONE || rc->base.state == CLOUD_CONN_FAILED)) {
+        write_exchange(rc);
+    }
+}
+
+static cloud_conn_t *record_open(const cloud_transport_t *transport)
+{
+    recorder_t *recorder = transport->ctx;
+    record_conn_t *rc = calloc(1, sizeof(*rc));
+    if (rc == NULL) {
+        return NULL;
+    }
+
+    rc->recorder = recorder;
+    rc->inner = cloud_conn_open(recorder->inner, record_on_header, record_on_body, rc);
+    if (rc->inner == NULL) {
+        free(rc);
+        return NULL;
+    }
+
+    return &rc->base;
+}
+
+static esp_err_t record_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms)
+{
+    record_conn_t *rc = (record_conn_t *)conn;
+
+    snprintf(rc->method, sizeof(rc->method), "%s", request->method);
+    snprintf(rc->path, sizeof(rc->path), "%s", request->path);
+    rc->truncated = false;
+    rc->request_headers.len = 0;
+    rc->request_body.len = 0;
+    rc->response_headers.len = 0;
+    rc->response_body.len = 0;
+    for (size_t i = 0; i < request->header_count; i++) {
+        text_append_header(rc, &rc->request_headers, request->headers[i].key, request->headers[i].value);
+    }
+    if (request->body_len > 0) {
+        text_append(rc, &rc->request_body, request->body, request->body_len);
+    }
+    rc->pending = true;
+
+    esp_err_t err = cloud_conn_start(rc->inner, request, timeout_ms);
+    record_update(rc);
+
+    return err;
+}
+
+static int record_add_fds(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us)
+{
+    record_conn_t *rc = (record_conn_t *)conn;
+
+    return cloud_conn_add_fds(rc->inner, read_fds, write_fds, max_fd, wake_us);
+}
+
+static void record_process(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds)
+{
+    record_conn_t *rc = (record_conn_t *)conn;
+
+    cloud_conn_process(rc->inner, read_fds, write_fds);
+    record_update(rc);
+}
+
+static void record_finish(cloud_conn_t *conn)
+{
+    record_conn_t *rc = (record_conn_t *)conn;
+
+    cloud_conn_finish(rc->inner);
+    record_sync(rc);
+}
+
+static void record_abort(cloud_conn_t *conn)
+{
+    record_conn_t *rc = (record_conn_t *)conn;
+
+    // An aborted exchange has no outcome worth replaying
+    rc->pending = false;
+    cloud_conn_abort(rc->inner);
+    record_sync(rc);
+}
+
+static void record_close(cloud_conn_t *conn)
+{
+    record_conn_t *rc = (record_conn_t *)conn;
+
+    cloud_conn_close(rc->inner);
+    free(rc);
+}
+
+static esp_err_t record_watch_host(const cloud_transport_t *transport, const char *host, uint32_t ttl_ms)
+{
+    const recorder_t *recorder = transport->ctx;
+
+    return cloud_transport_watch_host(recorder->inner, host, ttl_ms);
+}
+
+static void record_unwatch_host(const cloud_transport_t *transport, const char *host)
+{
+    const recorder_t *recorder = transport->ctx;
+
+    cloud_transport_unwatch_host(recorder->inner, host);
+}
+
+static void record_destroy(cloud_transport_t *transport)
+{
+    recorder_t *recorder = transport->ctx;
+
+    ESP_LOGI(TAG, "Recorded %" PRIu32 " exchange(s)", recorder->exchanges);
+    fclose(recorder->file);
+    free(recorder);
+}
+
+cloud_transport_t *cloud_transport_record_create(const cloud_transport_t *inner, const char *path)
+{
+    recorder_t *recorder = calloc(1, sizeof(*recorder));
+    if (recorder == NULL) {
+        return NULL;
+    }
+
+    recorder->file = fopen(path, "w");
+    if (recorder->file == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s for recording", path);
+        free(recorder);
+        return NULL;
+    }
+    fprintf(recorder->file, "# Cloud exchanges recorded through the %s transport\n", inner->name);
+
+    recorder->inner = inner;
+    recorder->transport = (cloud_transport_t) {
+        .name = "record",
+        .open = record_open,
+        .start = record_start,
+        .add_fds = record_add_fds,
+        .process = record_process,
+        .finish = record_finish,
+        .abort = record_abort,
+        .close = record_close,
+        .destroy = record_destroy,
+        .watch_host = record_watch_host,
+        .unwatch_host = record_unwatch_host,
+        .ctx = recorder,
+    };
+
+    return &recorder->transport;
+}
+
+/* ---------------------------------------------------------------------------
+ * Player
+ * ------------------------------------------------------------------------- */
+
+typedef struct {
+    char method[8];
+    char path[RECORD_PATH_SIZE];
+    int status_code;
+    esp_err_t err;
+    bool reused;
+    int64_t dns_us;                  // -1 = not recorded
+    int64_t connect_us;
+    int64_t ttfb_us;
+    int64_t total_us;
+    char *headers;                   // "key: value\n" lines
+    size_t headers_len;
+    char *body;
+    size_t body_len;
+    bool used;
+} replay_exchange_t;
+
+typedef struct {
+    cloud_transport_t transport;
+    replay_exchange_t *exchanges;
+    size_t count;
+    bool realtime;
+} player_t;
+
+typedef struct {
+    cloud_conn_t base;
+    player_t *player;
+    const replay_exchange_t *exchange;
+    int64_t due_us;
+} replay_conn_t;
+
+static void free_exchange(replay_exchange_t *exchange)
+{
+    free(exchange->headers);
+    free(exchange->body);
+}
+
+/**
+ * @brief Read a length-prefixed block and the newline after it
+ *
+ * @param out Receives a malloc'ed copy (NULL = skip the block)
+ */
+static bool read_block(FILE *file, size_t len, char **out)
+{
+    char *data = malloc(len + 1);
+    if (data == NULL || fread(data, 1, len, file) != len) {
+        free(data);
+        return false;
+    }
+    data[len] = '\0';
+    fgetc(file);
+
+    if (out != NULL) {
+        *out = data;
+    } else {
+        free(data);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Load every exchange of a recording
+ */
+static bool load_recording(player_t *player, FILE *file)
+{
+    char line[RECORD_LINE_SIZE];
+    replay_exchange_t current;
+    bool in_exchange = false;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        unsigned len;
+        unsigned err;
+        int reused;
+
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+        if (strncmp(line, "EXCHANGE ", 9) == 0) {
+            memset(&current, 0, sizeof(current));
+            if (sscanf(line + 9, "%7s %127s", current.method, current.path) != 2) {
+                return false;
+            }
+            in_exchange = true;
+        } else if (!in_exchange) {
+            return false;
+        } else if (strncmp(line, "> ", 2) == 0) {
+            continue;  // Request headers are for the reader only
+        } else if (sscanf(line, "REQUEST-BODY %u", &len) == 1) {
+            if (!read_block(file, len, NULL)) {
+                return false;
+            }
+        } else if (sscanf(line, "RESULT status=%d err=%x reused=%d connect_us=%" SCNd64 " ttfb_us=%" SCNd64
+                          " total_us=%" SCNd64, &current.status_code, &err, &reused, &current.connect_us,
+                          &current.ttfb_us, &current.total_us) == 6) {
+            current.err = (esp_err_t)err;
+            current.reused = (reused != 0);
+            const char *dns = strstr(line, " dns_us=");
+            if (dns == NULL || sscanf(dns, " dns_us=%" SCNd64, &current.dns_us) != 1) {
+                current.dns_us = -1;
+            }
+        } else if (strncmp(line, "< ", 2) == 0) {
+            size_t add = strlen(line + 2);
+            char *grown = realloc(current.headers, current.headers_len + add + 2);
+            if (grown == NULL) {
+                return false;
+            }
+            current.headers = grown;
+            memcpy(current.headers + current.headers_len, line + 2, add);
+            current.headers_len += add;
+            current.headers[current.headers_len++] = '\n';
+            current.headers[current.headers_len] = '\0';
+        } else if (sscanf(line, "BODY %u", &len) == 1) {
+            if (!read_block(file, len, &current.body)) {
+                return false;
+            }
+            current.body_len = len;
+        } else if (strcmp(line, "END") == 0) {
+            replay_exchange_t *grown = realloc(player->exchanges, (player->count + 1) * sizeof(*grown));
+            if (grown == NULL) {
+                free_exchange(&current);
+                return false;
+            }
+            player->exchanges = grown;
+            player->exchanges[player->count++] = current;
+            in_exchange = false;
+        } else {
+            return false;
+        }
+    }
+
+    if (in_exchange) {
+        free_exchange(&current);  // Cut off while recording
+    }
+
+    return true;
+}
+
+/**
+ * @brief Take the next unused exchange for a request, starting over once all were used
+ */
+static const replay_exchange_t *take_exchange(player_t *player, const char *method, const char *path)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        bool any = false;
+        for (size_t i = 0; i < player->count; i++) {
+            replay_exchange_t *exchange = &player->exchanges[i];
+            if (strcmp(exchange->method, method) != 0 || strcmp(exchange->path, path) != 0) {
+                continue;
+            }
+            any = true;
+            if (!exchange->used) {
+                exchange->used = true;
+                return exchange;
+            }
+        }
+        if (!any) {
+            return NULL;
+        }
+
+        ESP_LOGD(TAG, "All recordings of %s %s used, starting over", method, path);
+        for (size_t i = 0; i < player->count; i++) {
+            if (strcmp(player->exchanges[i].path, path) == 0 && strcmp(player->exchanges[i].method, method) == 0) {
+                player->exchanges[i].used = false;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Hand the recorded response to the connection's owner
+ */
+static void replay_deliver(replay_conn_t *rp)
+{
+    const replay_exchange_t *exchange = rp->exchange;
+    cloud_conn_t *conn = &rp->base;
+    int64_t scale = rp->player->realtime ? 1 : 0;
+
+    conn->reused = exchange->reused;
+    conn->resolved_us = (exchange->reused || exchange->dns_us < 0) ? 0 : conn->start_us + scale * exchange->dns_us;
+    conn->connected_us = exchange->reused ? 0 : conn->start_us + scale * exchange->connect_us;
+    conn->first_byte_us = (exchange->ttfb_us != 0) ? conn->start_us + scale * exchange->ttfb_us : 0;
+
+    if (exchange->err != ESP_OK) {
+        conn->err = exchange->err;
+        conn->open = false;
+        conn->state = CLOUD_CONN_FAILED;
+        return;
+    }
+
+    const char *pos = exchange->headers;
+    while (pos != NULL && *pos != '\0') {
+        char header[RECORD_LINE_SIZE];
+        size_t len = strcspn(pos, "\n");
+        snprintf(header, sizeof(header), "%.*s", (int)len, pos);
+        pos += len + (pos[len] == '\n' ? 1 : 0);
+
+        char *colon = strchr(header, ':');
+        if (colon == NULL || conn->on_header == NULL) {
+            continue;
+        }
+        *colon = '\0';
+        const char *value = colon + 1;
+        while (*value == ' ') {
+            value++;
+        }
+        conn->on_header(conn->ctx, header, value);
+    }
+    if (exchange->body_len > 0 && conn->on_body != NULL) {
+        conn->on_body(conn->ctx, exchange->body, exchange->body_len);
+    }
+
+    conn->status_code = exchange->status_code;
+    conn->open = true;
+    conn->state = CLOUD_CONN_DONE;
+}
+
+static cloud_conn_t *replay_open(const cloud_transport_t *transport)
+{
+    replay_conn_t *rp = calloc(1, sizeof(*rp));
+    if (rp == NULL) {
+        return NULL;
+    }
+
+    rp->player = transport->ctx;
+
+    return &rp->base;
+}
+
+static esp_err_t replay_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms)
+{
+    replay_conn_t *rp = (replay_conn_t *)conn;
+
+    rp->exchange = take_exchange(rp->player, request->method, request->path);
+    if (rp->exchange == NULL) {
+        ESP_LOGE(TAG, "No recorded exchange for %s %s", request->method, request->path);
+        conn->err = ESP_ERR_NOT_FOUND;
+        conn->state = CLOUD_CONN_FAILED;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    conn->start_us = esp_timer_get_time();
+    if (rp->player->realtime && rp->exchange->total_us > 0) {
+        rp->due_us = conn->start_us + rp->exchange->total_us;
+        conn->state = CLOUD_CONN_BUSY;
+    } else {
+        replay_deliver(rp);
+    }
+
+    return ESP_OK;
+}
+
+static int replay_add_fds(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us)
+{
+    replay_conn_t *rp = (replay_conn_t *)conn;
+
+    if (conn->state == CLOUD_CONN_BUSY && rp->due_us < *wake_us) {
+        *wake_us = rp->due_us;
+    }
+
+    return max_fd;
+}
+
+static void replay_process(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds)
+{
+    replay_conn_t *rp = (replay_conn_t *)conn;
+
+    if (conn->state == CLOUD_CONN_BUSY && esp_timer_get_time() >= rp->due_us) {
+        replay_deliver(rp);
+    }
+}
+
+static void replay_finish(cloud_conn_t *conn)
+{
+}
+
+static void replay_abort(cloud_conn_t *conn)
+{
+}
+
+static void replay_close(cloud_conn_t *conn)
+{
+    free(conn);
+}
+
+static void replay_destroy(cloud_transport_t *transport)
+{
+    player_t *player = transport->ctx;
+
+    for (size_t i = 0; i < player->count; i++) {
+        free_exchange(&player->exchanges[i]);
+    }
+    free(player->exchanges);
+    free(player);
+}
+
+cloud_transport_t *cloud_transport_replay_create(const char *path, bool realtime)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "Cannot open recording %s", path);
+        return NULL;
+    }
+
+    player_t *player = calloc(1, sizeof(*player));
+    if (player == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    player->realtime = realtime;
+    player->transport = (cloud_transport_t) {
+        .name = "replay",
+        .open = replay_open,
+        .start = replay_start,
+        .add_fds = replay_add_fds,
+        .process = replay_process,
+        .finish = replay_finish,
+        .abort = replay_abort,
+        .close = replay_close,
+        .destroy = replay_destroy,
+        .ctx = player,
+    };
+
+    bool loaded = load_recording(player, file);
+    fclose(file);
+    if (!loaded || player->count == 0) {
+        ESP_LOGE(TAG, "Recording %s is empty or malformed", path);
+        replay_destroy(&player->transport);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "Loaded %u exchange(s) from %s", (unsigned)player->count, path);
+
+    return &player->transport;
+}
@@ -0,0 +1,228 @@
+/**
+ * @file cloud_transport_socket.c
+ * @brief Cloud transport over non-blocking sockets (http_conn)
+ */
+
+#include "cloud_transport.h"
+#include "http_conn.h"
+#include "dns_cache.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CLOUD_SOCKET";
+
+#define SOCKET_TX_SIZE          1024    // Serialized request (head and body)
+
+typedef struct {
+    cloud_conn_t base;
+    http_conn_t http;
+    char host[HTTP_CONN_HOST_MAX];
+    uint16_t port;
+    uint32_t timeout_ms;
+    bool replayed;                   // Already sent again after a stale keep-alive socket
+    char tx[SOCKET_TX_SIZE];
+    size_t tx_len;
+} socket_conn_t;
+
+static void socket_on_header(void *ctx, const char *key, const char *value)
+{
+    cloud_conn_t *conn = ctx;
+
+    if (conn->on_header != NULL) {
+        conn->on_header(conn->ctx, key, value);
+    }
+}
+
+static void socket_on_body(void *ctx, const char *data, size_t len)
+{
+    cloud_conn_t *conn = ctx;
+
+    if (conn->on_body != NULL) {
+        conn->on_body(conn->ctx, data, len);
+    }
+}
+
+/**
+ * @brief Copy the state of the HTTP connection into the generic connection
+ */
+static void sync_state(socket_conn_t *sock)
+{
+    const http_conn_t *http = &sock->http;
+    cloud_conn_t *conn = &sock->base;
+
+    switch (http->state) {
+        case HTTP_CONN_IDLE:   conn->state = CLOUD_CONN_IDLE;   break;
+        case HTTP_CONN_DONE:   conn->state = CLOUD_CONN_DONE;   break;
+        case HTTP_CONN_FAILED: conn->state = CLOUD_CONN_FAILED; break;
+        default:               conn->state = CLOUD_CONN_BUSY;   break;
+    }
+    conn->open = (http->fd >= 0);
+    conn->status_code = http->status_code;
+    conn->err = http->err;
+    conn->reused = http->reused;
+    conn->start_us = http->start_us;
+    conn->resolved_us = http->resolved_us;
+    conn->connected_us = http->connected_us;
+    conn->first_byte_us = http->first_byte_us;
+}
+
+static cloud_conn_t *socket_open(const cloud_transport_t *transport)
+{
+    socket_conn_t *sock = calloc(1, sizeof(*sock));
+    if (sock == NULL) {
+        return NULL;
+    }
+
+    http_conn_init(&sock->http, socket_on_header, socket_on_body, &sock->base);
+
+    return &sock->base;
+}
+
+/**
+ * @brief Serialize the request into the transmit buffer
+ */
+static esp_err_t serialize(socket_conn_t *sock, const cloud_request_t *request)
+{
+    size_t size = sizeof(sock->tx);
+    size_t len = 0;
+    int n;
+
+    if (request->port == 80) {
+        n = snprintf(sock->tx, size, "%s %s HTTP/1.1\r\nHost: %s\r\n",
+                     request->method, request->path, request->host);
+    } else {
+        n = snprintf(sock->tx, size, "%s %s HTTP/1.1\r\nHost: %s:%u\r\n",
+                     request->method, request->path, request->host, request->port);
+    }
+    if (n < 0 || (size_t)n >= size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    len = (size_t)n;
+
+    for (size_t i = 0; i < request->header_count; i++) {
+        n = snprintf(sock->tx + len, size - len, "%s: %s\r\n", request->headers[i].key, request->headers[i].value);
+        if (n < 0 || (size_t)n >= size - len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        len += (size_t)n;
+    }
+
+    n = snprintf(sock->tx + len, size - len, "Content-Length: %u\r\n\r\n", (unsigned)request->body_len);
+    if (n < 0 || (size_t)n >= size - len || request->body_len > size - len - (size_t)n) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    len += (size_t)n;
+
+    if (request->body_len > 0) {
+        memcpy(sock->tx + len, request->body, request->body_len);
+        len += request->body_len;
+    }
+    sock->tx_len = len;
+
+    return ESP_OK;
+}
+
+static esp_err_t socket_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms)
+{
+    socket_conn_t *sock = (socket_conn_t *)conn;
+
+    esp_err_t err = serialize(sock, request);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Request to %s does not fit in %u bytes", request->path, (unsigned)sizeof(sock->tx));
+        conn->err = err;
+        conn->state = CLOUD_CONN_FAILED;
+        return err;
+    }
+
+    snprintf(sock->host, sizeof(sock->host), "%s", request->host);
+    sock->port = request->port;
+    sock->timeout_ms = timeout_ms;
+    sock->replayed = false;
+
+    err = http_conn_start(&sock->http, sock->host, sock->port, sock->tx, sock->tx_len, timeout_ms);
+    sync_state(sock);
+
+    return err;
+}
+
+static int socket_add_fds(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us)
+{
+    socket_conn_t *sock = (socket_conn_t *)conn;
+
+    if (http_conn_busy(&sock->http) && sock->http.deadline_us < *wake_us) {
+        *wake_us = sock->http.deadline_us;
+    }
+
+    return http_conn_add_fds(&sock->http, read_fds, write_fds, max_fd);
+}
+
+static void socket_process(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds)
+{
+    socket_conn_t *sock = (socket_conn_t *)conn;
+    http_conn_t *http = &sock->http;
+
+    http_conn_process(http, read_fds, write_fds);
+
+    if (http->state == HTTP_CONN_FAILED && http->reused && !http->received_any && !sock->replayed) {
+        ESP_LOGW(TAG, "Keep-alive connection lost (%s), reconnecting...", esp_err_to_name(http->err));
+        http_conn_finish(http);
+        sock->replayed = true;
+        http_conn_start(http, sock->host, sock->port, sock->tx, sock->tx_len, sock->timeout_ms);
+    }
+
+    sync_state(sock);
+}
+
+static void socket_finish(cloud_conn_t *conn)
+{
+    socket_conn_t *sock = (socket_conn_t *)conn;
+
+    http_conn_finish(&sock->http);
+    sync_state(sock);
+}
+
+static void socket_abort(cloud_conn_t *conn)
+{
+    socket_conn_t *sock = (socket_conn_t *)conn;
+
+    http_conn_abort(&sock->http);
+    sync_state(sock);
+}
+
+static void socket_close(cloud_conn_t *conn)
+{
+    socket_conn_t *sock = (socket_conn_t *)conn;
+
+    http_conn_close(&sock->http);
+    free(sock);
+}
+
+static esp_err_t socket_watch_host(const cloud_transport_t *transport, const char *host, uint32_t ttl_ms)
+{
+    return dns_cache_watch(host, ttl_ms);
+}
+
+static void socket_unwatch_host(const cloud_transport_t *transport, const char *host)
+{
+    dns_cache_unwatch(host);
+}
+
+static const cloud_transport_t s_socket_transport = {
+    .name = "socket",
+    .open = socket_open,
+    .start = socket_start,
+    .add_fds = socket_add_fds,
+    .process = socket_process,
+    .finish = socket_finish,
+    .abort = socket_abort,
+    .close = socket_close,
+    .watch_host = socket_watch_host,
+    .unwatch_host = socket_unwatch_host,
+};
+
+const cloud_transport_t *cloud_transport_socket(void)
+{
+    return &s_socket_transport;
+}
@@ -1,11 +1,8 @@
 # ESPHome component makefile for inverter_tentek
 
-# Add main directory to include paths
-COMPONENT_ADD_INCLUDEDIRS := . main
-COMPONENT_SRCDIRS := . main
+# The service sources live in the component root (main/ only holds the standalone example)
+COMPONENT_ADD_INCLUDEDIRS := .
+COMPONENT_SRCDIRS := .
 
-# Add C source files from main/
-COMPONENT_OBJS := main/set_power_service.o
-
-# Link with mbedtls for MD5
-COMPONENT_REQUIRES := mbedtls esp_http_client
+# Link with mbedtls for MD5, vfs for the service task's wake-up eventfd
+COMPONENT_REQUIRES := mbedtls esp_http_client vfs
@@ -0,0 +1,404 @@
+/**
+ * @file dns_cache.c
+ * @brief Process-wide cache of resolved host addresses
+ */
+
+#include "dns_cache.h"
+#include "http_conn.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+
+static const char *TAG = "DNS_CACHE";
+
+#define DNS_CACHE_TASK_STACK_SIZE   3072
+#define DNS_CACHE_TASK_PRIORITY     2
+#define RETRY_MIN_MS                1000    // First retry of a failed background lookup
+#define RETRY_MAX_MS                60000   // Retries back off up to this interval
+
+typedef struct {
+    char host[HTTP_CONN_HOST_MAX];   // Empty = free entry
+    struct sockaddr_storage addr;    // Last good address (port 0)
+    socklen_t addr_len;              // 0 = never resolved
+    int64_t expires_us;              // The address is current until then
+    int64_t refresh_us;              // Next background lookup (watched entries)
+    int64_t last_used_us;            // Eviction order
+    uint32_t ttl_ms;
+    uint8_t watchers;
+    uint8_t failures;                // Consecutive failed lookups
+    bool lookup_pending;             // Unwatched name asked for; the resolver looks it up once
+} dns_entry_t;
+
+static struct {
+    portMUX_TYPE lock;               // Guards everything below; never held across getaddrinfo()
+    dns_entry_t entries[DNS_CACHE_MAX_HOSTS];
+    bool task_started;
+    TaskHandle_t task;
+    dns_cache_stats_t stats;
+} s_cache = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/**
+ * @brief Resolve a name (blocks)
+ *
+ * @param flags getaddrinfo() flags (AI_NUMERICHOST = no network)
+ */
+static bool resolve(const char *host, int flags, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    struct addrinfo hints = {
+        .ai_flags = flags,
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0 || result == NULL) {
+        return false;
+    }
+
+    bool ok = (result->ai_addrlen <= sizeof(*addr));
+    if (ok) {
+        memcpy(addr, result->ai_addr, result->ai_addrlen);
+        *addr_len = result->ai_addrlen;
+    }
+    freeaddrinfo(result);
+
+    return ok;
+}
+
+static void set_port(struct sockaddr_storage *addr, uint16_t port)
+{
+    if (addr->ss_family == AF_INET) {
+        ((struct sockaddr_in *)addr)->sin_port = htons(port);
+    }
+#ifdef AF_INET6
+    if (addr->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)addr)->sin6_port = htons(port);
+    }
+#endif
+}
+
+/* The helpers below are called with the lock held */
+
+static dns_entry_t *find_entry(const char *host)
+{
+    for (int i = 0; i < DNS_CACHE_MAX_HOSTS; i++) {
+        if (strcmp(s_cache.entries[i].host, host) == 0) {
+            return &s_cache.entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find the entry of a name, or take a free or the least recently used unwatched one
+ *
+ * @param len strlen(host), below HTTP_CONN_HOST_MAX
+ * @return Entry, or NULL if all entries are watched
+ */
+static dns_entry_t *claim_entry(const char *host, size_t len)
+{
+    dns_entry_t *entry = find_entry(host);
+    if (entry != NULL) {
+        return entry;
+    }
+
+    for (int i = 0; i < DNS_CACHE_MAX_HOSTS; i++) {
+        dns_entry_t *candidate = &s_cache.entries[i];
+        if (candidate->host[0] == '\0') {
+            entry = candidate;
+            break;
+        }
+        if (candidate->watchers == 0 && (entry == NULL || candidate->last_used_us < entry->last_used_us)) {
+            entry = candidate;
+        }
+    }
+    if (entry != NULL) {
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->host, host, len + 1);
+        entry->ttl_ms = DNS_CACHE_DEFAULT_TTL_MS;
+    }
+
+    return entry;
+}
+
+static void store_address(dns_entry_t *entry, const struct sockaddr_storage *addr, socklen_t addr_len, int64_t now_us)
+{
+    entry->addr = *addr;
+    entry->addr_len = addr_len;
+    entry->expires_us = now_us + (int64_t)entry->ttl_ms * 1000;
+    entry->refresh_us = now_us + (int64_t)entry->ttl_ms * 750;
+    entry->failures = 0;
+}
+
+/**
+ * @brief Tell the resolver task that names are due, starting it first if needed
+ */
+static esp_err_t wake_resolver(void);
+
+esp_err_t dns_cache_lookup(const char *host, uint16_t port, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    if (resolve(host, AI_NUMERICHOST, addr, addr_len)) {
+        set_port(addr, port);
+        return ESP_OK;
+    }
+
+    size_t len = strlen(host);
+    if (len >= HTTP_CONN_HOST_MAX) {
+        ESP_LOGE(TAG, "Host name too long: %s", host);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    bool known = false;
+    bool current = false;
+    bool queued = false;
+
+    // Only ever answered from the cache: the caller may be an event loop that must not wait for DNS
+    taskENTER_CRITICAL(&s_cache.lock);
+    dns_entry_t *entry = find_entry(host);
+    if (entry != NULL && entry->addr_len > 0) {
+        known = true;
+        current = (now_us < entry->expires_us);
+        *addr = entry->addr;
+        *addr_len = entry->addr_len;
+        entry->last_used_us = now_us;
+    }
+    if (current) {
+        s_cache.stats.hits++;
+    } else {
+        if (known) {
+            s_cache.stats.stale_hits++;
+        } else {
+            s_cache.stats.misses++;
+        }
+        // A watched name is retried by the resolver anyway; any other one is looked up there once
+        if (entry == NULL) {
+            entry = claim_entry(host, len);
+        }
+        if (entry != NULL && entry->watchers == 0 && !entry->lookup_pending) {
+            entry->lookup_pending = true;
+            entry->refresh_us = now_us;
+            entry->last_used_us = now_us;
+            queued = true;
+        }
+    }
+    taskEXIT_CRITICAL(&s_cache.lock);
+
+    if (queued) {
+        wake_resolver();
+    }
+
+    if (!known) {
+        ESP_LOGW(TAG, "⚠️ No address for %s yet, it is being looked up", host);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    set_port(addr, port);
+    return ESP_OK;
+}
+
+/**
+ * @brief Resolve watched names when they are due, forever
+ */
+static void resolver_task(void *arg)
+{
+    while (1) {
+        char host[HTTP_CONN_HOST_MAX] = "";
+        int64_t now_us = esp_timer_get_time();
+        int64_t due_us = INT64_MAX;
+
+        taskENTER_CRITICAL(&s_cache.lock);
+        int due = -1;
+        for (int i = 0; i < DNS_CACHE_MAX_HOSTS; i++) {
+            const dns_entry_t *entry = &s_cache.entries[i];
+            if ((entry->watchers > 0 || entry->lookup_pending) && entry->refresh_us < due_us) {
+                due_us = entry->refresh_us;
+                due = i;
+            }
+        }
+        if (due >= 0 && due_us <= now_us) {
+            memcpy(host, s_cache.entries[due].host, sizeof(host));  // Same size, NUL-terminated
+        }
+        taskEXIT_CRITICAL(&s_cache.lock);
+
+        if (host[0] == '\0') {
+            // Sleep until the next name is due or dns_cache_watch() adds one
+            TickType_t ticks = (due_us == INT64_MAX) ? portMAX_DELAY
+                                                     : pdMS_TO_TICKS((due_us - now_us + 999) / 1000);
+            ulTaskNotifyTake(pdTRUE, ticks);
+            continue;
+        }
+
+        struct sockaddr_storage addr;
+        socklen_t addr_len = 0;
+        bool ok = resolve(host, 0, &addr, &addr_len);
+        int64_t end_us = esp_timer_get_time();
+        uint8_t failures = 0;
+        bool known = false;
+
+        taskENTER_CRITICAL(&s_cache.lock);
+        s_cache.stats.resolutions++;
+        dns_entry_t *entry = find_entry(host);
+        if (entry != NULL && entry->lookup_pending) {
+            // A one-off lookup is not retried; the next request asks again
+            entry->lookup_pending = false;
+            if (ok) {
+                store_address(entry, &addr, addr_len, end_us);
+            }
+        } else if (entry != NULL && ok) {
+            store_address(entry, &addr, addr_len, end_us);
+            s_cache.stats.refreshes++;
+        } else if (entry != NULL) {
+            if (entry->failures < UINT8_MAX) {
+                entry->failures++;
+            }
+            uint32_t retry_ms = RETRY_MIN_MS << (entry->failures < 7 ? entry->failures - 1 : 6);
+            if (retry_ms > RETRY_MAX_MS) {
+                retry_ms = RETRY_MAX_MS;
+            }
+            entry->refresh_us = end_us + (int64_t)retry_ms * 1000;
+            failures = entry->failures;
+            known = (entry->addr_len > 0);
+        }
+        if (!ok) {
+            s_cache.stats.failures++;
+        }
+        taskEXIT_CRITICAL(&s_cache.lock);
+
+        if (ok) {
+            ESP_LOGD(TAG, "🌍 Resolved %s in %lld ms", host, (long long)((end_us - now_us) / 1000));
+        } else {
+            ESP_LOGW(TAG, "⚠️ DNS lookup failed for %s (%u in a row), %s", host, failures,
+                     known ? "keeping its last good address" : "no address yet");
+        }
+    }
+}
+
+static esp_err_t wake_resolver(void)
+{
+    taskENTER_CRITICAL(&s_cache.lock);
+    bool start_task = !s_cache.task_started;
+    s_cache.task_started = true;
+    TaskHandle_t task = s_cache.task;
+    taskEXIT_CRITICAL(&s_cache.lock);
+
+    if (start_task) {
+        BaseType_t ret = xTaskCreate(resolver_task, "dns_cache", DNS_CACHE_TASK_STACK_SIZE, NULL,
+                                     DNS_CACHE_TASK_PRIORITY, &task);
+        taskENTER_CRITICAL(&s_cache.lock);
+        if (ret == pdPASS) {
+            s_cache.task = task;
+        } else {
+            s_cache.task_started = false;
+        }
+        taskEXIT_CRITICAL(&s_cache.lock);
+        if (ret != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create resolver task");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Also after a start: names added while the task was being created are seen on the next scan
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t dns_cache_watch(const char *host, uint32_t ttl_ms)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (resolve(host, AI_NUMERICHOST, &addr, &addr_len)) {
+        return ESP_OK;
+    }
+    size_t len = strlen(host);
+    if (len >= HTTP_CONN_HOST_MAX) {
+        ESP_LOGE(TAG, "Host name too long: %s", host);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ttl_ms == 0) {
+        ttl_ms = DNS_CACHE_DEFAULT_TTL_MS;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    bool resolved = false;
+
+    taskENTER_CRITICAL(&s_cache.lock);
+    dns_entry_t *entry = claim_entry(host, len);
+    if (entry != NULL) {
+        if (entry->watchers == 0 || ttl_ms < entry->ttl_ms) {
+            entry->ttl_ms = ttl_ms;
+        }
+        entry->watchers++;
+        entry->lookup_pending = false;
+        entry->last_used_us = now_us;
+        resolved = (entry->addr_len > 0);
+        // A known name is refreshed when its (possibly shorter) TTL says so
+        int64_t refresh_us = resolved ? entry->expires_us - (int64_t)entry->ttl_ms * 250 : INT64_MAX;
+        if (entry->watchers == 1 || refresh_us < entry->refresh_us) {
+            entry->refresh_us = refresh_us;
+        }
+    }
+    taskEXIT_CRITICAL(&s_cache.lock);
+
+    if (entry == NULL) {
+        ESP_LOGE(TAG, "No room to watch %s (%d names watched)", host, DNS_CACHE_MAX_HOSTS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Resolve a new name here, before the first request needs it; the resolver only keeps it fresh
+    if (!resolved) {
+        bool ok = resolve(host, 0, &addr, &addr_len);
+        int64_t end_us = esp_timer_get_time();
+        taskENTER_CRITICAL(&s_cache.lock);
+        s_cache.stats.resolutions++;
+        entry = find_entry(host);
+        if (entry != NULL && ok) {
+            store_address(entry, &addr, addr_len, end_us);
+        } else if (entry != NULL) {
+            entry->failures = 1;
+            entry->refresh_us = end_us + (int64_t)RETRY_MIN_MS * 1000;
+        }
+        if (!ok) {
+            s_cache.stats.failures++;
+        }
+        taskEXIT_CRITICAL(&s_cache.lock);
+        if (ok) {
+            ESP_LOGD(TAG, "🌍 Resolved %s in %lld ms", host, (long long)((end_us - now_us) / 1000));
+        } else {
+            ESP_LOGW(TAG, "⚠️ DNS lookup failed for %s, retrying in the background", host);
+        }
+    }
+
+    if (wake_resolver() != ESP_OK) {
+        dns_cache_unwatch(host);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void dns_cache_unwatch(const char *host)
+{
+    taskENTER_CRITICAL(&s_cache.lock);
+    dns_entry_t *entry = find_entry(host);
+    if (entry != NULL && entry->watchers > 0) {
+        entry->watchers--;
+    }
+    taskEXIT_CRITICAL(&s_cache.lock);
+}
+
+void dns_cache_get_stats(dns_cache_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_cache.lock);
+    *stats = s_cache.stats;
+    taskEXIT_CRITICAL(&s_cache.lock);
+}
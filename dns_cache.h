@@ -0,0 +1,91 @@
+/**
+ * @file dns_cache.h
+ * @brief Process-wide cache of resolved host addresses
+ *
+ * http_conn opens new connections through this cache instead of calling
+ * getaddrinfo() each time. A name is looked up once and its address kept
+ * for a TTL; getaddrinfo() does not report record TTLs, so the TTL is the
+ * one given by the owner of the name.
+ *
+ * Names registered with dns_cache_watch() are resolved there once and then
+ * re-resolved by a background resolver task before their TTL runs out. If a
+ * lookup fails, the last good address stays in use (past its TTL) and the
+ * lookup is retried with backoff.
+ *
+ * dns_cache_lookup() never waits for DNS, so it can be called from an event
+ * loop. A name it has no address for, or only an expired one, is handed to
+ * the resolver task, and the lookup answers with the expired address or
+ * with ESP_ERR_NOT_FOUND. The request is retried later, by which time the
+ * address is normally known.
+ *
+ * Numeric addresses bypass the cache. Thread-safe.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CACHE_MAX_HOSTS         8       // Cached names (unwatched ones are evicted when full)
+#define DNS_CACHE_DEFAULT_TTL_MS    (5 * 60 * 1000)  // TTL of names resolved without a watch
+
+/**
+ * @brief Cache counters (since start)
+ */
+typedef struct {
+    uint32_t hits;                   /*!< Lookups answered from the cache */
+    uint32_t misses;                 /*!< Lookups that found no address (name handed to the resolver) */
+    uint32_t stale_hits;             /*!< Lookups answered with an expired address (refresh late or failing) */
+    uint32_t resolutions;            /*!< getaddrinfo() calls (foreground and background) */
+    uint32_t failures;               /*!< getaddrinfo() calls that failed */
+    uint32_t refreshes;              /*!< Background re-resolutions that succeeded */
+} dns_cache_stats_t;
+
+/**
+ * @brief Get the address of a host from the cache (never blocks)
+ *
+ * @param host Host name or numeric address
+ * @param port TCP port, stored into the address
+ * @param addr Receives the address
+ * @param addr_len Receives the address length
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if no address of the name is known
+ *         yet (the resolver task looks it up in the background)
+ */
+esp_err_t dns_cache_lookup(const char *host, uint16_t port, struct sockaddr_storage *addr, socklen_t *addr_len);
+
+/**
+ * @brief Keep a name resolved in the background
+ *
+ * The first watch of a name resolves it before returning (this blocks, so
+ * watch names at start, not from an event loop). Watches are counted; the
+ * name is re-resolved in the background at 3/4 of the shortest TTL asked for.
+ *
+ * @param host Host name (numeric addresses are accepted and ignored)
+ * @param ttl_ms How long a resolved address is used (0 = DNS_CACHE_DEFAULT_TTL_MS)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if the name is HTTP_CONN_HOST_MAX
+ *         characters or longer, ESP_ERR_NO_MEM if all entries are watched or
+ *         the resolver task cannot be created
+ */
+esp_err_t dns_cache_watch(const char *host, uint32_t ttl_ms);
+
+/**
+ * @brief Undo one dns_cache_watch()
+ *
+ * The address stays cached (until evicted) but is no longer refreshed.
+ */
+void dns_cache_unwatch(const char *host);
+
+/**
+ * @brief Get the cache counters
+ */
+void dns_cache_get_stats(dns_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,705 @@
+/**
+ * @file set_power_bench.c
+ * @brief End-to-end benchmark of the set_power_service command pipeline
+ *
+ * Drives SET_OUTPUT commands into the unmodified service at a fixed rate
+ * against the local mock cloud and measures what the application sees:
+ *  - commands/s completed and setpoints/s accepted by the cloud
+ *  - confirmation latency (enqueue to completion) percentiles
+ *  - HTTP requests per accepted setpoint (retries, replays, re-logins)
+ *  - dedup hit rate and superseded (coalesced) setpoints
+ *  - stale-setpoint lag: how long the cloud holds a value other than the
+ *    latest one the application asked for
+ *
+ * Each scenario runs in a forked child so the service starts from a clean
+ * state; results of all scenarios are written as one JSON document.
+ *
+ * --transport mock serves the mock in-process instead of over loopback
+ * sockets: latency and loss are still simulated, but without socket and
+ * thread scheduling noise, so runs with the same seed are comparable.
+ * --hedge turns on hedged set-power requests in the service; compare the
+ * "stalls" scenario with and without it.
+ *
+ * Usage: set_power_bench [--scenario NAME]... [--output FILE] [--transport socket|mock] [--hedge] [overrides]
+ *        set_power_bench --list
+ */
+
+#include "set_power_service.h"
+#include "mock_cloud.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_EMAIL         "bench@example.com"
+#define BENCH_PASSWORD      "bench-password"
+#define BENCH_DEVICE_SN     "BENCH000000001"
+#define READY_TIMEOUT_MS    10000
+#define SAMPLE_PERIOD_US    1000
+#define MAX_SCENARIOS       16
+
+/**
+ * @brief One benchmark scenario: offered load and mock cloud behaviour
+ */
+typedef struct {
+    const char *name;
+    uint32_t rate_hz;               /*!< Setpoints offered per second */
+    uint32_t duration_ms;           /*!< Time setpoints are offered for */
+    uint32_t latency_ms;            /*!< Mock response latency */
+    uint32_t jitter_ms;             /*!< Mock latency jitter (uniform 0..jitter) */
+    uint8_t loss_percent;           /*!< Mock request loss */
+    uint8_t stall_percent;          /*!< Mock requests that stall */
+    uint32_t stall_ms;              /*!< Length of a mock stall */
+    uint32_t session_lifetime_ms;   /*!< Mock session lifetime (0 = never expires) */
+    uint8_t repeat_percent;         /*!< Share of setpoints equal to the previous one */
+    uint32_t deadline_ms;           /*!< Command deadline (0 = none) */
+    uint32_t drain_ms;              /*!< Time allowed for outstanding commands after the run */
+    uint8_t rate_limit_burst;       /*!< Service rate limit bucket size (0 = limiter off) */
+    uint32_t rate_limit_interval_ms; /*!< Service rate limit refill interval */
+    uint64_t seed;                  /*!< Seed for setpoints, mock jitter/loss and backoff jitter */
+} bench_scenario_t;
+
+static const bench_scenario_t s_presets[] = {
+    { .name = "baseline",       .rate_hz = 10,  .duration_ms = 5000, .latency_ms = 20,  .jitter_ms = 5,
+      .repeat_percent = 30, .drain_ms = 30000, .seed = 1 },
+    { .name = "burst",          .rate_hz = 200, .duration_ms = 3000, .latency_ms = 20,  .jitter_ms = 5,
+      .repeat_percent = 10, .drain_ms = 30000, .seed = 2 },
+    { .name = "slow-cloud",     .rate_hz = 20,  .duration_ms = 5000, .latency_ms = 200, .jitter_ms = 50,
+      .repeat_percent = 10, .drain_ms = 30000, .seed = 3 },
+    { .name = "lossy",          .rate_hz = 5,   .duration_ms = 8000, .latency_ms = 20,  .jitter_ms = 5,
+      .loss_percent = 10, .repeat_percent = 10, .deadline_ms = 3000, .drain_ms = 30000, .seed = 4 },
+    { .name = "session-expiry", .rate_hz = 10,  .duration_ms = 6000, .latency_ms = 20,  .jitter_ms = 5,
+      .session_lifetime_ms = 1500, .repeat_percent = 10, .drain_ms = 30000, .seed = 5 },
+    { .name = "rate-limited",   .rate_hz = 20,  .duration_ms = 5000, .latency_ms = 20,  .jitter_ms = 5,
+      .repeat_percent = 10, .drain_ms = 30000, .rate_limit_burst = 5, .rate_limit_interval_ms = 500, .seed = 6 },
+    { .name = "stalls",         .rate_hz = 2,   .duration_ms = 10000, .latency_ms = 20, .jitter_ms = 5,
+      .stall_percent = 10, .stall_ms = 2000, .repeat_percent = 10, .drain_ms = 30000, .seed = 7 },
+};
+
+#define PRESET_COUNT (sizeof(s_presets) / sizeof(s_presets[0]))
+
+/**
+ * @brief Per-command bookkeeping
+ */
+typedef struct {
+    int power;
+    SemaphoreHandle_t done;
+    esp_err_t result;
+    bool send_failed;               /*!< set_power_service_send() itself failed */
+    bool timed_out;                 /*!< Not completed within the drain time */
+    int64_t send_us;
+    int64_t complete_us;
+} bench_record_t;
+
+/**
+ * @brief State shared by the producer, collector and sampler threads
+ */
+typedef struct {
+    const bench_scenario_t *scenario;
+    bench_record_t *records;
+    uint32_t record_count;
+    atomic_uint published;          /*!< Records handed to the service so far */
+    atomic_bool producer_done;
+    atomic_llong drain_deadline_us; /*!< 0 while the producer is running */
+    atomic_bool collector_done;
+    atomic_int intended_power;      /*!< Latest setpoint offered (-1 = none yet) */
+
+    int64_t *stale_intervals_us;    /*!< Completed stale intervals */
+    uint32_t stale_count;
+    uint32_t stale_capacity;
+    int64_t stale_total_us;
+    bool stale_unresolved;          /*!< Still stale when the run ended */
+    int64_t sample_start_us;
+    int64_t sample_end_us;
+} bench_run_t;
+
+static bool s_verbose;
+static bool s_in_process;           // --transport mock
+static bool s_hedge;                // --hedge
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_until_us(int64_t deadline_us)
+{
+    struct timespec ts = {
+        .tv_sec = deadline_us / 1000000,
+        .tv_nsec = (long)(deadline_us % 1000000) * 1000L,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/**
+ * @brief Setpoint generator (xorshift64*, independent of the service's esp_random)
+ */
+static uint32_t next_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Nearest-rank percentile of sorted samples, in milliseconds
+ */
+static double percentile_ms(const int64_t *sorted_us, uint32_t count, double percentile)
+{
+    if (count == 0) {
+        return 0.0;
+    }
+
+    uint32_t rank = (uint32_t)((percentile / 100.0) * count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > count) {
+        rank = count;
+    }
+    return sorted_us[rank - 1] / 1000.0;
+}
+
+static void print_distribution(FILE *out, const char *name, int64_t *samples_us, uint32_t count)
+{
+    qsort(samples_us, count, sizeof(*samples_us), compare_int64);
+
+    double sum_us = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum_us += (double)samples_us[i];
+    }
+
+    fprintf(out, "      \"%s\": {\"count\": %u, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+            "\"p99\": %.3f, \"max\": %.3f}",
+            name, count, count ? sum_us / count / 1000.0 : 0.0,
+            percentile_ms(samples_us, count, 50), percentile_ms(samples_us, count, 90),
+            percentile_ms(samples_us, count, 99), count ? samples_us[count - 1] / 1000.0 : 0.0);
+}
+
+static double ratio(double numerator, double denominator)
+{
+    return (denominator > 0) ? numerator / denominator : 0.0;
+}
+
+/**
+ * @brief Wait for command completions in enqueue order
+ *
+ * Setpoints complete in the order they were offered (a newer one either
+ * supersedes the pending one, completing it, or is processed after it), so
+ * blocking on each record in turn timestamps completions accurately.
+ */
+static void *collector_thread(void *arg)
+{
+    bench_run_t *run = arg;
+
+    for (uint32_t i = 0; i < run->record_count; i++) {
+        while (atomic_load(&run->published) <= i) {
+            if (atomic_load(&run->producer_done)) {
+                goto done;
+            }
+            usleep(200);
+        }
+
+        bench_record_t *rec = &run->records[i];
+        if (rec->send_failed) {
+            continue;
+        }
+
+        for (;;) {
+            if (xSemaphoreTake(rec->done, pdMS_TO_TICKS(100)) == pdTRUE) {
+                rec->complete_us = now_us();
+                break;
+            }
+            int64_t deadline = atomic_load(&run->drain_deadline_us);
+            if (deadline != 0 && now_us() >= deadline) {
+                rec->timed_out = true;
+                break;
+            }
+        }
+    }
+
+done:
+    atomic_store(&run->collector_done, true);
+    return NULL;
+}
+
+/**
+ * @brief Track how long the cloud's setpoint lags the latest offered one
+ */
+static void *sampler_thread(void *arg)
+{
+    bench_run_t *run = arg;
+    int64_t stale_since_us = 0;
+    int64_t next_us = now_us();
+
+    run->sample_start_us = next_us;
+
+    for (;;) {
+        bool finished = atomic_load(&run->collector_done);
+
+        mock_cloud_stats_t stats;
+        mock_cloud_get_stats(&stats);
+        int intended = atomic_load(&run->intended_power);
+        int64_t t = now_us();
+        bool stale = (intended >= 0 && stats.last_power != intended);
+
+        if (stale && stale_since_us == 0) {
+            stale_since_us = t;
+        } else if (!stale && stale_since_us != 0) {
+            if (run->stale_count == run->stale_capacity) {
+                uint32_t capacity = run->stale_capacity ? run->stale_capacity * 2 : 256;
+                int64_t *grown = realloc(run->stale_intervals_us, capacity * sizeof(*grown));
+                if (grown == NULL) {
+                    break;
+                }
+                run->stale_intervals_us = grown;
+                run->stale_capacity = capacity;
+            }
+            run->stale_intervals_us[run->stale_count++] = t - stale_since_us;
+            run->stale_total_us += t - stale_since_us;
+            stale_since_us = 0;
+        }
+
+        if (finished) {
+            if (stale_since_us != 0) {
+                run->stale_total_us += t - stale_since_us;
+                run->stale_unresolved = true;
+            }
+            run->sample_end_us = t;
+            break;
+        }
+
+        next_us += SAMPLE_PERIOD_US;
+        sleep_until_us(next_us);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Run one scenario and write its JSON object to @p out
+ *
+ * @return 0 on success
+ */
+static int run_scenario(const bench_scenario_t *scenario, FILE *out)
+{
+    esp_log_level_set("*", s_verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+    esp_random_host_seed(scenario->seed);
+
+    mock_cloud_config_t mock_config = MOCK_CLOUD_CONFIG_DEFAULT();
+    mock_config.email = BENCH_EMAIL;
+    mock_config.password = BENCH_PASSWORD;
+    mock_config.latency_ms = scenario->latency_ms;
+    mock_config.latency_jitter_ms = scenario->jitter_ms;
+    mock_config.loss_percent = scenario->loss_percent;
+    mock_config.stall_percent = scenario->stall_percent;
+    mock_config.stall_ms = scenario->stall_ms;
+    mock_config.session_lifetime_ms = scenario->session_lifetime_ms;
+    mock_config.seed = scenario->seed;
+    mock_config.in_process = s_in_process;
+    if (mock_cloud_start(&mock_config) != 0) {
+        perror("mock_cloud_start");
+        return 1;
+    }
+    char base_url[64];
+    if (s_in_process) {
+        snprintf(base_url, sizeof(base_url), "http://mock-cloud");  // Never resolved
+    } else {
+        snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%d", mock_cloud_port());
+    }
+
+    set_power_service_config_t config = SET_POWER_SERVICE_CONFIG_DEFAULT();
+    config.email = BENCH_EMAIL;
+    config.password = BENCH_PASSWORD;
+    config.device_sn = BENCH_DEVICE_SN;
+    config.base_url = base_url;
+    config.transport = s_in_process ? mock_cloud_transport() : NULL;
+    config.default_deadline_ms = scenario->deadline_ms;
+    config.rate_limit.burst = scenario->rate_limit_burst;
+    config.rate_limit.refill_interval_ms = scenario->rate_limit_interval_ms;
+    config.hedge.enabled = s_hedge;
+
+    int64_t init_us = now_us();
+    esp_err_t err = set_power_service_init(&config);
+    if (err != ESP_OK) {
+        fprintf(stderr, "set_power_service_init failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+    while (!set_power_service_is_ready() && now_us() - init_us < (int64_t)READY_TIMEOUT_MS * 1000) {
+        usleep(1000);
+    }
+    int64_t ready_us = now_us();
+
+    bench_run_t run = { .scenario = scenario };
+    run.record_count = (uint32_t)((uint64_t)scenario->rate_hz * scenario->duration_ms / 1000);
+    if (run.record_count == 0) {
+        run.record_count = 1;
+    }
+    run.records = calloc(run.record_count, sizeof(*run.records));
+    if (run.records == NULL) {
+        return 1;
+    }
+    atomic_init(&run.intended_power, -1);
+
+    pthread_t collector, sampler;
+    pthread_create(&collector, NULL, collector_thread, &run);
+    pthread_create(&sampler, NULL, sampler_thread, &run);
+
+    uint64_t rng = scenario->seed * 0x9E3779B97F4A7C15ULL + 1;
+    int64_t period_us = 1000000 / (scenario->rate_hz ? scenario->rate_hz : 1);
+    int64_t start_us = now_us();
+    int previous = -1;
+
+    for (uint32_t i = 0; i < run.record_count; i++) {
+        sleep_until_us(start_us + (int64_t)i * period_us);
+
+        int power;
+        if (previous >= 0 && next_random(&rng) % 100 < scenario->repeat_percent) {
+            power = previous;
+        } else {
+            do {
+                power = (int)(next_random(&rng) % 101);
+            } while (power == previous);
+        }
+        previous = power;
+
+        bench_record_t *rec = &run.records[i];
+        rec->power = power;
+        rec->result = ESP_FAIL;
+        rec->done = xSemaphoreCreateBinary();
+
+        set_power_cmd_t cmd = {
+            .cmd_type = SET_POWER_CMD_SET_OUTPUT,
+            .output_power = power,
+            .response_sem = rec->done,
+            .result = &rec->result,
+        };
+
+        atomic_store(&run.intended_power, power);
+        rec->send_us = now_us();
+        if (set_power_service_send(&cmd, 0) != ESP_OK) {
+            rec->send_failed = true;
+        }
+        atomic_store(&run.published, i + 1);
+    }
+
+    int64_t offered_end_us = now_us();
+    atomic_store(&run.drain_deadline_us, offered_end_us + (int64_t)scenario->drain_ms * 1000);
+    atomic_store(&run.producer_done, true);
+    pthread_join(collector, NULL);
+    pthread_join(sampler, NULL);
+    int64_t end_us = now_us();
+
+    set_power_service_status_t status;
+    set_power_service_get_status(&status);
+    mock_cloud_stats_t mock;
+    mock_cloud_get_stats(&mock);
+
+    // Outcomes and confirmation latency of setpoints the service completed with ESP_OK
+    uint32_t ok = 0, superseded = 0, expired = 0, circuit_open = 0, failed = 0, timed_out = 0, send_failed = 0;
+    int64_t *confirm_us = calloc(run.record_count, sizeof(*confirm_us));
+    uint32_t confirm_count = 0;
+    int64_t last_complete_us = start_us;
+
+    for (uint32_t i = 0; i < run.record_count; i++) {
+        bench_record_t *rec = &run.records[i];
+        if (rec->send_failed) {
+            send_failed++;
+        } else if (rec->timed_out) {
+            timed_out++;
+        } else {
+            if (rec->complete_us > last_complete_us) {
+                last_complete_us = rec->complete_us;
+            }
+            switch (rec->result) {
+                case ESP_OK:
+                    ok++;
+                    if (confirm_us != NULL) {
+                        confirm_us[confirm_count++] = rec->complete_us - rec->send_us;
+                    }
+                    break;
+                case ESP_ERR_SET_POWER_SUPERSEDED:   superseded++;   break;
+                case ESP_ERR_SET_POWER_EXPIRED:      expired++;      break;
+                case ESP_ERR_SET_POWER_CIRCUIT_OPEN: circuit_open++; break;
+                default:                             failed++;       break;
+            }
+        }
+        if (rec->done != NULL) {
+            vSemaphoreDelete(rec->done);
+        }
+    }
+
+    double elapsed_s = (last_complete_us - start_us) / 1e6;
+    uint32_t completed = run.record_count - timed_out - send_failed;
+    const set_power_latency_t *e2e = &status.latency[SET_POWER_OP_SET_POWER][SET_POWER_PHASE_END_TO_END];
+    double sample_s = (run.sample_end_us - run.sample_start_us) / 1e6;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", scenario->name);
+    fprintf(out, "      \"transport\": \"%s\",\n", s_in_process ? "mock" : "socket");
+    fprintf(out, "      \"config\": {\"rate_hz\": %u, \"duration_ms\": %u, \"latency_ms\": %u, \"jitter_ms\": %u, "
+            "\"loss_percent\": %u, \"stall_percent\": %u, \"stall_ms\": %u, \"session_lifetime_ms\": %u, "
+            "\"repeat_percent\": %u, \"deadline_ms\": %u, \"rate_limit_burst\": %u, \"rate_limit_interval_ms\": %u, "
+            "\"hedge\": %s, \"seed\": %llu},\n",
+            scenario->rate_hz, scenario->duration_ms, scenario->latency_ms, scenario->jitter_ms,
+            scenario->loss_percent, scenario->stall_percent, scenario->stall_ms, scenario->session_lifetime_ms,
+            scenario->repeat_percent, scenario->deadline_ms, scenario->rate_limit_burst,
+            scenario->rate_limit_interval_ms, s_hedge ? "true" : "false", (unsigned long long)scenario->seed);
+    fprintf(out, "      \"time_to_ready_ms\": %.3f,\n", (ready_us - init_us) / 1000.0);
+    fprintf(out, "      \"elapsed_s\": %.3f,\n", elapsed_s);
+    fprintf(out, "      \"drain_ms\": %.3f,\n", (end_us - offered_end_us) / 1000.0);
+    fprintf(out, "      \"commands_offered\": %u,\n", run.record_count);
+    fprintf(out, "      \"commands_per_s\": %.3f,\n", ratio(completed, elapsed_s));
+    fprintf(out, "      \"accepted_per_s\": %.3f,\n", ratio(mock.set_power_accepted, elapsed_s));
+    fprintf(out, "      \"outcomes\": {\"ok\": %u, \"superseded\": %u, \"expired\": %u, \"circuit_open\": %u, "
+            "\"failed\": %u, \"timed_out\": %u, \"send_failed\": %u},\n",
+            ok, superseded, expired, circuit_open, failed, timed_out, send_failed);
+    print_distribution(out, "confirm_latency_ms", confirm_us, confirm_count);
+    fprintf(out, ",\n");
+    fprintf(out, "      \"http_requests\": %u,\n", mock.requests);
+    fprintf(out, "      \"http_requests_per_accepted\": %.3f,\n", ratio(mock.requests, mock.set_power_accepted));
+    fprintf(out, "      \"dedup_hit_rate\": %.4f,\n", ratio(status.skipped_requests, status.total_requests));
+    fprintf(out, "      \"superseded_rate\": %.4f,\n", ratio(superseded, run.record_count));
+    print_distribution(out, "stale_lag_ms", run.stale_intervals_us, run.stale_count);
+    fprintf(out, ",\n");
+    fprintf(out, "      \"stale_time_fraction\": %.4f,\n", ratio(run.stale_total_us / 1e6, sample_s));
+    fprintf(out, "      \"stale_unresolved\": %s,\n", run.stale_unresolved ? "true" : "false");
+    fprintf(out, "      \"mock\": {\"connections\": %u, \"logins\": %u, \"set_power_requests\": %u, "
+            "\"accepted\": %u, \"dropped\": %u, \"stalled\": %u, \"session_rejections\": %u, "
+            "\"signature_failures\": %u},\n",
+            mock.connections, mock.logins, mock.set_power_requests, mock.set_power_accepted,
+            mock.dropped_requests, mock.stalled_requests, mock.session_rejections, mock.signature_failures);
+    fprintf(out, "      \"service\": {\"total_requests\": %u, \"successful_requests\": %u, \"failed_requests\": %u, "
+            "\"skipped_requests\": %u, \"superseded_setpoints\": %u, \"expired_requests\": %u, \"retries\": %u, "
+            "\"session_refreshes\": %u, \"connection_reuses\": %u, \"connection_reconnects\": %u, "
+            "\"aborted_requests\": %u, \"max_in_flight_requests\": %u, \"breaker_trips\": %u, \"throttled_requests\": %u, "
+            "\"hedged_requests\": %u, \"hedge_wins\": %u, \"end_to_end_ms\": {\"count\": %u, \"p50\": %u, \"p90\": %u, \"p99\": %u, "
+            "\"max\": %u}}\n",
+            status.total_requests, status.successful_requests, status.failed_requests,
+            status.skipped_requests, status.superseded_setpoints, status.expired_requests, status.retries,
+            status.session_refreshes, status.connection_reuses, status.connection_reconnects,
+            status.aborted_requests, status.max_in_flight_requests, status.breaker_trips, status.throttled_requests,
+            status.hedged_requests, status.hedge_wins, e2e->count, e2e->p50_ms, e2e->p90_ms, e2e->p99_ms, e2e->max_ms);
+    fprintf(out, "    }");
+
+    free(confirm_us);
+    free(run.stale_intervals_us);
+    free(run.records);
+
+    set_power_service_deinit();
+    mock_cloud_stop();
+
+    return (timed_out == 0 && send_failed == 0) ? 0 : 1;
+}
+
+/**
+ * @brief Run a scenario in a child process and copy its JSON to @p out
+ */
+static int run_scenario_isolated(const bench_scenario_t *scenario, FILE *out)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    fflush(out);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        FILE *child_out = fdopen(fds[1], "w");
+        int rc = run_scenario(scenario, child_out);
+        fclose(child_out);
+        _exit(rc);
+    }
+
+    close(fds[1]);
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, (size_t)n, out);
+    }
+    close(fds[0]);
+
+    int wstatus = 0;
+    waitpid(pid, &wstatus, 0);
+    return (WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0) ? 0 : 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--scenario NAME]... [--output FILE] [--transport socket|mock] [--hedge] [--verbose]\n"
+            "          [--rate HZ] [--duration-ms N] [--latency-ms N] [--jitter-ms N]\n"
+            "          [--loss-percent N] [--stall-percent N] [--stall-ms N]\n"
+            "          [--session-lifetime-ms N] [--repeat-percent N]\n"
+            "          [--deadline-ms N] [--drain-ms N] [--seed N]\n"
+            "          [--rate-limit-burst N] [--rate-limit-interval-ms N]\n"
+            "       %s --list\n"
+            "Overrides apply to every selected scenario (default: all presets).\n", prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+    bench_scenario_t scenarios[MAX_SCENARIOS];
+    size_t scenario_count = 0;
+    const char *output_path = NULL;
+
+    // Overrides, applied after scenario selection (-1 = keep preset value)
+    long long rate = -1, duration = -1, latency = -1, jitter = -1, loss = -1, lifetime = -1;
+    long long stall_percent = -1, stall_ms = -1;
+    long long repeat = -1, deadline = -1, drain = -1, seed = -1, burst = -1, interval = -1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--list") == 0) {
+            for (size_t p = 0; p < PRESET_COUNT; p++) {
+                printf("%s\n", s_presets[p].name);
+            }
+            return 0;
+        }
+        if (strcmp(arg, "--verbose") == 0) {
+            s_verbose = true;
+            continue;
+        }
+        if (strcmp(arg, "--hedge") == 0) {
+            s_hedge = true;
+            continue;
+        }
+        if (value == NULL) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+
+        if (strcmp(arg, "--scenario") == 0) {
+            size_t p = 0;
+            while (p < PRESET_COUNT && strcmp(s_presets[p].name, value) != 0) {
+                p++;
+            }
+            if (p == PRESET_COUNT || scenario_count == MAX_SCENARIOS) {
+                fprintf(stderr, "Unknown scenario: %s\n", value);
+                return 2;
+            }
+            scenarios[scenario_count++] = s_presets[p];
+        } else if (strcmp(arg, "--output") == 0) {
+            output_path = value;
+        } else if (strcmp(arg, "--transport") == 0) {
+            if (strcmp(value, "socket") != 0 && strcmp(value, "mock") != 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            s_in_process = (strcmp(value, "mock") == 0);
+        } else if (strcmp(arg, "--rate") == 0) {
+            rate = atoll(value);
+        } else if (strcmp(arg, "--duration-ms") == 0) {
+            duration = atoll(value);
+        } else if (strcmp(arg, "--latency-ms") == 0) {
+            latency = atoll(value);
+        } else if (strcmp(arg, "--jitter-ms") == 0) {
+            jitter = atoll(value);
+        } else if (strcmp(arg, "--loss-percent") == 0) {
+            loss = atoll(value);
+        } else if (strcmp(arg, "--stall-percent") == 0) {
+            stall_percent = atoll(value);
+        } else if (strcmp(arg, "--stall-ms") == 0) {
+            stall_ms = atoll(value);
+        } else if (strcmp(arg, "--session-lifetime-ms") == 0) {
+            lifetime = atoll(value);
+        } else if (strcmp(arg, "--repeat-percent") == 0) {
+            repeat = atoll(value);
+        } else if (strcmp(arg, "--deadline-ms") == 0) {
+            deadline = atoll(value);
+        } else if (strcmp(arg, "--drain-ms") == 0) {
+            drain = atoll(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = atoll(value);
+        } else if (strcmp(arg, "--rate-limit-burst") == 0) {
+            burst = atoll(value);
+        } else if (strcmp(arg, "--rate-limit-interval-ms") == 0) {
+            interval = atoll(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (scenario_count == 0) {
+        memcpy(scenarios, s_presets, sizeof(s_presets));
+        scenario_count = PRESET_COUNT;
+    }
+
+    for (size_t s = 0; s < scenario_count; s++) {
+        bench_scenario_t *sc = &scenarios[s];
+        if (rate > 0)       sc->rate_hz = (uint32_t)rate;
+        if (duration >= 0)  sc->duration_ms = (uint32_t)duration;
+        if (latency >= 0)   sc->latency_ms = (uint32_t)latency;
+        if (jitter >= 0)    sc->jitter_ms = (uint32_t)jitter;
+        if (loss >= 0)      sc->loss_percent = (uint8_t)(loss > 100 ? 100 : loss);
+        if (stall_percent >= 0) sc->stall_percent = (uint8_t)(stall_percent > 100 ? 100 : stall_percent);
+        if (stall_ms >= 0)  sc->stall_ms = (uint32_t)stall_ms;
+        if (lifetime >= 0)  sc->session_lifetime_ms = (uint32_t)lifetime;
+        if (repeat >= 0)    sc->repeat_percent = (uint8_t)(repeat > 100 ? 100 : repeat);
+        if (deadline >= 0)  sc->deadline_ms = (uint32_t)deadline;
+        if (drain >= 0)     sc->drain_ms = (uint32_t)drain;
+        if (seed >= 0)      sc->seed = (uint64_t)seed;
+        if (burst >= 0)     sc->rate_limit_burst = (uint8_t)(burst > 255 ? 255 : burst);
+        if (interval >= 0)  sc->rate_limit_interval_ms = (uint32_t)interval;
+    }
+
+    FILE *out = stdout;
+    if (output_path != NULL) {
+        out = fopen(output_path, "w");
+        if (out == NULL) {
+            perror(output_path);
+            return 1;
+        }
+    }
+
+    int failures = 0;
+    fprintf(out, "{\n  \"benchmark\": \"set_power_pipeline\",\n  \"version\": 1,\n  \"scenarios\": [\n");
+    for (size_t s = 0; s < scenario_count; s++) {
+        fprintf(stderr, "Running scenario %s...\n", scenarios[s].name);
+        if (run_scenario_isolated(&scenarios[s], out) != 0) {
+            fprintf(stderr, "Scenario %s did not complete cleanly\n", scenarios[s].name);
+            failures++;
+        }
+        fprintf(out, "%s\n", (s + 1 < scenario_count) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
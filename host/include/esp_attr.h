@@ -0,0 +1,10 @@
+/**
+ * @file esp_attr.h
+ * @brief Host (POSIX) shim: memory placement attributes are no-ops
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
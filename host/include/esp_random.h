@@ -0,0 +1,26 @@
+/**
+ * @file esp_random.h
+ * @brief Host (POSIX) shim: random numbers
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 32-bit pseudo-random number (thread-safe)
+ */
+uint32_t esp_random(void);
+
+/**
+ * @brief Seed esp_random() for reproducible runs (host only)
+ */
+void esp_random_host_seed(uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
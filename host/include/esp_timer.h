@@ -0,0 +1,21 @@
+/**
+ * @file esp_timer.h
+ * @brief Host (POSIX) shim: monotonic microsecond clock
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Microseconds since the process started (CLOCK_MONOTONIC)
+ */
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
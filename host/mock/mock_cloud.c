@@ -0,0 +1,887 @@
+/**
+ * @file mock_cloud.c
+ * @brief Local mock of the MIC POWER cloud API for host builds
+ */
+
+#include "mock_cloud.h"
+#include "md5_wrapper.h"
+#include "cloud_transport.h"
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIGNATURE_KEY       "1f80ca5871919371ea71716cae4841bd"
+#define LOGIN_PATH          "/v1/user/login"
+#define SET_POWER_PATH      "/v1/manage/setOnGridInverterParam"
+
+#define MAX_SESSIONS        64
+#define MAX_CONNECTIONS     64
+#define SESSION_ID_LEN      32
+#define REQUEST_HEAD_MAX    8192
+#define REQUEST_BODY_MAX    2048
+#define FIELD_MAX           256
+
+typedef struct {
+    char id[SESSION_ID_LEN + 1];
+    int64_t issued_ms;
+} mock_session_t;
+
+typedef struct {
+    char method[8];
+    char path[256];
+    char cookie[128];
+    char sign[64];
+    bool connection_close;
+    long content_length;
+    char body[REQUEST_BODY_MAX + 1];
+} mock_request_t;
+
+typedef struct {
+    int status;
+    char headers[160];              // Extra "Key: value\r\n" lines
+    const char *body;
+} mock_response_t;
+
+static struct {
+    mock_cloud_config_t config;
+    int listen_fd;
+    int port;
+    bool running;
+    pthread_t accept_thread;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    int connection_fds[MAX_CONNECTIONS];
+    int active_connections;
+    mock_session_t sessions[MAX_SESSIONS];
+    uint32_t next_session;
+    uint64_t session_counter;
+    uint64_t random_state;
+    mock_cloud_stats_t stats;
+} s_mock = {
+    .listen_fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/**
+ * @brief Uniform random number in [0, bound) from the seeded generator
+ */
+static uint32_t random_below(uint32_t bound)
+{
+    if (bound == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&s_mock.lock);
+    // xorshift64*: reproducible for a given seed, good enough for test traffic
+    uint64_t x = s_mock.random_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    s_mock.random_state = x;
+    pthread_mutex_unlock(&s_mock.lock);
+
+    return (uint32_t)(((x * 0x2545F4914F6CDD1DULL) >> 32) % bound);
+}
+
+static void md5_hex(const char *input, char out[33])
+{
+    static const char *hex = "0123456789abcdef";
+    uint8_t digest[16];
+
+    md5_calculate((const uint8_t *)input, strlen(input), digest);
+    for (int i = 0; i < 16; i++) {
+        out[i * 2] = hex[digest[i] >> 4];
+        out[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    out[32] = '\0';
+}
+
+/**
+ * @brief URL-encode exactly as the device does before signing
+ */
+static void url_encode(char *dst, const char *src, size_t dst_size)
+{
+    static const char *hex = "0123456789ABCDEF";
+    size_t pos = 0;
+
+    for (; *src && pos + 4 < dst_size; src++) {
+        unsigned char c = (unsigned char)*src;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            dst[pos++] = (char)c;
+        } else {
+            dst[pos++] = '%';
+            dst[pos++] = hex[c >> 4];
+            dst[pos++] = hex[c & 0x0F];
+        }
+    }
+    dst[pos] = '\0';
+}
+
+/**
+ * @brief Copy the raw (still encoded) value of form field @p name
+ */
+static bool form_field(const char *body, const char *name, char *out, size_t out_size)
+{
+    size_t name_len = strlen(name);
+    const char *p = body;
+
+    while (p != NULL && *p) {
+        if (strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            const char *value = p + name_len + 1;
+            const char *end = strchr(value, '&');
+            size_t len = (end != NULL) ? (size_t)(end - value) : strlen(value);
+            if (len >= out_size) {
+                return false;
+            }
+            memcpy(out, value, len);
+            out[len] = '\0';
+            return true;
+        }
+        p = strchr(p, '&');
+        if (p != NULL) {
+            p++;
+        }
+    }
+
+    return false;
+}
+
+/* Sessions (caller holds s_mock.lock) */
+
+static const char *create_session(void)
+{
+    mock_session_t *session = &s_mock.sessions[s_mock.next_session];
+    s_mock.next_session = (s_mock.next_session + 1) % MAX_SESSIONS;
+
+    char seed[64];
+    snprintf(seed, sizeof(seed), "session-%llu-%lld",
+             (unsigned long long)++s_mock.session_counter, (long long)now_ms());
+    md5_hex(seed, session->id);
+    session->id[SESSION_ID_LEN] = '\0';
+    session->issued_ms = now_ms();
+
+    return session->id;
+}
+
+static bool session_valid(const char *cookie)
+{
+    const char *id = strstr(cookie, "JSESSIONID=");
+    if (id == NULL) {
+        return false;
+    }
+    id += strlen("JSESSIONID=");
+
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        mock_session_t *session = &s_mock.sessions[i];
+        if (session->id[0] == '\0' || strncmp(session->id, id, SESSION_ID_LEN) != 0) {
+            continue;
+        }
+        if (s_mock.config.session_lifetime_ms > 0 &&
+            now_ms() - session->issued_ms > (int64_t)s_mock.config.session_lifetime_ms) {
+            session->id[0] = '\0';
+            return false;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/* Request handling */
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool send_response(int fd, const mock_response_t *resp, bool close_after)
+{
+    char response[1024];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 %d %s\r\n"
+                       "Content-Type: application/json;charset=UTF-8\r\n"
+                       "%s"
+                       "Content-Length: %zu\r\n"
+                       "Connection: %s\r\n"
+                       "\r\n%s",
+                       resp->status, (resp->status == 200) ? "OK" : "Not Found", resp->headers,
+                       strlen(resp->body), close_after ? "close" : "keep-alive", resp->body);
+
+    return len > 0 && (size_t)len < sizeof(response) && send_all(fd, response, (size_t)len);
+}
+
+/**
+ * @brief Take note of the request headers the mock cares about
+ */
+static void request_header(mock_request_t *req, const char *key, const char *value)
+{
+    if (strcasecmp(key, "Content-Length") == 0) {
+        req->content_length = atol(value);
+    } else if (strcasecmp(key, "Cookie") == 0) {
+        snprintf(req->cookie, sizeof(req->cookie), "%s", value);
+    } else if (strcasecmp(key, "sign") == 0) {
+        snprintf(req->sign, sizeof(req->sign), "%s", value);
+    } else if (strcasecmp(key, "Connection") == 0) {
+        req->connection_close = (strcasecmp(value, "close") == 0);
+    }
+}
+
+/**
+ * @brief Read one request (head and body); false on EOF or malformed input
+ */
+static bool read_request(int fd, char *buf, size_t *buf_len, mock_request_t *req)
+{
+    memset(req, 0, sizeof(*req));
+    char *head_end = NULL;
+
+    for (;;) {
+        buf[*buf_len] = '\0';
+        head_end = strstr(buf, "\r\n\r\n");
+        if (head_end != NULL) {
+            break;
+        }
+        if (*buf_len >= REQUEST_HEAD_MAX) {
+            return false;
+        }
+        ssize_t received = recv(fd, buf + *buf_len, REQUEST_HEAD_MAX - *buf_len, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        *buf_len += (size_t)received;
+    }
+
+    *head_end = '\0';
+    char *save = NULL;
+    char *line = strtok_r(buf, "\r\n", &save);
+    if (line == NULL || sscanf(line, "%7s %255s", req->method, req->path) != 2) {
+        return false;
+    }
+
+    req->content_length = 0;
+    while ((line = strtok_r(NULL, "\r\n", &save)) != NULL) {
+        char *colon = strchr(line, ':');
+        if (colon == NULL) {
+            continue;
+        }
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') {
+            value++;
+        }
+
+        request_header(req, line, value);
+    }
+
+    if (req->content_length < 0 || req->content_length > REQUEST_BODY_MAX) {
+        return false;
+    }
+
+    // Bytes after the head belong to the body (and possibly a pipelined request)
+    size_t head_len = (size_t)(head_end - buf) + 4;
+    size_t have = *buf_len - head_len;
+    memmove(buf, buf + head_len, have);
+    *buf_len = have;
+
+    while (*buf_len < (size_t)req->content_length) {
+        ssize_t received = recv(fd, buf + *buf_len, REQUEST_HEAD_MAX - *buf_len, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        *buf_len += (size_t)received;
+    }
+
+    memcpy(req->body, buf, (size_t)req->content_length);
+    req->body[req->content_length] = '\0';
+    memmove(buf, buf + req->content_length, *buf_len - (size_t)req->content_length);
+    *buf_len -= (size_t)req->content_length;
+
+    return true;
+}
+
+static void handle_login(const mock_request_t *req, mock_response_t *resp)
+{
+    char email[FIELD_MAX], password[FIELD_MAX], app_version[64], phone_os[16], phone_model[64], sign[64];
+    bool ok = form_field(req->body, "email", email, sizeof(email)) &&
+              form_field(req->body, "password", password, sizeof(password)) &&
+              form_field(req->body, "appVersion", app_version, sizeof(app_version)) &&
+              form_field(req->body, "phoneOs", phone_os, sizeof(phone_os)) &&
+              form_field(req->body, "phoneModel", phone_model, sizeof(phone_model)) &&
+              form_field(req->body, "sign", sign, sizeof(sign));
+
+    if (ok && s_mock.config.email != NULL) {
+        ok = strcmp(email, s_mock.config.email) == 0;
+    }
+    if (ok && s_mock.config.password != NULL) {
+        char expected[33];
+        md5_hex(s_mock.config.password, expected);
+        ok = strcmp(password, expected) == 0;
+    }
+    if (ok && s_mock.config.verify_signatures) {
+        char encoded_email[FIELD_MAX * 3];
+        char sign_string[2048];
+        char expected[33];
+        url_encode(encoded_email, email, sizeof(encoded_email));
+        snprintf(sign_string, sizeof(sign_string),
+                 "appVersion=%s&email=%s&password=%s&phoneModel=%s&phoneOs=%s%s",
+                 app_version, encoded_email, password, phone_model, phone_os, SIGNATURE_KEY);
+        md5_hex(sign_string, expected);
+        ok = strcmp(sign, expected) == 0;
+    }
+
+    if (!ok) {
+        pthread_mutex_lock(&s_mock.lock);
+        s_mock.stats.login_failures++;
+        pthread_mutex_unlock(&s_mock.lock);
+        resp->body = "{\"result\":1,\"msg\":\"login failed\"}";
+        return;
+    }
+
+    pthread_mutex_lock(&s_mock.lock);
+    snprintf(resp->headers, sizeof(resp->headers), "Set-Cookie: JSESSIONID=%s; Path=/; HttpOnly\r\n",
+             create_session());
+    s_mock.stats.logins++;
+    pthread_mutex_unlock(&s_mock.lock);
+
+    resp->body = "{\"result\":0,\"msg\":\"success\",\"obj\":{\"userId\":1}}";
+}
+
+static void handle_set_power(const mock_request_t *req, mock_response_t *resp)
+{
+    char device_sn[64], power_str[16];
+    bool fields_ok = form_field(req->body, "deviceSn", device_sn, sizeof(device_sn)) &&
+                     form_field(req->body, "outputPower", power_str, sizeof(power_str));
+
+    bool sign_ok = fields_ok;
+    if (sign_ok && s_mock.config.verify_signatures) {
+        char encoded_sn[192];
+        char sign_string[512];
+        char expected[33];
+        url_encode(encoded_sn, device_sn, sizeof(encoded_sn));
+        snprintf(sign_string, sizeof(sign_string), "deviceSn=%s&outputPower=%s%s",
+                 encoded_sn, power_str, SIGNATURE_KEY);
+        md5_hex(sign_string, expected);
+        sign_ok = strcmp(req->sign, expected) == 0;
+    }
+
+    pthread_mutex_lock(&s_mock.lock);
+    s_mock.stats.set_power_requests++;
+    if (!session_valid(req->cookie)) {
+        s_mock.stats.session_rejections++;
+        resp->body = "{\"result\":10000,\"msg\":\"login expired\"}";
+    } else if (!sign_ok) {
+        s_mock.stats.signature_failures++;
+        resp->body = "{\"result\":1,\"msg\":\"sign error\"}";
+    } else {
+        s_mock.stats.set_power_accepted++;
+        s_mock.stats.last_power = atoi(power_str);
+        snprintf(s_mock.stats.last_device_sn, sizeof(s_mock.stats.last_device_sn), "%s", device_sn);
+        resp->body = "{\"result\":0,\"msg\":\"success\",\"obj\":null}";
+    }
+    pthread_mutex_unlock(&s_mock.lock);
+}
+
+/**
+ * @brief Answer a request, whichever way it arrived
+ */
+static void handle_request(const mock_request_t *req, mock_response_t *resp)
+{
+    resp->status = 200;
+    resp->headers[0] = '\0';
+
+    if (strcmp(req->path, LOGIN_PATH) == 0) {
+        handle_login(req, resp);
+    } else if (strcmp(req->path, SET_POWER_PATH) == 0) {
+        handle_set_power(req, resp);
+    } else {
+        resp->status = 404;
+        resp->body = "{\"result\":404,\"msg\":\"not found\"}";
+    }
+}
+
+/**
+ * @brief Count a request and roll its loss, stall and latency
+ */
+static uint32_t begin_request(bool *drop)
+{
+    *drop = random_below(100) < s_mock.config.loss_percent;
+    bool stall = random_below(100) < s_mock.config.stall_percent;
+
+    pthread_mutex_lock(&s_mock.lock);
+    s_mock.stats.requests++;
+    if (*drop) {
+        s_mock.stats.dropped_requests++;
+    }
+    if (stall) {
+        s_mock.stats.stalled_requests++;
+    }
+    pthread_mutex_unlock(&s_mock.lock);
+
+    return s_mock.config.latency_ms + random_below(s_mock.config.latency_jitter_ms + 1) +
+           (stall ? s_mock.config.stall_ms : 0);
+}
+
+static void *connection_thread(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    char *buf = malloc(REQUEST_HEAD_MAX + 1);
+    size_t buf_len = 0;
+    mock_request_t req;
+    mock_response_t resp;
+
+    while (buf != NULL && read_request(fd, buf, &buf_len, &req)) {
+        bool drop;
+        uint32_t delay_ms = begin_request(&drop);
+        if (delay_ms > 0) {
+            sleep_ms(delay_ms);
+        }
+
+        if (drop) {
+            break;  // Lost: the client sees the connection close without a response
+        }
+
+        handle_request(&req, &resp);
+        if (!send_response(fd, &resp, req.connection_close) || req.connection_close) {
+            break;
+        }
+    }
+    free(buf);
+
+    pthread_mutex_lock(&s_mock.lock);
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (s_mock.connection_fds[i] == fd) {
+            s_mock.connection_fds[i] = -1;
+            break;
+        }
+    }
+    close(fd);
+    s_mock.active_connections--;
+    pthread_cond_broadcast(&s_mock.idle);
+    pthread_mutex_unlock(&s_mock.lock);
+
+    return NULL;
+}
+
+static void *accept_thread(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        int fd = accept(s_mock.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;  // Listen socket shut down by mock_cloud_stop()
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        pthread_mutex_lock(&s_mock.lock);
+        int slot = -1;
+        for (int i = 0; i < MAX_CONNECTIONS && s_mock.running; i++) {
+            if (s_mock.connection_fds[i] < 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            pthread_mutex_unlock(&s_mock.lock);
+            close(fd);
+            continue;
+        }
+        s_mock.connection_fds[slot] = fd;
+        s_mock.active_connections++;
+        s_mock.stats.connections++;
+        pthread_mutex_unlock(&s_mock.lock);
+
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, connection_thread, (void *)(intptr_t)fd) != 0) {
+            pthread_mutex_lock(&s_mock.lock);
+            s_mock.connection_fds[slot] = -1;
+            s_mock.active_connections--;
+            pthread_mutex_unlock(&s_mock.lock);
+            close(fd);
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    return NULL;
+}
+
+/* In-process transport: requests go straight to the handlers, no sockets */
+
+static const char *TAG = "MOCK_CLOUD";
+
+typedef struct {
+    cloud_conn_t base;
+    mock_request_t req;
+    char host[64];                  // Server of the open connection
+    uint16_t port;
+    bool drop;                      // Loss roll of the current attempt
+    bool replayed;                  // Already sent again after a drop on a kept-alive connection
+    int64_t timeout_us;
+    int64_t due_us;                 // Simulated latency over
+    int64_t deadline_us;
+} mock_conn_t;
+
+/**
+ * @brief Send the request (again), on a new connection if none is open
+ */
+static void mock_conn_begin(mock_conn_t *mc)
+{
+    cloud_conn_t *conn = &mc->base;
+    int64_t now_us = esp_timer_get_time();
+
+    conn->start_us = now_us;
+    conn->reused = conn->open;
+    conn->connected_us = 0;
+    conn->first_byte_us = 0;
+    if (!conn->open) {
+        pthread_mutex_lock(&s_mock.lock);
+        s_mock.stats.connections++;
+        pthread_mutex_unlock(&s_mock.lock);
+        conn->connected_us = now_us;
+        conn->open = true;
+    }
+
+    uint32_t delay_ms = begin_request(&mc->drop);
+    mc->due_us = now_us + (int64_t)delay_ms * 1000;
+    mc->deadline_us = now_us + mc->timeout_us;
+    conn->state = CLOUD_CONN_BUSY;
+}
+
+/**
+ * @brief Deliver the outcome once the simulated latency or the timeout has passed
+ */
+static void mock_conn_complete(mock_conn_t *mc)
+{
+    cloud_conn_t *conn = &mc->base;
+
+    if (mc->due_us > mc->deadline_us) {
+        conn->open = false;
+        conn->err = ESP_ERR_TIMEOUT;
+        conn->state = CLOUD_CONN_FAILED;
+        return;
+    }
+
+    if (mc->drop) {
+        bool retry = conn->reused && !mc->replayed;
+        conn->open = false;
+        if (retry) {
+            // Same recovery as the socket transport for a stale keep-alive connection
+            ESP_LOGW(TAG, "Keep-alive connection lost (%s), reconnecting...",
+                     esp_err_to_name(ESP_ERR_HTTP_FETCH_HEADER));
+            mc->replayed = true;
+            mock_conn_begin(mc);
+            if (mc->due_us <= esp_timer_get_time()) {
+                mock_conn_complete(mc);
+            }
+            return;
+        }
+        conn->err = ESP_ERR_HTTP_FETCH_HEADER;
+        conn->state = CLOUD_CONN_FAILED;
+        return;
+    }
+
+    mock_response_t resp;
+    char length[24];
+    handle_request(&mc->req, &resp);
+    conn->first_byte_us = esp_timer_get_time();
+
+    if (conn->on_header != NULL) {
+        conn->on_header(conn->ctx, "Content-Type", "application/json;charset=UTF-8");
+
+        // Extra headers are "Key: value\r\n" lines
+        char *save = NULL;
+        for (char *line = strtok_r(resp.headers, "\r\n", &save); line != NULL;
+             line = strtok_r(NULL, "\r\n", &save)) {
+            char *colon = strchr(line, ':');
+            if (colon == NULL) {
+                continue;
+            }
+            *colon = '\0';
+            const char *value = colon + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            conn->on_header(conn->ctx, line, value);
+        }
+
+        snprintf(length, sizeof(length), "%zu", strlen(resp.body));
+        conn->on_header(conn->ctx, "Content-Length", length);
+        conn->on_header(conn->ctx, "Connection", mc->req.connection_close ? "close" : "keep-alive");
+    }
+    if (conn->on_body != NULL) {
+        conn->on_body(conn->ctx, resp.body, strlen(resp.body));
+    }
+
+    conn->status_code = resp.status;
+    conn->open = !mc->req.connection_close;
+    conn->state = CLOUD_CONN_DONE;
+}
+
+static cloud_conn_t *mock_conn_open(const cloud_transport_t *transport)
+{
+    mock_conn_t *mc = calloc(1, sizeof(*mc));
+    return (mc != NULL) ? &mc->base : NULL;
+}
+
+static esp_err_t mock_conn_start(cloud_conn_t *conn, const cloud_request_t *request, uint32_t timeout_ms)
+{
+    mock_conn_t *mc = (mock_conn_t *)conn;
+    mock_request_t *req = &mc->req;
+
+    pthread_mutex_lock(&s_mock.lock);
+    bool running = s_mock.running;
+    pthread_mutex_unlock(&s_mock.lock);
+    esp_err_t err = running ? ESP_OK : ESP_ERR_HTTP_CONNECT;
+    if (err == ESP_OK && request->body_len > REQUEST_BODY_MAX) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        conn->open = false;
+        conn->err = err;
+        conn->state = CLOUD_CONN_FAILED;
+        return err;
+    }
+
+    memset(req, 0, sizeof(*req));
+    snprintf(req->method, sizeof(req->method), "%s", request->method);
+    snprintf(req->path, sizeof(req->path), "%s", request->path);
+    for (size_t i = 0; i < request->header_count; i++) {
+        request_header(req, request->headers[i].key, request->headers[i].value);
+    }
+    req->content_length = (long)request->body_len;
+    if (request->body_len > 0) {
+        memcpy(req->body, request->body, request->body_len);
+    }
+
+    if (strcmp(mc->host, request->host) != 0 || mc->port != request->port) {
+        conn->open = false;  // Every host answers, but on a connection of its own
+        snprintf(mc->host, sizeof(mc->host), "%s", request->host);
+        mc->port = request->port;
+    }
+    mc->timeout_us = (int64_t)timeout_ms * 1000;
+    mc->replayed = false;
+    mock_conn_begin(mc);
+    if (mc->due_us <= conn->start_us) {
+        mock_conn_complete(mc);
+    }
+
+    return ESP_OK;
+}
+
+static int mock_conn_add_fds(cloud_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd, int64_t *wake_us)
+{
+    mock_conn_t *mc = (mock_conn_t *)conn;
+
+    if (conn->state == CLOUD_CONN_BUSY) {
+        int64_t due_us = (mc->due_us < mc->deadline_us) ? mc->due_us : mc->deadline_us;
+        if (due_us < *wake_us) {
+            *wake_us = due_us;
+        }
+    }
+
+    return max_fd;
+}
+
+static void mock_conn_process(cloud_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds)
+{
+    mock_conn_t *mc = (mock_conn_t *)conn;
+    int64_t now_us = esp_timer_get_time();
+
+    if (conn->state == CLOUD_CONN_BUSY && (now_us >= mc->due_us || now_us >= mc->deadline_us)) {
+        mock_conn_complete(mc);
+    }
+}
+
+static void mock_conn_finish(cloud_conn_t *conn)
+{
+}
+
+static void mock_conn_abort(cloud_conn_t *conn)
+{
+}
+
+static void mock_conn_close(cloud_conn_t *conn)
+{
+    free(conn);
+}
+
+static const cloud_transport_t s_mock_transport = {
+    .name = "mock",
+    .open = mock_conn_open,
+    .start = mock_conn_start,
+    .add_fds = mock_conn_add_fds,
+    .process = mock_conn_process,
+    .finish = mock_conn_finish,
+    .abort = mock_conn_abort,
+    .close = mock_conn_close,
+};
+
+const cloud_transport_t *mock_cloud_transport(void)
+{
+    return &s_mock_transport;
+}
+
+int mock_cloud_start(const mock_cloud_config_t *config)
+{
+    if (s_mock.running) {
+        errno = EALREADY;
+        return -1;
+    }
+
+    s_mock.config = *config;
+    s_mock.random_state = (config->seed != 0) ? config->seed : 0x9E3779B97F4A7C15ULL;
+    memset(&s_mock.stats, 0, sizeof(s_mock.stats));
+    s_mock.stats.last_power = -1;
+    memset(s_mock.sessions, 0, sizeof(s_mock.sessions));
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        s_mock.connection_fds[i] = -1;
+    }
+
+    if (config->in_process) {
+        s_mock.port = 0;
+        pthread_mutex_lock(&s_mock.lock);
+        s_mock.running = true;
+        pthread_mutex_unlock(&s_mock.lock);
+        return 0;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)config->port),
+    };
+    inet_pton(AF_INET, (config->bind_address != NULL) ? config->bind_address : "127.0.0.1", &addr.sin_addr);
+
+    socklen_t addr_len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    s_mock.listen_fd = fd;
+    s_mock.port = ntohs(addr.sin_port);
+    s_mock.running = true;
+
+    if (pthread_create(&s_mock.accept_thread, NULL, accept_thread, NULL) != 0) {
+        close(fd);
+        s_mock.listen_fd = -1;
+        s_mock.running = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+void mock_cloud_stop(void)
+{
+    if (!s_mock.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&s_mock.lock);
+    s_mock.running = false;
+    pthread_mutex_unlock(&s_mock.lock);
+
+    if (s_mock.listen_fd < 0) {
+        return;  // In-process only, no threads to stop
+    }
+
+    shutdown(s_mock.listen_fd, SHUT_RDWR);
+    pthread_join(s_mock.accept_thread, NULL);
+    close(s_mock.listen_fd);
+    s_mock.listen_fd = -1;
+
+    // Wake connection threads blocked in recv() and wait for them to finish
+    pthread_mutex_lock(&s_mock.lock);
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (s_mock.connection_fds[i] >= 0) {
+            shutdown(s_mock.connection_fds[i], SHUT_RDWR);
+        }
+    }
+    while (s_mock.active_connections > 0) {
+        pthread_cond_wait(&s_mock.idle, &s_mock.lock);
+    }
+    pthread_mutex_unlock(&s_mock.lock);
+}
+
+int mock_cloud_port(void)
+{
+    return s_mock.port;
+}
+
+void mock_cloud_get_stats(mock_cloud_stats_t *stats)
+{
+    pthread_mutex_lock(&s_mock.lock);
+    *stats = s_mock.stats;
+    pthread_mutex_unlock(&s_mock.lock);
+}
+
+void mock_cloud_expire_sessions(void)
+{
+    pthread_mutex_lock(&s_mock.lock);
+    memset(s_mock.sessions, 0, sizeof(s_mock.sessions));
+    pthread_mutex_unlock(&s_mock.lock);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file mock_cloud.h
+ * @brief Local mock of the MIC POWER cloud API for host builds
+ *
+ * Serves the two endpoints used by set_power_service over plain HTTP/1.1
+ * with keep-alive:
+ *  - POST /v1/user/login: issues a JSESSIONID cookie
+ *  - POST /v1/manage/setOnGridInverterParam: checks the session cookie and
+ *    the "sign" header, answers {"result":0} or {"result":10000} (session
+ *    expired)
+ *
+ * Latency, jitter, occasional stalls, packet loss (the connection is closed
+ * instead of answering) and session expiry are configurable to exercise the
+ * retry, hedging and re-login paths.
+ *
+ * The server runs in-process on its own threads so a host program can start
+ * it, point the service at it and inspect what it received. With
+ * in_process set there is no listening socket at all: the service reaches
+ * the same handlers through mock_cloud_transport(), which removes network
+ * and scheduling noise from benchmarks.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cloud_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mock server configuration
+ */
+typedef struct {
+    const char *bind_address;       /*!< Listen address (NULL = 127.0.0.1) */
+    int port;                       /*!< Listen port (0 = ephemeral, see mock_cloud_port()) */
+    uint32_t latency_ms;            /*!< Delay added before every response */
+    uint32_t latency_jitter_ms;     /*!< Extra uniformly distributed delay, 0..jitter */
+    uint8_t loss_percent;           /*!< Requests dropped (connection closed, no response), 0-100 */
+    uint8_t stall_percent;          /*!< Requests that stall for stall_ms on top of the latency, 0-100 */
+    uint32_t stall_ms;              /*!< Length of a stall */
+    uint64_t seed;                  /*!< Seed for jitter and loss (0 = fixed default) */
+    uint32_t session_lifetime_ms;   /*!< Sessions expire after this long (0 = never) */
+    const char *email;              /*!< Expected login email (NULL = accept any) */
+    const char *password;           /*!< Expected login password (NULL = accept any) */
+    bool verify_signatures;         /*!< Reject requests whose "sign" does not match */
+    bool in_process;                /*!< No listening socket, serve mock_cloud_transport() only */
+} mock_cloud_config_t;
+
+/**
+ * @brief Default mock configuration
+ */
+#define MOCK_CLOUD_CONFIG_DEFAULT() { \
+    .bind_address = NULL, \
+    .port = 0, \
+    .latency_ms = 0, \
+    .latency_jitter_ms = 0, \
+    .loss_percent = 0, \
+    .stall_percent = 0, \
+    .stall_ms = 0, \
+    .seed = 0, \
+    .session_lifetime_ms = 0, \
+    .email = NULL, \
+    .password = NULL, \
+    .verify_signatures = true, \
+    .in_process = false, \
+}
+
+/**
+ * @brief Counters of what the mock has served
+ */
+typedef struct {
+    uint32_t connections;           /*!< TCP connections accepted (or simulated in-process) */
+    uint32_t requests;              /*!< HTTP requests received (all paths, incl. dropped) */
+    uint32_t dropped_requests;      /*!< Requests dropped to simulate loss */
+    uint32_t stalled_requests;      /*!< Requests delayed by a stall */
+    uint32_t logins;                /*!< Successful logins */
+    uint32_t login_failures;        /*!< Logins rejected (credentials or sign) */
+    uint32_t set_power_requests;    /*!< setOnGridInverterParam requests received */
+    uint32_t set_power_accepted;    /*!< setOnGridInverterParam requests answered with result 0 */
+    uint32_t session_rejections;    /*!< Requests answered with result 10000 */
+    uint32_t signature_failures;    /*!< Requests rejected for a bad "sign" header */
+    int last_power;                 /*!< Last accepted output power (-1 = none) */
+    char last_device_sn[64];        /*!< Device SN of the last accepted request */
+} mock_cloud_stats_t;
+
+/**
+ * @brief Start the mock server
+ *
+ * @param config Server configuration
+ * @return 0 on success, -1 on failure (errno set)
+ */
+int mock_cloud_start(const mock_cloud_config_t *config);
+
+/**
+ * @brief Stop the mock server and close all connections
+ */
+void mock_cloud_stop(void);
+
+/**
+ * @brief Port the server is listening on (0 when in-process only)
+ */
+int mock_cloud_port(void);
+
+/**
+ * @brief Copy the current counters
+ */
+void mock_cloud_get_stats(mock_cloud_stats_t *stats);
+
+/**
+ * @brief Invalidate all sessions, as if the cloud had expired them
+ */
+void mock_cloud_expire_sessions(void);
+
+/**
+ * @brief Transport that hands requests to the running mock without sockets
+ *
+ * Latency, loss and timeouts are simulated with wake times instead of
+ * sleeps, so the service task is never blocked by the mock. Usable with
+ * or without in_process.
+ */
+const cloud_transport_t *mock_cloud_transport(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,101 @@
+/**
+ * @file mock_cloud_main.c
+ * @brief Standalone mock cloud server
+ *
+ * Usage: mock_cloud_server [--port N] [--latency-ms N] [--jitter-ms N] [--loss-percent N]
+ *                          [--stall-percent N --stall-ms N] [--session-lifetime-ms N] [--seed N]
+ *                          [--email E --password P] [--no-verify]
+ */
+
+#include "mock_cloud.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t s_stop;
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    s_stop = 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--port N] [--latency-ms N] [--jitter-ms N] [--loss-percent N]\n"
+            "          [--stall-percent N --stall-ms N] [--session-lifetime-ms N] [--seed N]\n"
+            "          [--email E --password P] [--no-verify]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    mock_cloud_config_t config = MOCK_CLOUD_CONFIG_DEFAULT();
+    config.port = 8080;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--no-verify") == 0) {
+            config.verify_signatures = false;
+            continue;
+        }
+        if (value == NULL) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(arg, "--port") == 0) {
+            config.port = atoi(value);
+        } else if (strcmp(arg, "--latency-ms") == 0) {
+            config.latency_ms = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--jitter-ms") == 0) {
+            config.latency_jitter_ms = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--loss-percent") == 0) {
+            config.loss_percent = (uint8_t)atoi(value);
+        } else if (strcmp(arg, "--stall-percent") == 0) {
+            config.stall_percent = (uint8_t)atoi(value);
+        } else if (strcmp(arg, "--stall-ms") == 0) {
+            config.stall_ms = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            config.seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--session-lifetime-ms") == 0) {
+            config.session_lifetime_ms = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--email") == 0) {
+            config.email = value;
+        } else if (strcmp(arg, "--password") == 0) {
+            config.password = value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+
+    if (mock_cloud_start(&config) != 0) {
+        perror("mock_cloud_start");
+        return 1;
+    }
+    printf("Mock cloud listening on 127.0.0.1:%d\n", mock_cloud_port());
+    fflush(stdout);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    while (!s_stop) {
+        pause();
+    }
+
+    mock_cloud_stop();
+
+    mock_cloud_stats_t stats;
+    mock_cloud_get_stats(&stats);
+    printf("connections=%u requests=%u dropped=%u stalled=%u logins=%u set_power=%u accepted=%u "
+           "session_rejections=%u signature_failures=%u\n",
+           stats.connections, stats.requests, stats.dropped_requests, stats.stalled_requests, stats.logins,
+           stats.set_power_requests, stats.set_power_accepted,
+           stats.session_rejections, stats.signature_failures);
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file set_power_host.c
+ * @brief Run the unmodified set_power_service on Linux
+ *
+ * Starts the in-process mock cloud (or uses --server host:port), points
+ * the service's base URL at it, sends a few setpoints (to each of --devices N
+ * inverters sharing a session, in each of --instances N independent service
+ * instances) and prints the service status. Useful to step through the
+ * service in a debugger or run it under sanitizers without a device.
+ *
+ * --transport picks how requests travel: "socket" (default), "esp-http"
+ * (the esp_http_client shim) or "mock" (the mock cloud in-process, no
+ * sockets). --record FILE saves every exchange; --replay FILE answers from
+ * such a recording instead of a server, with the recorded timing.
+ * --failover puts an endpoint that refuses connections in front of the
+ * cloud, so the service has to find the working one. --hedge enables hedged
+ * set-power requests.
+ *
+ * Exits non-zero if a setpoint fails or, with the mock cloud, if the mock did
+ * not accept every setpoint the service reports as successful or ended on
+ * another power than the last one sent (the ctest cases rely on this).
+ *
+ * Usage: set_power_host [--server host:port] [--transport socket|esp-http|mock] [--record FILE]
+ *                       [--replay FILE] [--failover] [--hedge] [--devices N] [--instances N] [--verbose] [power ...]
+ */
+
+#include "set_power_service.h"
+#include "mock_cloud.h"
+#include "dns_cache.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_EMAIL      "host@example.com"
+#define HOST_PASSWORD   "host-password"
+#define HOST_DEVICE_SN  "HOST%010d"     // Serial of device n (1-based, numbered across instances)
+#define HOST_MAX_INSTANCES  4
+#define HOST_DEAD_ENDPOINT  "http://127.0.0.1:9"   // Discard port, nothing listens there
+
+/**
+ * @return Requests the service counts as successful
+ */
+static uint32_t print_status(set_power_service_handle_t instance)
+{
+    set_power_service_status_t status;
+    if (set_power_instance_get_status(instance, &status) != ESP_OK) {
+        return 0;
+    }
+
+    printf("authenticated=%d total=%u ok=%u failed=%u skipped=%u refreshes=%u reuses=%u reconnects=%u "
+           "aborted=%u max_in_flight=%u\n",
+           status.is_authenticated, status.total_requests, status.successful_requests,
+           status.failed_requests, status.skipped_requests, status.session_refreshes,
+           status.connection_reuses, status.connection_reconnects, status.aborted_requests,
+           status.max_in_flight_requests);
+    if (status.hedge_delay_ms > 0) {
+        printf("hedged=%u hedge_wins=%u hedge_delay=%ums\n", status.hedged_requests, status.hedge_wins,
+               status.hedge_delay_ms);
+    }
+    for (int i = 0; i < status.device_count; i++) {
+        const set_power_device_status_t *device = &status.devices[i];
+        printf("  %s: confirmed=%d total=%u ok=%u failed=%u skipped=%u superseded=%u\n",
+               device->device_sn, (int)device->confirmed_power, device->total_requests,
+               device->successful_requests, device->failed_requests, device->skipped_requests,
+               device->superseded_setpoints);
+    }
+
+    for (int op = 0; op < SET_POWER_OP_COUNT; op++) {
+        const set_power_latency_t *total = &status.latency[op][SET_POWER_PHASE_TOTAL];
+        const set_power_latency_t *dns = &status.latency[op][SET_POWER_PHASE_DNS];
+        printf("%-9s total: n=%u p50=%ums p90=%ums p99=%ums max=%ums\n",
+               set_power_op_to_name((set_power_op_t)op), total->count,
+               total->p50_ms, total->p90_ms, total->p99_ms, total->max_ms);
+        if (dns->count > 0) {
+            printf("%-9s dns:   n=%u p50=%ums p90=%ums p99=%ums max=%ums\n",
+                   set_power_op_to_name((set_power_op_t)op), dns->count,
+                   dns->p50_ms, dns->p90_ms, dns->p99_ms, dns->max_ms);
+        }
+    }
+    if (status.endpoint_count > 1) {
+        printf("endpoint switches=%u\n", status.endpoint_switches);
+        for (int i = 0; i < status.endpoint_count; i++) {
+            const set_power_endpoint_status_t *endpoint = &status.endpoints[i];
+            printf("  %c %s: rtt=%ums errors=%u%% requests=%u failures=%u%s\n", endpoint->active ? '*' : ' ',
+                   endpoint->base_url, endpoint->rtt_ms, endpoint->error_permille / 10, endpoint->requests,
+                   endpoint->failures, endpoint->down ? " down" : "");
+        }
+    }
+
+    return status.successful_requests;
+}
+
+int main(int argc, char **argv)
+{
+    const char *server = NULL;
+    const char *transport_name = "socket";
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    bool failover = false;
+    bool hedge = false;
+    int device_count = 1;
+    int instance_count = 1;
+    int powers[32];
+    int power_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server = argv[++i];
+        } else if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+            transport_name = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--failover") == 0) {
+            failover = true;
+        } else if (strcmp(argv[i], "--hedge") == 0) {
+            hedge = true;
+        } else if (strcmp(argv[i], "--devices") == 0 && i + 1 < argc) {
+            device_count = atoi(argv[++i]);
+            if (device_count < 1 || device_count > SET_POWER_SERVICE_MAX_DEVICES) {
+                fprintf(stderr, "--devices must be 1..%d\n", SET_POWER_SERVICE_MAX_DEVICES);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instance_count = atoi(argv[++i]);
+            if (instance_count < 1 || instance_count > HOST_MAX_INSTANCES) {
+                fprintf(stderr, "--instances must be 1..%d\n", HOST_MAX_INSTANCES);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            esp_log_level_set("*", ESP_LOG_DEBUG);
+        } else if (power_count < (int)(sizeof(powers) / sizeof(powers[0]))) {
+            powers[power_count++] = atoi(argv[i]);
+        }
+    }
+    if (power_count == 0) {
+        static const int default_powers[] = { 20, 50, 50, 80, 0 };
+        power_count = (int)(sizeof(default_powers) / sizeof(default_powers[0]));
+        memcpy(powers, default_powers, sizeof(default_powers));
+    }
+
+    const cloud_transport_t *transport;
+    if (strcmp(transport_name, "socket") == 0) {
+        transport = cloud_transport_socket();
+    } else if (strcmp(transport_name, "esp-http") == 0) {
+        transport = cloud_transport_esp_http();
+    } else if (strcmp(transport_name, "mock") == 0 && server == NULL) {
+        transport = mock_cloud_transport();
+    } else {
+        fprintf(stderr, "--transport must be socket, esp-http or mock (mock without --server)\n");
+        return 2;
+    }
+
+    if (failover && (transport == mock_cloud_transport() || replay_path != NULL)) {
+        fprintf(stderr, "--failover needs a transport that really connects (socket or esp-http)\n");
+        return 2;
+    }
+
+    // A replay needs no cloud at all; the base URL only has to give the recorded paths
+    bool use_mock = (server == NULL && replay_path == NULL);
+    char base_url[160];
+    if (server != NULL) {
+        snprintf(base_url, sizeof(base_url), "http://%s", server);
+    } else if (!use_mock) {
+        snprintf(base_url, sizeof(base_url), "http://127.0.0.1");
+    } else {
+        mock_cloud_config_t mock_config = MOCK_CLOUD_CONFIG_DEFAULT();
+        mock_config.email = HOST_EMAIL;
+        mock_config.password = HOST_PASSWORD;
+        mock_config.in_process = (transport == mock_cloud_transport());
+        if (mock_cloud_start(&mock_config) != 0) {
+            perror("mock_cloud_start");
+            return 1;
+        }
+        if (mock_config.in_process) {
+            snprintf(base_url, sizeof(base_url), "http://mock-cloud");  // Never resolved
+        } else {
+            snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%d", mock_cloud_port());
+        }
+    }
+
+    cloud_transport_t *wrapper = NULL;
+    if (replay_path != NULL) {
+        wrapper = cloud_transport_replay_create(replay_path, true);
+    } else if (record_path != NULL) {
+        wrapper = cloud_transport_record_create(transport, record_path);
+    }
+    if ((replay_path != NULL || record_path != NULL) && instance_count > 1) {
+        fprintf(stderr, "--record and --replay serve a single instance\n");
+        return 2;
+    }
+    if ((replay_path != NULL || record_path != NULL) && wrapper == NULL) {
+        return 1;
+    }
+    if (wrapper != NULL) {
+        transport = wrapper;
+    }
+
+    // Each instance has its own login, session, connections and service task
+    set_power_service_handle_t instances[HOST_MAX_INSTANCES];
+    char device_sns[HOST_MAX_INSTANCES][SET_POWER_SERVICE_MAX_DEVICES][32];
+    for (int n = 0; n < instance_count; n++) {
+        set_power_service_config_t config = SET_POWER_SERVICE_CONFIG_DEFAULT();
+        config.email = HOST_EMAIL;
+        config.password = HOST_PASSWORD;
+        if (failover) {
+            config.base_urls[0] = HOST_DEAD_ENDPOINT;
+            config.base_urls[1] = base_url;
+            config.base_url_count = 2;
+        } else {
+            config.base_url = base_url;
+        }
+        config.transport = transport;
+        config.hedge.enabled = hedge;
+        for (int d = 0; d < device_count; d++) {
+            snprintf(device_sns[n][d], sizeof(device_sns[n][d]), HOST_DEVICE_SN, n * device_count + d + 1);
+            config.devices[d].device_sn = device_sns[n][d];
+        }
+        config.device_count = (uint8_t)device_count;
+
+        esp_err_t err = set_power_instance_create(&config, &instances[n]);
+        if (err != ESP_OK) {
+            fprintf(stderr, "set_power_instance_create failed: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    for (int n = 0; n < instance_count; n++) {
+        for (int i = 0; i < 50 && !set_power_instance_is_ready(instances[n]); i++) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    }
+
+    int failures = 0;
+    for (int i = 0; i < power_count; i++) {
+        for (int n = 0; n < instance_count; n++) {
+            for (int d = 0; d < device_count; d++) {
+                esp_err_t err = set_power_instance_set_output(instances[n], (uint8_t)d, powers[i], 0, true);
+                printf("set_output(%s, %d): %s\n", device_sns[n][d], powers[i], esp_err_to_name(err));
+                if (err != ESP_OK) {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    uint32_t successful = 0;
+    for (int n = 0; n < instance_count; n++) {
+        if (instance_count > 1) {
+            printf("instance %d: ", n);
+        }
+        successful += print_status(instances[n]);
+        set_power_instance_destroy(instances[n]);
+    }
+    cloud_transport_destroy(wrapper);
+
+    dns_cache_stats_t dns;
+    dns_cache_get_stats(&dns);
+    if (dns.resolutions > 0) {
+        printf("dns: hits=%u misses=%u stale_hits=%u resolutions=%u failures=%u refreshes=%u\n",
+               dns.hits, dns.misses, dns.stale_hits, dns.resolutions, dns.failures, dns.refreshes);
+    }
+
+    if (use_mock) {
+        mock_cloud_stats_t stats;
+        mock_cloud_stop();
+        mock_cloud_get_stats(&stats);
+        printf("mock: connections=%u logins=%u set_power=%u accepted=%u last_power=%d\n",
+               stats.connections, stats.logins, stats.set_power_requests,
+               stats.set_power_accepted, stats.last_power);
+        // Hedged requests may reach the mock twice, so it can accept more than the service counts
+        if (stats.set_power_accepted < successful) {
+            fprintf(stderr, "mock accepted %u setpoints, the service reports %u successful\n",
+                    stats.set_power_accepted, successful);
+            failures++;
+        }
+        if (power_count > 0 && stats.last_power != powers[power_count - 1]) {
+            fprintf(stderr, "mock ended on %d%%, the last setpoint sent was %d%%\n", stats.last_power,
+                    powers[power_count - 1]);
+            failures++;
+        }
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,638 @@
+/**
+ * @file esp_http_client_posix.c
+ * @brief Host (POSIX) shim: blocking HTTP/1.1 client on plain sockets
+ *
+ * Implements the esp_http_client subset used by set_power_service with the
+ * same observable behaviour: the connection is kept open between performs
+ * unless the server answers "Connection: close", a request on a dead
+ * keep-alive socket fails with ESP_ERR_HTTP_FETCH_HEADER, and response
+ * bodies are delivered de-chunked through HTTP_EVENT_ON_DATA in pieces of at
+ * most buffer_size bytes.
+ */
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+static const char *TAG = "HTTP_CLIENT";
+
+#define HOST_MAX_LEN        128
+#define PATH_MAX_LEN        256
+#define RX_BUFFER_SIZE      8192    // Holds the longest header line
+#define DEFAULT_BUFFER_SIZE 512
+#define DEFAULT_TIMEOUT_MS  5000
+
+typedef struct http_header {
+    char *key;
+    char *value;
+    struct http_header *next;
+} http_header_t;
+
+struct esp_http_client {
+    http_event_handle_cb event_handler;
+    void *user_data;
+    int buffer_size;
+    int timeout_ms;
+    esp_http_client_method_t method;
+
+    char host[HOST_MAX_LEN];
+    int port;
+    char path[PATH_MAX_LEN];
+
+    http_header_t *headers;
+    const char *post_data;          // Not owned, as on the device
+    int post_len;
+
+    int fd;
+    char connected_host[HOST_MAX_LEN];
+    int connected_port;
+
+    int status_code;
+    bool chunked;
+    long content_length;
+    bool connection_close;
+
+    char rx[RX_BUFFER_SIZE];
+    size_t rx_pos;
+    size_t rx_len;
+};
+
+static char s_redirect_host[HOST_MAX_LEN];
+static int s_redirect_port;
+
+void esp_http_client_host_redirect(const char *host, int port)
+{
+    if (host == NULL) {
+        s_redirect_host[0] = '\0';
+        s_redirect_port = 0;
+        return;
+    }
+
+    snprintf(s_redirect_host, sizeof(s_redirect_host), "%s", host);
+    s_redirect_port = port;
+}
+
+/**
+ * @brief Deliver an event to the configured handler
+ */
+static void dispatch_event(esp_http_client_handle_t client, esp_http_client_event_id_t id,
+                           void *data, int data_len, char *key, char *value)
+{
+    if (client->event_handler == NULL) {
+        return;
+    }
+
+    esp_http_client_event_t evt = {
+        .event_id = id,
+        .client = client,
+        .data = data,
+        .data_len = data_len,
+        .user_data = client->user_data,
+        .header_key = key,
+        .header_value = value,
+    };
+    client->event_handler(&evt);
+}
+
+/**
+ * @brief Split an http:// URL into host, port and path
+ */
+static esp_err_t parse_url(esp_http_client_handle_t client, const char *url)
+{
+    const char *prefix = "http://";
+    if (strncmp(url, prefix, strlen(prefix)) != 0) {
+        ESP_LOGE(TAG, "Only http:// URLs are supported: %s", url);
+        return ESP_ERR_HTTP_INVALID_TRANSPORT;
+    }
+
+    const char *host = url + strlen(prefix);
+    const char *path = strchr(host, '/');
+    const char *host_end = (path != NULL) ? path : host + strlen(host);
+    const char *colon = memchr(host, ':', host_end - host);
+    const char *name_end = (colon != NULL) ? colon : host_end;
+
+    if (name_end == host || (size_t)(name_end - host) >= sizeof(client->host)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(client->host, host, name_end - host);
+    client->host[name_end - host] = '\0';
+    client->port = (colon != NULL) ? atoi(colon + 1) : 80;
+    snprintf(client->path, sizeof(client->path), "%s", (path != NULL) ? path : "/");
+
+    return ESP_OK;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (config == NULL || config->url == NULL) {
+        return NULL;
+    }
+
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (client == NULL) {
+        return NULL;
+    }
+
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    client->buffer_size = (config->buffer_size > 0) ? config->buffer_size : DEFAULT_BUFFER_SIZE;
+    client->timeout_ms = (config->timeout_ms > 0) ? config->timeout_ms : DEFAULT_TIMEOUT_MS;
+    client->method = config->method;
+    client->fd = -1;
+
+    if (parse_url(client, config->url) != ESP_OK) {
+        free(client);
+        return NULL;
+    }
+
+    return client;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    return parse_url(client, url);
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    client->post_data = data;
+    client->post_len = len;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms)
+{
+    client->timeout_ms = timeout_ms;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    for (http_header_t *header = client->headers; header != NULL; header = header->next) {
+        if (strcasecmp(header->key, key) == 0) {
+            char *copy = strdup(value);
+            if (copy == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+            free(header->value);
+            header->value = copy;
+            return ESP_OK;
+        }
+    }
+
+    http_header_t *header = calloc(1, sizeof(*header));
+    if (header == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    header->key = strdup(key);
+    header->value = strdup(value);
+    if (header->key == NULL || header->value == NULL) {
+        free(header->key);
+        free(header->value);
+        free(header);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Append so headers go out in the order they were first set
+    http_header_t **tail = &client->headers;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = header;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    for (http_header_t **link = &client->headers; *link != NULL; link = &(*link)->next) {
+        http_header_t *header = *link;
+        if (strcasecmp(header->key, key) == 0) {
+            *link = header->next;
+            free(header->key);
+            free(header->value);
+            free(header);
+            return ESP_OK;
+        }
+    }
+
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status_code;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client)
+{
+    return client->chunked;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+        dispatch_event(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_http_client_close(client);
+
+    http_header_t *header = client->headers;
+    while (header != NULL) {
+        http_header_t *next = header->next;
+        free(header->key);
+        free(header->value);
+        free(header);
+        header = next;
+    }
+    free(client);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Open a TCP connection to host:port within the client timeout
+ */
+static int connect_socket(const char *host, int port, int timeout_ms)
+{
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(host, port_str, &hints, &result) != 0) {
+        ESP_LOGE(TAG, "DNS lookup failed for %s", host);
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        // Non-blocking connect so the handshake honours the timeout
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc != 0 && errno == EINPROGRESS) {
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            rc = -1;
+            if (poll(&pfd, 1, timeout_ms) == 1) {
+                int so_error = 0;
+                socklen_t len = sizeof(so_error);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
+                rc = (so_error == 0) ? 0 : -1;
+            }
+        }
+
+        if (rc == 0) {
+            fcntl(fd, F_SETFL, flags);
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Refill the receive buffer (returns false on EOF, error or timeout)
+ */
+static bool fill_rx(esp_http_client_handle_t client)
+{
+    if (client->rx_pos > 0 && client->rx_pos == client->rx_len) {
+        client->rx_pos = 0;
+        client->rx_len = 0;
+    } else if (client->rx_pos > 0) {
+        memmove(client->rx, client->rx + client->rx_pos, client->rx_len - client->rx_pos);
+        client->rx_len -= client->rx_pos;
+        client->rx_pos = 0;
+    }
+
+    if (client->rx_len == sizeof(client->rx)) {
+        return false;
+    }
+
+    for (;;) {
+        ssize_t received = recv(client->fd, client->rx + client->rx_len, sizeof(client->rx) - client->rx_len, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        client->rx_len += (size_t)received;
+        return true;
+    }
+}
+
+/**
+ * @brief Read one CRLF-terminated line (terminator stripped, NUL terminated in place)
+ */
+static char *read_line(esp_http_client_handle_t client)
+{
+    for (;;) {
+        char *start = client->rx + client->rx_pos;
+        size_t available = client->rx_len - client->rx_pos;
+        char *lf = memchr(start, '\n', available);
+
+        if (lf != NULL) {
+            *lf = '\0';
+            if (lf > start && lf[-1] == '\r') {
+                lf[-1] = '\0';
+            }
+            client->rx_pos += (size_t)(lf - start) + 1;
+            return start;
+        }
+
+        if (!fill_rx(client)) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * @brief Deliver up to @p len body bytes as ON_DATA events (len < 0: until EOF)
+ */
+static bool read_body(esp_http_client_handle_t client, long len)
+{
+    while (len != 0) {
+        if (client->rx_pos == client->rx_len && !fill_rx(client)) {
+            return len < 0;  // EOF ends a body without length
+        }
+
+        size_t available = client->rx_len - client->rx_pos;
+        size_t take = (size_t)client->buffer_size;
+        if (take > available) {
+            take = available;
+        }
+        if (len > 0 && take > (size_t)len) {
+            take = (size_t)len;
+        }
+
+        dispatch_event(client, HTTP_EVENT_ON_DATA, client->rx + client->rx_pos, (int)take, NULL, NULL);
+        client->rx_pos += take;
+        if (len > 0) {
+            len -= (long)take;
+        }
+    }
+
+    return true;
+}
+
+static bool read_chunked_body(esp_http_client_handle_t client)
+{
+    for (;;) {
+        char *line = read_line(client);
+        if (line == NULL) {
+            return false;
+        }
+
+        long chunk_len = strtol(line, NULL, 16);
+        if (chunk_len < 0) {
+            return false;
+        }
+        if (chunk_len == 0) {
+            // Skip trailers up to the terminating empty line
+            while ((line = read_line(client)) != NULL && line[0] != '\0') {
+            }
+            return line != NULL;
+        }
+
+        if (!read_body(client, chunk_len)) {
+            return false;
+        }
+        line = read_line(client);
+        if (line == NULL) {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Read the status line and headers, emitting ON_HEADER for each header
+ */
+static bool read_response_head(esp_http_client_handle_t client)
+{
+    char *line = read_line(client);
+    if (line == NULL || strncmp(line, "HTTP/1.", 7) != 0) {
+        return false;
+    }
+
+    const char *code = strchr(line, ' ');
+    if (code == NULL) {
+        return false;
+    }
+    client->status_code = atoi(code + 1);
+    client->connection_close = (strncmp(line, "HTTP/1.0", 8) == 0);
+
+    while ((line = read_line(client)) != NULL) {
+        if (line[0] == '\0') {
+            return true;
+        }
+
+        char *colon = strchr(line, ':');
+        if (colon == NULL) {
+            continue;
+        }
+        *colon = '\0';
+        char *value = colon + 1;
+        while (isspace((unsigned char)*value)) {
+            value++;
+        }
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_length = atol(value);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "chunked") == 0) {
+            client->chunked = true;
+        } else if (strcasecmp(line, "Connection") == 0) {
+            client->connection_close = (strcasecmp(value, "close") == 0);
+        }
+
+        dispatch_event(client, HTTP_EVENT_ON_HEADER, NULL, 0, line, value);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Serialize the request line, headers and body into one buffer
+ */
+static char *build_request(esp_http_client_handle_t client, const char *host, size_t *out_len)
+{
+    size_t capacity = 256 + strlen(client->path) + strlen(host) + (size_t)client->post_len;
+    for (http_header_t *header = client->headers; header != NULL; header = header->next) {
+        capacity += strlen(header->key) + strlen(header->value) + 4;
+    }
+
+    char *request = malloc(capacity);
+    if (request == NULL) {
+        return NULL;
+    }
+
+    size_t len = (size_t)snprintf(request, capacity, "%s %s HTTP/1.1\r\nHost: %s:%d\r\n",
+                                  (client->method == HTTP_METHOD_POST) ? "POST" : "GET",
+                                  client->path, host, client->port);
+    for (http_header_t *header = client->headers; header != NULL; header = header->next) {
+        len += (size_t)snprintf(request + len, capacity - len, "%s: %s\r\n", header->key, header->value);
+    }
+    if (client->method == HTTP_METHOD_POST) {
+        len += (size_t)snprintf(request + len, capacity - len, "Content-Length: %d\r\n", client->post_len);
+    }
+    len += (size_t)snprintf(request + len, capacity - len, "\r\n");
+    if (client->method == HTTP_METHOD_POST && client->post_len > 0) {
+        memcpy(request + len, client->post_data, (size_t)client->post_len);
+        len += (size_t)client->post_len;
+    }
+
+    *out_len = len;
+    return request;
+}
+
+/**
+ * @brief Drop the connection after a failed request and report @p err
+ */
+static esp_err_t fail_request(esp_http_client_handle_t client, esp_err_t err)
+{
+    dispatch_event(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+    esp_http_client_close(client);
+    return err;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    const char *target_host = (s_redirect_host[0] != '\0') ? s_redirect_host : client->host;
+    int target_port = (s_redirect_host[0] != '\0') ? s_redirect_port : client->port;
+
+    // A URL change to another server cannot reuse the open socket
+    if (client->fd >= 0 &&
+        (strcmp(client->connected_host, target_host) != 0 || client->connected_port != target_port)) {
+        esp_http_client_close(client);
+    }
+
+    if (client->fd < 0) {
+        client->fd = connect_socket(target_host, target_port, client->timeout_ms);
+        if (client->fd < 0) {
+            dispatch_event(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+            return ESP_ERR_HTTP_CONNECT;
+        }
+        snprintf(client->connected_host, sizeof(client->connected_host), "%s", target_host);
+        client->connected_port = target_port;
+        dispatch_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    }
+
+    size_t request_len = 0;
+    char *request = build_request(client, client->host, &request_len);
+    if (request == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bool sent = send_all(client->fd, request, request_len);
+    free(request);
+    if (!sent) {
+        return fail_request(client, ESP_ERR_HTTP_WRITE_DATA);
+    }
+    dispatch_event(client, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+
+    client->status_code = 0;
+    client->chunked = false;
+    client->content_length = -1;
+    client->connection_close = false;
+    client->rx_pos = 0;
+    client->rx_len = 0;
+
+    if (!read_response_head(client)) {
+        return fail_request(client, ESP_ERR_HTTP_FETCH_HEADER);
+    }
+
+    bool body_ok;
+    if (client->chunked) {
+        body_ok = read_chunked_body(client);
+    } else if (client->content_length >= 0) {
+        body_ok = read_body(client, client->content_length);
+    } else {
+        body_ok = read_body(client, -1);
+        client->connection_close = true;
+    }
+    if (!body_ok) {
+        return fail_request(client, ESP_FAIL);
+    }
+
+    dispatch_event(client, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+
+    if (client->connection_close) {
+        esp_http_client_close(client);
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file esp_system_posix.c
+ * @brief Host (POSIX) shim: esp_timer, esp_random, esp_log and esp_err_to_name
+ */
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "set_power_service.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+static _Atomic esp_log_level_t s_log_level = ESP_LOG_INFO;
+static atomic_uint_fast64_t s_random_state = 0x853c49e6748fea9bULL;
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t s_start_us;
+
+__attribute__((constructor))
+static void record_start_time(void)
+{
+    s_start_us = monotonic_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    // Microseconds since boot, like the ESP32 high-resolution timer
+    return monotonic_us() - s_start_us;
+}
+
+uint32_t esp_random(void)
+{
+    // splitmix64: each call claims its own counter value, so threads never share output
+    uint64_t z = atomic_fetch_add_explicit(&s_random_state, 0x9e3779b97f4a7c15ULL,
+                                           memory_order_relaxed) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+
+    return (uint32_t)(z >> 32);
+}
+
+void esp_random_host_seed(uint64_t seed)
+{
+    atomic_store_explicit(&s_random_state, seed, memory_order_relaxed);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    atomic_store_explicit(&s_log_level, level, memory_order_relaxed);
+}
+
+esp_log_level_t esp_log_level_get(void)
+{
+    return atomic_load_explicit(&s_log_level, memory_order_relaxed);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)level;
+    (void)tag;
+
+    va_list args;
+    va_start(args, format);
+    // Keep lines from concurrent tasks whole
+    pthread_mutex_lock(&s_log_lock);
+    vfprintf(stderr, format, args);
+    pthread_mutex_unlock(&s_log_lock);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                            return "ESP_OK";
+        case ESP_FAIL:                          return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:                    return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:               return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:             return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:              return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:                 return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:             return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:                   return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_HTTP_MAX_REDIRECT:         return "ESP_ERR_HTTP_MAX_REDIRECT";
+        case ESP_ERR_HTTP_CONNECT:              return "ESP_ERR_HTTP_CONNECT";
+        case ESP_ERR_HTTP_WRITE_DATA:           return "ESP_ERR_HTTP_WRITE_DATA";
+        case ESP_ERR_HTTP_FETCH_HEADER:         return "ESP_ERR_HTTP_FETCH_HEADER";
+        case ESP_ERR_HTTP_INVALID_TRANSPORT:    return "ESP_ERR_HTTP_INVALID_TRANSPORT";
+        case ESP_ERR_HTTP_CONNECTING:           return "ESP_ERR_HTTP_CONNECTING";
+        case ESP_ERR_HTTP_EAGAIN:               return "ESP_ERR_HTTP_EAGAIN";
+        case ESP_ERR_HTTP_CONNECTION_CLOSED:    return "ESP_ERR_HTTP_CONNECTION_CLOSED";
+        case ESP_ERR_SET_POWER_SUPERSEDED:      return "ESP_ERR_SET_POWER_SUPERSEDED";
+        case ESP_ERR_SET_POWER_CIRCUIT_OPEN:    return "ESP_ERR_SET_POWER_CIRCUIT_OPEN";
+        case ESP_ERR_SET_POWER_EXPIRED:         return "ESP_ERR_SET_POWER_EXPIRED";
+        default:                                return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,398 @@
+/**
+ * @file freertos_posix.c
+ * @brief Host (POSIX) shim: FreeRTOS tasks, notifications, queues and semaphores
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t task_code;
+    void *parameters;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_value;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+static __thread struct host_task *s_current_task;
+
+/**
+ * @brief Absolute CLOCK_MONOTONIC deadline for a wait of @p ticks
+ */
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)pdTICKS_TO_MS(ticks) * 1000000ULL;
+    ts.tv_sec += ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+
+    return ts;
+}
+
+/**
+ * @brief Condition variable that waits against CLOCK_MONOTONIC
+ */
+static void init_cond(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void unlock_mutex(void *mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+/* Tasks */
+
+static void *task_trampoline(void *arg)
+{
+    struct host_task *task = arg;
+    s_current_task = task;
+    task->task_code(task->parameters);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *created_task)
+{
+    (void)name;
+    (void)priority;
+
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+
+    task->task_code = task_code;
+    task->parameters = parameters;
+    pthread_mutex_init(&task->lock, NULL);
+    init_cond(&task->notified);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    // FreeRTOS stack depth is in bytes on ESP-IDF; leave headroom for host libc
+    size_t stack_size = (size_t)stack_depth * 4;
+    if (stack_size < PTHREAD_STACK_MIN * 4) {
+        stack_size = PTHREAD_STACK_MIN * 4;
+    }
+    pthread_attr_setstacksize(&attr, stack_size);
+
+    int err = pthread_create(&task->thread, &attr, task_trampoline, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(task);
+        return pdFAIL;
+    }
+
+    if (created_task != NULL) {
+        *created_task = task;
+    }
+
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *created_task,
+                                   BaseType_t core_id)
+{
+    (void)core_id;
+    return xTaskCreate(task_code, name, stack_depth, parameters, priority, created_task);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == s_current_task) {
+        // The handle stays valid for whoever deletes it later; the thread just ends
+        pthread_exit(NULL);
+    }
+
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    pthread_cond_destroy(&task->notified);
+    pthread_mutex_destroy(&task->lock);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = pdTICKS_TO_MS(ticks) / 1000,
+        .tv_nsec = (long)(pdTICKS_TO_MS(ticks) % 1000) * 1000000L,
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current_task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify_value++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = s_current_task;
+    uint32_t value;
+
+    pthread_mutex_lock(&task->lock);
+    pthread_cleanup_push(unlock_mutex, &task->lock);
+
+    if (task->notify_value == 0 && ticks_to_wait > 0) {
+        struct timespec deadline = deadline_after(ticks_to_wait);
+        while (task->notify_value == 0) {
+            int err = (ticks_to_wait == portMAX_DELAY) ?
+                pthread_cond_wait(&task->notified, &task->lock) :
+                pthread_cond_timedwait(&task->notified, &task->lock, &deadline);
+            if (err == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    value = task->notify_value;
+    if (value > 0) {
+        task->notify_value = clear_count_on_exit ? 0 : value - 1;
+    }
+
+    pthread_cleanup_pop(1);
+
+    return value;
+}
+
+/* Queues */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    queue->storage = calloc(length, item_size);
+    if (queue->storage == NULL) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    init_cond(&queue->not_empty);
+    init_cond(&queue->not_full);
+
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->storage);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    BaseType_t sent = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    pthread_cleanup_push(unlock_mutex, &queue->lock);
+
+    if (queue->count >= queue->length && ticks_to_wait > 0) {
+        struct timespec deadline = deadline_after(ticks_to_wait);
+        while (queue->count >= queue->length) {
+            int err = (ticks_to_wait == portMAX_DELAY) ?
+                pthread_cond_wait(&queue->not_full, &queue->lock) :
+                pthread_cond_timedwait(&queue->not_full, &queue->lock, &deadline);
+            if (err == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    if (queue->count < queue->length) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->storage + (size_t)tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_signal(&queue->not_empty);
+        sent = pdTRUE;
+    }
+
+    pthread_cleanup_pop(1);
+
+    return sent;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    BaseType_t received = pdFALSE;
+
+    pthread_mutex_lock(&queue->lock);
+    pthread_cleanup_push(unlock_mutex, &queue->lock);
+
+    if (queue->count == 0 && ticks_to_wait > 0) {
+        struct timespec deadline = deadline_after(ticks_to_wait);
+        while (queue->count == 0) {
+            int err = (ticks_to_wait == portMAX_DELAY) ?
+                pthread_cond_wait(&queue->not_empty, &queue->lock) :
+                pthread_cond_timedwait(&queue->not_empty, &queue->lock, &deadline);
+            if (err == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    if (queue->count > 0) {
+        memcpy(buffer, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+        received = pdTRUE;
+    }
+
+    pthread_cleanup_pop(1);
+
+    return received;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+
+    return count;
+}
+
+/* Semaphores */
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct host_semaphore *semaphore = calloc(1, sizeof(*semaphore));
+    if (semaphore == NULL) {
+        return NULL;
+    }
+
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    pthread_mutex_init(&semaphore->lock, NULL);
+    init_cond(&semaphore->available);
+
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    pthread_cond_destroy(&semaphore->available);
+    pthread_mutex_destroy(&semaphore->lock);
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    BaseType_t taken = pdFALSE;
+
+    pthread_mutex_lock(&semaphore->lock);
+    pthread_cleanup_push(unlock_mutex, &semaphore->lock);
+
+    if (semaphore->count == 0 && ticks_to_wait > 0) {
+        struct timespec deadline = deadline_after(ticks_to_wait);
+        while (semaphore->count == 0) {
+            int err = (ticks_to_wait == portMAX_DELAY) ?
+                pthread_cond_wait(&semaphore->available, &semaphore->lock) :
+                pthread_cond_timedwait(&semaphore->available, &semaphore->lock, &deadline);
+            if (err == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    if (semaphore->count > 0) {
+        semaphore->count--;
+        taken = pdTRUE;
+    }
+
+    pthread_cleanup_pop(1);
+
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    BaseType_t given = pdFALSE;
+
+    pthread_mutex_lock(&semaphore->lock);
+    if (semaphore->count < semaphore->max_count) {
+        semaphore->count++;
+        pthread_cond_signal(&semaphore->available);
+        given = pdTRUE;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+
+    return given;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file md5_host.c
+ * @brief Host implementation of md5_wrapper.h (RFC 1321)
+ *
+ * On the device md5_calculate() wraps ESPHome's MD5; the host build has no
+ * ESPHome, so this is a small self-contained implementation.
+ */
+
+#include "md5_wrapper.h"
+#include <string.h>
+
+typedef struct {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t block[64];
+    size_t block_len;
+} md5_context_t;
+
+static const uint32_t s_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const uint8_t s_shift[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static uint32_t rotate_left(uint32_t value, uint8_t bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void md5_transform(md5_context_t *ctx, const uint8_t block[64])
+{
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+               ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    uint32_t a = ctx->state[0];
+    uint32_t b = ctx->state[1];
+    uint32_t c = ctx->state[2];
+    uint32_t d = ctx->state[3];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+
+        uint32_t tmp = d;
+        d = c;
+        c = b;
+        b = b + rotate_left(a + f + s_k[i] + m[g], s_shift[i]);
+        a = tmp;
+    }
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+}
+
+static void md5_update(md5_context_t *ctx, const uint8_t *data, size_t len)
+{
+    ctx->length += len;
+
+    while (len > 0) {
+        size_t take = sizeof(ctx->block) - ctx->block_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(ctx->block + ctx->block_len, data, take);
+        ctx->block_len += take;
+        data += take;
+        len -= take;
+
+        if (ctx->block_len == sizeof(ctx->block)) {
+            md5_transform(ctx, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+int md5_calculate(const uint8_t *input, size_t ilen, uint8_t output[16])
+{
+    if (output == NULL || (input == NULL && ilen > 0)) {
+        return -1;
+    }
+
+    md5_context_t ctx = {
+        .state = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 },
+    };
+    md5_update(&ctx, input, ilen);
+
+    uint64_t bit_length = ctx.length * 8;
+    static const uint8_t padding[64] = { 0x80 };
+    size_t pad_len = (ctx.block_len < 56) ? (56 - ctx.block_len) : (120 - ctx.block_len);
+    md5_update(&ctx, padding, pad_len);
+
+    uint8_t length_le[8];
+    for (int i = 0; i < 8; i++) {
+        length_le[i] = (uint8_t)(bit_length >> (8 * i));
+    }
+    md5_update(&ctx, length_le, sizeof(length_le));
+
+    for (int i = 0; i < 4; i++) {
+        output[i * 4] = (uint8_t)ctx.state[i];
+        output[i * 4 + 1] = (uint8_t)(ctx.state[i] >> 8);
+        output[i * 4 + 2] = (uint8_t)(ctx.state[i] >> 16);
+        output[i * 4 + 3] = (uint8_t)(ctx.state[i] >> 24);
+    }
+
+    return 0;
+}
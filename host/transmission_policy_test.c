@@ -0,0 +1,111 @@
+/**
+ * @file transmission_policy_test.c
+ * @brief Check the transmission policy against setpoint sequences
+ *
+ * Each step requests a power at a given time, or re-checks the pending one as
+ * the component's loop() does, and states whether it must be sent. A new
+ * request equal to the confirmed power takes the component's duplicate path
+ * (settled, never evaluated), like set_output_power() does.
+ *
+ * Exits non-zero if any step decides otherwise (the ctest case relies on this).
+ */
+
+#include "transmission_policy.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct {
+    uint32_t at_ms;         // Time of the request
+    int confirmed;          // Power the inverter confirmed by then (-1 = none)
+    int power;              // Requested setpoint
+    bool recheck;           // loop() re-check of the pending setpoint, not a new request
+    bool sent;              // Expected decision
+} policy_step_t;
+
+typedef struct {
+    const char *name;
+    transmission_policy_config_t config;
+    policy_step_t steps[8];
+    int step_count;
+} policy_case_t;
+
+static const policy_case_t CASES[] = {
+    {
+        "first setpoint is always sent",
+        {5, 100.0f, 0},
+        {{0, -1, 50, false, true}},
+        1,
+    },
+    {
+        "small change integrates until the threshold",
+        {5, 100.0f, 0},
+        {{0, -1, 50, false, true}, {1000, 50, 52, false, false}, {40000, 50, 52, true, false},
+         {51000, 50, 52, true, true}},
+        4,
+    },
+    {
+        "suppressed, back to confirmed, small change later",
+        {5, 100.0f, 0},
+        {{0, -1, 50, false, true}, {1000, 50, 52, false, false}, {30000, 50, 52, true, false},
+         {31000, 50, 50, false, false}, {3631000, 50, 51, false, false}, {3633000, 50, 51, true, false}},
+        6,
+    },
+    {
+        "suppressed until the inverter confirms it, small change later",
+        {5, 100.0f, 0},
+        {{0, -1, 50, false, true}, {1000, 50, 52, false, false}, {45000, 50, 52, true, false},
+         {50000, 52, 52, true, false}, {3631000, 52, 53, false, false}, {3633000, 52, 53, true, false}},
+        6,
+    },
+    {
+        "large change is sent at once and resent unconfirmed",
+        {5, 100.0f, 0},
+        {{0, -1, 50, false, true}, {1000, 50, 60, false, true}, {2000, 50, 60, true, false},
+         {32000, 50, 60, true, true}},
+        4,
+    },
+    {
+        "silent interval bounds a small error",
+        {5, 0.0f, 10000},
+        {{0, -1, 50, false, true}, {1000, 50, 52, false, false}, {10000, 50, 52, true, true}},
+        3,
+    },
+};
+
+static bool run_case(const policy_case_t *test)
+{
+    transmission_policy_state_t state = TRANSMISSION_POLICY_STATE_INIT;
+
+    for (int i = 0; i < test->step_count; i++) {
+        const policy_step_t *step = &test->steps[i];
+        bool sent = false;
+        if (!step->recheck && step->power == step->confirmed) {
+            transmission_policy_settle(&state, step->at_ms);
+        } else {
+            sent = transmission_policy_should_transmit(&test->config, &state, step->confirmed, step->power,
+                                                       step->at_ms);
+        }
+        if (sent != step->sent) {
+            printf("FAIL %s: step %d (%d%% at %ums) %s, expected %s (error %d%%, integral %.1f %%·s)\n",
+                   test->name, i + 1, step->power, (unsigned) step->at_ms, sent ? "sent" : "held",
+                   step->sent ? "sent" : "held", state.tracking_error, state.error_integral);
+            return false;
+        }
+        if (sent) {
+            transmission_policy_transmitted(&state, step->power, step->at_ms);
+        }
+    }
+    printf("ok   %s\n", test->name);
+    return true;
+}
+
+int main(void)
+{
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        if (!run_case(&CASES[i])) {
+            failed++;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
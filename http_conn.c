@@ -0,0 +1,515 @@
+/**
+ * @file http_conn.c
+ * @brief Non-blocking HTTP/1.1 client connection driven by select()
+ */
+
+#include "http_conn.h"
+#include "dns_cache.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char *TAG = "HTTP_CONN";
+
+#define RX_BUFFER_SIZE          256     // Bytes read per recv() call (task stack)
+
+/* TCP keep-alive on open connections: probe after 5 s idle, every 5 s, 3 times */
+#define KEEPALIVE_IDLE_S        5
+#define KEEPALIVE_INTERVAL_S    5
+#define KEEPALIVE_COUNT         3
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Position of the response parser */
+enum {
+    RX_STATUS_LINE,
+    RX_HEADERS,
+    RX_BODY,             // Content-Length body, or body up to EOF
+    RX_CHUNK_SIZE,
+    RX_CHUNK_DATA,
+    RX_CHUNK_END,        // CRLF after chunk data
+    RX_TRAILERS,
+    RX_COMPLETE,
+};
+
+void http_conn_init(http_conn_t *conn, http_conn_header_cb_t on_header, http_conn_body_cb_t on_body, void *ctx)
+{
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = -1;
+    conn->state = HTTP_CONN_IDLE;
+    conn->on_header = on_header;
+    conn->on_body = on_body;
+    conn->ctx = ctx;
+}
+
+void http_conn_close(http_conn_t *conn)
+{
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+        ESP_LOGD(TAG, "Connection to %s:%u closed", conn->host, conn->port);
+    }
+    conn->state = HTTP_CONN_IDLE;
+}
+
+/**
+ * @brief End the request with an error, dropping the socket
+ */
+static void fail(http_conn_t *conn, esp_err_t err)
+{
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    conn->err = err;
+    conn->state = HTTP_CONN_FAILED;
+}
+
+/**
+ * @brief Apply socket options of a new connection
+ */
+static void set_socket_options(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+#ifdef TCP_KEEPIDLE
+    int idle = KEEPALIVE_IDLE_S;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+#endif
+#ifdef TCP_KEEPINTVL
+    int interval = KEEPALIVE_INTERVAL_S;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+    int count = KEEPALIVE_COUNT;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+}
+
+/**
+ * @brief Look up the peer in the DNS cache and start a non-blocking connect
+ *
+ * @return ESP_OK with the connection CONNECTING (or SENDING if it connected at once)
+ */
+static esp_err_t open_socket(http_conn_t *conn, const char *host, uint16_t port)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    esp_err_t err = dns_cache_lookup(host, port, &addr, &addr_len);
+    conn->resolved_us = esp_timer_get_time();
+    if (err != ESP_OK) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    set_socket_options(fd);
+
+    int rc = connect(fd, (const struct sockaddr *)&addr, addr_len);
+    if (rc != 0 && errno != EINPROGRESS) {
+        ESP_LOGE(TAG, "Connect to %s:%u failed: errno %d", host, port, errno);
+        close(fd);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    conn->fd = fd;
+    snprintf(conn->host, sizeof(conn->host), "%s", host);
+    conn->port = port;
+    if (rc == 0) {
+        conn->connected_us = esp_timer_get_time();
+        conn->state = HTTP_CONN_SENDING;
+    } else {
+        conn->state = HTTP_CONN_CONNECTING;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t http_conn_start(http_conn_t *conn, const char *host, uint16_t port,
+                          const char *request, size_t len, uint32_t timeout_ms)
+{
+    if (conn->state != HTTP_CONN_IDLE) {
+        fail(conn, ESP_ERR_INVALID_STATE);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    conn->tx = request;
+    conn->tx_len = len;
+    conn->tx_sent = 0;
+    conn->rx_phase = RX_STATUS_LINE;
+    conn->line_len = 0;
+    conn->content_length = -1;
+    conn->body_remaining = 0;
+    conn->chunked = false;
+    conn->close_after = false;
+    conn->status_code = 0;
+    conn->err = ESP_OK;
+    conn->received_any = false;
+    conn->start_us = esp_timer_get_time();
+    conn->resolved_us = 0;
+    conn->connected_us = 0;
+    conn->first_byte_us = 0;
+    conn->deadline_us = conn->start_us + (int64_t)timeout_ms * 1000;
+
+    // A socket to another server cannot be reused
+    if (conn->fd >= 0 && (conn->port != port || strcmp(conn->host, host) != 0)) {
+        http_conn_close(conn);
+    }
+
+    conn->reused = (conn->fd >= 0);
+    if (conn->reused) {
+        conn->state = HTTP_CONN_SENDING;
+        return ESP_OK;
+    }
+
+    esp_err_t err = open_socket(conn, host, port);
+    if (err != ESP_OK) {
+        fail(conn, err);
+    }
+
+    return err;
+}
+
+bool http_conn_busy(const http_conn_t *conn)
+{
+    return conn->state == HTTP_CONN_CONNECTING || conn->state == HTTP_CONN_SENDING ||
+           conn->state == HTTP_CONN_RECEIVING;
+}
+
+int http_conn_add_fds(const http_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd)
+{
+    if (conn->fd < 0) {
+        return max_fd;
+    }
+
+    switch (conn->state) {
+        case HTTP_CONN_CONNECTING:
+        case HTTP_CONN_SENDING:
+            FD_SET(conn->fd, write_fds);
+            break;
+        case HTTP_CONN_IDLE:
+        case HTTP_CONN_RECEIVING:
+            FD_SET(conn->fd, read_fds);
+            break;
+        default:
+            return max_fd;
+    }
+
+    return (conn->fd > max_fd) ? conn->fd : max_fd;
+}
+
+/**
+ * @brief Mark the response complete
+ */
+static void complete(http_conn_t *conn)
+{
+    conn->rx_phase = RX_COMPLETE;
+    conn->state = HTTP_CONN_DONE;
+}
+
+/**
+ * @brief Choose how the body is read once the response head is complete
+ */
+static void start_body(http_conn_t *conn)
+{
+    if (conn->status_code == 204 || conn->status_code == 304) {
+        complete(conn);
+    } else if (conn->chunked) {
+        conn->rx_phase = RX_CHUNK_SIZE;
+    } else if (conn->content_length >= 0) {
+        conn->body_remaining = conn->content_length;
+        conn->rx_phase = RX_BODY;
+        if (conn->body_remaining == 0) {
+            complete(conn);
+        }
+    } else {
+        // No length: the body ends when the server closes the connection
+        conn->close_after = true;
+        conn->body_remaining = -1;
+        conn->rx_phase = RX_BODY;
+    }
+}
+
+/**
+ * @brief Handle one complete head, chunk size or trailer line
+ */
+static void handle_line(http_conn_t *conn, char *line)
+{
+    switch (conn->rx_phase) {
+        case RX_STATUS_LINE: {
+            const char *code = strchr(line, ' ');
+            if (strncmp(line, "HTTP/1.", 7) != 0 || code == NULL) {
+                fail(conn, ESP_ERR_HTTP_FETCH_HEADER);
+                return;
+            }
+            conn->status_code = atoi(code + 1);
+            conn->close_after = (strncmp(line, "HTTP/1.0", 8) == 0);
+            conn->rx_phase = RX_HEADERS;
+            break;
+        }
+
+        case RX_HEADERS: {
+            if (line[0] == '\0') {
+                start_body(conn);
+                return;
+            }
+
+            char *colon = strchr(line, ':');
+            if (colon == NULL) {
+                return;
+            }
+            *colon = '\0';
+            char *value = colon + 1;
+            while (isspace((unsigned char)*value)) {
+                value++;
+            }
+
+            if (strcasecmp(line, "Content-Length") == 0) {
+                conn->content_length = atol(value);
+            } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "chunked") == 0) {
+                conn->chunked = true;
+            } else if (strcasecmp(line, "Connection") == 0) {
+                conn->close_after = (strcasecmp(value, "close") == 0);
+            }
+
+            if (conn->on_header != NULL) {
+                conn->on_header(conn->ctx, line, value);
+            }
+            break;
+        }
+
+        case RX_CHUNK_SIZE: {
+            long chunk_len = strtol(line, NULL, 16);
+            if (chunk_len < 0) {
+                fail(conn, ESP_FAIL);
+            } else if (chunk_len == 0) {
+                conn->rx_phase = RX_TRAILERS;
+            } else {
+                conn->body_remaining = chunk_len;
+                conn->rx_phase = RX_CHUNK_DATA;
+            }
+            break;
+        }
+
+        case RX_CHUNK_END:
+            conn->rx_phase = RX_CHUNK_SIZE;
+            break;
+
+        case RX_TRAILERS:
+            if (line[0] == '\0') {
+                complete(conn);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Run received bytes through the response parser
+ */
+static void feed(http_conn_t *conn, const char *data, size_t len)
+{
+    while (len > 0 && conn->state == HTTP_CONN_RECEIVING) {
+        if (conn->rx_phase == RX_BODY || conn->rx_phase == RX_CHUNK_DATA) {
+            size_t take = len;
+            if (conn->body_remaining >= 0 && take > (size_t)conn->body_remaining) {
+                take = (size_t)conn->body_remaining;
+            }
+            if (conn->on_body != NULL) {
+                conn->on_body(conn->ctx, data, take);
+            }
+            data += take;
+            len -= take;
+
+            if (conn->body_remaining >= 0) {
+                conn->body_remaining -= (long)take;
+                if (conn->body_remaining == 0) {
+                    if (conn->rx_phase == RX_CHUNK_DATA) {
+                        conn->rx_phase = RX_CHUNK_END;
+                    } else {
+                        complete(conn);
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Line-oriented parts: assemble up to LF, keeping what fits
+        const char *lf = memchr(data, '\n', len);
+        size_t take = (lf != NULL) ? (size_t)(lf - data) + 1 : len;
+        size_t room = sizeof(conn->line) - 1 - conn->line_len;
+        size_t copy = (take < room) ? take : room;
+        memcpy(conn->line + conn->line_len, data, copy);
+        conn->line_len += copy;
+        data += take;
+        len -= take;
+
+        if (lf != NULL) {
+            size_t line_len = conn->line_len;
+            while (line_len > 0 && (conn->line[line_len - 1] == '\n' || conn->line[line_len - 1] == '\r')) {
+                line_len--;
+            }
+            conn->line[line_len] = '\0';
+            conn->line_len = 0;
+            handle_line(conn, conn->line);
+        }
+    }
+}
+
+/**
+ * @brief Check the result of a non-blocking connect
+ */
+static void process_connecting(http_conn_t *conn)
+{
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &so_error, &len) != 0 || so_error != 0) {
+        ESP_LOGE(TAG, "Connect to %s:%u failed: errno %d", conn->host, conn->port, so_error);
+        fail(conn, ESP_ERR_HTTP_CONNECT);
+        return;
+    }
+
+    conn->connected_us = esp_timer_get_time();
+    conn->state = HTTP_CONN_SENDING;
+}
+
+/**
+ * @brief Write as much of the request as the socket takes
+ */
+static void process_sending(http_conn_t *conn)
+{
+    while (conn->tx_sent < conn->tx_len) {
+        ssize_t sent = send(conn->fd, conn->tx + conn->tx_sent, conn->tx_len - conn->tx_sent, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (sent <= 0) {
+            fail(conn, ESP_ERR_HTTP_WRITE_DATA);
+            return;
+        }
+        conn->tx_sent += (size_t)sent;
+    }
+
+    conn->state = HTTP_CONN_RECEIVING;
+}
+
+/**
+ * @brief Read what has arrived and parse it
+ */
+static void process_receiving(http_conn_t *conn)
+{
+    char rx[RX_BUFFER_SIZE];
+
+    while (conn->state == HTTP_CONN_RECEIVING) {
+        ssize_t received = recv(conn->fd, rx, sizeof(rx), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (received == 0 && conn->rx_phase == RX_BODY && conn->body_remaining < 0) {
+            complete(conn);  // EOF ends a body without length
+            return;
+        }
+        if (received <= 0) {
+            // Nothing at all means the request never got an answer (e.g. stale keep-alive socket)
+            fail(conn, conn->received_any ? ESP_FAIL : ESP_ERR_HTTP_FETCH_HEADER);
+            return;
+        }
+
+        if (!conn->received_any) {
+            conn->received_any = true;
+            conn->first_byte_us = esp_timer_get_time();
+        }
+        feed(conn, rx, (size_t)received);
+    }
+}
+
+/**
+ * @brief Drop an idle keep-alive socket the server has closed
+ */
+static void process_idle(http_conn_t *conn)
+{
+    char rx[16];
+    ssize_t received = recv(conn->fd, rx, sizeof(rx), 0);
+
+    // EOF, an error or unsolicited data all make the socket unusable
+    if (received >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        ESP_LOGD(TAG, "Idle connection to %s:%u closed by peer", conn->host, conn->port);
+        http_conn_close(conn);
+    }
+}
+
+void http_conn_process(http_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds)
+{
+    if (conn->fd < 0) {
+        return;
+    }
+
+    if (conn->state == HTTP_CONN_IDLE) {
+        if (FD_ISSET(conn->fd, read_fds)) {
+            process_idle(conn);
+        }
+        return;
+    }
+
+    if (conn->state == HTTP_CONN_CONNECTING && FD_ISSET(conn->fd, write_fds)) {
+        process_connecting(conn);
+    }
+    if (conn->state == HTTP_CONN_SENDING && FD_ISSET(conn->fd, write_fds)) {
+        process_sending(conn);
+    }
+    if (conn->state == HTTP_CONN_RECEIVING && FD_ISSET(conn->fd, read_fds)) {
+        process_receiving(conn);
+    }
+
+    if (http_conn_busy(conn) && esp_timer_get_time() >= conn->deadline_us) {
+        ESP_LOGW(TAG, "Request to %s:%u timed out", conn->host, conn->port);
+        fail(conn, ESP_ERR_TIMEOUT);
+    }
+
+    if (conn->state == HTTP_CONN_DONE && conn->close_after) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+}
+
+void http_conn_finish(http_conn_t *conn)
+{
+    if (conn->state == HTTP_CONN_FAILED) {
+        http_conn_close(conn);
+    }
+    conn->state = HTTP_CONN_IDLE;
+}
+
+void http_conn_abort(http_conn_t *conn)
+{
+    http_conn_close(conn);
+}
@@ -0,0 +1,167 @@
+/**
+ * @file http_conn.h
+ * @brief Non-blocking HTTP/1.1 client connection driven by select()
+ *
+ * One connection carries one request at a time. Instead of blocking until
+ * the response is complete, the owner starts a request, adds the socket to
+ * its select() sets with http_conn_add_fds() and lets http_conn_process()
+ * advance the connection whenever select() returns:
+ *
+ *   IDLE -> CONNECTING -> SENDING -> RECEIVING -> DONE / FAILED
+ *
+ * The socket is kept open after a response unless the server asked to
+ * close it, so the next request on the same connection skips the TCP
+ * handshake. Peer addresses come from the DNS cache (dns_cache.h). The response head is parsed line by line (headers are
+ * reported through on_header) and the body is streamed de-chunked to
+ * on_body, so nothing of the response is buffered. A request can be
+ * aborted at any point, which drops the socket.
+ *
+ * Works on POSIX sockets and on lwIP (ESP-IDF) alike; only http:// is supported.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/select.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HTTP_CONN_HOST_MAX      64      // Longest host name
+#define HTTP_CONN_LINE_MAX      256     // Response head line buffer (longer lines are truncated)
+
+/**
+ * @brief Connection state
+ */
+typedef enum {
+    HTTP_CONN_IDLE,          /*!< No request; an open socket is kept for reuse */
+    HTTP_CONN_CONNECTING,    /*!< Non-blocking connect in progress */
+    HTTP_CONN_SENDING,       /*!< Writing the request */
+    HTTP_CONN_RECEIVING,     /*!< Reading the response */
+    HTTP_CONN_DONE,          /*!< Complete response received */
+    HTTP_CONN_FAILED,        /*!< Request failed, see err */
+} http_conn_state_t;
+
+/**
+ * @brief Called for every response header (value has leading blanks stripped)
+ */
+typedef void (*http_conn_header_cb_t)(void *ctx, const char *key, const char *value);
+
+/**
+ * @brief Called with each piece of the (de-chunked) response body
+ */
+typedef void (*http_conn_body_cb_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Connection (owned and placed by the caller)
+ */
+typedef struct {
+    int fd;                          /*!< Socket (-1 = none) */
+    http_conn_state_t state;
+    char host[HTTP_CONN_HOST_MAX];   /*!< Peer the socket is connected to */
+    uint16_t port;
+
+    http_conn_header_cb_t on_header;
+    http_conn_body_cb_t on_body;
+    void *ctx;
+
+    const char *tx;                  /*!< Request bytes (not owned, must outlive the request) */
+    size_t tx_len;
+    size_t tx_sent;
+
+    uint8_t rx_phase;                /*!< Response parser position */
+    char line[HTTP_CONN_LINE_MAX];   /*!< Head, chunk size or trailer line being assembled */
+    size_t line_len;
+    long content_length;             /*!< -1 = not given */
+    long body_remaining;             /*!< Bytes left in the body or current chunk */
+    bool chunked;
+    bool close_after;                /*!< Server closes (or asked to close) after this response */
+
+    int status_code;                 /*!< HTTP status of the response */
+    esp_err_t err;                   /*!< Failure reason when FAILED */
+    bool reused;                     /*!< Request went out on an already open socket */
+    bool received_any;               /*!< At least one response byte arrived */
+    int64_t start_us;                /*!< http_conn_start() time */
+    int64_t resolved_us;             /*!< Peer address known (0 = reused socket) */
+    int64_t connected_us;            /*!< TCP connection established (0 = reused socket) */
+    int64_t first_byte_us;           /*!< First response byte (0 = none yet) */
+    int64_t deadline_us;             /*!< Request fails with ESP_ERR_TIMEOUT after this time */
+} http_conn_t;
+
+/**
+ * @brief Initialize a connection (no socket yet)
+ *
+ * @param on_header Header callback (NULL = none)
+ * @param on_body Body callback (NULL = body discarded)
+ * @param ctx Passed to the callbacks
+ */
+void http_conn_init(http_conn_t *conn, http_conn_header_cb_t on_header, http_conn_body_cb_t on_body, void *ctx);
+
+/**
+ * @brief Start a request
+ *
+ * The open socket is reused if it is connected to the same host and port,
+ * otherwise a new one is opened. The peer address comes from the DNS cache,
+ * which never blocks; a name it has no address for yet fails the request
+ * with ESP_ERR_HTTP_CONNECT while the name is looked up in the background.
+ *
+ * @param conn Connection in state IDLE
+ * @param host Host name or address
+ * @param port TCP port
+ * @param request Complete request (head and body); must stay valid until the request ends
+ * @param len Request length in bytes
+ * @param timeout_ms Time allowed for the whole request
+ * @return ESP_OK if the request is under way; otherwise the connection is
+ *         FAILED with the same error (ESP_ERR_HTTP_CONNECT, ESP_ERR_INVALID_STATE)
+ */
+esp_err_t http_conn_start(http_conn_t *conn, const char *host, uint16_t port,
+                          const char *request, size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Check whether a request is under way (CONNECTING, SENDING or RECEIVING)
+ */
+bool http_conn_busy(const http_conn_t *conn);
+
+/**
+ * @brief Add the socket to the select() sets it has to wait on
+ *
+ * An idle open socket is watched for reading, so a keep-alive connection
+ * closed by the server is noticed and dropped before it is reused.
+ *
+ * @return Highest descriptor in the sets (max of @p max_fd and the socket)
+ */
+int http_conn_add_fds(const http_conn_t *conn, fd_set *read_fds, fd_set *write_fds, int max_fd);
+
+/**
+ * @brief Advance the connection after select() returned
+ *
+ * Also enforces the request timeout, so it is called for busy connections
+ * even when select() timed out.
+ */
+void http_conn_process(http_conn_t *conn, const fd_set *read_fds, const fd_set *write_fds);
+
+/**
+ * @brief Return a DONE or FAILED connection to IDLE
+ *
+ * The socket stays open only after a complete response the server did not
+ * ask to close.
+ */
+void http_conn_finish(http_conn_t *conn);
+
+/**
+ * @brief Abort a request in any state, dropping the socket
+ */
+void http_conn_abort(http_conn_t *conn);
+
+/**
+ * @brief Close the socket (connection back to IDLE)
+ */
+void http_conn_close(http_conn_t *conn);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,21 +10,76 @@
 #include "esphome/core/log.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/hal.h"
+#include <cinttypes>
+#include <cmath>
 
 namespace esphome {
 namespace inverter_tentek {
 
 static const char *const TAG = "inverter_tentek";
 
-void InverterTentekComponent::set_output_power(int power) {
+// A transmitted setpoint the cloud has not confirmed is sent again after this long
+// (by the transmission policy and the zero-export controller alike)
+static const uint32_t UNCONFIRMED_RESEND_MS = TRANSMISSION_POLICY_RESEND_MS;
+
+#ifdef USE_SENSOR
+// Longest gap between grid readings that is integrated (a stalled sensor must not wind up the integral)
+static const float CONTROLLER_MAX_DT_S = 10.0f;
+#endif
+
+#ifdef USE_SENSOR
+/**
+ * @brief Publish a sensor value only if it differs from the last published one
+ */
+static void publish_if_changed(sensor::Sensor *sens, float value) {
+  if (sens != nullptr && (!sens->has_state() || sens->raw_state != value)) {
+    sens->publish_state(value);
+  }
+}
+#endif
+
+void InverterTentekComponent::set_output_power(int power, uint32_t deadline_ms) {
+  this->set_output_power_(0, power, deadline_ms);
+}
+
+void InverterTentekComponent::set_device_output_power(const std::string &device_sn, int power,
+                                                      uint32_t deadline_ms) {
+  int index = this->find_device_(device_sn);
+  if (index < 0) {
+    ESP_LOGW(TAG, "Unknown device %s, ignoring power %d%%", device_sn.c_str(), power);
+    return;
+  }
+  this->set_output_power_(index, power, deadline_ms);
+}
+
+int InverterTentekComponent::get_output_power(const std::string &device_sn) const {
+  int index = this->find_device_(device_sn);
+  return index < 0 ? -1 : devices_[index].output_power;
+}
+
+int InverterTentekComponent::find_device_(const std::string &device_sn) const {
+  for (size_t i = 0; i < devices_.size(); i++) {
+    if (devices_[i].device_sn == device_sn) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void InverterTentekComponent::set_output_power_(size_t index, int power, uint32_t deadline_ms) {
+  InverterDevice &device = devices_[index];
+  
   if (power < 0 || power > 100) {
     ESP_LOGW(TAG, "Invalid power value %d, must be 0-100", power);
     return;
   }
 
-  // Skip duplicate check if output_power_ is -1 (not yet set)
-  if (output_power_ != -1 && power == output_power_) {
-    ESP_LOGD(TAG, "Power already set to %d%%, ignoring duplicate request", power);
+  // Skip duplicate check if output_power is -1 (not yet set)
+  if (device.output_power != -1 && power == device.output_power) {
+    ESP_LOGD(TAG, "Power of %s already set to %d%%, ignoring duplicate request", device.device_sn.c_str(), power);
+    device.pending_power = -1;
+    device.last_suppressed_power = -1;
+    transmission_policy_settle(&device.policy, millis());  // No error is held any more
     return;
   }
 
@@ -33,17 +88,46 @@ void InverterTentekComponent::set_output_power(int power) {
     return;
   }
 
-  ESP_LOGI(TAG, "Requesting power change to %d%% (current: %s)...", 
-           power, output_power_ == -1 ? "Not set" : std::to_string(output_power_).c_str());
+  device.pending_power = power;
+  device.pending_deadline_ms = deadline_ms;
+  this->apply_transmission_policy_(index, millis());
+}
+
+void InverterTentekComponent::apply_transmission_policy_(size_t index, uint32_t now) {
+  InverterDevice &device = devices_[index];
+  int power = device.pending_power;
+  if (!transmission_policy_should_transmit(&policy_, &device.policy, device.output_power, power, now)) {
+    if (device.policy.tracking_error == 0) {
+      device.pending_power = -1;  // Inverter already there
+      device.last_suppressed_power = -1;
+    } else if (power != device.last_suppressed_power && power != device.policy.transmitted_power) {
+      // Counted once per value, not once per loop() re-check
+      device.last_suppressed_power = power;
+      suppressed_setpoints_++;
+      ESP_LOGD(TAG, "Setpoint %d%% for %s suppressed (error %d%%, integral %.1f %%·s)", power,
+               device.device_sn.c_str(), device.policy.tracking_error, device.policy.error_integral);
+#ifdef USE_SENSOR
+      publish_if_changed(suppressed_setpoints_sensor_, suppressed_setpoints_);
+#endif
+    }
+    return;
+  }
+  
+  device.pending_power = -1;
+  device.last_suppressed_power = -1;
+  transmission_policy_transmitted(&device.policy, power, now);
+
+  ESP_LOGI(TAG, "Requesting power change of %s to %d%% (current: %s)...", device.device_sn.c_str(),
+           power, device.output_power == -1 ? "Not set" : std::to_string(device.output_power).c_str());
   
-  // Send command through service (non-blocking)
-  // Note: output_power_ will be updated ONLY when service layer confirms success
+  // Send command through service (non-blocking, replaces any setpoint of this device not yet sent)
+  // Note: output_power will be updated ONLY when service layer confirms success
   // via the last_successful_power tracking in set_power_service.c
-  esp_err_t err = set_power_service_set_output(power, false);
+  esp_err_t err = set_power_instance_set_output(service_, index, power, device.pending_deadline_ms, false);
   
   if (err == ESP_OK) {
     ESP_LOGI(TAG, "✅ Power command queued successfully (power will update after HTTP success)");
-    // DO NOT update output_power_ here - wait for actual HTTP success
+    // DO NOT update output_power here - wait for actual HTTP success
   } else {
     ESP_LOGE(TAG, "❌ Failed to queue power command: %s", esp_err_to_name(err));
   }
@@ -53,22 +137,38 @@ void InverterTentekComponent::setup() {
   ESP_LOGI(TAG, "🔧 Setting up Inverter Tentek Component...");
   
   // Validate configuration
-  if (email_.empty() || password_.empty() || device_sn_.empty()) {
-    ESP_LOGE(TAG, "❌ Invalid configuration: email, password, and device_sn are required");
+  if (email_.empty() || password_.empty() || devices_[0].device_sn.empty() ||
+      devices_.size() > SET_POWER_SERVICE_MAX_DEVICES || base_urls_.size() > SET_POWER_SERVICE_MAX_ENDPOINTS) {
+    ESP_LOGE(TAG, "❌ Invalid configuration: email, password, 1-%d device serials and at most %d base URLs "
+             "are required", SET_POWER_SERVICE_MAX_DEVICES, SET_POWER_SERVICE_MAX_ENDPOINTS);
     this->mark_failed();
     return;
   }
   
   ESP_LOGI(TAG, "Configuration:");
   ESP_LOGI(TAG, "  ├─ Email: %s", email_.c_str());
-  ESP_LOGI(TAG, "  ├─ Device SN: %s", device_sn_.c_str());
-  if (output_power_ == -1) {
+  for (const InverterDevice &device : devices_) {
+    ESP_LOGI(TAG, "  ├─ Device SN: %s", device.device_sn.c_str());
+  }
+  for (const std::string &base_url : base_urls_) {
+    ESP_LOGI(TAG, "  ├─ Endpoint: %s", base_url.c_str());
+  }
+  if (devices_[0].output_power == -1) {
     ESP_LOGI(TAG, "  ├─ Output Power: Not set (waiting for first automation call)");
   } else {
-    ESP_LOGI(TAG, "  ├─ Output Power: %d%%", output_power_);
+    ESP_LOGI(TAG, "  ├─ Output Power: %d%%", devices_[0].output_power);
   }
   ESP_LOGI(TAG, "  ├─ Request Timeout: %u ms", request_timeout_ms_);
-  ESP_LOGI(TAG, "  └─ Max Retry Count: %u", max_retry_count_);
+  ESP_LOGI(TAG, "  ├─ Max Retry Count: %u", max_retry_count_);
+  ESP_LOGI(TAG, "  ├─ Circuit Breaker: %u failures, open %u ms", circuit_breaker_.failure_threshold,
+           circuit_breaker_.open_duration_ms);
+  if (rate_limit_.burst == 0) {
+    ESP_LOGI(TAG, "  ├─ Rate Limit: off");
+  } else {
+    ESP_LOGI(TAG, "  ├─ Rate Limit: burst %u, one request per %u ms", rate_limit_.burst,
+             rate_limit_.refill_interval_ms);
+  }
+  ESP_LOGI(TAG, "  └─ Hedging: %s (at least %u ms)", hedge_.enabled ? "on" : "off", hedge_.min_delay_ms);
   
   // Wait for WiFi to be connected (ESPHome handles WiFi)
   // The component's setup_priority is AFTER_WIFI, so WiFi should be ready
@@ -79,12 +179,45 @@ void InverterTentekComponent::setup() {
   set_power_service_config_t service_config = {
       .email = email_.c_str(),
       .password = password_.c_str(),
-      .device_sn = device_sn_.c_str(),
+      .dns_ttl_ms = dns_ttl_ms_,
       .request_timeout_ms = request_timeout_ms_,
       .max_retry_count = max_retry_count_,
+      .session_lifetime_ms = session_lifetime_ms_,
+      .circuit_breaker = circuit_breaker_,
+      .default_deadline_ms = command_deadline_ms_,
+      .rate_limit = rate_limit_,
+      .hedge = hedge_,
   };
+  for (int i = 0; i < SET_POWER_ERROR_CLASS_COUNT; i++) {
+    service_config.retry_policy[i] = retry_policy_[i];
+  }
+  // All devices share one login, session and connection
+  service_config.device_count = devices_.size();
+  for (size_t i = 0; i < devices_.size(); i++) {
+    service_config.devices[i].device_sn = devices_[i].device_sn.c_str();
+    service_config.devices[i].signature_table = devices_[i].signature_table;
+  }
+  // Equivalent endpoints of the cloud, chosen by measured latency and errors
+  service_config.base_url_count = base_urls_.size();
+  for (size_t i = 0; i < base_urls_.size(); i++) {
+    service_config.base_urls[i] = base_urls_[i].c_str();
+  }
+  
+  // Try the session and setpoint saved before the last reboot first
+  if (restore_state_) {
+    pref_ = global_preferences->make_preference<set_power_service_persisted_t>(
+        fnv1_hash("inverter_tentek_" + devices_[0].device_sn), true);
+    if (pref_.load(&restored_state_)) {
+      restored_state_.jsessionid[sizeof(restored_state_.jsessionid) - 1] = '\0';
+      service_config.restore_state = &restored_state_;
+      ESP_LOGI(TAG, "Restoring saved state (session %s, last power %d%%)",
+               restored_state_.jsessionid[0] != '\0' ? "present" : "none",
+               (int) restored_state_.devices[0].confirmed_power);
+    }
+  }
   
-  esp_err_t err = set_power_service_init(&service_config);
+  // Own instance, so several inverter_tentek blocks (accounts) can coexist
+  esp_err_t err = set_power_instance_create(&service_config, &service_);
   
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "❌ Failed to initialize set_power_service: %s", esp_err_to_name(err));
@@ -96,7 +229,17 @@ void InverterTentekComponent::setup() {
   
   ESP_LOGI(TAG, "✅ set_power_service initialized successfully");
   ESP_LOGI(TAG, "   (Initial authentication will happen in background)");
+  
+#ifdef USE_SENSOR
+  if (grid_power_sensor_ != nullptr) {
+    grid_power_sensor_->add_on_state_callback([this](float state) { this->update_zero_export_(state); });
+    ESP_LOGI(TAG, "   Zero-export controller active: output follows the grid power sensor");
+  } else {
+    ESP_LOGI(TAG, "   Note: No initial power setting sent - waiting for first automation call");
+  }
+#else
   ESP_LOGI(TAG, "   Note: No initial power setting sent - waiting for first automation call");
+#endif
   
   ESP_LOGI(TAG, "✅ Inverter Tentek Component initialized successfully");
 }
@@ -106,53 +249,321 @@ void InverterTentekComponent::loop() {
     return;
   }
   
-  // Sync output_power_ with actual successful power from service layer
-  // This ensures output_power_ only reflects what was ACTUALLY set via HTTP
-  set_power_service_status_t status;
-  if (set_power_service_get_status(&status) == ESP_OK) {
-    // Get last successful power from service layer (via get_last_successful_power API)
-    int last_successful = set_power_service_get_last_successful_power();
-    if (last_successful != -1 && last_successful != output_power_) {
-      ESP_LOGI(TAG, "🔄 Syncing output_power_: %d%% → %d%% (from HTTP success)", 
-               output_power_, last_successful);
-      output_power_ = last_successful;
+  uint32_t loop_start_us = micros();
+  
+  // A suppressed setpoint may become due as its error integrates or the silent interval runs out
+  for (size_t i = 0; i < devices_.size(); i++) {
+    if (devices_[i].pending_power != -1) {
+      this->apply_transmission_policy_(i, millis());
     }
   }
   
-  // Periodic status logging (every 30 seconds)
+  // The service task bumps the status generation whenever something changes;
+  // in the common case nothing did and no lock is taken
+  uint32_t generation = set_power_instance_get_status_generation(service_);
+  if (generation != status_generation_) {
+    status_generation_ = generation;
+    sync_from_service_();
+  }
+  
+  // Periodic status logging (every 30 seconds), unless statistics are published as entities
   uint32_t current_time = millis();
   if (current_time - last_status_log_time_ > 30000) {
     last_status_log_time_ = current_time;
+    if (!statistics_entities_) {
+      log_statistics_();
+    }
+    ESP_LOGD(TAG, "Loop time: avg %lu us, max %lu us over %lu loops (%lu status syncs)",
+             loop_count_ > 0 ? (unsigned long) (loop_time_total_us_ / loop_count_) : 0UL,
+             (unsigned long) loop_time_max_us_, (unsigned long) loop_count_, (unsigned long) status_syncs_);
+    loop_time_total_us_ = 0;
+    loop_time_max_us_ = 0;
+    loop_count_ = 0;
+    status_syncs_ = 0;
+  }
+  
+  uint32_t loop_time_us = micros() - loop_start_us;
+  loop_time_total_us_ += loop_time_us;
+  loop_count_++;
+  if (loop_time_us > loop_time_max_us_) {
+    loop_time_max_us_ = loop_time_us;
+  }
+}
+
+void InverterTentekComponent::sync_from_service_() {
+  status_syncs_++;
+  
+  // Sync output_power with actual successful power from service layer
+  // This ensures output_power only reflects what was ACTUALLY set via HTTP
+  set_power_service_status_t status;
+  if (set_power_instance_get_status(service_, &status) == ESP_OK) {
+    for (size_t i = 0; i < devices_.size(); i++) {
+      InverterDevice &device = devices_[i];
+      int last_successful = set_power_instance_get_last_successful_power(service_, i);
+      if (last_successful != -1 && last_successful != device.output_power) {
+        ESP_LOGI(TAG, "🔄 Syncing output power of %s: %d%% → %d%% (from HTTP success)", device.device_sn.c_str(),
+                 device.output_power, last_successful);
+        device.output_power = last_successful;
+      }
+    }
     
-    set_power_service_status_t status;
-    if (set_power_service_get_status(&status) == ESP_OK) {
-      ESP_LOGI(TAG, "📊 Service Statistics [v2024.10.29-fix-init-power]:");
-      ESP_LOGI(TAG, "   ├─ Authenticated: %s", status.is_authenticated ? "Yes" : "No");
-      if (output_power_ == -1) {
-        ESP_LOGI(TAG, "   ├─ Current Power Setting: Not set yet");
-      } else {
-        ESP_LOGI(TAG, "   ├─ Current Power Setting: %d%%", output_power_);
+    // Save session/setpoint when they changed (preferences batch flash writes)
+    if (restore_state_ && status.persist_generation != persisted_generation_) {
+      set_power_service_persisted_t state;
+      if (set_power_instance_get_persisted_state(service_, &state) == ESP_OK) {
+        pref_.save(&state);
+        persisted_generation_ = status.persist_generation;
       }
-      ESP_LOGI(TAG, "   ├─ Total Requests: %lu", status.total_requests);
-      ESP_LOGI(TAG, "   ├─ Successful: %lu", status.successful_requests);
-      ESP_LOGI(TAG, "   ├─ Skipped (Dedup): %lu", status.skipped_requests);
-      ESP_LOGI(TAG, "   ├─ Failed: %lu", status.failed_requests);
-      ESP_LOGI(TAG, "   └─ Session Refreshes: %lu", status.session_refreshes);
+    }
+    
+    if (statistics_entities_) {
+      publish_statistics_(status);
     }
   }
 }
 
+#ifdef USE_SENSOR
+void InverterTentekComponent::update_zero_export_(float grid_power_w) {
+  if (std::isnan(grid_power_w) || !service_initialized_) {
+    return;
+  }
+  
+  uint32_t now = millis();
+  float dt_s = controller_last_update_ms_ == 0 ? 0.0f : (now - controller_last_update_ms_) / 1000.0f;
+  controller_last_update_ms_ = now;
+  if (dt_s > CONTROLLER_MAX_DT_S) {
+    dt_s = CONTROLLER_MAX_DT_S;
+  }
+  controller_updates_++;
+  
+  float min_w = controller_min_percent_ * rated_power_w_ / 100.0f;
+  float max_w = controller_max_percent_ * rated_power_w_ / 100.0f;
+  
+  // Bumpless start: the integral begins at the output the inverter already has
+  if (!controller_started_) {
+    int start_percent = devices_[0].output_power != -1 ? devices_[0].output_power : controller_min_percent_;
+    integral_w_ = clamp(start_percent * rated_power_w_ / 100.0f, min_w, max_w);
+    controller_output_ = devices_[0].output_power;
+    controller_started_ = true;
+  }
+  
+  // Positive error: importing more than the target allows, so produce more
+  float error_w = grid_power_w + target_export_w_;
+  float proportional_w = kp_ * error_w;
+  
+  // Anti-windup: stop integrating while the output is saturated in the error's direction
+  float candidate_w = integral_w_ + ki_ * error_w * dt_s;
+  float unclamped_w = proportional_w + candidate_w;
+  bool saturated = (unclamped_w > max_w && error_w > 0) || (unclamped_w < min_w && error_w < 0);
+  if (!saturated) {
+    integral_w_ = clamp(candidate_w, min_w, max_w);
+  }
+  
+  float output_w = clamp(proportional_w + integral_w_, min_w, max_w);
+  int step = controller_step_percent_ > 0 ? controller_step_percent_ : 1;
+  int percent = (int) lroundf(output_w * 100.0f / rated_power_w_ / step) * step;
+  percent = clamp(percent, controller_min_percent_, controller_max_percent_);
+  
+  ESP_LOGV(TAG, "Zero export: grid %.0f W, error %.0f W, P %.0f W, I %.0f W -> %d%%", grid_power_w, error_w,
+           proportional_w, integral_w_, percent);
+  
+  // Only a change of the quantized setpoint is worth a cloud call
+  if (percent == controller_output_ &&
+      (devices_[0].output_power == percent || now - controller_last_command_ms_ < UNCONFIRMED_RESEND_MS)) {
+    return;
+  }
+  controller_output_ = percent;
+  controller_last_command_ms_ = now;
+  controller_commands_++;
+  ESP_LOGD(TAG, "Zero export: grid %.0f W, setpoint %d%% (%.0f W)", grid_power_w, percent, output_w);
+  set_output_power(percent);
+}
+#endif
+
+void InverterTentekComponent::log_statistics_() {
+  set_power_service_status_t status;
+  if (set_power_instance_get_status(service_, &status) == ESP_OK) {
+    ESP_LOGI(TAG, "📊 Service Statistics [v2024.10.29-fix-init-power]:");
+    ESP_LOGI(TAG, "   ├─ Authenticated: %s", status.is_authenticated ? "Yes" : "No");
+    if (devices_[0].output_power == -1) {
+      ESP_LOGI(TAG, "   ├─ Current Power Setting: Not set yet");
+    } else {
+      ESP_LOGI(TAG, "   ├─ Current Power Setting: %d%%", devices_[0].output_power);
+    }
+    ESP_LOGI(TAG, "   ├─ Total Requests: %" PRIu32, status.total_requests);
+    ESP_LOGI(TAG, "   ├─ Successful: %" PRIu32, status.successful_requests);
+    ESP_LOGI(TAG, "   ├─ Skipped (Dedup): %" PRIu32, status.skipped_requests);
+    ESP_LOGI(TAG, "   ├─ Suppressed (Transmission Policy): %lu", (unsigned long) suppressed_setpoints_);
+    ESP_LOGI(TAG, "   ├─ Superseded: %" PRIu32, status.superseded_setpoints);
+    ESP_LOGI(TAG, "   ├─ Throttled: %" PRIu32 " (%" PRIu32 " tokens left)", status.throttled_requests,
+             status.rate_limit_tokens);
+    ESP_LOGI(TAG, "   ├─ Expired: %" PRIu32 " (queue wait %" PRIu32 " ms last, %" PRIu32 " ms max)",
+             status.expired_requests, status.last_queue_wait_ms, status.max_queue_wait_ms);
+    ESP_LOGI(TAG, "   ├─ Failed: %" PRIu32 " (%" PRIu32 " retries, %" PRIu32 " failed fast)", status.failed_requests,
+             status.retries, status.fast_failed_requests);
+    ESP_LOGI(TAG, "   ├─ Circuit Breaker: %s (%" PRIu32 " consecutive failures, %" PRIu32 " trips, %" PRIu32
+             " ms until probe)",
+             set_power_breaker_state_to_name(status.breaker_state), status.consecutive_failures,
+             status.breaker_trips, status.breaker_open_remaining_ms);
+    ESP_LOGI(TAG, "   ├─ Session Refreshes: %" PRIu32 " (%" PRIu32 " proactive, %" PRIu32 " reactive)",
+             status.session_refreshes, status.proactive_refreshes, status.reactive_refreshes);
+    ESP_LOGI(TAG, "   ├─ Session Age: %" PRIu32 " ms (expected lifetime %" PRIu32 " ms, %s)", status.session_age_ms,
+             status.session_lifetime_ms, status.session_restored ? "restored" : "new");
+    ESP_LOGI(TAG, "   ├─ Time to First Accepted Command: %" PRIu32 " ms", status.time_to_first_accept_ms);
+    ESP_LOGI(TAG, "   ├─ Connections: %" PRIu32 " reused, %" PRIu32 " opened, up to %" PRIu32 " in flight, %" PRIu32
+             " aborted",
+             status.connection_reuses, status.connection_reconnects, status.max_in_flight_requests,
+             status.aborted_requests);
+    // The DNS cache serves every instance; its counters are not this instance's alone
+    dns_cache_stats_t dns;
+    dns_cache_get_stats(&dns);
+    ESP_LOGI(TAG, "   ├─ DNS (shared by all instances): %" PRIu32 " cached, %" PRIu32 " looked up, %" PRIu32
+             " failed, %" PRIu32 " refreshed, %" PRIu32 " stale",
+             dns.hits, dns.misses, dns.failures, dns.refreshes, dns.stale_hits);
+    if (hedge_.enabled) {
+      ESP_LOGI(TAG, "   ├─ Hedges: %" PRIu32 " sent, %" PRIu32 " won (delay %" PRIu32 " ms)", status.hedged_requests,
+               status.hedge_wins, status.hedge_delay_ms);
+    }
+    if (status.endpoint_count > 1) {
+      for (uint8_t i = 0; i < status.endpoint_count; i++) {
+        const set_power_endpoint_status_t &endpoint = status.endpoints[i];
+        ESP_LOGI(TAG, "   ├─ Endpoint %s%s: rtt %" PRIu32 " ms, errors %u‰, %" PRIu32 "/%" PRIu32 " failed%s",
+                 endpoint.base_url, endpoint.active ? " (active)" : "", endpoint.rtt_ms, endpoint.error_permille,
+                 endpoint.failures, endpoint.requests, endpoint.down ? ", down" : "");
+      }
+      ESP_LOGI(TAG, "   ├─ Endpoint Switches: %" PRIu32, status.endpoint_switches);
+    }
+    if (status.device_count > 1) {
+      for (uint8_t i = 0; i < status.device_count; i++) {
+        const set_power_device_status_t &device = status.devices[i];
+        ESP_LOGI(TAG, "   ├─ Device %s: confirmed %ld%%, %" PRIu32 "/%" PRIu32 " successful, %" PRIu32 " failed",
+                 device.device_sn, (long) device.confirmed_power, device.successful_requests, device.total_requests,
+                 device.failed_requests);
+      }
+    }
+#ifdef USE_SENSOR
+    if (grid_power_sensor_ != nullptr) {
+      ESP_LOGI(TAG, "   ├─ Zero Export: %lu setpoints from %lu grid readings (integral %.0f W)",
+               (unsigned long) controller_commands_, (unsigned long) controller_updates_, integral_w_);
+    }
+#endif
+    ESP_LOGI(TAG, "   ├─ Memory: stack %" PRIu32 "/%" PRIu32 " B free (min), arena peak %" PRIu32 "/%" PRIu32 " B",
+             status.stack_high_water_bytes, status.stack_size_bytes, status.arena_peak_bytes,
+             status.arena_size_bytes);
+    if (status.stack_high_water_bytes != 0 && status.stack_high_water_bytes < SET_POWER_SERVICE_STACK_MARGIN) {
+      ESP_LOGW(TAG, "   ├─ ⚠️ Service task stack is low: %" PRIu32 " B free, keep at least %u B",
+               status.stack_high_water_bytes, (unsigned) SET_POWER_SERVICE_STACK_MARGIN);
+    }
+    ESP_LOGI(TAG, "   └─ Latency p50/p90/p99 (ms):");
+    for (int op = 0; op < SET_POWER_OP_COUNT; op++) {
+      for (int phase = 0; phase < SET_POWER_PHASE_COUNT; phase++) {
+        const set_power_latency_t &latency = status.latency[op][phase];
+        if (latency.count == 0) {
+          continue;
+        }
+        ESP_LOGI(TAG, "      %s %s: %" PRIu32 "/%" PRIu32 "/%" PRIu32 " (max %" PRIu32 ", n=%" PRIu32 ")",
+                 set_power_op_to_name((set_power_op_t) op), set_power_phase_to_name((set_power_phase_t) phase),
+                 latency.p50_ms, latency.p90_ms, latency.p99_ms, latency.max_ms, latency.count);
+      }
+    }
+  }
+}
+
+void InverterTentekComponent::publish_statistics_(const set_power_service_status_t &status) {
+#ifdef USE_SENSOR
+  if (devices_[0].output_power != -1) {
+    publish_if_changed(confirmed_power_sensor_, devices_[0].output_power);
+  }
+  publish_if_changed(total_requests_sensor_, status.total_requests);
+  publish_if_changed(successful_requests_sensor_, status.successful_requests);
+  publish_if_changed(failed_requests_sensor_, status.failed_requests);
+  publish_if_changed(skipped_requests_sensor_, status.skipped_requests);
+  publish_if_changed(suppressed_setpoints_sensor_, suppressed_setpoints_);
+  publish_if_changed(throttled_requests_sensor_, status.throttled_requests);
+  publish_if_changed(session_refreshes_sensor_, status.session_refreshes);
+  
+  const set_power_latency_t &set_power = status.latency[SET_POWER_OP_SET_POWER][SET_POWER_PHASE_END_TO_END];
+  if (set_power.count > 0) {
+    publish_if_changed(set_power_latency_p50_sensor_, set_power.p50_ms);
+    publish_if_changed(set_power_latency_p90_sensor_, set_power.p90_ms);
+    publish_if_changed(set_power_latency_p99_sensor_, set_power.p99_ms);
+  }
+  const set_power_latency_t &login = status.latency[SET_POWER_OP_LOGIN][SET_POWER_PHASE_TOTAL];
+  if (login.count > 0) {
+    publish_if_changed(login_latency_p50_sensor_, login.p50_ms);
+    publish_if_changed(login_latency_p90_sensor_, login.p90_ms);
+    publish_if_changed(login_latency_p99_sensor_, login.p99_ms);
+  }
+#endif
+#ifdef USE_TEXT_SENSOR
+  const char *breaker = set_power_breaker_state_to_name(status.breaker_state);
+  if (circuit_breaker_text_sensor_ != nullptr &&
+      (!circuit_breaker_text_sensor_->has_state() || circuit_breaker_text_sensor_->raw_state != breaker)) {
+    circuit_breaker_text_sensor_->publish_state(breaker);
+  }
+#endif
+#ifdef USE_BINARY_SENSOR
+  if (authenticated_binary_sensor_ != nullptr &&
+      (!authenticated_binary_sensor_->has_state() || authenticated_binary_sensor_->state != status.is_authenticated)) {
+    authenticated_binary_sensor_->publish_state(status.is_authenticated);
+  }
+#endif
+}
+
 void InverterTentekComponent::dump_config() {
   ESP_LOGCONFIG(TAG, "Inverter Tentek Component:");
   ESP_LOGCONFIG(TAG, "  Email: %s", email_.c_str());
-  ESP_LOGCONFIG(TAG, "  Device SN: %s", device_sn_.c_str());
-  ESP_LOGCONFIG(TAG, "  Output Power: %d%%", output_power_);
+  for (const InverterDevice &device : devices_) {
+    ESP_LOGCONFIG(TAG, "  Device SN: %s (output power %d%%)", device.device_sn.c_str(), device.output_power);
+  }
+  for (const std::string &base_url : base_urls_) {
+    ESP_LOGCONFIG(TAG, "  Endpoint: %s", base_url.c_str());
+  }
   ESP_LOGCONFIG(TAG, "  Request Timeout: %u ms", request_timeout_ms_);
+  ESP_LOGCONFIG(TAG, "  DNS TTL: %u ms", dns_ttl_ms_);
   ESP_LOGCONFIG(TAG, "  Max Retry Count: %u", max_retry_count_);
+  if (command_deadline_ms_ != 0) {
+    ESP_LOGCONFIG(TAG, "  Command Deadline: %u ms", command_deadline_ms_);
+  }
+  if (policy_.deadband_percent != 0 || policy_.error_integral_threshold > 0 || policy_.max_silent_interval_ms != 0) {
+    ESP_LOGCONFIG(TAG, "  Transmission Policy: deadband %d%%, error integral %.1f %%·s, max silent %" PRIu32 " ms",
+                  policy_.deadband_percent, policy_.error_integral_threshold, policy_.max_silent_interval_ms);
+  }
+  for (int i = 0; i < SET_POWER_ERROR_CLASS_COUNT; i++) {
+    if (retry_policy_[i].max_delay_ms != 0) {
+      ESP_LOGCONFIG(TAG, "  Retry Policy (%s): %u retries, %u..%u ms",
+                    set_power_error_class_to_name((set_power_error_class_t) i), retry_policy_[i].max_retries,
+                    retry_policy_[i].base_delay_ms, retry_policy_[i].max_delay_ms);
+    }
+  }
+  ESP_LOGCONFIG(TAG, "  Circuit Breaker: %u failures, open %u ms", circuit_breaker_.failure_threshold,
+                circuit_breaker_.open_duration_ms);
+  if (rate_limit_.burst != 0) {
+    ESP_LOGCONFIG(TAG, "  Rate Limit: burst %u, one request per %u ms", rate_limit_.burst,
+                  rate_limit_.refill_interval_ms);
+  }
+  if (hedge_.enabled) {
+    ESP_LOGCONFIG(TAG, "  Hedging: after p90 request time, at least %u ms", hedge_.min_delay_ms);
+  }
+#ifdef USE_SENSOR
+  if (grid_power_sensor_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Zero Export Controller:");
+    ESP_LOGCONFIG(TAG, "    Target Export: %.0f W", target_export_w_);
+    ESP_LOGCONFIG(TAG, "    Rated Power: %.0f W", rated_power_w_);
+    ESP_LOGCONFIG(TAG, "    Kp: %.3f, Ki: %.3f /s", kp_, ki_);
+    ESP_LOGCONFIG(TAG, "    Output: %d..%d%%, step %d%%", controller_min_percent_, controller_max_percent_,
+                  controller_step_percent_);
+  }
+#endif
   ESP_LOGCONFIG(TAG, "  Service Status: %s", service_initialized_ ? "Initialized" : "Not initialized");
   
   if (service_initialized_) {
     ESP_LOGCONFIG(TAG, "  Ready: %s", is_ready() ? "Yes" : "No");
+    set_power_service_status_t status;
+    if (get_status(&status)) {
+      ESP_LOGCONFIG(TAG, "  Task Stack: %lu B, %lu B free (min)", (unsigned long) status.stack_size_bytes,
+                    (unsigned long) status.stack_high_water_bytes);
+    }
   }
 }
 
@@ -161,7 +572,7 @@ bool InverterTentekComponent::is_ready() const {
     return false;
   }
   
-  return set_power_service_is_ready();
+  return set_power_instance_is_ready(service_);
 }
 
 bool InverterTentekComponent::get_status(set_power_service_status_t *status) const {
@@ -169,7 +580,18 @@ bool InverterTentekComponent::get_status(set_power_service_status_t *status) con
     return false;
   }
   
-  return set_power_service_get_status(status) == ESP_OK;
+  return set_power_instance_get_status(service_, status) == ESP_OK;
+}
+
+bool InverterTentekComponent::get_latency(set_power_op_t op, set_power_phase_t phase,
+                                          set_power_latency_t *latency) const {
+  set_power_service_status_t status;
+  if (latency == nullptr || op >= SET_POWER_OP_COUNT || phase >= SET_POWER_PHASE_COUNT || !get_status(&status)) {
+    return false;
+  }
+
+  *latency = status.latency[op][phase];
+  return true;
 }
 
 }  // namespace inverter_tentek
@@ -10,7 +10,8 @@
  * - Automatic JSESSIONID management and re-authentication
  * - Background service task for non-blocking operation
  * - Configurable power output (0-100%)
- * - Statistics tracking and monitoring
+ * - Statistics tracking and monitoring (optionally as sensor entities)
+ * - Built-in zero-export PI controller driven by a grid power sensor
  * - ESPHome automation actions
  * 
  * @note Requires WiFi to be connected before initialization
@@ -23,17 +24,44 @@
 
 #include "esphome/core/component.h"
 #include "esphome/core/automation.h"
+#include "esphome/core/defines.h"
 #include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#ifdef USE_SENSOR
+#include "esphome/components/sensor/sensor.h"
+#endif
+#ifdef USE_TEXT_SENSOR
+#include "esphome/components/text_sensor/text_sensor.h"
+#endif
+#ifdef USE_BINARY_SENSOR
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#endif
 #include <string>
+#include <vector>
 
-// Include ESP-IDF set_power_service (located in main/)
+// Include ESP-IDF set_power_service (component root, shared with the standalone example)
 extern "C" {
 #include "set_power_service.h"
+#include "dns_cache.h"
+#include "transmission_policy.h"
 }
 
 namespace esphome {
 namespace inverter_tentek {
 
+/**
+ * @brief One inverter of the account and its transmission policy state
+ */
+struct InverterDevice {
+  std::string device_sn;           ///< Device serial number
+  const uint8_t (*signature_table)[16]{nullptr};  ///< Build-time signature table (optional)
+  int output_power{-1};            ///< Confirmed power output setting (-1=not set, 0-100% valid)
+  int pending_power{-1};           ///< Requested setpoint not sent yet (-1 = none)
+  uint32_t pending_deadline_ms{0}; ///< Deadline of the pending setpoint
+  transmission_policy_state_t policy TRANSMISSION_POLICY_STATE_INIT;  ///< Last transmission and held error
+  int last_suppressed_power{-1};   ///< Last value counted as suppressed
+};
+
 /**
  * @class InverterTentekComponent
  * @brief ESPHome component for Tentek/MIC POWER inverter control
@@ -53,22 +81,56 @@ class InverterTentekComponent : public Component {
   void set_password(const std::string &password) { password_ = password; }
 
   /**
-   * @brief Set device serial number
+   * @brief Set serial number of the primary device
+   * @param device_sn Device serial number
+   */
+  void set_device_sn(const std::string &device_sn) { devices_[0].device_sn = device_sn; }
+
+  /**
+   * @brief Add another inverter of the same account (shares login, session and connection)
    * @param device_sn Device serial number
+   * @param table Build-time signature table (optional)
+   */
+  void add_device(const std::string &device_sn, const uint8_t (*table)[16]) {
+    InverterDevice device;
+    device.device_sn = device_sn;
+    device.signature_table = table;
+    devices_.push_back(device);
+  }
+
+  /**
+   * @brief Add a cloud endpoint; with several, requests go to the healthiest one
+   * @param base_url "http://host[:port][/path]" (none added = the default server)
+   */
+  void add_base_url(const std::string &base_url) { base_urls_.push_back(base_url); }
+
+  /**
+   * @brief Set output power percentage of the primary device
+   * @param power Output power percentage (0-100)
+   * @param deadline_ms Drop the setpoint if it cannot be sent within this time (0 = command_deadline)
    */
-  void set_device_sn(const std::string &device_sn) { device_sn_ = device_sn; }
+  void set_output_power(int power, uint32_t deadline_ms = 0);
 
   /**
-   * @brief Set output power percentage
+   * @brief Set output power percentage of one device
+   * @param device_sn Device serial number (device_sn or one of additional_devices)
    * @param power Output power percentage (0-100)
+   * @param deadline_ms Drop the setpoint if it cannot be sent within this time (0 = command_deadline)
    */
-  void set_output_power(int power);
+  void set_device_output_power(const std::string &device_sn, int power, uint32_t deadline_ms = 0);
 
   /**
-   * @brief Get current output power setting
+   * @brief Get current output power setting of the primary device
    * @return int Current power percentage (0-100)
    */
-  int get_output_power() const { return output_power_; }
+  int get_output_power() const { return devices_[0].output_power; }
+
+  /**
+   * @brief Get current output power setting of one device
+   * @param device_sn Device serial number
+   * @return int Current power percentage (0-100), -1 if not set or unknown device
+   */
+  int get_output_power(const std::string &device_sn) const;
 
   /**
    * @brief Set HTTP request timeout
@@ -82,6 +144,170 @@ class InverterTentekComponent : public Component {
    */
   void set_max_retry_count(uint8_t max_retry) { max_retry_count_ = max_retry; }
 
+  /**
+   * @brief Set the retry policy of one error class
+   * @param error_class Error class (network, HTTP 5xx, unknown result)
+   * @param max_retries Retries after the first attempt
+   * @param base_delay_ms Backoff cap of the first retry (doubles per retry)
+   * @param max_delay_ms Upper bound of the backoff cap
+   */
+  void set_retry_policy(set_power_error_class_t error_class, uint8_t max_retries, uint32_t base_delay_ms,
+                        uint32_t max_delay_ms) {
+    retry_policy_[error_class] = {max_retries, base_delay_ms, max_delay_ms};
+  }
+
+  /**
+   * @brief Configure the circuit breaker
+   * @param failure_threshold Consecutive failures that open the breaker (0 = disabled)
+   * @param open_duration_ms Time the breaker stays open before a probe
+   */
+  void set_circuit_breaker(uint8_t failure_threshold, uint32_t open_duration_ms) {
+    circuit_breaker_ = {failure_threshold, open_duration_ms};
+  }
+
+  /**
+   * @brief Configure the cloud request rate limit (token bucket, login and set-power)
+   * @param burst Requests allowed back to back (0 = disabled)
+   * @param refill_interval_ms Time to regain one request
+   */
+  void set_rate_limit(uint8_t burst, uint32_t refill_interval_ms) {
+    rate_limit_ = {burst, refill_interval_ms};
+  }
+
+  /**
+   * @brief Configure hedged set-power requests (a second copy when the first one is slow)
+   * @param enabled Send hedges
+   * @param min_delay_ms Least time before a hedge (the delay follows the p90 request time)
+   */
+  void set_hedging(bool enabled, uint32_t min_delay_ms) { hedge_ = {enabled, min_delay_ms}; }
+
+  /**
+   * @brief Set default deadline of setpoints (stale setpoints are dropped, not sent)
+   * @param deadline_ms Deadline in milliseconds after the setpoint was issued (0 = none)
+   */
+  void set_command_deadline(uint32_t deadline_ms) { command_deadline_ms_ = deadline_ms; }
+
+  /**
+   * @brief Configure when a new setpoint is worth a cloud call
+   *
+   * A setpoint is sent when it differs from the confirmed output by more than
+   * the deadband, when the integral of the tracking error since the error was
+   * last closed reaches the threshold, or when nothing was sent for the
+   * maximum silent interval. Otherwise it is held back (and re-checked) as
+   * a suppressed setpoint.
+   *
+   * @param deadband_percent Error sent immediately when exceeded (0 = any change)
+   * @param error_integral_threshold Accumulated error in %·s that forces a send (0 = disabled)
+   * @param max_silent_interval_ms Longest time a non-zero error goes unsent (0 = unbounded)
+   */
+  void set_transmission_policy(int deadband_percent, float error_integral_threshold, uint32_t max_silent_interval_ms) {
+    policy_.deadband_percent = deadband_percent;
+    policy_.error_integral_threshold = error_integral_threshold;
+    policy_.max_silent_interval_ms = max_silent_interval_ms;
+  }
+
+  /**
+   * @brief Get the number of setpoints held back by the transmission policy
+   */
+  uint32_t get_suppressed_setpoints() const { return suppressed_setpoints_; }
+
+  /**
+   * @brief Set expected session lifetime (refined from observed expiries)
+   * @param lifetime_ms Lifetime in milliseconds (0 = learn from the first expiry)
+   */
+  void set_session_lifetime(uint32_t lifetime_ms) { session_lifetime_ms_ = lifetime_ms; }
+
+  /**
+   * @brief Set how long a resolved cloud address is used (re-resolved in the background before)
+   * @param ttl_ms TTL in milliseconds
+   */
+  void set_dns_ttl(uint32_t ttl_ms) { dns_ttl_ms_ = ttl_ms; }
+
+  /**
+   * @brief Persist session and last confirmed setpoint across reboots
+   * @param restore True to save/restore state via ESPHome preferences
+   */
+  void set_restore_state(bool restore) { restore_state_ = restore; }
+
+  /**
+   * @brief Set build-time signature table of the primary device (MD5 digests for power 0..100)
+   * @param table Table generated by codegen, stored in flash
+   */
+  void set_signature_table(const uint8_t (*table)[16]) { devices_[0].signature_table = table; }
+
+#ifdef USE_SENSOR
+  // Statistics sensors (sensor platform), published when their value changes
+  SUB_SENSOR(confirmed_power)
+  SUB_SENSOR(total_requests)
+  SUB_SENSOR(successful_requests)
+  SUB_SENSOR(failed_requests)
+  SUB_SENSOR(skipped_requests)
+  SUB_SENSOR(suppressed_setpoints)
+  SUB_SENSOR(throttled_requests)
+  SUB_SENSOR(session_refreshes)
+  // Set-power end-to-end latency
+  SUB_SENSOR(set_power_latency_p50)
+  SUB_SENSOR(set_power_latency_p90)
+  SUB_SENSOR(set_power_latency_p99)
+  // Login request latency
+  SUB_SENSOR(login_latency_p50)
+  SUB_SENSOR(login_latency_p90)
+  SUB_SENSOR(login_latency_p99)
+#endif
+#ifdef USE_TEXT_SENSOR
+  SUB_TEXT_SENSOR(circuit_breaker)
+#endif
+#ifdef USE_BINARY_SENSOR
+  SUB_BINARY_SENSOR(authenticated)
+#endif
+
+#ifdef USE_SENSOR
+  /**
+   * @brief Drive the output from a grid power sensor (zero-export controller)
+   * @param sensor Grid power in W, positive = import, negative = export
+   */
+  void set_grid_power_sensor(sensor::Sensor *sensor) { grid_power_sensor_ = sensor; }
+
+  /**
+   * @brief Set the export the controller regulates to
+   * @param watts Desired export in W (0 = zero export, negative = keep importing)
+   */
+  void set_target_export(float watts) { target_export_w_ = watts; }
+
+  /**
+   * @brief Set inverter output at 100%, used to convert watts to percent
+   * @param watts Rated output in W
+   */
+  void set_rated_power(float watts) { rated_power_w_ = watts; }
+
+  /**
+   * @brief Set PI controller gains
+   * @param kp Proportional gain (W of output per W of error)
+   * @param ki Integral gain (W of output per W of error per second)
+   */
+  void set_pi_gains(float kp, float ki) {
+    kp_ = kp;
+    ki_ = ki;
+  }
+
+  /**
+   * @brief Set the controller output range and quantization
+   * @param min_percent Lowest setpoint the controller sends
+   * @param max_percent Highest setpoint the controller sends
+   * @param step_percent Setpoint resolution (the cloud is called only when the quantized value changes)
+   */
+  void set_controller_output(int min_percent, int max_percent, int step_percent) {
+    controller_min_percent_ = min_percent;
+    controller_max_percent_ = max_percent;
+    controller_step_percent_ = step_percent;
+  }
+#endif
+
+  /**
+   * @brief Mark that statistics are published as entities (replaces the periodic log)
+   */
+  void set_publish_statistics(bool publish) { statistics_entities_ = publish; }
+
   /**
    * @brief Component setup (called once during initialization)
    */
@@ -116,16 +342,115 @@ class InverterTentekComponent : public Component {
    */
   bool get_status(set_power_service_status_t *status) const;
 
+  /**
+   * @brief Get latency percentiles of one operation phase
+   * @param op Operation (login or set-power)
+   * @param phase Measured phase
+   * @param latency Pointer to structure to fill
+   * @return bool True on success
+   */
+  bool get_latency(set_power_op_t op, set_power_phase_t phase, set_power_latency_t *latency) const;
+
  protected:
+  /**
+   * @brief Find a device by serial number
+   * @param device_sn Device serial number
+   * @return Index into devices_, -1 if unknown
+   */
+  int find_device_(const std::string &device_sn) const;
+
+  /**
+   * @brief Request a setpoint for one device
+   * @param index Index into devices_
+   * @param power Output power percentage (0-100)
+   * @param deadline_ms Setpoint deadline (0 = command_deadline)
+   */
+  void set_output_power_(size_t index, int power, uint32_t deadline_ms);
+
+  /**
+   * @brief Send the pending setpoint of one device if the transmission policy allows it
+   * @param index Index into devices_
+   * @param now Current millis()
+   */
+  void apply_transmission_policy_(size_t index, uint32_t now);
+
+  /**
+   * @brief Pull confirmed power, persisted state and statistics after a status change
+   */
+  void sync_from_service_();
+
+#ifdef USE_SENSOR
+  /**
+   * @brief Run one PI controller step on a new grid power reading
+   * @param grid_power_w Grid power in W (positive = import)
+   */
+  void update_zero_export_(float grid_power_w);
+#endif
+
+  /**
+   * @brief Log the multi-line service statistics
+   */
+  void log_statistics_();
+
+  /**
+   * @brief Publish statistics entities whose value changed
+   * @param status Current service status
+   */
+  void publish_statistics_(const set_power_service_status_t &status);
+
   std::string email_;              ///< User email for authentication
   std::string password_;           ///< User password for authentication
-  std::string device_sn_;          ///< Device serial number
-  int output_power_{-1};           ///< Current power output setting (-1=not set, 0-100% valid)
+  std::vector<InverterDevice> devices_ = std::vector<InverterDevice>(1);  ///< devices_[0] is the primary
+  std::vector<std::string> base_urls_;  ///< Equivalent cloud endpoints (empty = default server)
   uint32_t request_timeout_ms_{10000};  ///< HTTP request timeout
   uint8_t max_retry_count_{3};     ///< Maximum retry count
+  uint32_t session_lifetime_ms_{0};  ///< Expected session lifetime (0 = learn)
+  uint32_t dns_ttl_ms_{300000};      ///< Cloud host address cache TTL
+  bool restore_state_{true};         ///< Persist session/setpoint across reboots
+  set_power_retry_policy_t retry_policy_[SET_POWER_ERROR_CLASS_COUNT]{};  ///< Unset = defaults with max_retry_count_
+  set_power_circuit_breaker_config_t circuit_breaker_{5, 60000};  ///< Circuit breaker configuration
+  set_power_rate_limit_config_t rate_limit_{0, 6000};  ///< Cloud request rate limit (burst 0 = off)
+  set_power_hedge_config_t hedge_{false, 500};  ///< Hedged set-power requests
+  uint32_t command_deadline_ms_{0};  ///< Default setpoint deadline (0 = none)
+  
+  // Transmission policy
+  transmission_policy_config_t policy_{0, 0.0f, 0};  ///< Thresholds (all off = send every change)
+  uint32_t suppressed_setpoints_{0}; ///< Setpoints held back by the policy
   
+  ESPPreferenceObject pref_;         ///< Persisted service state
+  set_power_service_persisted_t restored_state_{};  ///< State loaded at boot
+  uint32_t persisted_generation_{0}; ///< persist_generation last saved
+  
+  set_power_service_handle_t service_{nullptr};  ///< This component's service instance
   bool service_initialized_{false};  ///< Service initialization status
+  bool statistics_entities_{false};  ///< Statistics published as entities
   uint32_t last_status_log_time_{0}; ///< Last status log timestamp
+  uint32_t status_generation_{UINT32_MAX};  ///< Service status generation last synced
+  
+  // loop() time over the current 30 s window
+  uint64_t loop_time_total_us_{0};
+  uint32_t loop_time_max_us_{0};
+  uint32_t loop_count_{0};
+  uint32_t status_syncs_{0};         ///< Loops that had to sync with the service
+
+#ifdef USE_SENSOR
+  // Zero-export PI controller (active when grid_power_sensor_ is set)
+  sensor::Sensor *grid_power_sensor_{nullptr};  ///< Grid power, positive = import
+  float target_export_w_{0.0f};      ///< Export the controller regulates to
+  float rated_power_w_{800.0f};      ///< Inverter output at 100%
+  float kp_{0.3f};                   ///< Proportional gain
+  float ki_{0.05f};                  ///< Integral gain (1/s)
+  int controller_min_percent_{0};    ///< Lowest controller setpoint
+  int controller_max_percent_{100};  ///< Highest controller setpoint
+  int controller_step_percent_{1};   ///< Controller setpoint resolution
+  float integral_w_{0.0f};           ///< Integral term, kept within the output range (anti-windup)
+  bool controller_started_{false};   ///< Integral seeded from the confirmed output
+  int controller_output_{-1};        ///< Last quantized setpoint sent (-1 = none)
+  uint32_t controller_last_update_ms_{0};  ///< Time of the previous grid reading
+  uint32_t controller_last_command_ms_{0};  ///< Time the last setpoint was sent
+  uint32_t controller_updates_{0};   ///< Grid readings processed
+  uint32_t controller_commands_{0};  ///< Setpoints sent by the controller
+#endif
 };
 
 /**
@@ -137,10 +462,17 @@ template<typename... Ts> class SetPowerAction : public Action<Ts...> {
   SetPowerAction(InverterTentekComponent *parent) : parent_(parent) {}
 
   TEMPLATABLE_VALUE(int, power)
+  TEMPLATABLE_VALUE(uint32_t, deadline)
+  TEMPLATABLE_VALUE(std::string, device_sn)
 
   void play(Ts... x) override {
     int power = this->power_.value(x...);
-    this->parent_->set_output_power(power);
+    uint32_t deadline = this->deadline_.value_or(x..., 0);
+    if (this->device_sn_.has_value()) {
+      this->parent_->set_device_output_power(this->device_sn_.value(x...), power, deadline);
+    } else {
+      this->parent_->set_output_power(power, deadline);
+    }
   }
 
  protected:
@@ -0,0 +1,86 @@
+/**
+ * @file latency_histogram.c
+ * @brief Fixed-memory log-bucketed latency histogram
+ */
+
+#include "latency_histogram.h"
+#include <string.h>
+
+/* Sub-bucket index bits (LATENCY_HISTOGRAM_SUB_BUCKETS == 1 << SUB_BUCKET_BITS) */
+#define SUB_BUCKET_BITS     2
+
+/**
+ * @brief Bucket holding a value
+ *
+ * Values below 4 map to themselves. A value with its highest set bit at
+ * position e >= 2 maps to 4 * (e - 1) + the next two bits below it.
+ */
+static uint32_t bucket_index(uint32_t value)
+{
+    if (value < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+    
+    uint32_t exponent = 31 - __builtin_clz(value);
+    uint32_t sub = (value >> (exponent - SUB_BUCKET_BITS)) & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+    uint32_t index = LATENCY_HISTOGRAM_SUB_BUCKETS * (exponent - 1) + sub;
+    
+    return (index < LATENCY_HISTOGRAM_BUCKETS) ? index : LATENCY_HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * @brief Largest value that maps to a bucket
+ */
+static uint32_t bucket_upper_bound(uint32_t index)
+{
+    if (index < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    
+    uint32_t exponent = index / LATENCY_HISTOGRAM_SUB_BUCKETS + 1;
+    uint32_t sub = index % LATENCY_HISTOGRAM_SUB_BUCKETS;
+    uint32_t width = 1u << (exponent - SUB_BUCKET_BITS);
+    
+    return (1u << exponent) + (sub + 1) * width - 1;
+}
+
+void latency_histogram_reset(latency_histogram_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+void latency_histogram_record(latency_histogram_t *hist, uint32_t value_ms)
+{
+    hist->buckets[bucket_index(value_ms)]++;
+    hist->count++;
+    if (value_ms > hist->max_ms) {
+        hist->max_ms = value_ms;
+    }
+}
+
+uint32_t latency_histogram_percentile(const latency_histogram_t *hist, uint8_t percentile)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+    
+    // Rank of the sample at the percentile (1-based, rounded up)
+    uint64_t rank = ((uint64_t)hist->count * percentile + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            if (i == LATENCY_HISTOGRAM_BUCKETS - 1) {
+                break;  // Overflow bucket has no upper bound
+            }
+            uint32_t bound = bucket_upper_bound(i);
+            return (bound < hist->max_ms) ? bound : hist->max_ms;
+        }
+    }
+    
+    return hist->max_ms;
+}
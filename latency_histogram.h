@@ -0,0 +1,60 @@
+/**
+ * @file latency_histogram.h
+ * @brief Fixed-memory log-bucketed latency histogram
+ *
+ * Samples are counted in buckets whose width grows with the value: below
+ * 4 ms every millisecond has its own bucket, above that every power of two
+ * is split into 4 sub-buckets. Percentiles are therefore accurate to within
+ * 25% of the value while one histogram covers 0 ms to about two minutes
+ * (larger samples share the last bucket) in a fixed 264 bytes, with no heap
+ * allocation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LATENCY_HISTOGRAM_SUB_BUCKETS   4       // Buckets per power of two
+#define LATENCY_HISTOGRAM_BUCKETS       64      // Last bucket also holds all larger samples
+
+/**
+ * @brief Latency histogram (all values in milliseconds)
+ */
+typedef struct {
+    uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];  /*!< Sample count per bucket */
+    uint32_t count;              /*!< Total samples */
+    uint32_t max_ms;             /*!< Largest sample */
+} latency_histogram_t;
+
+/**
+ * @brief Clear all samples
+ *
+ * @param hist Histogram to reset
+ */
+void latency_histogram_reset(latency_histogram_t *hist);
+
+/**
+ * @brief Add one sample
+ *
+ * @param hist Histogram
+ * @param value_ms Sample in milliseconds
+ */
+void latency_histogram_record(latency_histogram_t *hist, uint32_t value_ms);
+
+/**
+ * @brief Get a percentile
+ *
+ * @param hist Histogram
+ * @param percentile Percentile (0-100)
+ * @return Upper bound of the bucket holding the percentile (capped at the
+ *         largest sample), or 0 if the histogram is empty
+ */
+uint32_t latency_histogram_percentile(const latency_histogram_t *hist, uint8_t percentile);
+
+#ifdef __cplusplus
+}
+#endif
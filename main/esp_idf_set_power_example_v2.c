@@ -161,6 +161,8 @@ static void app_periodic_task(void *pvParameters)
                 ESP_LOGI(TAG, "   Successful: %lu", status.successful_requests);
                 ESP_LOGI(TAG, "   Failed: %lu", status.failed_requests);
                 ESP_LOGI(TAG, "   Session Refreshes: %lu", status.session_refreshes);
+                ESP_LOGI(TAG, "   Task Stack: %lu B, %lu B free (min)",
+                         status.stack_size_bytes, status.stack_high_water_bytes);
             }
         }
         
@@ -222,6 +224,16 @@ void app_main(void)
     
     ESP_LOGI(TAG, "✅ set_power_service initialized successfully");
     
+#if CONFIG_RUN_SIGNATURE_BENCHMARK
+    // Per-request CPU cost of the old (computed) vs. new (table) signature path
+    set_power_signature_benchmark_t bench;
+    if (set_power_service_benchmark_signature(CONFIG_SIGNATURE_BENCHMARK_ITERATIONS, &bench) == ESP_OK) {
+        ESP_LOGI(TAG, "⏱️  Signature: compute %lu ns, lookup %lu ns, saved %lu ns per request",
+                 bench.compute_ns_per_op, bench.lookup_ns_per_op,
+                 bench.compute_ns_per_op - bench.lookup_ns_per_op);
+    }
+#endif
+    
     // Create application periodic task
     BaseType_t task_created = xTaskCreate(
         app_periodic_task,
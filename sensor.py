@@ -0,0 +1,82 @@
+"""
+Statistics sensors for the Tentek/MIC POWER inverter component
+
+Each sensor is published only when its value changes.
+"""
+
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import sensor
+from esphome.const import (
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
+)
+
+from . import CONF_INVERTER_TENTEK_ID, InverterTentekComponent
+
+DEPENDENCIES = ["inverter_tentek"]
+
+CONF_CONFIRMED_POWER = "confirmed_power"
+CONF_TOTAL_REQUESTS = "total_requests"
+CONF_SUCCESSFUL_REQUESTS = "successful_requests"
+CONF_FAILED_REQUESTS = "failed_requests"
+CONF_SKIPPED_REQUESTS = "skipped_requests"
+CONF_SESSION_REFRESHES = "session_refreshes"
+CONF_SUPPRESSED_SETPOINTS = "suppressed_setpoints"
+CONF_THROTTLED_REQUESTS = "throttled_requests"
+
+COUNTERS = [
+    CONF_TOTAL_REQUESTS,
+    CONF_SUCCESSFUL_REQUESTS,
+    CONF_FAILED_REQUESTS,
+    CONF_SKIPPED_REQUESTS,
+    CONF_SESSION_REFRESHES,
+    CONF_SUPPRESSED_SETPOINTS,
+    CONF_THROTTLED_REQUESTS,
+]
+
+# Set-power: end-to-end command-to-confirmation, login: request time
+LATENCIES = [
+    f"{op}_latency_{percentile}"
+    for op in ("set_power", "login")
+    for percentile in ("p50", "p90", "p99")
+]
+
+counter_schema = sensor.sensor_schema(
+    accuracy_decimals=0,
+    icon="mdi:counter",
+    state_class=STATE_CLASS_TOTAL_INCREASING,
+)
+latency_schema = sensor.sensor_schema(
+    unit_of_measurement=UNIT_MILLISECOND,
+    accuracy_decimals=0,
+    icon="mdi:timer-outline",
+    state_class=STATE_CLASS_MEASUREMENT,
+)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_INVERTER_TENTEK_ID): cv.use_id(InverterTentekComponent),
+        cv.Optional(CONF_CONFIRMED_POWER): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            accuracy_decimals=0,
+            icon="mdi:flash",
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        **{cv.Optional(key): counter_schema for key in COUNTERS},
+        **{cv.Optional(key): latency_schema for key in LATENCIES},
+    }
+)
+
+
+async def to_code(config):
+    """Generate C++ code"""
+    parent = await cg.get_variable(config[CONF_INVERTER_TENTEK_ID])
+    cg.add(parent.set_publish_statistics(True))
+
+    for key in [CONF_CONFIRMED_POWER, *COUNTERS, *LATENCIES]:
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(getattr(parent, f"set_{key}_sensor")(sens))
@@ -5,64 +5,426 @@
 
 #include "set_power_service.h"
 #include "md5_wrapper.h"
+#include "api_response_parser.h"
+#include "latency_histogram.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_random.h"
+#include "esp_vfs_eventfd.h"
+#include "cloud_transport.h"
 
 static const char *TAG = "SET_POWER_SVC";
 
 /* API Configuration */
-#define API_URL        "http://server-tj.shuoxd.com:8080/v1/manage/setOnGridInverterParam"
-#define LOGIN_URL      "http://server-tj.shuoxd.com:8080/v1/user/login"
-#define SIGNATURE_KEY  "1f80ca5871919371ea71716cae4841bd"
+#define DEFAULT_BASE_URL  "http://server-tj.shuoxd.com:8080"
+#define LOGIN_PATH        "/v1/user/login"
+#define SET_POWER_PATH    "/v1/manage/setOnGridInverterParam"
+#define SIGNATURE_KEY  "1f80ca5871919371ea71716cae4841bd"  // Also used by __init__.py codegen
 #define USER_AGENT     "Mozilla/5.0 (iPhone; CPU iPhone OS 18_6_2 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Mobile/15E148 Html5Plus/1.0 (Immersed/20) uni-app"
 
-#define MAX_HTTP_OUTPUT_BUFFER 4096  // Increased from 2048 to handle large headers
+#define REQUEST_MAX_HEADERS    10    // Common and request specific headers of one request
+#define REQUEST_PATH_SIZE      128   // Base URL path and API path
 
-/* Service state */
+/* Event loop */
+#define ABORT_MIN_AGE_MS       1000  // In-flight set-power never aborted before this age
+
+/*
+ * Working arena shared by the login and set-power paths of an instance.
+ * Request buffers (post body, sign string, headers) are carved from it instead
+ * of the task stack; it is reset at the start of every request, which the
+ * transport has taken over once it was started. The default
+ * instance uses a static arena, others allocate one in set_power_instance_create().
+ * Build with -DSET_POWER_SERVICE_ARENA_IN_PSRAM=1 to place it in external RAM.
+ */
+#if SET_POWER_SERVICE_ARENA_IN_PSRAM && CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY
+#define ARENA_ATTR EXT_RAM_BSS_ATTR
+#else
+#define ARENA_ATTR
+#endif
+#if SET_POWER_SERVICE_ARENA_IN_PSRAM
+#include "esp_heap_caps.h"
+#define ARENA_MALLOC(size) heap_caps_malloc(size, MALLOC_CAP_SPIRAM)
+#else
+#define ARENA_MALLOC(size) malloc(size)
+#endif
+
+/* Arena carve-outs per request path */
+#define LOGIN_BUFFER_SIZE         512   // Login sign string and post body (each)
+#define LOGIN_ENCODED_EMAIL_SIZE  128
+#define SET_POWER_POST_SIZE       128
+#define SET_POWER_TIME_SIZE       24    // time header value
+#define SET_POWER_COOKIE_SIZE     80    // Cookie header value
+
+static uint8_t s_work_arena[SET_POWER_SERVICE_ARENA_SIZE] ARENA_ATTR __attribute__((aligned(4)));
+
+/* send_sync() calls outstanding per instance; one whose caller timed out keeps
+ * its waiter until the command completes */
+#define SYNC_WAITER_COUNT       4
+
+/**
+ * A send_sync() caller waiting for its command
+ * 
+ * Waiters live in the instance, so a command that completes after its caller
+ * gave up writes its result and gives the semaphore into memory that is still
+ * valid; the waiter is only reused once that has happened.
+ */
+typedef struct {
+    SemaphoreHandle_t done;          // Given once when the command completes
+    esp_err_t result;
+    bool in_use;                     // Claimed by a caller, or held by a command whose caller gave up
+    bool waiting;                    // The caller still wants the result
+    bool completed;                  // The command completed; done is given right after
+} sync_waiter_t;
+
+/* Smart deduplication for power requests */
+#define FORCE_SYNC_INTERVAL_MS (5 * 60 * 1000)  // 5 minutes force sync
+
+/**
+ * Status published by the service task for lock-free readers
+ * 
+ * An instance keeps three copies (two seqlock slots and the writer's build
+ * buffer), so only what changes while the service runs is published. Readers
+ * add the fixed configuration (serials, base URLs, counts, sizes), sum the
+ * device counters and derive the time-dependent fields (session age, breaker
+ * open remaining, rate limit tokens, endpoints down, stack high-water mark)
+ * from the timestamps stored alongside.
+ */
+typedef struct {
+    int32_t confirmed_power;
+    uint32_t total_requests;
+    uint32_t successful_requests;
+    uint32_t failed_requests;
+    uint32_t skipped_requests;
+    uint32_t superseded_setpoints;
+    uint32_t expired_requests;
+    int64_t confirmed_epoch_ms;
+} device_snapshot_t;
+
+typedef struct {
+    uint32_t rtt_ms;
+    uint32_t requests;
+    uint32_t failures;
+    uint16_t error_permille;
+} endpoint_snapshot_t;
+
+typedef struct {
+    bool is_authenticated;
+    bool session_restored;
+    uint8_t active_endpoint;
+    set_power_breaker_state_t breaker_state;
+    uint32_t session_refreshes;
+    uint32_t proactive_refreshes;
+    uint32_t reactive_refreshes;
+    uint32_t session_lifetime_ms;
+    uint32_t time_to_first_accept_ms;
+    uint32_t persist_generation;
+    uint32_t retries;
+    uint32_t consecutive_failures;
+    uint32_t breaker_trips;
+    uint32_t fast_failed_requests;
+    uint32_t connection_reuses;
+    uint32_t connection_reconnects;
+    uint32_t aborted_requests;
+    uint32_t max_in_flight_requests;
+    uint32_t hedged_requests;
+    uint32_t hedge_wins;
+    uint32_t hedge_delay_ms;
+    uint32_t expired_requests;
+    uint32_t throttled_requests;
+    uint32_t last_queue_wait_ms;
+    uint32_t max_queue_wait_ms;
+    uint32_t arena_peak_bytes;
+    uint32_t endpoint_switches;
+    set_power_latency_t latency[SET_POWER_OP_COUNT][SET_POWER_PHASE_COUNT];
+    endpoint_snapshot_t endpoints[SET_POWER_SERVICE_MAX_ENDPOINTS];
+    device_snapshot_t devices[SET_POWER_SERVICE_MAX_DEVICES];
+    char jsessionid[64];
+    int64_t session_issued_epoch_ms;
+    int64_t session_issued_us;
+    int64_t breaker_open_until_us;
+    int64_t rate_full_at_us;
+    int64_t endpoint_down_until_us[SET_POWER_SERVICE_MAX_ENDPOINTS];
+} status_snapshot_t;
+
+#define STATUS_SNAPSHOT_WORDS   ((sizeof(status_snapshot_t) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+/**
+ * One seqlock-protected copy of the snapshot
+ * 
+ * The data is stored as relaxed atomic words, so a reader racing with the
+ * writer gets a torn copy (detected through seq) but never a data race.
+ */
+typedef struct {
+    atomic_uint seq;                 // Odd while the writer is updating the slot
+    atomic_uint words[STATUS_SNAPSHOT_WORDS];
+} status_slot_t;
+
+/* Why a login is performed */
+typedef enum {
+    LOGIN_INITIAL,       // First login after start
+    LOGIN_REACTIVE,      // Session rejected or missing when a command needed it
+    LOGIN_PROACTIVE,     // Idle refresh before the expected expiry
+    LOGIN_FORCED,        // SET_POWER_CMD_FORCE_RELOGIN
+} login_reason_t;
+
+/* Where a device's active setpoint is in the event loop */
+typedef enum {
+    DEVICE_IDLE,         // No active setpoint
+    DEVICE_READY,        // Waiting for session, breaker, rate limit token or a free connection
+    DEVICE_IN_FLIGHT,    // Set-power request on a connection
+    DEVICE_BACKOFF,      // Waiting for the retry time
+} device_phase_t;
+
+/* Circuit breaker decision for a request about to start */
+typedef enum {
+    BREAKER_ADMIT,       // Send (as the probe if half-open)
+    BREAKER_WAIT,        // Half-open probe outstanding, wait for its outcome
+    BREAKER_REJECT,      // Open, fail fast
+} breaker_verdict_t;
+
+/* What a connection slot is carrying */
+typedef enum {
+    REQUEST_NONE,
+    REQUEST_LOGIN,
+    REQUEST_SET_POWER,
+} request_kind_t;
+
+/* One cloud endpoint (base URL) and its measured health */
+typedef struct {
+    char url[64];                    // Configured base URL (for logs and status)
+    char host[64];
+    uint16_t port;
+    char base_path[64];              // Path prefix in front of the API paths
+    uint32_t rtt_us;                 // Smoothed request time of successful requests (0 = not measured)
+    uint16_t error_permille;         // Smoothed failure rate
+    uint32_t requests;               // Completed requests (aborted ones not counted)
+    uint32_t failures;               // Network errors and HTTP 5xx
+    uint8_t consecutive_failures;
+    int64_t down_until_us;           // Skipped until then (0 = up)
+    int64_t last_used_us;            // Last request started on it
+    bool host_watched;               // The transport keeps host resolved in the background
+} endpoint_t;
+
+/* Per-device state; all devices share the session, breaker and rate limit */
+typedef struct {
+    char device_sn[32];
+    uint32_t device_sn_hash;         // Matches persisted state to the device
+    
+    // Set-power signatures for every power level (depend only on device_sn)
+    const uint8_t (*signature_table)[16];  // Points to external table or signature_digests
+    uint8_t (*signature_digests)[16];      // Computed at init if there is no usable table (heap)
+    
+    // Latest-value-wins setpoint mailbox (under mailbox_lock)
+    bool mailbox_full;
+    set_power_cmd_t mailbox_cmd;
+    uint32_t superseded_setpoints;   // Setpoints replaced before they were sent
+    
+    /* Smart deduplication: last successfully set power (-1 = invalid, ensures first
+     * request always sent). Written only by the service task; atomic so other tasks
+     * may read it at any time. */
+    atomic_int last_successful_power;
+    int64_t last_success_time_ms;    // Timestamp of last successful request (0 = no success yet)
+    
+    set_power_cmd_t deferred_cmd;    // Setpoint rejected while open, sent as half-open probe
+    bool has_deferred;
+    
+    // Setpoint taken from the mailbox and worked on by the event loop
+    device_phase_t phase;
+    set_power_cmd_t active_cmd;
+    uint8_t retries[SET_POWER_ERROR_CLASS_COUNT];  // Retries of active_cmd per error class
+    int64_t retry_at_us;             // End of the backoff (DEVICE_BACKOFF)
+    bool abort_protected;            // active_cmd replaced an aborted request and is never aborted
+    bool hedged;                     // A hedge was sent for the request in flight
+    bool cloud_unconfirmed;          // An aborted request may have changed the cloud setpoint
+    
+    // Statistics
+    uint32_t total_requests;
+    uint32_t successful_requests;
+    uint32_t failed_requests;
+    uint32_t skipped_requests;       // Requests skipped due to deduplication
+    uint32_t expired_requests;       // Setpoints dropped because they passed their deadline
+} set_power_device_t;
+
+/* One request in flight on its own connection */
 typedef struct {
+    cloud_conn_t *conn;              // Keep-alive connection of the slot
+    uint8_t conn_endpoint;           // Endpoint the connection was last used for
+    request_kind_t kind;             // REQUEST_NONE = slot free
+    uint8_t endpoint;                // Endpoint of the request (chosen by slot_acquire)
+    set_power_device_t *device;      // Device of a set-power request
+    int output_power;
+    login_reason_t login_reason;
+    bool probe;                      // Sent as the half-open breaker probe
+    bool hedge;                      // Second copy of a slow set-power request
+    int64_t start_us;                // First attempt (the total phase includes a transport retry)
+    char session[64];                // JSESSIONID the set-power request carries
+    api_response_parser_t parser;    // Streaming parser for the response body
+    char jsessionid_from_cookie[64]; // Set-Cookie JSESSIONID of the response
+} request_slot_t;
+
+/* Service instance state (one account), reached through set_power_service_handle_t */
+struct set_power_service {
     bool initialized;
     bool authenticated;
     char jsessionid[64];
     char email[128];
     char password[128];
-    char device_sn[32];
     uint32_t request_timeout_ms;
     uint8_t max_retry_count;
     
+    // Inverters on the account
+    set_power_device_t devices[SET_POWER_SERVICE_MAX_DEVICES];
+    uint8_t device_count;
+    uint8_t next_device;             // Mailbox checked first on the next take (round robin)
+    
     // Statistics
-    uint32_t total_requests;
-    uint32_t successful_requests;
-    uint32_t failed_requests;
-    uint32_t skipped_requests;       // Requests skipped due to deduplication
     uint32_t session_refreshes;
+    uint32_t proactive_refreshes;    // Logins done ahead of expiry while idle
+    uint32_t reactive_refreshes;     // Logins forced by an expired/missing session
+    
+    // Session lifetime tracking (esp_timer microseconds)
+    int64_t session_issued_us;       // When the current JSESSIONID was obtained (0 = none)
+    int64_t session_last_valid_us;   // Last time the current JSESSIONID was accepted
+    int64_t session_lifetime_ms;     // Expected lifetime (configured or learned, 0 = unknown)
+    int64_t next_refresh_attempt_us; // Earliest time for the next proactive refresh attempt
+    int64_t session_issued_epoch_ms; // Wall clock issue time for persistence (0 = clock not set)
+    
+    // Retry policies and circuit breaker
+    set_power_retry_policy_t retry_policy[SET_POWER_ERROR_CLASS_COUNT];
+    set_power_circuit_breaker_config_t breaker_config;
+    set_power_breaker_state_t breaker_state;
+    uint32_t consecutive_failures;   // Consecutive endpoint failures (network, HTTP 5xx)
+    int64_t breaker_open_until_us;   // When an open breaker may half-open
+    uint32_t retries;                // Retry attempts after backoff
+    
+    // Command deadlines
+    uint32_t default_deadline_ms;    // Applied to commands without their own deadline (0 = none)
+    uint32_t expired_requests;       // Commands dropped because they passed their deadline
+    uint32_t last_queue_wait_ms;     // Enqueue to start of processing, last command
+    uint32_t max_queue_wait_ms;      // Enqueue to start of processing, worst case
+    uint32_t fast_failed_requests;   // Requests rejected while the breaker was open
+    uint32_t breaker_trips;          // Times the breaker opened
+    set_power_error_class_t last_error_class;  // Class of the last failed request (ERROR_CLASS_NONE if n/a)
+    
+    // Per-phase latency, separately for login and set-power
+    latency_histogram_t latency[SET_POWER_OP_COUNT][SET_POWER_PHASE_COUNT];
+    
+    // Persistence and startup metrics
+    bool session_restored;           // Current JSESSIONID was restored from persisted state
+    uint32_t persist_generation;     // Incremented whenever persisted state changes
+    int64_t init_time_us;            // When set_power_service_init() was called
+    uint32_t time_to_first_accept_ms; // Init to first command accepted by the cloud (0 = none yet)
+    uint32_t connection_reuses;      // Requests served on an already open keep-alive connection
+    uint32_t connection_reconnects;  // Requests that had to open a new TCP connection
+    
+    // Cloud endpoints (from base_url or base_urls) and the transport that reaches them
+    endpoint_t endpoints[SET_POWER_SERVICE_MAX_ENDPOINTS];
+    uint8_t endpoint_count;
+    uint8_t active_endpoint;         // Where requests go unless one explores another endpoint
+    uint32_t endpoint_switches;      // Times active_endpoint changed
+    uint32_t endpoint_requests;      // Requests started, paces the exploration of other endpoints
+    int8_t session_endpoint;         // Endpoint that issued the session (-1 = unknown, e.g. restored)
+    bool session_pinned;             // Another endpoint rejected the session: sessions are not shared
+    uint8_t login_failovers;         // Endpoints the pending login moved on from after a failure
+    const cloud_transport_t *transport;
+    
+    // Requests in flight, each on its own keep-alive connection
+    request_slot_t slots[SET_POWER_SERVICE_MAX_CONNECTIONS];
+    uint32_t max_in_flight;          // Most requests in flight at once
+    uint32_t aborted_requests;       // In-flight set-power requests aborted for a newer setpoint
+    
+    // Hedged set-power requests
+    set_power_hedge_config_t hedge;
+    uint32_t hedged_requests;        // Hedges sent
+    uint32_t hedge_wins;             // Setpoints confirmed by the hedge
+    
+    // Login state of the event loop
+    bool login_wanted;               // A login should be started
+    login_reason_t login_reason;
+    bool login_in_flight;
+    bool probe_in_flight;            // Half-open breaker probe outstanding
+    bool has_relogin_cmd;            // FORCE_RELOGIN waiting for its login (control queue paused)
+    set_power_cmd_t relogin_cmd;
+    
+    // Working arena (static for the default instance, heap for others)
+    uint8_t *arena;
+    size_t arena_size;
+    bool arena_owned;                // Allocated by set_power_instance_create()
+    size_t arena_used;
+    size_t arena_peak;
+    
+    // Guards the device mailboxes (SET_OUTPUT commands only)
+    portMUX_TYPE mailbox_lock;
+    
+    // Token bucket rate limit shared by login and set-power requests
+    set_power_rate_limit_config_t rate_limit;
+    int64_t rate_full_at_us;         // When the bucket is full again (in the past = full)
+    bool rate_hold_noted;            // Setpoint held in the mailbox already counted as throttled
+    uint32_t throttled_requests;     // Setpoints and logins that had to wait for a token
     
     // FreeRTOS resources
-    QueueHandle_t cmd_queue;
+    QueueHandle_t cmd_queue;         // Control commands (relogin, status)
     TaskHandle_t task_handle;
-    SemaphoreHandle_t state_mutex;
-} set_power_service_state_t;
+    int wake_fd;                     // eventfd posters write to, in the task's select() (-1 = none)
+    
+    // send_sync() waiters; the flags are guarded by sync_lock
+    portMUX_TYPE sync_lock;
+    sync_waiter_t sync_waiters[SYNC_WAITER_COUNT];
+    
+    /* Status snapshot, two slots: the service task (single writer) always fills
+     * the slot readers are not directed to, then flips status_generation to it.
+     * A reader only retries if the writer lapped it, so it never spins on a
+     * preempted writer. */
+    status_slot_t status_slots[2];
+    atomic_uint status_generation;   // Snapshots published; latest is in slot [generation & 1]
+    status_snapshot_t status_scratch; // Writer-only build buffer (keeps it off the task stack)
+};
 
-static set_power_service_state_t s_service = {0};
-static char g_jsessionid_from_cookie[64] = {0};
+/* Instance behind the set_power_service_*() functions */
+static struct set_power_service s_default_service;
 
-/* Smart deduplication for power requests */
-static int s_last_successful_power = -1;  // Last successfully set power (-1 = invalid, ensures first request always sent)
-static int64_t s_last_success_time_ms = 0;  // Timestamp of last successful request (0 = no success yet)
-#define FORCE_SYNC_INTERVAL_MS (5 * 60 * 1000)  // 5 minutes force sync
+#define WALL_CLOCK_VALID_MS     1600000000000LL      // Wall clock considered set (SNTP) after Sep 2020
+
+/* Proactive session refresh */
+#define SESSION_REFRESH_PERCENT        80                  // Re-login at 80% of the expected lifetime
+#define SESSION_MIN_REFRESH_AGE_MS     (60 * 1000)         // Never refresh sessions younger than 1 minute
+#define SESSION_REFRESH_RETRY_MS       (30 * 1000)         // Back-off after a failed proactive refresh
+
+/* Request failures that are not worth retrying (e.g. HTTP 4xx) */
+#define ERROR_CLASS_NONE           SET_POWER_ERROR_CLASS_COUNT
+
+/* Endpoint selection */
+#define ENDPOINT_EWMA_SHIFT            2                   // Moving averages weigh a new sample 1/4
+#define ENDPOINT_ERROR_WEIGHT          4                   // Score = rtt * (1 + 4 * error rate)
+#define ENDPOINT_SWITCH_PERCENT        80                  // Switch only to an endpoint scoring below 80%
+#define ENDPOINT_DOWN_FAILURES         2                   // Consecutive failures that take an endpoint down
+#define ENDPOINT_DOWN_MS               (30 * 1000)         // Time a down endpoint is skipped
+#define ENDPOINT_EXPLORE_INTERVAL      20                  // Every 20th request re-measures another endpoint
+
+/**
+ * @brief Current wall clock time in milliseconds
+ */
+static int64_t wall_clock_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000LL + (int64_t)tv.tv_usec / 1000LL;
+}
 
 /* Forward declarations */
 static void service_task(void *pvParameters);
-static esp_err_t login_and_get_session(char *jsessionid_out);
-static esp_err_t send_set_power_request(int output_power, const char *jsessionid);
 
 /**
  * @brief URL encode a string
@@ -94,13 +456,26 @@ static bool url_encode(char *dst, const char *src, size_t dst_size)
 }
 
 /**
- * @brief Calculate MD5 signature
+ * @brief Encode binary data as lowercase hex (out must hold len * 2 + 1 chars)
  */
-static void calculate_signature(const char *device_sn, int output_power, char *signature)
+static void hex_encode(const uint8_t *data, size_t len, char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+    
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = hex[data[i] >> 4];
+        out[i * 2 + 1] = hex[data[i] & 0x0F];
+    }
+    out[len * 2] = '\0';
+}
+
+/**
+ * @brief Calculate raw MD5 signature digest for a set-power request
+ */
+static void calculate_signature_digest(const char *device_sn, int output_power, uint8_t digest[16])
 {
     char encoded_sn[64];
     char sign_string[256];
-    unsigned char md5_output[16];
     
     url_encode(encoded_sn, device_sn, sizeof(encoded_sn));
     
@@ -109,584 +484,2719 @@ static void calculate_signature(const char *device_sn, int output_power, char *s
              encoded_sn, output_power, SIGNATURE_KEY);
     
     // Use ESPHome MD5 wrapper instead of mbedtls
-    md5_calculate((const uint8_t *)sign_string, strlen(sign_string), md5_output);
+    md5_calculate((const uint8_t *)sign_string, strlen(sign_string), digest);
+}
+
+/**
+ * @brief Calculate MD5 signature (hex string, 33 bytes)
+ */
+static void calculate_signature(const char *device_sn, int output_power, char *signature)
+{
+    uint8_t md5_output[16];
     
-    for (int i = 0; i < 16; i++) {
-        sprintf(&signature[i * 2], "%02x", md5_output[i]);
-    }
-    signature[32] = '\0';
+    calculate_signature_digest(device_sn, output_power, md5_output);
+    hex_encode(md5_output, sizeof(md5_output), signature);
+}
+
+/**
+ * @brief Look up the precomputed signature for a power level (hex string, 33 bytes)
+ */
+static void lookup_signature(const set_power_device_t *device, int output_power, char *signature)
+{
+    hex_encode(device->signature_table[output_power], 16, signature);
 }
 
 /**
- * @brief HTTP event handler
+ * @brief Set up the signature table of a device for all power levels
+ * 
+ * A build-time table is spot-checked against a runtime calculation so a
+ * device_sn or key mismatch falls back to computing the table locally.
+ * 
+ * @return ESP_OK, or ESP_ERR_NO_MEM if a table had to be computed and could not be allocated
  */
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+static esp_err_t init_signature_table(set_power_device_t *device, const uint8_t (*precomputed)[16])
 {
-    static int output_len;
+    if (precomputed != NULL) {
+        uint8_t check[16];
+        calculate_signature_digest(device->device_sn, 100, check);
+        if (memcmp(check, precomputed[100], sizeof(check)) == 0) {
+            device->signature_table = precomputed;
+            ESP_LOGI(TAG, "Using build-time signature table for %s", device->device_sn);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Build-time signature table does not match device SN %s, recomputing", device->device_sn);
+    }
     
-    switch(evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
-            break;
-            
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
-            break;
-            
-        case HTTP_EVENT_ON_HEADER:
-            // Capture Set-Cookie header for JSESSIONID
-            if (strcasecmp(evt->header_key, "Set-Cookie") == 0) {
-                ESP_LOGD(TAG, "Found Set-Cookie: %s", evt->header_value);
-                
-                char *jsessionid_start = strstr(evt->header_value, "JSESSIONID=");
-                if (jsessionid_start != NULL) {
-                    jsessionid_start += strlen("JSESSIONID=");
-                    char *jsessionid_end = strchr(jsessionid_start, ';');
-                    
-                    int len;
-                    if (jsessionid_end != NULL) {
-                        len = jsessionid_end - jsessionid_start;
-                    } else {
-                        len = strlen(jsessionid_start);
-                    }
-                    
-                    if (len > 0 && len < sizeof(g_jsessionid_from_cookie)) {
-                        strncpy(g_jsessionid_from_cookie, jsessionid_start, len);
-                        g_jsessionid_from_cookie[len] = '\0';
-                        ESP_LOGI(TAG, "✅ Captured JSESSIONID: %s", g_jsessionid_from_cookie);
-                    }
-                }
-            }
-            break;
-            
-        case HTTP_EVENT_ON_DATA:
-            if (output_len == 0 && evt->user_data) {
-                memset(evt->user_data, 0, MAX_HTTP_OUTPUT_BUFFER);
-            }
-            
-            if (!esp_http_client_is_chunked_response(evt->client)) {
-                if (evt->user_data) {
-                    int copy_len = evt->data_len;
-                    if (output_len + copy_len >= MAX_HTTP_OUTPUT_BUFFER) {
-                        copy_len = MAX_HTTP_OUTPUT_BUFFER - output_len - 1;
-                    }
-                    if (copy_len > 0) {
-                        memcpy((char *)evt->user_data + output_len, evt->data, copy_len);
-                        output_len += copy_len;
-                    }
-                }
-            }
-            break;
-            
-        case HTTP_EVENT_ON_FINISH:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
-            output_len = 0;
-            break;
-            
-        case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
-            output_len = 0;
-            break;
-            
-        default:
-            break;
+    device->signature_digests = malloc(SET_POWER_SIGNATURE_TABLE_SIZE * sizeof(*device->signature_digests));
+    if (device->signature_digests == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int power = 0; power < SET_POWER_SIGNATURE_TABLE_SIZE; power++) {
+        calculate_signature_digest(device->device_sn, power, device->signature_digests[power]);
     }
+    device->signature_table = (const uint8_t (*)[16])device->signature_digests;
     
     return ESP_OK;
 }
 
 /**
- * @brief Login and get JSESSIONID
+ * @brief FNV-1a hash of a device serial (identifies persisted per-device state)
  */
-static esp_err_t login_and_get_session(char *jsessionid_out)
+static uint32_t device_sn_hash(const char *device_sn)
 {
-    esp_err_t err = ESP_FAIL;
-    char password_hash[33];
-    char signature[33];
-    char post_data[512];
-    char response_buffer[MAX_HTTP_OUTPUT_BUFFER];
+    uint32_t hash = 2166136261u;
     
-    ESP_LOGI(TAG, "🔐 Logging in with email: %s", s_service.email);
+    while (*device_sn != '\0') {
+        hash ^= (uint8_t)*device_sn++;
+        hash *= 16777619u;
+    }
     
-    // Calculate MD5 hash of password using ESPHome wrapper
-    unsigned char md5_output[16];
-    md5_calculate((const uint8_t *)s_service.password, strlen(s_service.password), md5_output);
+    return hash;
+}
+
+/**
+ * @brief Response header callback of a connection slot (captures the JSESSIONID cookie)
+ */
+static void slot_on_header(void *ctx, const char *key, const char *value)
+{
+    request_slot_t *slot = ctx;
     
-    for (int i = 0; i < 16; i++) {
-        sprintf(&password_hash[i * 2], "%02x", md5_output[i]);
+    if (strcasecmp(key, "Set-Cookie") != 0) {
+        return;
     }
-    password_hash[32] = '\0';
-    
-    // Calculate signature for login
-    char encoded_email[128];
-    url_encode(encoded_email, s_service.email, sizeof(encoded_email));
+    ESP_LOGD(TAG, "Found Set-Cookie: %s", value);
     
-    char sign_string[512];
-    snprintf(sign_string, sizeof(sign_string),
-             "appVersion=20250822.1&email=%s&password=%s&phoneModel=huawei%%20mate&phoneOs=1%s",
-             encoded_email, password_hash, SIGNATURE_KEY);
+    const char *jsessionid_start = strstr(value, "JSESSIONID=");
+    if (jsessionid_start != NULL) {
+        jsessionid_start += strlen("JSESSIONID=");
+        const char *jsessionid_end = strchr(jsessionid_start, ';');
+        
+        int len;
+        if (jsessionid_end != NULL) {
+            len = jsessionid_end - jsessionid_start;
+        } else {
+            len = strlen(jsessionid_start);
+        }
+        
+        if (len > 0 && len < sizeof(slot->jsessionid_from_cookie)) {
+            strncpy(slot->jsessionid_from_cookie, jsessionid_start, len);
+            slot->jsessionid_from_cookie[len] = '\0';
+            ESP_LOGI(TAG, "✅ Captured JSESSIONID: %s", slot->jsessionid_from_cookie);
+        }
+    }
+}
+
+/**
+ * @brief Response body callback of a connection slot
+ */
+static void slot_on_body(void *ctx, const char *data, size_t len)
+{
+    request_slot_t *slot = ctx;
     
-    // Calculate signature MD5 using ESPHome wrapper
-    md5_calculate((const uint8_t *)sign_string, strlen(sign_string), md5_output);
+    // Body pieces (already de-chunked) are tokenized as they arrive
+    api_response_parser_feed(&slot->parser, data, len);
+}
+
+/**
+ * @brief Time after which an unanswered set-power request is hedged
+ * 
+ * The running set-power total p90, so about one request in ten is hedged
+ * while the cloud behaves, bounded below by the configured minimum.
+ */
+static uint32_t hedge_delay_ms(set_power_service_handle_t svc)
+{
+    uint32_t delay_ms = latency_histogram_percentile(&svc->latency[SET_POWER_OP_SET_POWER][SET_POWER_PHASE_TOTAL], 90);
     
-    for (int i = 0; i < 16; i++) {
-        sprintf(&signature[i * 2], "%02x", md5_output[i]);
+    return (delay_ms > svc->hedge.min_delay_ms) ? delay_ms : svc->hedge.min_delay_ms;
+}
+
+/**
+ * @brief Build the status snapshot from the service state (service task only)
+ */
+static void build_status_snapshot(set_power_service_handle_t svc, status_snapshot_t *snap)
+{
+    memset(snap, 0, sizeof(*snap));
+    
+    snap->is_authenticated = svc->authenticated;
+    snap->session_restored = svc->session_restored;
+    snap->active_endpoint = svc->active_endpoint;
+    snap->breaker_state = svc->breaker_state;
+    snap->session_refreshes = svc->session_refreshes;
+    snap->proactive_refreshes = svc->proactive_refreshes;
+    snap->reactive_refreshes = svc->reactive_refreshes;
+    snap->session_lifetime_ms = (uint32_t)svc->session_lifetime_ms;
+    snap->time_to_first_accept_ms = svc->time_to_first_accept_ms;
+    snap->persist_generation = svc->persist_generation;
+    snap->retries = svc->retries;
+    snap->consecutive_failures = svc->consecutive_failures;
+    snap->breaker_trips = svc->breaker_trips;
+    snap->fast_failed_requests = svc->fast_failed_requests;
+    snap->connection_reuses = svc->connection_reuses;
+    snap->connection_reconnects = svc->connection_reconnects;
+    snap->aborted_requests = svc->aborted_requests;
+    snap->max_in_flight_requests = svc->max_in_flight;
+    snap->hedged_requests = svc->hedged_requests;
+    snap->hedge_wins = svc->hedge_wins;
+    snap->hedge_delay_ms = svc->hedge.enabled ? hedge_delay_ms(svc) : 0;
+    snap->expired_requests = svc->expired_requests;
+    snap->throttled_requests = svc->throttled_requests;
+    snap->last_queue_wait_ms = svc->last_queue_wait_ms;
+    snap->max_queue_wait_ms = svc->max_queue_wait_ms;
+    snap->arena_peak_bytes = svc->arena_peak;
+    snap->endpoint_switches = svc->endpoint_switches;
+    for (int op = 0; op < SET_POWER_OP_COUNT; op++) {
+        for (int phase = 0; phase < SET_POWER_PHASE_COUNT; phase++) {
+            const latency_histogram_t *hist = &svc->latency[op][phase];
+            set_power_latency_t *latency = &snap->latency[op][phase];
+            latency->count = hist->count;
+            latency->p50_ms = latency_histogram_percentile(hist, 50);
+            latency->p90_ms = latency_histogram_percentile(hist, 90);
+            latency->p99_ms = latency_histogram_percentile(hist, 99);
+            latency->max_ms = hist->max_ms;
+        }
+    }
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        const endpoint_t *endpoint = &svc->endpoints[i];
+        endpoint_snapshot_t *endpoint_snap = &snap->endpoints[i];
+        endpoint_snap->rtt_ms = endpoint->rtt_us / 1000;
+        endpoint_snap->error_permille = endpoint->error_permille;
+        endpoint_snap->requests = endpoint->requests;
+        endpoint_snap->failures = endpoint->failures;
+        snap->endpoint_down_until_us[i] = endpoint->down_until_us;
     }
-    signature[32] = '\0';
+    for (int i = 0; i < svc->device_count; i++) {
+        const set_power_device_t *device = &svc->devices[i];
+        device_snapshot_t *device_snap = &snap->devices[i];
+        device_snap->confirmed_power = atomic_load_explicit(&device->last_successful_power, memory_order_relaxed);
+        device_snap->total_requests = device->total_requests;
+        device_snap->successful_requests = device->successful_requests;
+        device_snap->failed_requests = device->failed_requests;
+        device_snap->skipped_requests = device->skipped_requests;
+        device_snap->expired_requests = device->expired_requests;
+        device_snap->confirmed_epoch_ms = device->last_success_time_ms;
+        // Written by posting tasks under the mailbox lock
+        taskENTER_CRITICAL(&svc->mailbox_lock);
+        device_snap->superseded_setpoints = device->superseded_setpoints;
+        taskEXIT_CRITICAL(&svc->mailbox_lock);
+    }
+    memcpy(snap->jsessionid, svc->jsessionid, sizeof(snap->jsessionid));
+    snap->session_issued_epoch_ms = svc->session_issued_epoch_ms;
+    snap->session_issued_us = svc->session_issued_us;
+    snap->breaker_open_until_us = (svc->breaker_state == SET_POWER_BREAKER_OPEN) ?
+        svc->breaker_open_until_us : 0;
+    snap->rate_full_at_us = svc->rate_full_at_us;
+}
+
+/**
+ * @brief Publish a new status snapshot and tell observers that the status changed
+ * 
+ * Only the service task (or init, before the task exists) may call this.
+ * It never waits for readers.
+ */
+static void status_changed(set_power_service_handle_t svc)
+{
+    build_status_snapshot(svc, &svc->status_scratch);
     
-    // Build POST data
-    snprintf(post_data, sizeof(post_data),
-             "email=%s&password=%s&appVersion=20250822.1&phoneOs=1&phoneModel=huawei%%20mate&sign=%s",
-             s_service.email, password_hash, signature);
-    
-    // Configure HTTP client with optimized settings
-    esp_http_client_config_t config = {
-        .url = LOGIN_URL,
-        .event_handler = http_event_handler,
-        .user_data = response_buffer,
-        .timeout_ms = s_service.request_timeout_ms * 2,  // Double timeout for login
-        .buffer_size = MAX_HTTP_OUTPUT_BUFFER,
-        .buffer_size_tx = 2048,  // Transmit buffer
-        .keep_alive_enable = true,
-        .keep_alive_idle = 5,
-        .keep_alive_interval = 5,
-        .keep_alive_count = 3,
-    };
+    unsigned generation = atomic_load_explicit(&svc->status_generation, memory_order_relaxed) + 1;
+    status_slot_t *slot = &svc->status_slots[generation & 1];
+    
+    unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
     
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
+    const uint8_t *src = (const uint8_t *)&svc->status_scratch;
+    for (size_t i = 0; i < STATUS_SNAPSHOT_WORDS; i++) {
+        uint32_t word = 0;
+        size_t len = sizeof(svc->status_scratch) - i * sizeof(uint32_t);
+        memcpy(&word, src + i * sizeof(uint32_t), len < sizeof(word) ? len : sizeof(word));
+        atomic_store_explicit(&slot->words[i], word, memory_order_relaxed);
     }
     
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_header(client, "User-Agent", USER_AGENT);
-    esp_http_client_set_header(client, "Accept", "*/*");
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    atomic_store_explicit(&svc->status_generation, generation, memory_order_release);
+}
+
+/**
+ * @brief Read the latest status snapshot (any task, never blocks)
+ */
+static void read_status_snapshot(set_power_service_handle_t svc, status_snapshot_t *snap)
+{
+    uint8_t *dst = (uint8_t *)snap;
     
-    ESP_LOGI(TAG, "Sending login request...");
+    while (1) {
+        unsigned generation = atomic_load_explicit(&svc->status_generation, memory_order_acquire);
+        status_slot_t *slot = &svc->status_slots[generation & 1];
+        
+        unsigned seq_before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq_before & 1) {
+            continue;  // Writer lapped us and is refilling this slot; the other one is complete
+        }
+        
+        for (size_t i = 0; i < STATUS_SNAPSHOT_WORDS; i++) {
+            uint32_t word = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+            size_t len = sizeof(*snap) - i * sizeof(uint32_t);
+            memcpy(dst + i * sizeof(uint32_t), &word, len < sizeof(word) ? len : sizeof(word));
+        }
+        
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq_before) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Classify a failed request for the retry policy
+ * 
+ * @param err Transport result of the request
+ * @param status_code HTTP status code (valid when err == ESP_OK)
+ * @return Error class, or ERROR_CLASS_NONE if the failure should not be retried
+ */
+static set_power_error_class_t classify_error(esp_err_t err, int status_code)
+{
+    if (err != ESP_OK) {
+        return SET_POWER_ERROR_CLASS_NETWORK;
+    }
+    if (status_code >= 500) {
+        return SET_POWER_ERROR_CLASS_HTTP_5XX;
+    }
+    if (status_code == 200) {
+        return SET_POWER_ERROR_CLASS_UNKNOWN_RESULT;
+    }
+    return ERROR_CLASS_NONE;
+}
+
+/**
+ * @brief Check whether the circuit breaker lets a request through
+ * 
+ * An open breaker moves to half-open once its open period has passed; the
+ * next request is then sent as a probe and the others wait for its outcome.
+ */
+static breaker_verdict_t breaker_check(set_power_service_handle_t svc)
+{
+    if (svc->breaker_state == SET_POWER_BREAKER_OPEN) {
+        if (esp_timer_get_time() < svc->breaker_open_until_us) {
+            return BREAKER_REJECT;
+        }
+        svc->breaker_state = SET_POWER_BREAKER_HALF_OPEN;
+        ESP_LOGI(TAG, "Circuit breaker half-open, sending probe request");
+    }
     
-    memset(g_jsessionid_from_cookie, 0, sizeof(g_jsessionid_from_cookie));
+    if (svc->breaker_state == SET_POWER_BREAKER_HALF_OPEN && svc->probe_in_flight) {
+        return BREAKER_WAIT;
+    }
     
-    err = esp_http_client_perform(client);
+    return BREAKER_ADMIT;
+}
+
+/**
+ * @brief Feed the outcome of a request to the circuit breaker
+ * 
+ * Only network errors and HTTP 5xx count as endpoint failures; any other
+ * answer proves the endpoint is reachable and closes the breaker.
+ */
+static void breaker_record(set_power_service_handle_t svc, set_power_error_class_t error_class)
+{
+    bool endpoint_failure = (error_class == SET_POWER_ERROR_CLASS_NETWORK ||
+                             error_class == SET_POWER_ERROR_CLASS_HTTP_5XX);
     
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "📡 Login Response: status=%d, body=%s", status_code, response_buffer);
-        
-        if (status_code == 200) {
-            if (strstr(response_buffer, "\"result\":0") != NULL) {
-                if (strlen(g_jsessionid_from_cookie) > 0) {
-                    strncpy(jsessionid_out, g_jsessionid_from_cookie, 63);
-                    jsessionid_out[63] = '\0';
-                    ESP_LOGI(TAG, "✅ Login successful! JSESSIONID: %s", jsessionid_out);
-                    
-                    // Update service state
-                    xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-                    s_service.authenticated = true;
-                    strncpy(s_service.jsessionid, jsessionid_out, sizeof(s_service.jsessionid) - 1);
-                    s_service.session_refreshes++;
-                    xSemaphoreGive(s_service.state_mutex);
-                    
-                    err = ESP_OK;
-                } else {
-                    ESP_LOGE(TAG, "❌ JSESSIONID not captured");
-                    err = ESP_FAIL;
-                }
-            } else {
-                ESP_LOGE(TAG, "❌ Login failed: %s", response_buffer);
-                err = ESP_FAIL;
-            }
-        } else {
-            ESP_LOGE(TAG, "❌ Login HTTP error: status code %d", status_code);
-            err = ESP_FAIL;
+    if (!endpoint_failure) {
+        if (svc->breaker_state != SET_POWER_BREAKER_CLOSED) {
+            ESP_LOGI(TAG, "✅ Circuit breaker closed");
         }
+        svc->consecutive_failures = 0;
+        svc->breaker_state = SET_POWER_BREAKER_CLOSED;
     } else {
-        ESP_LOGE(TAG, "❌ Login HTTP request failed: %s", esp_err_to_name(err));
+        svc->consecutive_failures++;
+        if (svc->breaker_config.failure_threshold > 0 &&
+            (svc->breaker_state == SET_POWER_BREAKER_HALF_OPEN ||
+             svc->consecutive_failures >= svc->breaker_config.failure_threshold)) {
+            if (svc->breaker_state != SET_POWER_BREAKER_OPEN) {
+                svc->breaker_trips++;
+            }
+            svc->breaker_state = SET_POWER_BREAKER_OPEN;
+            svc->breaker_open_until_us = esp_timer_get_time() +
+                (int64_t)svc->breaker_config.open_duration_ms * 1000;
+            ESP_LOGW(TAG, "⛔ Circuit breaker open for %lu ms after %lu consecutive failures",
+                     (unsigned long)svc->breaker_config.open_duration_ms,
+                     (unsigned long)svc->consecutive_failures);
+        }
+    }
+}
+
+/**
+ * @brief Backoff delay before a retry: full jitter over an exponential cap
+ * 
+ * @param policy Retry policy of the error class
+ * @param retry Retry number (1 = first retry)
+ * @return Delay in milliseconds, uniformly random in [0, min(max_delay, base * 2^(retry-1))]
+ */
+static uint32_t backoff_delay_ms(const set_power_retry_policy_t *policy, uint8_t retry)
+{
+    uint64_t cap = policy->base_delay_ms;
+    for (uint8_t i = 1; i < retry && cap < policy->max_delay_ms; i++) {
+        cap *= 2;
+    }
+    if (cap > policy->max_delay_ms) {
+        cap = policy->max_delay_ms;
     }
     
-    esp_http_client_cleanup(client);
+    return (cap > 0) ? (uint32_t)(esp_random() % (uint32_t)(cap + 1)) : 0;
+}
+
+/**
+ * @brief Check whether a newer setpoint for a device is waiting in its mailbox
+ */
+static bool mailbox_pending(set_power_service_handle_t svc, const set_power_device_t *device)
+{
+    taskENTER_CRITICAL(&svc->mailbox_lock);
+    bool pending = device->mailbox_full;
+    taskEXIT_CRITICAL(&svc->mailbox_lock);
     
-    return err;
+    return pending;
 }
 
 /**
- * @brief Send set power request
+ * @brief Whole tokens in the rate limit bucket
+ * 
+ * The bucket is kept as the time it will be full again: each request pushes
+ * that time one refill interval further out, so the tokens missing at any
+ * moment follow from how far in the future it lies.
+ * 
+ * @param full_at_us When the bucket is full again (esp_timer time)
+ * @param now_us Current esp_timer time
  */
-static esp_err_t send_set_power_request(int output_power, const char *jsessionid)
+static uint32_t rate_limit_tokens(set_power_service_handle_t svc, int64_t full_at_us, int64_t now_us)
 {
-    ESP_LOGI(TAG, "🌐 Sending HTTP request: Set power to %d%% for device %s", 
-             output_power, s_service.device_sn);
+    if (svc->rate_limit.burst == 0) {
+        return 0;
+    }
     
-    esp_err_t err = ESP_FAIL;
-    char signature[33];
-    char post_data[256];
-    char cookie_header[128];
-    char time_header[32];
-    char response_buffer[MAX_HTTP_OUTPUT_BUFFER];
+    int64_t interval_us = (int64_t)svc->rate_limit.refill_interval_ms * 1000;
+    int64_t missing_us = (full_at_us > now_us) ? full_at_us - now_us : 0;
     
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t timestamp_ms = (int64_t)tv.tv_sec * 1000LL + (int64_t)tv.tv_usec / 1000LL;
+    return (uint32_t)(((int64_t)svc->rate_limit.burst * interval_us - missing_us) / interval_us);
+}
+
+/**
+ * @brief Time until the rate limiter lets the next request through
+ * 
+ * @return 0 if a token is available (or the limiter is disabled), otherwise microseconds to wait
+ */
+static int64_t rate_limit_wait_us(set_power_service_handle_t svc)
+{
+    if (svc->rate_limit.burst == 0) {
+        return 0;
+    }
     
-    calculate_signature(s_service.device_sn, output_power, signature);
+    int64_t interval_us = (int64_t)svc->rate_limit.refill_interval_ms * 1000;
+    int64_t wait_us = svc->rate_full_at_us - (int64_t)(svc->rate_limit.burst - 1) * interval_us -
+                      esp_timer_get_time();
     
-    snprintf(post_data, sizeof(post_data), 
-             "deviceSn=%s&outputPower=%d",
-             s_service.device_sn, output_power);
-    
-    snprintf(time_header, sizeof(time_header), "%lld", timestamp_ms);
-    snprintf(cookie_header, sizeof(cookie_header), "JSESSIONID=%s", jsessionid);
-    
-    // Configure HTTP client with optimized settings
-    esp_http_client_config_t config = {
-        .url = API_URL,
-        .event_handler = http_event_handler,
-        .user_data = response_buffer,
-        .timeout_ms = s_service.request_timeout_ms * 2,  // Increase timeout
-        .buffer_size = MAX_HTTP_OUTPUT_BUFFER,
-        .buffer_size_tx = 2048,  // Transmit buffer
-        .keep_alive_enable = true,
-        .keep_alive_idle = 5,
-        .keep_alive_interval = 5,
-        .keep_alive_count = 3,
-    };
+    return (wait_us > 0) ? wait_us : 0;
+}
+
+/**
+ * @brief Take a token for a cloud request
+ * 
+ * A request that finds the bucket empty is not sent: a setpoint stays
+ * READY, where newer ones replace it, so bursts are merged into the next
+ * request the limiter allows. The wait is counted as throttled once, and
+ * the task wakes up when the next token is due.
+ * 
+ * @return true if a token was taken (or the limiter is disabled)
+ */
+static bool rate_limit_take(set_power_service_handle_t svc)
+{
+    if (svc->rate_limit.burst == 0) {
+        return true;
+    }
     
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
+    int64_t wait_us = rate_limit_wait_us(svc);
+    if (wait_us > 0) {
+        if (!svc->rate_hold_noted) {
+            ESP_LOGI(TAG, "🚦 Rate limit reached, holding request for %lld ms", (long long)(wait_us / 1000));
+            svc->rate_hold_noted = true;
+            svc->throttled_requests++;
+        }
+        return false;
     }
+    svc->rate_hold_noted = false;
     
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_header(client, "User-Agent", USER_AGENT);
-    esp_http_client_set_header(client, "Accept", "*/*");
-    esp_http_client_set_header(client, "Accept-Language", "zh");
-    esp_http_client_set_header(client, "Accept-Encoding", "gzip, deflate");
-    esp_http_client_set_header(client, "Connection", "keep-alive");
-    esp_http_client_set_header(client, "time", time_header);
-    esp_http_client_set_header(client, "sign", signature);
-    esp_http_client_set_header(client, "Cookie", cookie_header);
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
+    int64_t now_us = esp_timer_get_time();
+    if (svc->rate_full_at_us < now_us) {
+        svc->rate_full_at_us = now_us;
+    }
+    svc->rate_full_at_us += (int64_t)svc->rate_limit.refill_interval_ms * 1000;
     
-    err = esp_http_client_perform(client);
+    return true;
+}
+
+/**
+ * @brief Release all working arena allocations (start of a request)
+ */
+static void arena_reset(set_power_service_handle_t svc)
+{
+    svc->arena_used = 0;
+}
+
+/**
+ * @brief Allocate a buffer from the working arena
+ * 
+ * @return Pointer to the buffer, or NULL if the arena is exhausted
+ */
+static char *arena_alloc(set_power_service_handle_t svc, size_t size)
+{
+    size_t offset = (svc->arena_used + 3) & ~(size_t)3;
+    
+    if (offset + size > svc->arena_size) {
+        ESP_LOGE(TAG, "Working arena exhausted (%u + %u > %u bytes)",
+                 (unsigned)offset, (unsigned)size, (unsigned)svc->arena_size);
+        return NULL;
+    }
+    
+    svc->arena_used = offset + size;
+    if (svc->arena_used > svc->arena_peak) {
+        svc->arena_peak = svc->arena_used;
+    }
+    
+    return (char *)&svc->arena[offset];
+}
+
+/**
+ * @brief Add a latency sample
+ * 
+ * @param op Operation the sample belongs to
+ * @param phase Measured phase
+ * @param start_us esp_timer time at which the phase started
+ * @param end_us esp_timer time at which the phase ended
+ */
+static void record_latency(set_power_service_handle_t svc, set_power_op_t op, set_power_phase_t phase, int64_t start_us, int64_t end_us)
+{
+    int64_t elapsed_ms = (end_us - start_us) / 1000;
+    
+    latency_histogram_record(&svc->latency[op][phase], (elapsed_ms > 0) ? (uint32_t)elapsed_ms : 0);
+}
+
+/**
+ * @brief Number of connection slots carrying a request
+ */
+static uint32_t requests_in_flight(set_power_service_handle_t svc)
+{
+    uint32_t count = 0;
+    
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        if (svc->slots[i].kind != REQUEST_NONE) {
+            count++;
+        }
+    }
+    
+    return count;
+}
+
+/**
+ * @brief Whether an endpoint is skipped after consecutive failures
+ */
+static bool endpoint_down(const endpoint_t *endpoint, int64_t now_us)
+{
+    return endpoint->down_until_us != 0 && now_us < endpoint->down_until_us;
+}
+
+/**
+ * @brief Cost of routing a request to an endpoint (lower is better)
+ * 
+ * The smoothed request time, inflated by the error rate. An endpoint that
+ * was never used scores 0 so that it gets measured; one that only failed
+ * is charged the request timeout.
+ */
+static uint64_t endpoint_score(set_power_service_handle_t svc, const endpoint_t *endpoint)
+{
+    uint64_t rtt_us = endpoint->rtt_us;
+    if (rtt_us == 0 && endpoint->requests > 0) {
+        rtt_us = (uint64_t)svc->request_timeout_ms * 1000;
+    }
+    
+    return rtt_us * (1000 + ENDPOINT_ERROR_WEIGHT * endpoint->error_permille) / 1000;
+}
+
+/**
+ * @brief Healthiest endpoint: best score among those up, else the one that comes back first
+ */
+static uint8_t endpoint_best(set_power_service_handle_t svc, int64_t now_us)
+{
+    int best = -1;
+    
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        const endpoint_t *endpoint = &svc->endpoints[i];
+        if (endpoint_down(endpoint, now_us)) {
+            continue;
+        }
+        if (best < 0 || endpoint_score(svc, endpoint) < endpoint_score(svc, &svc->endpoints[best])) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        return (uint8_t)best;
+    }
+    
+    best = 0;
+    for (int i = 1; i < svc->endpoint_count; i++) {
+        if (svc->endpoints[i].down_until_us < svc->endpoints[best].down_until_us) {
+            best = i;
+        }
+    }
+    
+    return (uint8_t)best;
+}
+
+/**
+ * @brief Move requests to a healthier endpoint if the active one is down or clearly worse
+ * 
+ * The margin keeps two endpoints of about the same latency from taking
+ * turns on every sample.
+ */
+static void endpoint_evaluate(set_power_service_handle_t svc)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint8_t best = endpoint_best(svc, now_us);
+    if (best == svc->active_endpoint) {
+        return;
+    }
+    
+    const endpoint_t *active = &svc->endpoints[svc->active_endpoint];
+    const endpoint_t *candidate = &svc->endpoints[best];
+    if (!endpoint_down(active, now_us) &&
+        endpoint_score(svc, candidate) * 100 >= endpoint_score(svc, active) * ENDPOINT_SWITCH_PERCENT) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "🔀 Switching cloud endpoint %s -> %s (rtt %lu ms, errors %u‰)", active->url, candidate->url,
+             (unsigned long)(candidate->rtt_us / 1000), candidate->error_permille);
+    svc->active_endpoint = best;
+    svc->endpoint_switches++;
+}
+
+/**
+ * @brief Endpoint for the next request of @p kind
+ * 
+ * Normally the active endpoint. Every ENDPOINT_EXPLORE_INTERVAL-th request
+ * goes to the least recently used other endpoint that is up, so that its
+ * measurements stay current. Set-power requests stay with the endpoint
+ * that issued the session once another one has rejected it.
+ */
+static uint8_t endpoint_select(set_power_service_handle_t svc, request_kind_t kind)
+{
+    int64_t now_us = esp_timer_get_time();
+    
+    if (kind == REQUEST_SET_POWER && svc->session_pinned && svc->session_endpoint >= 0 &&
+        !endpoint_down(&svc->endpoints[svc->session_endpoint], now_us)) {
+        return (uint8_t)svc->session_endpoint;
+    }
+    if (svc->endpoint_count < 2 || kind == REQUEST_LOGIN ||
+        (svc->endpoint_requests + 1) % ENDPOINT_EXPLORE_INTERVAL != 0) {
+        return svc->active_endpoint;
+    }
+    
+    int oldest = -1;
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        const endpoint_t *endpoint = &svc->endpoints[i];
+        if (i == svc->active_endpoint || endpoint_down(endpoint, now_us)) {
+            continue;
+        }
+        if (oldest < 0 || endpoint->last_used_us < svc->endpoints[oldest].last_used_us) {
+            oldest = i;
+        }
+    }
+    
+    return (oldest >= 0) ? (uint8_t)oldest : svc->active_endpoint;
+}
+
+/**
+ * @brief Feed the outcome of a request to its endpoint's health
+ * 
+ * Network errors and HTTP 5xx count as failures, like for the circuit
+ * breaker; the request time of successful requests is the latency sample.
+ */
+static void endpoint_record(set_power_service_handle_t svc, const request_slot_t *slot)
+{
+    endpoint_t *endpoint = &svc->endpoints[slot->endpoint];
+    const cloud_conn_t *conn = slot->conn;
+    bool failed = (conn->state != CLOUD_CONN_DONE || conn->status_code >= 500);
+    
+    endpoint->requests++;
+    endpoint->error_permille = (uint16_t)((((uint32_t)endpoint->error_permille << ENDPOINT_EWMA_SHIFT) -
+                                           endpoint->error_permille + (failed ? 1000 : 0)) >> ENDPOINT_EWMA_SHIFT);
+    if (failed) {
+        endpoint->failures++;
+        endpoint->consecutive_failures++;
+        if (endpoint->consecutive_failures >= ENDPOINT_DOWN_FAILURES) {
+            if (!endpoint_down(endpoint, esp_timer_get_time()) && svc->endpoint_count > 1) {
+                ESP_LOGW(TAG, "⛔ Cloud endpoint %s down for %d ms after %u consecutive failures", endpoint->url,
+                         ENDPOINT_DOWN_MS, endpoint->consecutive_failures);
+            }
+            endpoint->down_until_us = esp_timer_get_time() + (int64_t)ENDPOINT_DOWN_MS * 1000;
+        }
+    } else {
+        int64_t elapsed_us = esp_timer_get_time() - conn->start_us;
+        uint32_t sample_us = (elapsed_us > 0) ? (uint32_t)elapsed_us : 1;
+        endpoint->rtt_us = (endpoint->rtt_us == 0) ? sample_us :
+            (uint32_t)((((uint64_t)endpoint->rtt_us << ENDPOINT_EWMA_SHIFT) - endpoint->rtt_us + sample_us) >>
+                       ENDPOINT_EWMA_SHIFT);
+        endpoint->consecutive_failures = 0;
+        endpoint->down_until_us = 0;
+    }
+    
+    endpoint_evaluate(svc);
+}
+
+/**
+ * @brief Endpoint for the hedge of a request sent to @p primary
+ * 
+ * The healthiest other endpoint that is up, so that the hedge does not
+ * share the trouble of the first copy; the same endpoint if there is none
+ * or sessions are not shared between endpoints.
+ */
+static uint8_t endpoint_hedge(set_power_service_handle_t svc, uint8_t primary)
+{
+    int64_t now_us = esp_timer_get_time();
+    int best = -1;
+    
+    if (svc->session_pinned) {
+        return primary;
+    }
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        const endpoint_t *endpoint = &svc->endpoints[i];
+        if (i == primary || endpoint_down(endpoint, now_us)) {
+            continue;
+        }
+        if (best < 0 || endpoint_score(svc, endpoint) < endpoint_score(svc, &svc->endpoints[best])) {
+            best = i;
+        }
+    }
+    
+    return (best >= 0) ? (uint8_t)best : primary;
+}
+
+/**
+ * @brief Find a free connection slot for a request to @p endpoint
+ * 
+ * Prefers a slot whose keep-alive connection is open to that endpoint, then
+ * one without an open connection, so that open connections to other
+ * endpoints are only dropped when there is no other choice.
+ * 
+ * @return Slot, or NULL if all connections are busy
+ */
+static request_slot_t *slot_acquire_for(set_power_service_handle_t svc, uint8_t endpoint)
+{
+    request_slot_t *closed_slot = NULL;
+    request_slot_t *free_slot = NULL;
+    
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        request_slot_t *slot = &svc->slots[i];
+        if (slot->kind != REQUEST_NONE) {
+            continue;
+        }
+        if (slot->conn->open && slot->conn_endpoint == endpoint) {
+            free_slot = slot;
+            closed_slot = NULL;
+            break;
+        }
+        if (!slot->conn->open && closed_slot == NULL) {
+            closed_slot = slot;
+        }
+        if (free_slot == NULL) {
+            free_slot = slot;
+        }
+    }
+    
+    request_slot_t *slot = (closed_slot != NULL) ? closed_slot : free_slot;
+    if (slot != NULL) {
+        slot->endpoint = endpoint;
+    }
+    
+    return slot;
+}
+
+/**
+ * @brief Find a free connection slot for the next request of @p kind and pick its endpoint
+ * 
+ * @return Slot, or NULL if all connections are busy
+ */
+static request_slot_t *slot_acquire(set_power_service_handle_t svc, request_kind_t kind)
+{
+    return slot_acquire_for(svc, endpoint_select(svc, kind));
+}
+
+/**
+ * @brief Put a POST request in flight on a slot
+ * 
+ * The headers common to all requests are added here, Host and
+ * Content-Length by the transport. A failure to even start (DNS, socket,
+ * request too large) leaves the connection FAILED and is handled like any
+ * other failed request.
+ * 
+ * @param path API path (appended to the base URL path)
+ * @param extra_headers Request specific headers
+ * @param extra_count Number of request specific headers
+ * @param body URL-encoded form body
+ */
+static void slot_start(set_power_service_handle_t svc, request_slot_t *slot, request_kind_t kind, const char *path,
+                       const cloud_header_t *extra_headers, size_t extra_count, const char *body)
+{
+    static const cloud_header_t common_headers[] = {
+        { "Content-Type", "application/x-www-form-urlencoded" },
+        { "User-Agent", USER_AGENT },
+        { "Accept", "*/*" },
+        { "Connection", "keep-alive" },
+    };
+    cloud_header_t headers[REQUEST_MAX_HEADERS];
+    char full_path[REQUEST_PATH_SIZE];
+    size_t count = 0;
+    
+    for (size_t i = 0; i < sizeof(common_headers) / sizeof(common_headers[0]); i++) {
+        headers[count++] = common_headers[i];
+    }
+    for (size_t i = 0; i < extra_count && count < REQUEST_MAX_HEADERS; i++) {
+        headers[count++] = extra_headers[i];
+    }
+    endpoint_t *endpoint = &svc->endpoints[slot->endpoint];
+    snprintf(full_path, sizeof(full_path), "%s%s", endpoint->base_path, path);
+    
+    cloud_request_t request = {
+        .method = "POST",
+        .host = endpoint->host,
+        .port = endpoint->port,
+        .path = full_path,
+        .headers = headers,
+        .header_count = count,
+        .body = body,
+        .body_len = strlen(body),
+    };
+    
+    slot->kind = kind;
+    slot->start_us = esp_timer_get_time();
+    slot->conn_endpoint = slot->endpoint;  // The transport drops a connection open to another endpoint
+    endpoint->last_used_us = slot->start_us;
+    svc->endpoint_requests++;
+    slot->probe = (svc->breaker_state == SET_POWER_BREAKER_HALF_OPEN);
+    if (slot->probe) {
+        svc->probe_in_flight = true;
+    }
+    api_response_parser_reset(&slot->parser);
+    slot->jsessionid_from_cookie[0] = '\0';
+    
+    // Double timeout (covers login). Transports that answer at once have already
+    // completed the request here; it is handled on the next pass like any other.
+    cloud_conn_start(slot->conn, &request, svc->request_timeout_ms * 2);
+    
+    uint32_t in_flight = requests_in_flight(svc);
+    if (in_flight > svc->max_in_flight) {
+        svc->max_in_flight = in_flight;
+    }
+}
+
+/**
+ * @brief Free a slot after its request ended or was aborted (the connection stays as it is)
+ */
+static void slot_release(set_power_service_handle_t svc, request_slot_t *slot)
+{
+    if (slot->probe) {
+        svc->probe_in_flight = false;
+    }
+    slot->kind = REQUEST_NONE;
+    slot->device = NULL;
+    slot->probe = false;
+    slot->hedge = false;
+}
+
+/**
+ * @brief Find the other copy of a hedged set-power request
+ * 
+ * @return Slot carrying the same device's request, or NULL if there is none
+ */
+static request_slot_t *slot_twin(set_power_service_handle_t svc, const request_slot_t *slot)
+{
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        request_slot_t *other = &svc->slots[i];
+        if (other != slot && other->kind == REQUEST_SET_POWER && other->device == slot->device) {
+            return other;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * @brief Build the login request and put it in flight on @p slot
+ */
+static esp_err_t start_login(set_power_service_handle_t svc, request_slot_t *slot, login_reason_t reason)
+{
+    unsigned char md5_output[16];
+    
+    ESP_LOGI(TAG, "🔐 Logging in with email: %s", svc->email);
+    
+    arena_reset(svc);
+    char *password_hash = arena_alloc(svc, 33);
+    char *signature = arena_alloc(svc, 33);
+    char *encoded_email = arena_alloc(svc, LOGIN_ENCODED_EMAIL_SIZE);
+    char *sign_string = arena_alloc(svc, LOGIN_BUFFER_SIZE);
+    char *post_data = arena_alloc(svc, LOGIN_BUFFER_SIZE);
+    if (post_data == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Calculate MD5 hash of password using ESPHome wrapper
+    md5_calculate((const uint8_t *)svc->password, strlen(svc->password), md5_output);
+    hex_encode(md5_output, sizeof(md5_output), password_hash);
+    
+    // Calculate signature for login
+    url_encode(encoded_email, svc->email, LOGIN_ENCODED_EMAIL_SIZE);
+    
+    snprintf(sign_string, LOGIN_BUFFER_SIZE,
+             "appVersion=20250822.1&email=%s&password=%s&phoneModel=huawei%%20mate&phoneOs=1%s",
+             encoded_email, password_hash, SIGNATURE_KEY);
+    
+    // Calculate signature MD5 using ESPHome wrapper
+    md5_calculate((const uint8_t *)sign_string, strlen(sign_string), md5_output);
+    hex_encode(md5_output, sizeof(md5_output), signature);
+    
+    // Build POST data
+    snprintf(post_data, LOGIN_BUFFER_SIZE,
+             "email=%s&password=%s&appVersion=20250822.1&phoneOs=1&phoneModel=huawei%%20mate&sign=%s",
+             svc->email, password_hash, signature);
+    
+    ESP_LOGI(TAG, "Sending login request...");
+    
+    // Login carries no session or request signature headers
+    slot->login_reason = reason;
+    svc->login_in_flight = true;
+    slot_start(svc, slot, REQUEST_LOGIN, LOGIN_PATH, NULL, 0, post_data);
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Build the set-power request of a device's active setpoint and put it in flight on @p slot
+ * 
+ * @param session JSESSIONID to send (a hedge repeats the first copy exactly)
+ * @param hedge Second copy of the request already in flight
+ */
+static esp_err_t start_set_power(set_power_service_handle_t svc, request_slot_t *slot, set_power_device_t *device,
+                                 const char *session, bool hedge)
+{
+    int output_power = device->active_cmd.output_power;
+    
+    if (!hedge) {
+        ESP_LOGI(TAG, "🌐 Sending HTTP request: Set power to %d%% for device %s", 
+                 output_power, device->device_sn);
+    }
+    
+    arena_reset(svc);
+    char *signature = arena_alloc(svc, 33);
+    char *post_data = arena_alloc(svc, SET_POWER_POST_SIZE);
+    char *time_value = arena_alloc(svc, SET_POWER_TIME_SIZE);
+    char *cookie = arena_alloc(svc, SET_POWER_COOKIE_SIZE);
+    if (cookie == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    lookup_signature(device, output_power, signature);
+    
+    snprintf(post_data, SET_POWER_POST_SIZE, 
+             "deviceSn=%s&outputPower=%d",
+             device->device_sn, output_power);
+    
+    snprintf(slot->session, sizeof(slot->session), "%s", session);
+    snprintf(time_value, SET_POWER_TIME_SIZE, "%lld", (long long)wall_clock_ms());
+    snprintf(cookie, SET_POWER_COOKIE_SIZE, "JSESSIONID=%s", slot->session);
+    const cloud_header_t headers[] = {
+        { "Accept-Language", "zh" },
+        { "Accept-Encoding", "gzip, deflate" },
+        { "time", time_value },
+        { "sign", signature },
+        { "Cookie", cookie },
+    };
+    
+    slot->device = device;
+    slot->output_power = output_power;
+    slot->hedge = hedge;
+    device->hedged = hedge;
+    device->phase = DEVICE_IN_FLIGHT;
+    slot_start(svc, slot, REQUEST_SET_POWER, SET_POWER_PATH, headers, sizeof(headers) / sizeof(headers[0]), post_data);
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Complete a command: store its result and release a waiting caller
+ * 
+ * A send_sync() waiter whose caller already gave up is released instead.
+ */
+static void complete_command(set_power_service_handle_t svc, const set_power_cmd_t *cmd, esp_err_t result)
+{
+    if (cmd->response_sem == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < SYNC_WAITER_COUNT; i++) {
+        sync_waiter_t *waiter = &svc->sync_waiters[i];
+        if (cmd->result != &waiter->result) {
+            continue;
+        }
+        
+        taskENTER_CRITICAL(&svc->sync_lock);
+        bool waiting = waiter->waiting;
+        if (waiting) {
+            waiter->result = result;
+            waiter->completed = true;
+        } else {
+            waiter->in_use = false;
+        }
+        taskEXIT_CRITICAL(&svc->sync_lock);
+        
+        if (waiting) {
+            xSemaphoreGive(waiter->done);
+        }
+        return;
+    }
+    
+    if (cmd->result != NULL) {
+        *cmd->result = result;
+    }
+    xSemaphoreGive((SemaphoreHandle_t)cmd->response_sem);
+}
+
+/**
+ * @brief Post a setpoint to its device's single-slot mailbox (latest value wins)
+ * 
+ * A setpoint that is still waiting in the mailbox is replaced by the new one
+ * and completed with ESP_ERR_SET_POWER_SUPERSEDED. Never blocks.
+ */
+static void mailbox_post(set_power_service_handle_t svc, const set_power_cmd_t *cmd)
+{
+    set_power_device_t *device = &svc->devices[cmd->device];
+    set_power_cmd_t superseded;
+    bool has_superseded = false;
+    
+    taskENTER_CRITICAL(&svc->mailbox_lock);
+    if (device->mailbox_full) {
+        superseded = device->mailbox_cmd;
+        has_superseded = true;
+        device->superseded_setpoints++;
+    }
+    device->mailbox_cmd = *cmd;
+    device->mailbox_full = true;
+    taskEXIT_CRITICAL(&svc->mailbox_lock);
+    
+    if (has_superseded) {
+        ESP_LOGD(TAG, "Setpoint %d%% superseded by %d%%", superseded.output_power, cmd->output_power);
+        complete_command(svc, &superseded, ESP_ERR_SET_POWER_SUPERSEDED);
+    }
+}
+
+/**
+ * @brief Take the pending setpoint out of a device's mailbox
+ * 
+ * @return true if a setpoint was pending
+ */
+static bool mailbox_take(set_power_service_handle_t svc, set_power_device_t *device, set_power_cmd_t *cmd)
+{
+    taskENTER_CRITICAL(&svc->mailbox_lock);
+    bool taken = device->mailbox_full;
+    if (taken) {
+        *cmd = device->mailbox_cmd;
+        device->mailbox_full = false;
+    }
+    taskEXIT_CRITICAL(&svc->mailbox_lock);
+    
+    return taken;
+}
+
+/**
+ * @brief Record that the current session was accepted by the server
+ * 
+ * A session still valid past the expected lifetime raises the estimate.
+ */
+static void session_note_valid(set_power_service_handle_t svc)
+{
+    if (svc->session_issued_us == 0) {
+        return;
+    }
+    
+    svc->session_last_valid_us = esp_timer_get_time();
+    int64_t age_ms = (svc->session_last_valid_us - svc->session_issued_us) / 1000;
+    if (svc->session_lifetime_ms > 0 && age_ms > svc->session_lifetime_ms) {
+        svc->session_lifetime_ms = age_ms;
+    }
+}
+
+/**
+ * @brief Learn the session lifetime from an observed expiry (result:10000)
+ * 
+ * The session died somewhere between its last accepted use and now; the
+ * midpoint is folded into a running average of observed lifetimes.
+ */
+static void session_note_expired(set_power_service_handle_t svc)
+{
+    if (svc->session_issued_us == 0) {
+        return;
+    }
+    
+    int64_t now_us = esp_timer_get_time();
+    int64_t valid_ms = (svc->session_last_valid_us - svc->session_issued_us) / 1000;
+    int64_t expired_ms = (now_us - svc->session_issued_us) / 1000;
+    int64_t sample_ms = (valid_ms + expired_ms) / 2;
+    
+    if (svc->session_lifetime_ms == 0) {
+        svc->session_lifetime_ms = sample_ms;
+    } else {
+        svc->session_lifetime_ms = (3 * svc->session_lifetime_ms + sample_ms) / 4;
+    }
+    
+    ESP_LOGI(TAG, "Session expired after %lld-%lld ms, expected lifetime now %lld ms",
+             (long long)valid_ms, (long long)expired_ms, (long long)svc->session_lifetime_ms);
+}
+
+/**
+ * @brief Time at which the current session should be refreshed proactively
+ * 
+ * @return esp_timer time in microseconds, or INT64_MAX if no refresh is planned
+ */
+static int64_t session_refresh_due_us(set_power_service_handle_t svc)
+{
+    if (!svc->authenticated || svc->session_issued_us == 0 ||
+        svc->session_lifetime_ms == 0) {
+        return INT64_MAX;
+    }
+    
+    int64_t refresh_age_ms = svc->session_lifetime_ms * SESSION_REFRESH_PERCENT / 100;
+    if (refresh_age_ms < SESSION_MIN_REFRESH_AGE_MS) {
+        refresh_age_ms = SESSION_MIN_REFRESH_AGE_MS;
+    }
+    
+    int64_t due_us = svc->session_issued_us + refresh_age_ms * 1000;
+    return (due_us > svc->next_refresh_attempt_us) ? due_us : svc->next_refresh_attempt_us;
+}
+
+/**
+ * @brief Ticks to sleep until the next proactive session refresh
+ */
+static TickType_t session_refresh_wait_ticks(set_power_service_handle_t svc)
+{
+    int64_t due_us = session_refresh_due_us(svc);
+    if (due_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    
+    int64_t wait_ms = (due_us - esp_timer_get_time()) / 1000;
+    return (wait_ms > 0) ? pdMS_TO_TICKS(wait_ms) + 1 : 0;
+}
+
+/**
+ * @brief Ask the event loop for a login
+ * 
+ * Merged with a login already asked for; a forced login takes precedence.
+ */
+static void login_request(set_power_service_handle_t svc, login_reason_t reason)
+{
+    if (!svc->login_wanted || reason == LOGIN_FORCED) {
+        svc->login_wanted = true;
+        svc->login_reason = reason;
+    }
+}
+
+/**
+ * @brief Ask for a re-login if the session is about to expire
+ * 
+ * @return true if a refresh was asked for
+ */
+static bool refresh_session_if_due(set_power_service_handle_t svc)
+{
+    if (svc->login_wanted || svc->login_in_flight) {
+        return false;
+    }
+    
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < session_refresh_due_us(svc)) {
+        return false;
+    }
+    
+    // Not worth waiting for a token: setpoints may need it more
+    int64_t rate_wait_us = rate_limit_wait_us(svc);
+    if (rate_wait_us > 0) {
+        svc->next_refresh_attempt_us = now_us + rate_wait_us;
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "🔄 Refreshing session proactively (age %lld ms, expected lifetime %lld ms)",
+             (long long)((now_us - svc->session_issued_us) / 1000), (long long)svc->session_lifetime_ms);
+    login_request(svc, LOGIN_PROACTIVE);
+    
+    return true;
+}
+
+/**
+ * @brief Check whether a command has passed its deadline
+ */
+static bool command_expired(const set_power_cmd_t *cmd)
+{
+    return cmd->deadline_ms != 0 &&
+           esp_timer_get_time() - cmd->enqueue_time_us >= (int64_t)cmd->deadline_ms * 1000;
+}
+
+/**
+ * @brief Count a command dropped because it passed its deadline
+ * 
+ * @return ESP_ERR_SET_POWER_EXPIRED
+ */
+static esp_err_t expire_command(set_power_service_handle_t svc, const set_power_cmd_t *cmd)
+{
+    ESP_LOGW(TAG, "⌛ Dropping expired command (type %d, power %d%%): %lld ms old, deadline %lu ms",
+             cmd->cmd_type, cmd->output_power, (long long)((esp_timer_get_time() - cmd->enqueue_time_us) / 1000),
+             (unsigned long)cmd->deadline_ms);
+    
+    svc->expired_requests++;
+    if (cmd->cmd_type == SET_POWER_CMD_SET_OUTPUT) {
+        svc->devices[cmd->device].expired_requests++;
+    }
+    
+    return ESP_ERR_SET_POWER_EXPIRED;
+}
+
+/**
+ * @brief Remember a setpoint rejected by the open breaker; it becomes the half-open probe
+ */
+static void defer_if_circuit_open(set_power_service_handle_t svc, const set_power_cmd_t *cmd, esp_err_t result)
+{
+    set_power_device_t *device = &svc->devices[cmd->device];
+    
+    device->has_deferred = (result == ESP_ERR_SET_POWER_CIRCUIT_OPEN);
+    if (device->has_deferred) {
+        device->deferred_cmd = *cmd;
+        device->deferred_cmd.response_sem = NULL;  // The caller has already been answered
+        device->deferred_cmd.result = NULL;
+    }
+}
+
+/**
+ * @brief Give up on a setpoint because a newer one is waiting in the mailbox
+ * 
+ * @return ESP_ERR_SET_POWER_SUPERSEDED
+ */
+static esp_err_t abandon_setpoint(set_power_service_handle_t svc, const set_power_cmd_t *cmd)
+{
+    taskENTER_CRITICAL(&svc->mailbox_lock);
+    svc->devices[cmd->device].superseded_setpoints++;
+    taskEXIT_CRITICAL(&svc->mailbox_lock);
+    
+    return ESP_ERR_SET_POWER_SUPERSEDED;
+}
+
+/**
+ * @brief Complete the active setpoint of a device and make the device idle
+ */
+static void device_complete(set_power_service_handle_t svc, set_power_device_t *device, esp_err_t result)
+{
+    device->phase = DEVICE_IDLE;
+    device->abort_protected = false;
+    if (device->active_cmd.response_sem != NULL) {
+        status_changed(svc);  // A released caller may read the status right away
+    }
+    complete_command(svc, &device->active_cmd, result);
+}
+
+/**
+ * @brief Record how long a command waited before the service task picked it up
+ */
+static void record_queue_wait(set_power_service_handle_t svc, const set_power_cmd_t *cmd)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint32_t queue_wait_ms = (uint32_t)((start_us - cmd->enqueue_time_us) / 1000);
+    svc->last_queue_wait_ms = queue_wait_ms;
+    if (queue_wait_ms > svc->max_queue_wait_ms) {
+        svc->max_queue_wait_ms = queue_wait_ms;
+    }
+    
+    if (cmd->cmd_type == SET_POWER_CMD_SET_OUTPUT) {
+        record_latency(svc, SET_POWER_OP_SET_POWER, SET_POWER_PHASE_QUEUE_WAIT, cmd->enqueue_time_us, start_us);
+    } else if (cmd->cmd_type == SET_POWER_CMD_FORCE_RELOGIN) {
+        record_latency(svc, SET_POWER_OP_LOGIN, SET_POWER_PHASE_QUEUE_WAIT, cmd->enqueue_time_us, start_us);
+    }
+}
+
+/**
+ * @brief Start working on a SET_OUTPUT command (deadline and deduplication)
+ * 
+ * A setpoint the cloud already has is completed at once; any other becomes
+ * the device's active setpoint, READY to be sent.
+ */
+static void device_activate(set_power_service_handle_t svc, set_power_device_t *device, const set_power_cmd_t *cmd)
+{
+    record_queue_wait(svc, cmd);
+    
+    device->active_cmd = *cmd;
+    device->abort_protected = false;
+    memset(device->retries, 0, sizeof(device->retries));
+    
+    if (command_expired(cmd)) {
+        device_complete(svc, device, expire_command(svc, cmd));
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Processing SET_OUTPUT command: power=%d%% (device %s)", cmd->output_power, device->device_sn);
+    
+    // Smart deduplication: Skip if power unchanged and <5min elapsed
+    // (a negative elapsed time means a restored timestamp from a different clock)
+    int64_t elapsed_ms = wall_clock_ms() - device->last_success_time_ms;
+    
+    int last_power = atomic_load_explicit(&device->last_successful_power, memory_order_relaxed);
+    if (last_power == cmd->output_power && !device->cloud_unconfirmed &&
+        elapsed_ms >= 0 && elapsed_ms < FORCE_SYNC_INTERVAL_MS && 
+        device->last_success_time_ms > 0) {
+        ESP_LOGI(TAG, "⏭️  Skipping duplicate request: power=%d%% (same as last), elapsed=%lld ms (<%lld ms force sync)", 
+                cmd->output_power, (long long)elapsed_ms, (long long)FORCE_SYNC_INTERVAL_MS);
+        
+        // Update statistics: count as skipped request
+        device->total_requests++;
+        device->skipped_requests++;  // Track deduplication efficiency
+        
+        device_complete(svc, device, ESP_OK);  // Treat as success (no need to send)
+        return;
+    }
+    
+    if (elapsed_ms >= FORCE_SYNC_INTERVAL_MS && device->last_success_time_ms > 0) {
+        ESP_LOGI(TAG, "🔄 Force sync triggered: %lld ms elapsed (>=%lld ms), sending power=%d%%",
+                (long long)elapsed_ms, (long long)FORCE_SYNC_INTERVAL_MS, cmd->output_power);
+    }
+    
+    device->phase = DEVICE_READY;
+}
+
+/**
+ * @brief Act on the outcome of a login
+ * 
+ * A failed reactive or forced login fails the setpoints waiting for the
+ * session; after a failed initial login the first setpoint logs in again.
+ */
+static void login_done(set_power_service_handle_t svc, login_reason_t reason, esp_err_t result)
+{
+    svc->login_failovers = 0;
+    
+    if (result == ESP_OK) {
+        if (reason == LOGIN_INITIAL) {
+            ESP_LOGI(TAG, "✅ Initial authentication successful");
+        }
+    } else if (reason == LOGIN_INITIAL) {
+        ESP_LOGE(TAG, "❌ Initial authentication failed, will retry on first command");
+    } else if (reason == LOGIN_PROACTIVE) {
+        // Keep using the old session; it may still be valid
+        ESP_LOGW(TAG, "Proactive refresh failed, retrying in %d ms", SESSION_REFRESH_RETRY_MS);
+        svc->next_refresh_attempt_us = esp_timer_get_time() + (int64_t)SESSION_REFRESH_RETRY_MS * 1000;
+    } else {
+        ESP_LOGE(TAG, "❌ Login failed");
+        for (int i = 0; i < svc->device_count; i++) {
+            set_power_device_t *device = &svc->devices[i];
+            if (device->phase == DEVICE_READY) {
+                device_complete(svc, device, result);
+                defer_if_circuit_open(svc, &device->active_cmd, result);
+            }
+        }
+    }
+    
+    if (reason == LOGIN_FORCED && svc->has_relogin_cmd) {
+        if (result == ESP_OK) {
+            record_latency(svc, SET_POWER_OP_LOGIN, SET_POWER_PHASE_END_TO_END, svc->relogin_cmd.enqueue_time_us,
+                           esp_timer_get_time());
+        }
+        complete_command(svc, &svc->relogin_cmd, result);
+        svc->has_relogin_cmd = false;
+    }
+}
+
+/**
+ * @brief Evaluate the response of a login request
+ */
+static void finish_login(set_power_service_handle_t svc, request_slot_t *slot)
+{
+    const cloud_conn_t *conn = slot->conn;
+    esp_err_t err = (conn->state == CLOUD_CONN_DONE) ? ESP_OK : conn->err;
+    int status_code = (err == ESP_OK) ? conn->status_code : 0;
+    login_reason_t reason = slot->login_reason;
+    set_power_error_class_t error_class = classify_error(err, status_code);
+    
+    svc->login_in_flight = false;
+    breaker_record(svc, error_class);
+    
+    if (err == ESP_OK) {
+        api_result_t api_result = api_response_parser_result(&slot->parser);
+        ESP_LOGI(TAG, "📡 Login Response: status=%d, result=%d (%s), msg=%s", status_code,
+                 (int)slot->parser.result_code, api_result_to_name(api_result), slot->parser.msg);
+        
+        if (status_code == 200) {
+            if (api_result == API_RESULT_SUCCESS) {
+                if (strlen(slot->jsessionid_from_cookie) > 0) {
+                    ESP_LOGI(TAG, "✅ Login successful! JSESSIONID: %s", slot->jsessionid_from_cookie);
+                    
+                    // Update service state
+                    svc->authenticated = true;
+                    strncpy(svc->jsessionid, slot->jsessionid_from_cookie, sizeof(svc->jsessionid) - 1);
+                    svc->session_refreshes++;
+                    if (reason == LOGIN_PROACTIVE) {
+                        svc->proactive_refreshes++;
+                    } else if (reason == LOGIN_REACTIVE) {
+                        svc->reactive_refreshes++;
+                    }
+                    svc->session_restored = false;
+                    int64_t now_epoch_ms = wall_clock_ms();
+                    svc->session_issued_epoch_ms = (now_epoch_ms >= WALL_CLOCK_VALID_MS) ? now_epoch_ms : 0;
+                    svc->persist_generation++;
+                    
+                    svc->session_issued_us = esp_timer_get_time();
+                    svc->session_last_valid_us = svc->session_issued_us;
+                    svc->session_endpoint = (int8_t)slot->endpoint;
+                } else {
+                    ESP_LOGE(TAG, "❌ JSESSIONID not captured");
+                    err = ESP_FAIL;
+                }
+            } else {
+                ESP_LOGE(TAG, "❌ Login failed: %s", slot->parser.msg);
+                err = ESP_FAIL;
+            }
+        } else {
+            ESP_LOGE(TAG, "❌ Login HTTP error: status code %d", status_code);
+            err = ESP_FAIL;
+        }
+    } else {
+        ESP_LOGE(TAG, "❌ Login HTTP request failed: %s", esp_err_to_name(err));
+    }
+    
+    // An endpoint failure moved the active endpoint: log in there before giving up
+    if (err != ESP_OK && (error_class == SET_POWER_ERROR_CLASS_NETWORK || error_class == SET_POWER_ERROR_CLASS_HTTP_5XX) &&
+        svc->active_endpoint != slot->endpoint && svc->login_failovers + 1 < svc->endpoint_count) {
+        ESP_LOGW(TAG, "🔀 Login failed on %s, trying %s", svc->endpoints[slot->endpoint].url,
+                 svc->endpoints[svc->active_endpoint].url);
+        svc->login_failovers++;
+        login_request(svc, reason);
+        return;
+    }
+    
+    login_done(svc, reason, err);
+}
+
+/**
+ * @brief Act on the outcome of a device's set-power request (success, re-login or retry)
+ * 
+ * @param session JSESSIONID the request carried
+ * @param endpoint Endpoint the request was sent to
+ */
+static void set_output_result(set_power_service_handle_t svc, set_power_device_t *device, const char *session,
+                              uint8_t endpoint, esp_err_t result)
+{
+    set_power_cmd_t *cmd = &device->active_cmd;
+    
+    // Success or device offline - both are acceptable
+    if (result == ESP_OK) {
+        session_note_valid(svc);
+        
+        // Update last successful request tracking
+        bool power_changed = (atomic_load_explicit(&device->last_successful_power, memory_order_relaxed) !=
+                              cmd->output_power);
+        atomic_store_explicit(&device->last_successful_power, cmd->output_power, memory_order_release);
+        device->last_success_time_ms = wall_clock_ms();
+        device->cloud_unconfirmed = false;
+        ESP_LOGI(TAG, "✅ Updated last successful power of %s: %d%% at %lld ms", 
+                device->device_sn, cmd->output_power, (long long)device->last_success_time_ms);
+        
+        record_latency(svc, SET_POWER_OP_SET_POWER, SET_POWER_PHASE_END_TO_END, cmd->enqueue_time_us,
+                       esp_timer_get_time());
+        
+        if (power_changed) {
+            svc->persist_generation++;  // Only a new setpoint is worth a flash write
+        }
+        if (svc->time_to_first_accept_ms == 0) {
+            svc->time_to_first_accept_ms =
+                (uint32_t)((esp_timer_get_time() - svc->init_time_us) / 1000);
+            ESP_LOGI(TAG, "⏱️  First command accepted %lu ms after start (%s session)",
+                     (unsigned long)svc->time_to_first_accept_ms,
+                     svc->session_restored ? "restored" : "new");
+        }
+        device_complete(svc, device, result);
+        defer_if_circuit_open(svc, cmd, result);
+        return;
+    }
+    
+    // Handle session expiry; a request that carried an older session is just resent
+    if (result == ESP_ERR_INVALID_STATE) {
+        if (svc->authenticated && strcmp(session, svc->jsessionid) == 0) {
+            // Another endpoint may just not know sessions issued by the one that logged in
+            bool foreign = (svc->session_endpoint >= 0 && endpoint != svc->session_endpoint);
+            const endpoint_t *issuer = foreign ? &svc->endpoints[svc->session_endpoint] : NULL;
+            if (foreign && !endpoint_down(issuer, esp_timer_get_time())) {
+                if (!svc->session_pinned) {
+                    ESP_LOGW(TAG, "📌 %s does not accept sessions of %s, keeping set-power requests there",
+                             svc->endpoints[endpoint].url, issuer->url);
+                    svc->session_pinned = true;
+                }
+                device->phase = DEVICE_READY;
+                return;
+            }
+            if (foreign) {
+                ESP_LOGW(TAG, "🔄 Session issuer %s is down, re-logging in...", issuer->url);
+            } else {
+                ESP_LOGW(TAG, "🔄 Session expired, re-logging in...");
+                session_note_expired(svc);
+            }
+            
+            svc->authenticated = false;
+            if (!svc->login_in_flight) {
+                login_request(svc, LOGIN_REACTIVE);
+            }
+        }
+        device->phase = DEVICE_READY;  // Sent again once there is a session
+        return;
+    }
+    
+    // Retry per error class with exponential backoff and full jitter
+    set_power_error_class_t error_class = svc->last_error_class;
+    if (error_class == ERROR_CLASS_NONE) {
+        device_complete(svc, device, result);  // Non-retryable error (e.g. HTTP 4xx)
+        defer_if_circuit_open(svc, cmd, result);
+        return;
+    }
+    
+    const set_power_retry_policy_t *policy = &svc->retry_policy[error_class];
+    if (device->retries[error_class] >= policy->max_retries) {
+        ESP_LOGE(TAG, "❌ Request failed after %d retries", device->retries[error_class]);
+        device_complete(svc, device, result);
+        defer_if_circuit_open(svc, cmd, result);
+        return;
+    }
+    
+    // Failing over to a healthier endpoint needs no backoff
+    bool failover = (endpoint != svc->active_endpoint && error_class != SET_POWER_ERROR_CLASS_UNKNOWN_RESULT);
+    device->retries[error_class]++;
+    uint32_t delay_ms = failover ? 0 : backoff_delay_ms(policy, device->retries[error_class]);
+    int64_t retry_at_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    if (cmd->deadline_ms != 0 &&
+        retry_at_us >= cmd->enqueue_time_us + (int64_t)cmd->deadline_ms * 1000) {
+        ESP_LOGW(TAG, "Backoff of %lu ms would pass the deadline", (unsigned long)delay_ms);
+        device_complete(svc, device, expire_command(svc, cmd));
+        return;
+    }
+    if (failover) {
+        ESP_LOGW(TAG, "🔀 Request failed (%s) on %s, retry %d/%d on %s...",
+                 set_power_error_class_to_name(error_class), svc->endpoints[endpoint].url,
+                 device->retries[error_class], policy->max_retries, svc->endpoints[svc->active_endpoint].url);
+    } else {
+        ESP_LOGW(TAG, "⚠️  Request failed (%s), retry %d/%d after %lu ms...",
+                 set_power_error_class_to_name(error_class), device->retries[error_class],
+                 policy->max_retries, (unsigned long)delay_ms);
+    }
+    
+    svc->retries++;
+    device->retry_at_us = retry_at_us;
+    device->phase = DEVICE_BACKOFF;  // A newer setpoint replaces it during the wait
+}
+
+/**
+ * @brief Evaluate the response of a set-power request
+ */
+static void finish_set_power(set_power_service_handle_t svc, request_slot_t *slot)
+{
+    set_power_device_t *device = slot->device;
+    const cloud_conn_t *conn = slot->conn;
+    esp_err_t err = (conn->state == CLOUD_CONN_DONE) ? ESP_OK : conn->err;
+    int status_code = (err == ESP_OK) ? conn->status_code : 0;
+    esp_err_t transport_err = err;
+    
+    if (err == ESP_OK) {
+        api_result_t api_result = api_response_parser_result(&slot->parser);
+        ESP_LOGI(TAG, "📡 HTTP Response: status=%d, result=%d (%s), msg=%s", status_code,
+                 (int)slot->parser.result_code, api_result_to_name(api_result), slot->parser.msg);
+        
+        if (status_code == 200) {
+            switch (api_result) {
+                case API_RESULT_SUCCESS:
+                    ESP_LOGI(TAG, "✅ Success: Power set to %d%% for device %s", slot->output_power, device->device_sn);
+                    err = ESP_OK;
+                    break;
+                case API_RESULT_DEVICE_OFFLINE:
+                    ESP_LOGW(TAG, "⚠️  Device offline (result:2)");
+                    err = ESP_OK;
+                    break;
+                case API_RESULT_SESSION_EXPIRED:
+                    ESP_LOGE(TAG, "❌ Session expired (result:10000), need re-login");
+                    err = ESP_ERR_INVALID_STATE;
+                    break;
+                default:
+                    ESP_LOGE(TAG, "❌ Unknown response: %s", slot->parser.msg);
+                    err = ESP_FAIL;
+                    break;
+            }
+        } else {
+            ESP_LOGE(TAG, "❌ HTTP error: status code %d", status_code);
+            err = ESP_FAIL;
+        }
+    } else {
+        ESP_LOGE(TAG, "❌ HTTP request failed: %s", esp_err_to_name(err));
+    }
+    
+    svc->last_error_class = (err == ESP_OK || err == ESP_ERR_INVALID_STATE) ?
+        ERROR_CLASS_NONE : classify_error(transport_err, status_code);
+    breaker_record(svc, svc->last_error_class);
+    
+    // Of a hedged pair the first successful copy wins; a failed copy leaves the decision to the other
+    request_slot_t *twin = slot_twin(svc, slot);
+    if (twin != NULL) {
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s copy of %d%% for %s failed, waiting for the other one",
+                     slot->hedge ? "Hedged" : "First", slot->output_power, device->device_sn);
+            return;
+        }
+        cloud_conn_abort(twin->conn);
+        slot_release(svc, twin);
+        if (slot->hedge) {
+            svc->hedge_wins++;
+            ESP_LOGI(TAG, "🏁 Hedge answered first for %s, first copy cancelled", device->device_sn);
+        }
+    }
+    
+    // Update statistics
+    device->total_requests++;
+    if (err == ESP_OK) {
+        device->successful_requests++;
+    } else {
+        device->failed_requests++;
+    }
+    
+    set_output_result(svc, device, slot->session, slot->endpoint, err);
+}
+
+/**
+ * @brief Handle a slot whose request ended (connection DONE or FAILED)
+ * 
+ * Name resolution, connect time, time to first byte and total time of
+ * successful requests are recorded in the latency histograms of the operation.
+ */
+static void slot_complete(set_power_service_handle_t svc, request_slot_t *slot)
+{
+    cloud_conn_t *conn = slot->conn;
+    
+    set_power_op_t op = (slot->kind == REQUEST_LOGIN) ? SET_POWER_OP_LOGIN : SET_POWER_OP_SET_POWER;
+    if (conn->state == CLOUD_CONN_DONE) {
+        // Phases are measured from the start of the attempt that succeeded
+        if (conn->resolved_us != 0) {
+            record_latency(svc, op, SET_POWER_PHASE_DNS, conn->start_us, conn->resolved_us);
+        }
+        if (conn->connected_us != 0) {
+            int64_t connect_start_us = (conn->resolved_us != 0) ? conn->resolved_us : conn->start_us;
+            record_latency(svc, op, SET_POWER_PHASE_CONNECT, connect_start_us, conn->connected_us);
+        }
+        if (conn->first_byte_us != 0) {
+            record_latency(svc, op, SET_POWER_PHASE_TTFB, conn->start_us, conn->first_byte_us);
+        }
+        record_latency(svc, op, SET_POWER_PHASE_TOTAL, slot->start_us, esp_timer_get_time());
+        
+        if (conn->reused) {
+            svc->connection_reuses++;
+        } else {
+            svc->connection_reconnects++;
+        }
+    }
+    
+    endpoint_record(svc, slot);
+    
+    if (slot->kind == REQUEST_LOGIN) {
+        finish_login(svc, slot);
+    } else {
+        finish_set_power(svc, slot);
+    }
+    
+    cloud_conn_finish(conn);
+    slot_release(svc, slot);
+}
+
+/**
+ * @brief Handle every request that ended since the last pass
+ * 
+ * @return true if any request ended
+ */
+static bool process_connections(set_power_service_handle_t svc)
+{
+    bool ended = false;
+    
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        request_slot_t *slot = &svc->slots[i];
+        if (slot->kind != REQUEST_NONE && !cloud_conn_busy(slot->conn)) {
+            slot_complete(svc, slot);
+            ended = true;
+        }
+    }
+    
+    return ended;
+}
+
+/**
+ * @brief Find the slot carrying a device's set-power request (the first copy if it was hedged)
+ */
+static request_slot_t *device_slot(set_power_service_handle_t svc, const set_power_device_t *device)
+{
+    request_slot_t *found = NULL;
+    
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        request_slot_t *slot = &svc->slots[i];
+        if (slot->kind == REQUEST_SET_POWER && slot->device == device && (found == NULL || !slot->hedge)) {
+            found = slot;
+        }
+    }
+    
+    return found;
+}
+
+/**
+ * @brief Check whether a device's in-flight request should give way to the newer setpoint
+ * 
+ * Only a request outstanding for longer than usual (the set-power total
+ * p90, at least ABORT_MIN_AGE_MS) is aborted: a normal one is about to be
+ * answered, and aborting it costs the connection. The replacement of an
+ * aborted request is never aborted itself, so a stream of setpoints faster
+ * than the cloud cannot keep a device from ever being confirmed.
+ */
+static bool should_abort(set_power_service_handle_t svc, const set_power_device_t *device)
+{
+    const request_slot_t *slot = device_slot(svc, device);
+    if (device->abort_protected || slot == NULL) {
+        return false;
+    }
+    
+    uint32_t limit_ms = latency_histogram_percentile(&svc->latency[SET_POWER_OP_SET_POWER][SET_POWER_PHASE_TOTAL], 90);
+    if (limit_ms < ABORT_MIN_AGE_MS) {
+        limit_ms = ABORT_MIN_AGE_MS;
+    }
+    
+    return esp_timer_get_time() - slot->start_us >= (int64_t)limit_ms * 1000;
+}
+
+/**
+ * @brief Abort a device's in-flight set-power request
+ * 
+ * The request may still reach the cloud, so deduplication is off for the
+ * device until the next confirmed setpoint.
+ */
+static void abort_set_power(set_power_service_handle_t svc, set_power_device_t *device)
+{
+    request_slot_t *slot = device_slot(svc, device);
+    
+    ESP_LOGW(TAG, "✂️  Aborting %d%% for %s after %lld ms, a newer setpoint is waiting",
+             slot->output_power, device->device_sn, (long long)((esp_timer_get_time() - slot->start_us) / 1000));
+    
+    cloud_conn_abort(slot->conn);
+    slot_release(svc, slot);
+    request_slot_t *twin = device_slot(svc, device);
+    if (twin != NULL) {
+        cloud_conn_abort(twin->conn);  // The hedge of the same setpoint
+        slot_release(svc, twin);
+    }
+    svc->aborted_requests++;
+    device->cloud_unconfirmed = true;
+}
+
+/**
+ * @brief Move newly posted setpoints from the mailboxes into the event loop
+ * 
+ * An idle device takes its setpoint at once. A setpoint still waiting to be
+ * sent (for a token, the session, a connection or a retry) is replaced by
+ * the newer one. An in-flight request is only replaced if it is aborted;
+ * otherwise the newer setpoint stays in the mailbox until the request ends.
+ * 
+ * @return true if a setpoint was taken
+ */
+static bool take_setpoints(set_power_service_handle_t svc)
+{
+    bool taken_any = false;
+    
+    for (int i = 0; i < svc->device_count; i++) {
+        set_power_device_t *device = &svc->devices[i];
+        bool replaces_aborted = false;
+        
+        if (device->phase == DEVICE_IN_FLIGHT) {
+            if (!mailbox_pending(svc, device) || !should_abort(svc, device)) {
+                continue;
+            }
+            abort_set_power(svc, device);
+            replaces_aborted = true;
+        }
+        
+        set_power_cmd_t cmd;
+        if (!mailbox_take(svc, device, &cmd)) {
+            continue;
+        }
+        
+        if (device->phase != DEVICE_IDLE) {
+            ESP_LOGI(TAG, "Newer setpoint arrived, abandoning %d%%", device->active_cmd.output_power);
+            device_complete(svc, device, abandon_setpoint(svc, &device->active_cmd));
+        }
+        
+        device_activate(svc, device, &cmd);
+        device->abort_protected = replaces_aborted;
+        taken_any = true;
+    }
+    
+    return taken_any;
+}
+
+/**
+ * @brief Process a control command
+ * 
+ * A FORCE_RELOGIN completes when its login has finished; until then the
+ * commands queued behind it wait.
+ */
+static void process_command(set_power_service_handle_t svc, const set_power_cmd_t *cmd)
+{
+    esp_err_t result = ESP_FAIL;
+    
+    record_queue_wait(svc, cmd);
+    
+    if (command_expired(cmd)) {
+        complete_command(svc, cmd, expire_command(svc, cmd));
+        return;
+    }
+    
+    switch (cmd->cmd_type) {
+        case SET_POWER_CMD_FORCE_RELOGIN:
+            ESP_LOGI(TAG, "Processing FORCE_RELOGIN command");
+            
+            svc->authenticated = false;
+            svc->relogin_cmd = *cmd;
+            svc->has_relogin_cmd = true;
+            login_request(svc, LOGIN_FORCED);
+            return;
+            
+        case SET_POWER_CMD_GET_STATUS:
+            ESP_LOGI(TAG, "Processing GET_STATUS command");
+            result = ESP_OK;
+            break;
+            
+        default:
+            ESP_LOGE(TAG, "Unknown command type: %d", cmd->cmd_type);
+            result = ESP_ERR_INVALID_ARG;
+            break;
+    }
+    
+    complete_command(svc, cmd, result);
+}
+
+/**
+ * @brief Process queued control commands
+ * 
+ * @return true if a command was processed
+ */
+static bool drain_control_queue(set_power_service_handle_t svc)
+{
+    set_power_cmd_t cmd;
+    bool processed = false;
     
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "📡 HTTP Response: status=%d, body=%s", status_code, response_buffer);
+    while (!svc->has_relogin_cmd && xQueueReceive(svc->cmd_queue, &cmd, 0) == pdTRUE) {
+        process_command(svc, &cmd);
+        processed = true;
+    }
+    
+    return processed;
+}
+
+/**
+ * @brief Check whether any device has a setpoint deferred by the open breaker
+ */
+static bool any_setpoint_deferred(set_power_service_handle_t svc)
+{
+    for (int i = 0; i < svc->device_count; i++) {
+        if (svc->devices[i].has_deferred) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+/**
+ * @brief Re-activate the setpoints deferred by the open breaker once it may half-open
+ * 
+ * The first one sent is the probe; the others wait for its outcome and follow
+ * only if it closed the breaker (otherwise they are rejected and deferred
+ * again). A device that has a newer setpoint meanwhile drops its deferred one.
+ * 
+ * @return true if a setpoint was re-activated
+ */
+static bool probe_deferred_setpoint(set_power_service_handle_t svc)
+{
+    if (!any_setpoint_deferred(svc) || svc->breaker_state != SET_POWER_BREAKER_OPEN ||
+        esp_timer_get_time() < svc->breaker_open_until_us) {
+        return false;
+    }
+    
+    for (int i = 0; i < svc->device_count; i++) {
+        set_power_device_t *device = &svc->devices[i];
+        if (!device->has_deferred) {
+            continue;
+        }
+        device->has_deferred = false;
+        if (device->phase == DEVICE_IDLE) {
+            // Keeps its original enqueue time, so an expired probe is dropped unsent
+            set_power_cmd_t probe = device->deferred_cmd;
+            device_activate(svc, device, &probe);
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Start the pending login if the breaker, rate limit and connections allow
+ * 
+ * @return true if the login was started or failed
+ */
+static bool dispatch_login(set_power_service_handle_t svc)
+{
+    login_reason_t reason = svc->login_reason;
+    
+    breaker_verdict_t verdict = breaker_check(svc);
+    if (verdict == BREAKER_WAIT) {
+        return false;
+    }
+    if (verdict == BREAKER_REJECT) {
+        ESP_LOGW(TAG, "⛔ Circuit breaker open, login not attempted");
+        svc->fast_failed_requests++;
+        svc->login_wanted = false;
+        login_done(svc, reason, ESP_ERR_SET_POWER_CIRCUIT_OPEN);
+        return true;
+    }
+    
+    request_slot_t *slot = slot_acquire(svc, REQUEST_LOGIN);
+    if (slot == NULL || !rate_limit_take(svc)) {
+        return false;
+    }
+    
+    svc->login_wanted = false;
+    esp_err_t err = start_login(svc, slot, reason);
+    if (err != ESP_OK) {
+        login_done(svc, reason, err);
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Send a hedge for every set-power request that has been unanswered for too long
+ * 
+ * Only with a connection to spare after the regular requests, a token the
+ * rate limiter can give right away and the breaker closed. Each request is
+ * hedged at most once.
+ * 
+ * @return true if a hedge was sent
+ */
+static bool hedge_slow_requests(set_power_service_handle_t svc)
+{
+    bool sent = false;
+    
+    if (!svc->hedge.enabled || svc->breaker_state != SET_POWER_BREAKER_CLOSED) {
+        return false;
+    }
+    
+    int64_t delay_us = (int64_t)hedge_delay_ms(svc) * 1000;
+    for (int i = 0; i < svc->device_count; i++) {
+        set_power_device_t *device = &svc->devices[i];
+        if (device->phase != DEVICE_IN_FLIGHT || device->hedged) {
+            continue;
+        }
+        const request_slot_t *primary = device_slot(svc, device);
+        int64_t age_us = esp_timer_get_time() - primary->start_us;
+        if (age_us < delay_us) {
+            continue;
+        }
         
-        if (status_code == 200) {
-            if (strstr(response_buffer, "\"result\":0") != NULL) {
-                ESP_LOGI(TAG, "✅ Success: Power set to %d%%", output_power);
-                err = ESP_OK;
-            } else if (strstr(response_buffer, "\"result\":2") != NULL) {
-                ESP_LOGW(TAG, "⚠️  Device offline (result:2)");
-                err = ESP_OK;
-            } else if (strstr(response_buffer, "\"result\":10000") != NULL) {
-                ESP_LOGE(TAG, "❌ Session expired (result:10000), need re-login");
-                err = ESP_ERR_INVALID_STATE;
-            } else {
-                ESP_LOGE(TAG, "❌ Unknown response: %s", response_buffer);
-                err = ESP_FAIL;
-            }
+        request_slot_t *slot = slot_acquire_for(svc, endpoint_hedge(svc, primary->endpoint));
+        if (slot == NULL || rate_limit_wait_us(svc) > 0 || !rate_limit_take(svc)) {
+            break;
+        }
+        
+        ESP_LOGI(TAG, "🪁 Hedging %d%% for %s after %lld ms on %s", primary->output_power, device->device_sn,
+                 (long long)(age_us / 1000), svc->endpoints[slot->endpoint].url);
+        if (start_set_power(svc, slot, device, primary->session, true) == ESP_OK) {
+            svc->hedged_requests++;
+            sent = true;
         } else {
-            ESP_LOGE(TAG, "❌ HTTP error: status code %d", status_code);
-            err = ESP_FAIL;
+            device->hedged = true;  // No memory for it now: not worth retrying for this request
         }
-    } else {
-        ESP_LOGE(TAG, "❌ HTTP request failed: %s", esp_err_to_name(err));
     }
     
-    esp_http_client_cleanup(client);
+    return sent;
+}
+
+/**
+ * @brief Start every request that can be started: the login first, then READY devices in turn
+ * 
+ * Devices take turns for connections and rate limit tokens, so a device
+ * that keeps receiving setpoints cannot starve the others.
+ * 
+ * @return true if anything observable changed
+ */
+static bool dispatch_requests(set_power_service_handle_t svc)
+{
+    bool changed = false;
+    int64_t now_us = esp_timer_get_time();
+    uint32_t throttled_before = svc->throttled_requests;
+    set_power_breaker_state_t breaker_before = svc->breaker_state;
+    bool waiting_for_session = false;
+    
+    for (int i = 0; i < svc->device_count; i++) {
+        set_power_device_t *device = &svc->devices[i];
+        if (device->phase == DEVICE_BACKOFF && now_us >= device->retry_at_us) {
+            device->phase = DEVICE_READY;
+        }
+        if (device->phase == DEVICE_READY && command_expired(&device->active_cmd)) {
+            // A setpoint is only worth sending while it is still current
+            device_complete(svc, device, expire_command(svc, &device->active_cmd));
+            changed = true;
+        }
+        waiting_for_session |= (device->phase == DEVICE_READY && !svc->authenticated);
+    }
     
-    // Update statistics
-    xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-    s_service.total_requests++;
-    if (err == ESP_OK) {
-        s_service.successful_requests++;
+    if (waiting_for_session && !svc->login_wanted && !svc->login_in_flight) {
+        ESP_LOGW(TAG, "Not authenticated, attempting login...");
+        login_request(svc, LOGIN_REACTIVE);
+    }
+    if (svc->login_wanted && !svc->login_in_flight) {
+        changed |= dispatch_login(svc);
+    }
+    
+    for (int n = 0; n < svc->device_count && svc->authenticated; n++) {
+        int i = (svc->next_device + n) % svc->device_count;
+        set_power_device_t *device = &svc->devices[i];
+        if (device->phase != DEVICE_READY) {
+            continue;
+        }
+        
+        breaker_verdict_t verdict = breaker_check(svc);
+        if (verdict == BREAKER_WAIT) {
+            break;
+        }
+        if (verdict == BREAKER_REJECT) {
+            ESP_LOGW(TAG, "⛔ Circuit breaker open, failing fast");
+            svc->fast_failed_requests++;
+            svc->last_error_class = ERROR_CLASS_NONE;
+            device_complete(svc, device, ESP_ERR_SET_POWER_CIRCUIT_OPEN);
+            defer_if_circuit_open(svc, &device->active_cmd, ESP_ERR_SET_POWER_CIRCUIT_OPEN);
+            changed = true;
+            continue;
+        }
+        
+        request_slot_t *slot = slot_acquire(svc, REQUEST_SET_POWER);
+        if (slot == NULL || !rate_limit_take(svc)) {
+            break;
+        }
+        
+        esp_err_t err = start_set_power(svc, slot, device, svc->jsessionid, false);
+        if (err != ESP_OK) {
+            device_complete(svc, device, err);
+        }
+        svc->next_device = (uint8_t)((i + 1) % svc->device_count);
+        changed = true;
+    }
+    
+    changed |= hedge_slow_requests(svc);
+    
+    return changed || svc->throttled_requests != throttled_before || svc->breaker_state != breaker_before;
+}
+
+/**
+ * @brief Ticks to sleep until the next timed action (session refresh, breaker probe,
+ *        end of a retry backoff, rate limit token for a waiting request, hedge)
+ */
+static TickType_t next_wakeup_ticks(set_power_service_handle_t svc)
+{
+    // A login under way renews the session, so no refresh is due meanwhile
+    TickType_t wait = (svc->login_wanted || svc->login_in_flight) ? portMAX_DELAY : session_refresh_wait_ticks(svc);
+    int64_t now_us = esp_timer_get_time();
+    bool waiting = svc->login_wanted;
+    
+    for (int i = 0; i < svc->device_count; i++) {
+        const set_power_device_t *device = &svc->devices[i];
+        if (device->phase == DEVICE_READY) {
+            waiting = true;
+        } else if (device->phase == DEVICE_BACKOFF) {
+            int64_t wait_ms = (device->retry_at_us - now_us) / 1000;
+            TickType_t retry_wait = (wait_ms > 0) ? pdMS_TO_TICKS(wait_ms) + 1 : 0;
+            if (retry_wait < wait) {
+                wait = retry_wait;
+            }
+        } else if (device->phase == DEVICE_IN_FLIGHT && svc->hedge.enabled && !device->hedged) {
+            const request_slot_t *primary = device_slot(svc, device);
+            int64_t wait_ms = (primary->start_us + (int64_t)hedge_delay_ms(svc) * 1000 - now_us) / 1000;
+            // A hedge already due waits for a connection or token, whose release wakes the task anyway
+            if (wait_ms > 0 && pdMS_TO_TICKS(wait_ms) + 1 < wait) {
+                wait = pdMS_TO_TICKS(wait_ms) + 1;
+            }
+        }
+    }
+    
+    int64_t rate_wait_us = rate_limit_wait_us(svc);
+    if (rate_wait_us > 0 && waiting) {
+        TickType_t token_wait = pdMS_TO_TICKS(rate_wait_us / 1000) + 1;
+        if (token_wait < wait) {
+            wait = token_wait;
+        }
+    }
+    
+    if (any_setpoint_deferred(svc) && svc->breaker_state == SET_POWER_BREAKER_OPEN) {
+        int64_t wait_ms = (svc->breaker_open_until_us - now_us) / 1000;
+        TickType_t probe_wait = (wait_ms > 0) ? pdMS_TO_TICKS(wait_ms) + 1 : 0;
+        if (probe_wait < wait) {
+            wait = probe_wait;
+        }
+    }
+    
+    return wait;
+}
+
+/**
+ * @brief Wait for the next event: socket activity, a posted command or setpoint, or a timed action
+ * 
+ * The task waits in a single select() on the sockets of the requests in
+ * flight and on its wake-up eventfd, which set_power_instance_send() writes
+ * to, so a setpoint or command posted meanwhile interrupts the wait at once.
+ * Requests of a transport without sockets (in-process mock, replay) only
+ * name the time they are due; the task then waits on the eventfd alone
+ * until that time.
+ */
+static void service_wait(set_power_service_handle_t svc)
+{
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        const request_slot_t *slot = &svc->slots[i];
+        if (slot->kind != REQUEST_NONE && !cloud_conn_busy(slot->conn)) {
+            return;  // Ended without I/O (e.g. connect failed), handle it now
+        }
+    }
+    
+    fd_set read_fds, write_fds;
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    FD_SET(svc->wake_fd, &read_fds);
+    int max_fd = svc->wake_fd;
+    int64_t wake_us = INT64_MAX;
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        if (svc->slots[i].kind != REQUEST_NONE) {
+            max_fd = cloud_conn_add_fds(svc->slots[i].conn, &read_fds, &write_fds, max_fd, &wake_us);
+        }
+    }
+    
+    TickType_t wait = next_wakeup_ticks(svc);
+    int64_t wait_ms = (wait == portMAX_DELAY) ? INT64_MAX : (int64_t)pdTICKS_TO_MS(wait);
+    if (wake_us != INT64_MAX) {
+        int64_t due_ms = (wake_us - esp_timer_get_time() + 999) / 1000;
+        if (due_ms < wait_ms) {
+            wait_ms = (due_ms > 0) ? due_ms : 0;
+        }
+    }
+    
+    struct timeval timeout;
+    struct timeval *timeout_ptr = NULL;  // Nothing timed: wait for I/O or a post
+    if (wait_ms != INT64_MAX) {
+        timeout.tv_sec = (time_t)(wait_ms / 1000);
+        timeout.tv_usec = (suseconds_t)(wait_ms % 1000) * 1000;
+        timeout_ptr = &timeout;
+    }
+    if (select(max_fd + 1, &read_fds, &write_fds, NULL, timeout_ptr) <= 0) {
+        FD_ZERO(&read_fds);  // Timeouts are still checked
+        FD_ZERO(&write_fds);
+    }
+    
+    if (FD_ISSET(svc->wake_fd, &read_fds)) {
+        uint64_t posts;
+        if (read(svc->wake_fd, &posts, sizeof(posts)) != sizeof(posts)) {
+            ESP_LOGW(TAG, "Failed to clear the wake-up event");
+        }
+    }
+    
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        if (svc->slots[i].kind != REQUEST_NONE && cloud_conn_busy(svc->slots[i].conn)) {
+            cloud_conn_process(svc->slots[i].conn, &read_fds, &write_fds);
+        }
+    }
+}
+
+/**
+ * @brief Service task main loop
+ * 
+ * The task is an event loop around non-blocking requests, so it never
+ * stops listening while the cloud is slow. Each pass handles the requests
+ * that ended, the control commands and the newest setpoint of each device,
+ * then starts whatever can be started: the login first, then one set-power
+ * request per READY device (up to SET_POWER_SERVICE_MAX_CONNECTIONS at a
+ * time, each on its own keep-alive connection). The time to reach the
+ * current target is therefore bounded by one round trip regardless of how
+ * many setpoints arrived, and devices do not wait for each other.
+ * 
+ * Once the session lifetime is known, the task also re-logs in shortly
+ * before the session is expected to expire, so setpoints rarely have to
+ * wait for authentication. While the circuit breaker is open, the last
+ * rejected setpoint is sent as a probe when it half-opens. While the rate
+ * limiter is out of tokens, setpoints stay READY (newer ones replace them)
+ * and the task wakes up when the next token is due.
+ */
+static void service_task(void *pvParameters)
+{
+    set_power_service_handle_t svc = pvParameters;
+    
+    ESP_LOGI(TAG, "Service task started");
+    
+    // Perform initial authentication on first run, unless a persisted session was
+    // restored - it is tried first and replaced only when the server rejects it
+    if (svc->session_restored) {
+        ESP_LOGI(TAG, "Using restored session, skipping initial authentication");
     } else {
-        s_service.failed_requests++;
+        ESP_LOGI(TAG, "Performing initial authentication...");
+        login_request(svc, LOGIN_INITIAL);
+    }
+    
+    while (1) {
+        bool changed = process_connections(svc);
+        changed |= drain_control_queue(svc);
+        changed |= take_setpoints(svc);
+        changed |= probe_deferred_setpoint(svc);
+        changed |= refresh_session_if_due(svc);
+        changed |= dispatch_requests(svc);
+        
+        // Counters, auth and breaker state may have changed in this pass
+        if (changed) {
+            status_changed(svc);
+        }
+        
+        // Wait until a request makes progress, a command or setpoint is posted, or a timed action is due
+        service_wait(svc);
+    }
+    
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Restore session and last confirmed setpoint from persisted state
+ */
+static void restore_persisted_state(set_power_service_handle_t svc, const set_power_service_persisted_t *state)
+{
+    int64_t now_epoch_ms = wall_clock_ms();
+    bool clock_valid = (now_epoch_ms >= WALL_CLOCK_VALID_MS);
+    
+    if (state->jsessionid[0] != '\0') {
+        // Persisted state comes from flash: do not rely on its terminator
+        memcpy(svc->jsessionid, state->jsessionid, sizeof(svc->jsessionid) - 1);
+        svc->jsessionid[sizeof(svc->jsessionid) - 1] = '\0';
+        svc->session_restored = true;
+        svc->session_issued_epoch_ms = state->session_issued_epoch_ms;
+        
+        // Rebase the issue time onto esp_timer; without a wall clock assume a fresh session
+        int64_t age_ms = 0;
+        if (clock_valid && state->session_issued_epoch_ms > 0 && now_epoch_ms > state->session_issued_epoch_ms) {
+            age_ms = now_epoch_ms - state->session_issued_epoch_ms;
+        }
+        svc->session_issued_us = svc->init_time_us - age_ms * 1000;
+        svc->session_last_valid_us = svc->session_issued_us;
+        
+        ESP_LOGI(TAG, "Restored session (age %lld ms)", (long long)age_ms);
+    }
+    
+    if (svc->session_lifetime_ms == 0) {
+        svc->session_lifetime_ms = state->session_lifetime_ms;
+    }
+    
+    // Entries are matched by serial, so reordering the configured devices is harmless
+    for (int i = 0; i < svc->device_count; i++) {
+        set_power_device_t *device = &svc->devices[i];
+        for (int j = 0; j < SET_POWER_SERVICE_MAX_DEVICES; j++) {
+            int32_t confirmed_power = state->devices[j].confirmed_power;
+            if (state->devices[j].device_sn_hash != device->device_sn_hash ||
+                confirmed_power < 0 || confirmed_power > 100) {
+                continue;
+            }
+            atomic_store_explicit(&device->last_successful_power, confirmed_power, memory_order_relaxed);
+            device->last_success_time_ms = state->devices[j].confirmed_epoch_ms;
+            ESP_LOGI(TAG, "Restored last confirmed power of %s: %d%%", device->device_sn, (int)confirmed_power);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Free the signature tables computed at init
+ */
+static void release_devices(set_power_service_handle_t svc)
+{
+    for (int i = 0; i < svc->device_count; i++) {
+        free(svc->devices[i].signature_digests);
+        svc->devices[i].signature_digests = NULL;
+    }
+}
+
+/**
+ * @brief Create the send_sync() waiter semaphores
+ */
+static esp_err_t create_sync_waiters(set_power_service_handle_t svc)
+{
+    portMUX_INITIALIZE(&svc->sync_lock);
+    for (int i = 0; i < SYNC_WAITER_COUNT; i++) {
+        svc->sync_waiters[i].done = xSemaphoreCreateBinary();
+        if (svc->sync_waiters[i].done == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    return ESP_OK;
+}
+
+static void delete_sync_waiters(set_power_service_handle_t svc)
+{
+    for (int i = 0; i < SYNC_WAITER_COUNT; i++) {
+        if (svc->sync_waiters[i].done != NULL) {
+            vSemaphoreDelete(svc->sync_waiters[i].done);
+            svc->sync_waiters[i].done = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Create the eventfd that wakes the service task out of select()
+ */
+static esp_err_t create_wake_event(set_power_service_handle_t svc)
+{
+    // Registered once per application; another instance or the application may have done it
+    esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    esp_err_t err = esp_vfs_eventfd_register(&eventfd_config);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+    
+    svc->wake_fd = eventfd(0, 0);
+    return (svc->wake_fd >= 0) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void delete_wake_event(set_power_service_handle_t svc)
+{
+    if (svc->wake_fd >= 0) {
+        close(svc->wake_fd);
+        svc->wake_fd = -1;
+    }
+}
+
+/**
+ * @brief Wake the service task, whether it waits for I/O or for the next post
+ */
+static void wake_service_task(set_power_service_handle_t svc)
+{
+    uint64_t post = 1;
+    if (write(svc->wake_fd, &post, sizeof(post)) != sizeof(post)) {
+        ESP_LOGW(TAG, "Failed to wake the service task");
+    }
+}
+
+/**
+ * @brief Check a configuration before any instance state is touched
+ */
+static bool config_valid(const set_power_service_config_t *config)
+{
+    if (config == NULL || config->email == NULL || config->password == NULL ||
+        (config->device_count == 0 && config->device_sn == NULL) ||
+        config->device_count > SET_POWER_SERVICE_MAX_DEVICES ||
+        config->base_url_count > SET_POWER_SERVICE_MAX_ENDPOINTS) {
+        ESP_LOGE(TAG, "Invalid configuration");
+        return false;
+    }
+    for (int i = 0; i < config->device_count; i++) {
+        if (config->devices[i].device_sn == NULL) {
+            ESP_LOGE(TAG, "Invalid configuration: device %d has no serial number", i);
+            return false;
+        }
+    }
+    for (int i = 0; i < config->base_url_count; i++) {
+        if (config->base_urls[i] == NULL) {
+            ESP_LOGE(TAG, "Invalid configuration: endpoint %d has no base URL", i);
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Split a cloud base URL into host, port and path prefix
+ * 
+ * @param base_url "http://host[:port][/path]", NULL for the default
+ */
+static bool parse_base_url(endpoint_t *endpoint, const char *base_url)
+{
+    const char *p = (base_url != NULL) ? base_url : DEFAULT_BASE_URL;
+    if (strncmp(p, "http://", 7) != 0 || strlen(p) >= sizeof(endpoint->url)) {
+        return false;
+    }
+    strcpy(endpoint->url, p);
+    p += 7;
+    
+    size_t host_len = strcspn(p, ":/");
+    if (host_len == 0 || host_len >= sizeof(endpoint->host)) {
+        return false;
+    }
+    memcpy(endpoint->host, p, host_len);
+    endpoint->host[host_len] = '\0';
+    p += host_len;
+    
+    endpoint->port = 80;
+    if (*p == ':') {
+        char *end;
+        long port = strtol(p + 1, &end, 10);
+        if (end == p + 1 || port <= 0 || port > 65535) {
+            return false;
+        }
+        endpoint->port = (uint16_t)port;
+        p = end;
+    }
+    if (*p != '\0' && *p != '/') {
+        return false;
+    }
+    
+    size_t path_len = strlen(p);
+    while (path_len > 0 && p[path_len - 1] == '/') {
+        path_len--;  // Request paths start with '/'
+    }
+    if (path_len >= sizeof(endpoint->base_path)) {
+        return false;
+    }
+    memcpy(endpoint->base_path, p, path_len);
+    endpoint->base_path[path_len] = '\0';
+    
+    return true;
+}
+
+/**
+ * @brief Open the connection of every slot on the instance's transport
+ */
+static esp_err_t open_connections(set_power_service_handle_t svc)
+{
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        svc->slots[i].conn = cloud_conn_open(svc->transport, slot_on_header, slot_on_body, &svc->slots[i]);
+        if (svc->slots[i].conn == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief Have the transport resolve every endpoint host now and keep it resolved
+ *
+ * Not fatal if it cannot: the host is then resolved when a connection to it is opened.
+ */
+static void watch_endpoint_hosts(set_power_service_handle_t svc, uint32_t dns_ttl_ms)
+{
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        endpoint_t *endpoint = &svc->endpoints[i];
+        esp_err_t err = cloud_transport_watch_host(svc->transport, endpoint->host, dns_ttl_ms);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "⚠️ %s will be resolved in the background on first use: %s", endpoint->host, esp_err_to_name(err));
+        }
+        endpoint->host_watched = (err == ESP_OK);
+    }
+}
+
+/**
+ * @brief Close the slot connections, dropping keep-alive sockets and aborting requests left in flight
+ *
+ * Endpoint hosts are no longer kept resolved either.
+ */
+static void close_connections(set_power_service_handle_t svc)
+{
+    for (int i = 0; i < SET_POWER_SERVICE_MAX_CONNECTIONS; i++) {
+        cloud_conn_close(svc->slots[i].conn);
+        svc->slots[i].conn = NULL;
+    }
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        if (svc->endpoints[i].host_watched) {
+            cloud_transport_unwatch_host(svc->transport, svc->endpoints[i].host);
+            svc->endpoints[i].host_watched = false;
+        }
     }
-    xSemaphoreGive(s_service.state_mutex);
-    
-    return err;
 }
 
 /**
- * @brief Service task main loop
+ * @brief Set up an instance and start its service task
+ * 
+ * @param svc Instance, all state is reset
+ * @param arena Working arena of the instance
+ * @param arena_size Size of the arena in bytes
  */
-static void service_task(void *pvParameters)
+static esp_err_t instance_start(set_power_service_handle_t svc, const set_power_service_config_t *config,
+                                uint8_t *arena, size_t arena_size)
 {
-    set_power_cmd_t cmd;
-    esp_err_t result;
+    if (!config_valid(config)) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    ESP_LOGI(TAG, "Service task started");
+    memset(svc, 0, sizeof(*svc));
+    svc->wake_fd = -1;
+    svc->arena = arena;
+    svc->arena_size = arena_size;
+    
+    svc->endpoint_count = (config->base_url_count > 0) ? config->base_url_count : 1;
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        const char *base_url = (config->base_url_count > 0) ? config->base_urls[i] : config->base_url;
+        if (!parse_base_url(&svc->endpoints[i], base_url)) {
+            ESP_LOGE(TAG, "Invalid base URL: %s", base_url);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    svc->session_endpoint = -1;
+    svc->transport = (config->transport != NULL) ? config->transport : cloud_transport_socket();
+    if (open_connections(svc) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open %s connections", svc->transport->name);
+        close_connections(svc);
+        return ESP_ERR_NO_MEM;
+    }
+    // Resolve the endpoints while the instance starts up, not in front of its first request
+    watch_endpoint_hosts(svc, config->dns_ttl_ms);
     
-    // Perform initial authentication on first run
-    ESP_LOGI(TAG, "Performing initial authentication...");
-    char initial_session[64];
-    esp_err_t initial_auth_result = login_and_get_session(initial_session);
-    if (initial_auth_result == ESP_OK) {
-        ESP_LOGI(TAG, "✅ Initial authentication successful");
-    } else {
-        ESP_LOGE(TAG, "❌ Initial authentication failed, will retry on first command");
+    // Copy configuration
+    strncpy(svc->email, config->email, sizeof(svc->email) - 1);
+    strncpy(svc->password, config->password, sizeof(svc->password) - 1);
+    svc->request_timeout_ms = config->request_timeout_ms;
+    svc->max_retry_count = config->max_retry_count;
+    svc->session_lifetime_ms = config->session_lifetime_ms;
+    svc->init_time_us = esp_timer_get_time();
+    svc->breaker_config = config->circuit_breaker;
+    svc->default_deadline_ms = config->default_deadline_ms;
+    svc->rate_limit = config->rate_limit;
+    svc->hedge = config->hedge;
+    if (svc->rate_limit.refill_interval_ms == 0) {
+        svc->rate_limit.burst = 0;  // No refill interval means no limit
     }
     
-    while (1) {
-        // Wait for command from queue
-        if (xQueueReceive(s_service.cmd_queue, &cmd, portMAX_DELAY) == pdTRUE) {
-            
-            result = ESP_FAIL;
-            
-            switch (cmd.cmd_type) {
-                case SET_POWER_CMD_SET_OUTPUT:
-                    ESP_LOGI(TAG, "Processing SET_OUTPUT command: power=%d%%", cmd.output_power);
-                    
-                    // Smart deduplication: Skip if power unchanged and <5min elapsed
-                    struct timeval tv_now;
-                    gettimeofday(&tv_now, NULL);
-                    int64_t now_ms = (int64_t)tv_now.tv_sec * 1000LL + (int64_t)tv_now.tv_usec / 1000LL;
-                    int64_t elapsed_ms = now_ms - s_last_success_time_ms;
-                    
-                    if (s_last_successful_power == cmd.output_power && 
-                        elapsed_ms < FORCE_SYNC_INTERVAL_MS && 
-                        s_last_success_time_ms > 0) {
-                        ESP_LOGI(TAG, "⏭️  Skipping duplicate request: power=%d%% (same as last), elapsed=%lld ms (<%lld ms force sync)", 
-                                cmd.output_power, elapsed_ms, (int64_t)FORCE_SYNC_INTERVAL_MS);
-                        
-                        // Update statistics: count as skipped request
-                        xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-                        s_service.total_requests++;
-                        s_service.skipped_requests++;  // Track deduplication efficiency
-                        xSemaphoreGive(s_service.state_mutex);
-                        
-                        result = ESP_OK;  // Treat as success (no need to send)
-                        break;
-                    }
-                    
-                    if (elapsed_ms >= FORCE_SYNC_INTERVAL_MS && s_last_success_time_ms > 0) {
-                        ESP_LOGI(TAG, "🔄 Force sync triggered: %lld ms elapsed (>=%lld ms), sending power=%d%%",
-                                elapsed_ms, (int64_t)FORCE_SYNC_INTERVAL_MS, cmd.output_power);
-                    }
-                    
-                    // Check authentication
-                    xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-                    bool is_auth = s_service.authenticated;
-                    char session[64];
-                    strncpy(session, s_service.jsessionid, sizeof(session) - 1);
-                    xSemaphoreGive(s_service.state_mutex);
-                    
-                    if (!is_auth) {
-                        ESP_LOGW(TAG, "Not authenticated, attempting login...");
-                        result = login_and_get_session(session);
-                        if (result != ESP_OK) {
-                            ESP_LOGE(TAG, "❌ Login failed");
-                            break;
-                        }
-                    }
-                    
-                    // Send request with retry logic
-                    uint8_t retry_count = 0;
-                    while (retry_count <= s_service.max_retry_count) {
-                        result = send_set_power_request(cmd.output_power, session);
-                        
-                        // Success or device offline - both are acceptable
-                        if (result == ESP_OK) {
-                            // Update last successful request tracking
-                            s_last_successful_power = cmd.output_power;
-                            gettimeofday(&tv_now, NULL);
-                            s_last_success_time_ms = (int64_t)tv_now.tv_sec * 1000LL + (int64_t)tv_now.tv_usec / 1000LL;
-                            ESP_LOGI(TAG, "✅ Updated last successful power: %d%% at %lld ms", 
-                                    s_last_successful_power, s_last_success_time_ms);
-                            break;
-                        }
-                        
-                        // Handle session expiry
-                        if (result == ESP_ERR_INVALID_STATE) {
-                            ESP_LOGW(TAG, "🔄 Session expired, re-logging in...");
-                            
-                            xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-                            s_service.authenticated = false;
-                            xSemaphoreGive(s_service.state_mutex);
-                            
-                            result = login_and_get_session(session);
-                            if (result != ESP_OK) {
-                                ESP_LOGE(TAG, "❌ Re-login failed");
-                                break;
-                            }
-                            ESP_LOGI(TAG, "✅ Re-login successful, retrying request...");
-                            continue;  // Retry with new session
-                        }
-                        
-                        // Handle timeout/network errors with retry
-                        if (result == ESP_ERR_HTTP_EAGAIN || result == ESP_FAIL) {
-                            retry_count++;
-                            if (retry_count <= s_service.max_retry_count) {
-                                ESP_LOGW(TAG, "⚠️  Request failed, retry %d/%d after 2s...", 
-                                        retry_count, s_service.max_retry_count);
-                                vTaskDelay(pdMS_TO_TICKS(2000));  // Wait before retry
-                            } else {
-                                ESP_LOGE(TAG, "❌ Request failed after %d retries", s_service.max_retry_count);
-                            }
-                        } else {
-                            break;  // Other errors, don't retry
-                        }
-                    }
-                    break;
-                    
-                case SET_POWER_CMD_FORCE_RELOGIN:
-                    ESP_LOGI(TAG, "Processing FORCE_RELOGIN command");
-                    
-                    xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-                    s_service.authenticated = false;
-                    xSemaphoreGive(s_service.state_mutex);
-                    
-                    result = login_and_get_session(session);
-                    break;
-                    
-                case SET_POWER_CMD_GET_STATUS:
-                    ESP_LOGI(TAG, "Processing GET_STATUS command");
-                    result = ESP_OK;
-                    break;
-                    
-                default:
-                    ESP_LOGE(TAG, "Unknown command type: %d", cmd.cmd_type);
-                    result = ESP_ERR_INVALID_ARG;
-                    break;
-            }
-            
-            // Signal completion if requested
-            if (cmd.response_sem != NULL) {
-                if (cmd.result != NULL) {
-                    *cmd.result = result;
-                }
-                xSemaphoreGive((SemaphoreHandle_t)cmd.response_sem);
-            }
+    // Policies left at zero fall back to the defaults with max_retry_count retries
+    const set_power_retry_policy_t default_policy[SET_POWER_ERROR_CLASS_COUNT] = SET_POWER_RETRY_POLICY_DEFAULT();
+    for (int i = 0; i < SET_POWER_ERROR_CLASS_COUNT; i++) {
+        svc->retry_policy[i] = config->retry_policy[i];
+        if (svc->retry_policy[i].max_delay_ms == 0) {
+            svc->retry_policy[i] = default_policy[i];
+            svc->retry_policy[i].max_retries = config->max_retry_count;
         }
     }
     
-    vTaskDelete(NULL);
-}
-
-/* Public API Implementation */
-
-esp_err_t set_power_service_init(const set_power_service_config_t *config)
-{
-    if (config == NULL || config->email == NULL || config->password == NULL || config->device_sn == NULL) {
-        ESP_LOGE(TAG, "Invalid configuration");
-        return ESP_ERR_INVALID_ARG;
+    // A single device may be given the pre-multi-device way
+    set_power_device_config_t single_device = {
+        .device_sn = config->device_sn,
+        .signature_table = config->signature_table,
+    };
+    const set_power_device_config_t *device_configs = (config->device_count > 0) ? config->devices : &single_device;
+    svc->device_count = (config->device_count > 0) ? config->device_count : 1;
+    for (int i = 0; i < svc->device_count; i++) {
+        set_power_device_t *device = &svc->devices[i];
+        strncpy(device->device_sn, device_configs[i].device_sn, sizeof(device->device_sn) - 1);
+        device->device_sn_hash = device_sn_hash(device->device_sn);
+        atomic_store_explicit(&device->last_successful_power, -1, memory_order_relaxed);
     }
     
-    if (s_service.initialized) {
-        ESP_LOGW(TAG, "Service already initialized");
-        return ESP_OK;
+    if (config->restore_state != NULL) {
+        restore_persisted_state(svc, config->restore_state);
     }
     
-    memset(&s_service, 0, sizeof(s_service));
-    
-    // Copy configuration
-    strncpy(s_service.email, config->email, sizeof(s_service.email) - 1);
-    strncpy(s_service.password, config->password, sizeof(s_service.password) - 1);
-    strncpy(s_service.device_sn, config->device_sn, sizeof(s_service.device_sn) - 1);
-    s_service.request_timeout_ms = config->request_timeout_ms;
-    s_service.max_retry_count = config->max_retry_count;
-    
-    // Create mutex
-    s_service.state_mutex = xSemaphoreCreateMutex();
-    if (s_service.state_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create mutex");
-        return ESP_ERR_NO_MEM;
+    // Signatures depend only on device_sn and power, so the hot path is a table lookup
+    for (int i = 0; i < svc->device_count; i++) {
+        if (init_signature_table(&svc->devices[i], device_configs[i].signature_table) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to allocate signature table");
+            release_devices(svc);
+            close_connections(svc);
+            return ESP_ERR_NO_MEM;
+        }
     }
     
+    portMUX_INITIALIZE(&svc->mailbox_lock);
+    
     // Create command queue
-    s_service.cmd_queue = xQueueCreate(SET_POWER_SERVICE_QUEUE_SIZE, sizeof(set_power_cmd_t));
-    if (s_service.cmd_queue == NULL) {
+    svc->cmd_queue = xQueueCreate(SET_POWER_SERVICE_QUEUE_SIZE, sizeof(set_power_cmd_t));
+    if (svc->cmd_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create command queue");
-        vSemaphoreDelete(s_service.state_mutex);
+        release_devices(svc);
+        close_connections(svc);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    if (create_wake_event(svc) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create wake-up event");
+        vQueueDelete(svc->cmd_queue);
+        release_devices(svc);
+        close_connections(svc);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    if (create_sync_waiters(svc) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create sync waiters");
+        delete_sync_waiters(svc);
+        delete_wake_event(svc);
+        vQueueDelete(svc->cmd_queue);
+        release_devices(svc);
+        close_connections(svc);
         return ESP_ERR_NO_MEM;
     }
     
     // Initial authentication will be performed by service task
     // to avoid stack overflow in app_main context
-    s_service.authenticated = false;
+    svc->authenticated = svc->session_restored;
+    
+    // Readers see a valid snapshot from the start; afterwards only the service task publishes
+    status_changed(svc);
     
     // Create service task
     BaseType_t ret = xTaskCreate(
         service_task,
         "set_power_svc",
         SET_POWER_SERVICE_TASK_STACK_SIZE,
-        NULL,
+        svc,
         SET_POWER_SERVICE_TASK_PRIORITY,
-        &s_service.task_handle
+        &svc->task_handle
     );
     
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create service task");
-        vQueueDelete(s_service.cmd_queue);
-        vSemaphoreDelete(s_service.state_mutex);
+        delete_sync_waiters(svc);
+        delete_wake_event(svc);
+        vQueueDelete(svc->cmd_queue);
+        release_devices(svc);
+        close_connections(svc);
         return ESP_ERR_NO_MEM;
     }
     
-    s_service.initialized = true;
+    svc->initialized = true;
     
-    ESP_LOGI(TAG, "✅ Service initialized successfully (authentication will happen in background)");
+    ESP_LOGI(TAG, "✅ Service initialized successfully for %s, %u device(s) (authentication will happen in background)",
+             svc->email, svc->device_count);
     
     return ESP_OK;
 }
 
-esp_err_t set_power_service_deinit(void)
+/**
+ * @brief Stop the service task of an instance and free its resources (not the arena)
+ */
+static esp_err_t instance_stop(set_power_service_handle_t svc)
 {
-    if (!s_service.initialized) {
+    if (!svc->initialized) {
         return ESP_OK;
     }
     
-    if (s_service.task_handle != NULL) {
-        vTaskDelete(s_service.task_handle);
-        s_service.task_handle = NULL;
+    if (svc->task_handle != NULL) {
+        vTaskDelete(svc->task_handle);
+        svc->task_handle = NULL;
     }
     
-    if (s_service.cmd_queue != NULL) {
-        vQueueDelete(s_service.cmd_queue);
-        s_service.cmd_queue = NULL;
-    }
+    close_connections(svc);
     
-    if (s_service.state_mutex != NULL) {
-        vSemaphoreDelete(s_service.state_mutex);
-        s_service.state_mutex = NULL;
+    if (svc->cmd_queue != NULL) {
+        vQueueDelete(svc->cmd_queue);
+        svc->cmd_queue = NULL;
     }
     
-    s_service.initialized = false;
+    delete_sync_waiters(svc);
+    delete_wake_event(svc);
+    release_devices(svc);
+    
+    svc->initialized = false;
     
     ESP_LOGI(TAG, "Service deinitialized");
     
     return ESP_OK;
 }
 
-esp_err_t set_power_service_send(const set_power_cmd_t *cmd, uint32_t timeout_ms)
+/* Public API Implementation */
+
+esp_err_t set_power_instance_create(const set_power_service_config_t *config, set_power_service_handle_t *out_handle)
+{
+    if (out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_handle = NULL;
+    
+    set_power_service_handle_t svc = calloc(1, sizeof(*svc));
+    uint8_t *arena = ARENA_MALLOC(SET_POWER_SERVICE_ARENA_SIZE);
+    if (svc == NULL || arena == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate service instance");
+        free(arena);
+        free(svc);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    esp_err_t err = instance_start(svc, config, arena, SET_POWER_SERVICE_ARENA_SIZE);
+    if (err != ESP_OK) {
+        free(arena);
+        free(svc);
+        return err;
+    }
+    svc->arena_owned = true;
+    
+    *out_handle = svc;
+    
+    return ESP_OK;
+}
+
+esp_err_t set_power_instance_destroy(set_power_service_handle_t svc)
+{
+    if (svc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    instance_stop(svc);
+    
+    if (svc->arena_owned) {
+        free(svc->arena);
+    }
+    if (svc != &s_default_service) {
+        free(svc);
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t set_power_instance_send(set_power_service_handle_t svc, const set_power_cmd_t *cmd, uint32_t timeout_ms)
 {
-    if (!s_service.initialized) {
+    if (svc == NULL || !svc->initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (cmd == NULL) {
+    if (cmd == NULL || (cmd->cmd_type == SET_POWER_CMD_SET_OUTPUT && cmd->device >= svc->device_count)) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    // Stamp the command so the service task can tell how long it waited
+    set_power_cmd_t stamped = *cmd;
+    stamped.enqueue_time_us = esp_timer_get_time();
+    if (stamped.deadline_ms == 0) {
+        stamped.deadline_ms = svc->default_deadline_ms;
+    }
     
-    if (xQueueSend(s_service.cmd_queue, cmd, ticks) != pdTRUE) {
-        ESP_LOGW(TAG, "Command queue full, timeout occurred");
-        return ESP_ERR_TIMEOUT;
+    if (stamped.cmd_type == SET_POWER_CMD_SET_OUTPUT) {
+        // Only the newest setpoint matters - overwrite instead of queueing
+        mailbox_post(svc, &stamped);
+    } else {
+        TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+        
+        if (xQueueSend(svc->cmd_queue, &stamped, ticks) != pdTRUE) {
+            ESP_LOGW(TAG, "Command queue full, timeout occurred");
+            return ESP_ERR_TIMEOUT;
+        }
     }
     
+    wake_service_task(svc);
+    
     return ESP_OK;
 }
 
-esp_err_t set_power_service_send_sync(set_power_cmd_t *cmd, uint32_t timeout_ms)
+esp_err_t set_power_instance_send_sync(set_power_service_handle_t svc, set_power_cmd_t *cmd, uint32_t timeout_ms)
 {
-    if (!s_service.initialized) {
+    if (svc == NULL || !svc->initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
@@ -694,33 +3204,57 @@ esp_err_t set_power_service_send_sync(set_power_cmd_t *cmd, uint32_t timeout_ms)
         return ESP_ERR_INVALID_ARG;
     }
     
-    SemaphoreHandle_t sem = xSemaphoreCreateBinary();
-    if (sem == NULL) {
+    sync_waiter_t *waiter = NULL;
+    taskENTER_CRITICAL(&svc->sync_lock);
+    for (int i = 0; i < SYNC_WAITER_COUNT; i++) {
+        if (!svc->sync_waiters[i].in_use) {
+            waiter = &svc->sync_waiters[i];
+            waiter->in_use = true;
+            waiter->waiting = true;
+            waiter->completed = false;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&svc->sync_lock);
+    if (waiter == NULL) {
+        ESP_LOGW(TAG, "Too many synchronous commands outstanding");
         return ESP_ERR_NO_MEM;
     }
     
-    esp_err_t result = ESP_FAIL;
-    cmd->response_sem = sem;
-    cmd->result = &result;
-    
-    esp_err_t err = set_power_service_send(cmd, timeout_ms);
-    if (err != ESP_OK) {
-        vSemaphoreDelete(sem);
-        return err;
-    }
+    cmd->response_sem = waiter->done;
+    cmd->result = &waiter->result;
     
-    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    if (xSemaphoreTake(sem, ticks) != pdTRUE) {
-        vSemaphoreDelete(sem);
-        return ESP_ERR_TIMEOUT;
+    esp_err_t err = set_power_instance_send(svc, cmd, timeout_ms);
+    if (err == ESP_OK) {
+        TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+        bool done = (xSemaphoreTake(waiter->done, ticks) == pdTRUE);
+        
+        // Detach from the command; if it is still pending, it releases the waiter when it completes
+        taskENTER_CRITICAL(&svc->sync_lock);
+        waiter->waiting = false;
+        bool completed = waiter->completed;
+        taskEXIT_CRITICAL(&svc->sync_lock);
+        
+        if (!done && completed) {
+            // Completed right at the timeout: its give is on the way, consume it before reuse
+            xSemaphoreTake(waiter->done, portMAX_DELAY);
+            done = true;
+        }
+        err = done ? waiter->result : ESP_ERR_TIMEOUT;
+        if (!done) {
+            return err;  // The command still holds the waiter
+        }
     }
     
-    vSemaphoreDelete(sem);
+    taskENTER_CRITICAL(&svc->sync_lock);
+    waiter->in_use = false;
+    taskEXIT_CRITICAL(&svc->sync_lock);
     
-    return result;
+    return err;
 }
 
-esp_err_t set_power_service_set_output(int output_power, bool wait_completion)
+esp_err_t set_power_instance_set_output(set_power_service_handle_t svc, uint8_t device, int output_power,
+                                        uint32_t deadline_ms, bool wait_completion)
 {
     if (output_power < 0 || output_power > 100) {
         return ESP_ERR_INVALID_ARG;
@@ -729,18 +3263,35 @@ esp_err_t set_power_service_set_output(int output_power, bool wait_completion)
     set_power_cmd_t cmd = {
         .cmd_type = SET_POWER_CMD_SET_OUTPUT,
         .output_power = output_power,
+        .device = device,
         .response_sem = NULL,
         .result = NULL,
+        .deadline_ms = deadline_ms,
     };
     
     if (wait_completion) {
-        return set_power_service_send_sync(&cmd, 30000);
+        return set_power_instance_send_sync(svc, &cmd, 30000);
     } else {
-        return set_power_service_send(&cmd, 1000);
+        return set_power_instance_send(svc, &cmd, 1000);
     }
 }
 
-esp_err_t set_power_service_force_relogin(void)
+int set_power_instance_find_device(set_power_service_handle_t svc, const char *device_sn)
+{
+    if (svc == NULL || !svc->initialized || device_sn == NULL) {
+        return -1;
+    }
+    
+    for (int i = 0; i < svc->device_count; i++) {
+        if (strcmp(svc->devices[i].device_sn, device_sn) == 0) {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+esp_err_t set_power_instance_force_relogin(set_power_service_handle_t svc)
 {
     set_power_cmd_t cmd = {
         .cmd_type = SET_POWER_CMD_FORCE_RELOGIN,
@@ -748,46 +3299,339 @@ esp_err_t set_power_service_force_relogin(void)
         .result = NULL,
     };
     
-    return set_power_service_send_sync(&cmd, 30000);
+    return set_power_instance_send_sync(svc, &cmd, 30000);
 }
 
-esp_err_t set_power_service_get_status(set_power_service_status_t *status)
+esp_err_t set_power_instance_get_status(set_power_service_handle_t svc, set_power_service_status_t *status)
 {
-    if (!s_service.initialized || status == NULL) {
+    if (svc == NULL || !svc->initialized || status == NULL) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-    
-    status->is_authenticated = s_service.authenticated;
-    status->total_requests = s_service.total_requests;
-    status->successful_requests = s_service.successful_requests;
-    status->failed_requests = s_service.failed_requests;
-    status->skipped_requests = s_service.skipped_requests;
-    status->session_refreshes = s_service.session_refreshes;
-    strncpy(status->jsessionid, s_service.jsessionid, sizeof(status->jsessionid) - 1);
+    status_snapshot_t snap;
+    read_status_snapshot(svc, &snap);
+    
+    memset(status, 0, sizeof(*status));
+    status->is_authenticated = snap.is_authenticated;
+    status->session_restored = snap.session_restored;
+    status->breaker_state = snap.breaker_state;
+    status->session_refreshes = snap.session_refreshes;
+    status->proactive_refreshes = snap.proactive_refreshes;
+    status->reactive_refreshes = snap.reactive_refreshes;
+    status->session_lifetime_ms = snap.session_lifetime_ms;
+    status->time_to_first_accept_ms = snap.time_to_first_accept_ms;
+    status->persist_generation = snap.persist_generation;
+    status->retries = snap.retries;
+    status->consecutive_failures = snap.consecutive_failures;
+    status->breaker_trips = snap.breaker_trips;
+    status->fast_failed_requests = snap.fast_failed_requests;
+    status->connection_reuses = snap.connection_reuses;
+    status->connection_reconnects = snap.connection_reconnects;
+    status->aborted_requests = snap.aborted_requests;
+    status->max_in_flight_requests = snap.max_in_flight_requests;
+    status->hedged_requests = snap.hedged_requests;
+    status->hedge_wins = snap.hedge_wins;
+    status->hedge_delay_ms = snap.hedge_delay_ms;
+    status->expired_requests = snap.expired_requests;
+    status->throttled_requests = snap.throttled_requests;
+    status->last_queue_wait_ms = snap.last_queue_wait_ms;
+    status->max_queue_wait_ms = snap.max_queue_wait_ms;
+    memcpy(status->latency, snap.latency, sizeof(status->latency));
+    status->stack_size_bytes = SET_POWER_SERVICE_TASK_STACK_SIZE;
+    status->arena_size_bytes = svc->arena_size;
+    status->arena_peak_bytes = snap.arena_peak_bytes;
+    status->endpoint_switches = snap.endpoint_switches;
+    memcpy(status->jsessionid, snap.jsessionid, sizeof(status->jsessionid));
+    
+    // Time-dependent fields are derived here, so the snapshot only changes on events
+    int64_t now_us = esp_timer_get_time();
+    status->session_age_ms = (snap.session_issued_us > 0) ?
+        (uint32_t)((now_us - snap.session_issued_us) / 1000) : 0;
+    status->breaker_open_remaining_ms = (snap.breaker_open_until_us > now_us) ?
+        (uint32_t)((snap.breaker_open_until_us - now_us) / 1000) : 0;
+    status->rate_limit_tokens = rate_limit_tokens(svc, snap.rate_full_at_us, now_us);
+    status->stack_high_water_bytes = (svc->task_handle != NULL) ?
+        (uint32_t)uxTaskGetStackHighWaterMark(svc->task_handle) : 0;
+    
+    // Base URLs and serials are fixed once the instance runs, so they are read from it directly
+    status->endpoint_count = svc->endpoint_count;
+    for (int i = 0; i < svc->endpoint_count; i++) {
+        const endpoint_snapshot_t *endpoint_snap = &snap.endpoints[i];
+        set_power_endpoint_status_t *endpoint_status = &status->endpoints[i];
+        strncpy(endpoint_status->base_url, svc->endpoints[i].url, sizeof(endpoint_status->base_url) - 1);
+        endpoint_status->rtt_ms = endpoint_snap->rtt_ms;
+        endpoint_status->error_permille = endpoint_snap->error_permille;
+        endpoint_status->requests = endpoint_snap->requests;
+        endpoint_status->failures = endpoint_snap->failures;
+        endpoint_status->down = (now_us < snap.endpoint_down_until_us[i]);
+        endpoint_status->active = (i == snap.active_endpoint);
+    }
     
-    xSemaphoreGive(s_service.state_mutex);
+    // Service totals are the sums over all devices
+    status->device_count = svc->device_count;
+    for (int i = 0; i < svc->device_count; i++) {
+        const device_snapshot_t *device_snap = &snap.devices[i];
+        set_power_device_status_t *device_status = &status->devices[i];
+        strncpy(device_status->device_sn, svc->devices[i].device_sn, sizeof(device_status->device_sn) - 1);
+        device_status->confirmed_power = device_snap->confirmed_power;
+        device_status->total_requests = device_snap->total_requests;
+        device_status->successful_requests = device_snap->successful_requests;
+        device_status->failed_requests = device_snap->failed_requests;
+        device_status->skipped_requests = device_snap->skipped_requests;
+        device_status->superseded_setpoints = device_snap->superseded_setpoints;
+        device_status->expired_requests = device_snap->expired_requests;
+        
+        status->total_requests += device_status->total_requests;
+        status->successful_requests += device_status->successful_requests;
+        status->failed_requests += device_status->failed_requests;
+        status->skipped_requests += device_status->skipped_requests;
+        status->superseded_setpoints += device_status->superseded_setpoints;
+    }
     
     return ESP_OK;
 }
 
-bool set_power_service_is_ready(void)
+uint32_t set_power_instance_get_status_generation(set_power_service_handle_t svc)
+{
+    if (svc == NULL) {
+        return 0;
+    }
+    
+    return atomic_load_explicit(&svc->status_generation, memory_order_acquire);
+}
+
+bool set_power_instance_is_ready(set_power_service_handle_t svc)
 {
-    if (!s_service.initialized) {
+    if (svc == NULL || !svc->initialized) {
         return false;
     }
     
-    xSemaphoreTake(s_service.state_mutex, portMAX_DELAY);
-    bool is_auth = s_service.authenticated;
-    xSemaphoreGive(s_service.state_mutex);
+    status_snapshot_t snap;
+    read_status_snapshot(svc, &snap);
+    
+    return snap.is_authenticated;
+}
+
+int set_power_instance_get_last_successful_power(set_power_service_handle_t svc, uint8_t device)
+{
+    if (svc == NULL || device >= svc->device_count) {
+        return -1;
+    }
+    
+    // Written only by the service task; the acquire load pairs with its release store
+    return atomic_load_explicit(&svc->devices[device].last_successful_power, memory_order_acquire);
+}
+
+esp_err_t set_power_instance_benchmark_signature(set_power_service_handle_t svc, uint32_t iterations,
+                                                 set_power_signature_benchmark_t *result)
+{
+    if (svc == NULL || !svc->initialized || result == NULL || iterations == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    char signature[33];
+    volatile char sink = 0;  // Keeps the compiler from dropping the loops
+    
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < iterations; i++) {
+        calculate_signature(svc->devices[0].device_sn, (int)(i % SET_POWER_SIGNATURE_TABLE_SIZE), signature);
+        sink ^= signature[0];
+    }
+    int64_t compute_us = esp_timer_get_time() - start_us;
+    
+    start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < iterations; i++) {
+        lookup_signature(&svc->devices[0], (int)(i % SET_POWER_SIGNATURE_TABLE_SIZE), signature);
+        sink ^= signature[0];
+    }
+    int64_t lookup_us = esp_timer_get_time() - start_us;
+    (void)sink;
+    
+    result->iterations = iterations;
+    result->compute_ns_per_op = (uint32_t)(compute_us * 1000 / iterations);
+    result->lookup_ns_per_op = (uint32_t)(lookup_us * 1000 / iterations);
+    
+    ESP_LOGI(TAG, "Signature benchmark (%lu iterations): compute %lu ns/op, lookup %lu ns/op",
+             (unsigned long)iterations, (unsigned long)result->compute_ns_per_op,
+             (unsigned long)result->lookup_ns_per_op);
+    
+    return ESP_OK;
+}
+
+esp_err_t set_power_instance_get_persisted_state(set_power_service_handle_t svc,
+                                                 set_power_service_persisted_t *state)
+{
+    if (svc == NULL || !svc->initialized || state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    status_snapshot_t snap;
+    read_status_snapshot(svc, &snap);
+    
+    memset(state, 0, sizeof(*state));
+    if (snap.is_authenticated) {
+        memcpy(state->jsessionid, snap.jsessionid, sizeof(state->jsessionid));
+        state->session_issued_epoch_ms = snap.session_issued_epoch_ms;
+    }
+    state->session_lifetime_ms = snap.session_lifetime_ms;
+    for (int i = 0; i < svc->device_count; i++) {
+        state->devices[i].device_sn_hash = svc->devices[i].device_sn_hash;
+        state->devices[i].confirmed_power = snap.devices[i].confirmed_power;
+        state->devices[i].confirmed_epoch_ms = snap.devices[i].confirmed_epoch_ms;
+    }
+    
+    return ESP_OK;
+}
+
+/* Default instance */
+
+esp_err_t set_power_service_init(const set_power_service_config_t *config)
+{
+    if (s_default_service.initialized) {
+        ESP_LOGW(TAG, "Service already initialized");
+        return ESP_OK;
+    }
     
-    return is_auth;
+    return instance_start(&s_default_service, config, s_work_arena, sizeof(s_work_arena));
+}
+
+esp_err_t set_power_service_deinit(void)
+{
+    return instance_stop(&s_default_service);
+}
+
+set_power_service_handle_t set_power_service_default_instance(void)
+{
+    return &s_default_service;
+}
+
+esp_err_t set_power_service_send(const set_power_cmd_t *cmd, uint32_t timeout_ms)
+{
+    return set_power_instance_send(&s_default_service, cmd, timeout_ms);
+}
+
+esp_err_t set_power_service_send_sync(set_power_cmd_t *cmd, uint32_t timeout_ms)
+{
+    return set_power_instance_send_sync(&s_default_service, cmd, timeout_ms);
+}
+
+esp_err_t set_power_service_set_output(int output_power, bool wait_completion)
+{
+    return set_power_instance_set_output(&s_default_service, 0, output_power, 0, wait_completion);
+}
+
+esp_err_t set_power_service_set_output_with_deadline(int output_power, uint32_t deadline_ms, bool wait_completion)
+{
+    return set_power_instance_set_output(&s_default_service, 0, output_power, deadline_ms, wait_completion);
+}
+
+esp_err_t set_power_service_set_device_output(uint8_t device, int output_power, uint32_t deadline_ms,
+                                              bool wait_completion)
+{
+    return set_power_instance_set_output(&s_default_service, device, output_power, deadline_ms, wait_completion);
+}
+
+int set_power_service_find_device(const char *device_sn)
+{
+    return set_power_instance_find_device(&s_default_service, device_sn);
+}
+
+esp_err_t set_power_service_force_relogin(void)
+{
+    return set_power_instance_force_relogin(&s_default_service);
+}
+
+esp_err_t set_power_service_get_status(set_power_service_status_t *status)
+{
+    return set_power_instance_get_status(&s_default_service, status);
+}
+
+bool set_power_service_is_ready(void)
+{
+    return set_power_instance_is_ready(&s_default_service);
 }
 
 int set_power_service_get_last_successful_power(void)
 {
-    // Return the last successfully set power from service layer
-    // No mutex needed as this is a simple atomic read of static variable
-    return s_last_successful_power;
+    return set_power_instance_get_last_successful_power(&s_default_service, 0);
+}
+
+int set_power_service_get_device_last_successful_power(uint8_t device)
+{
+    return set_power_instance_get_last_successful_power(&s_default_service, device);
+}
+
+esp_err_t set_power_service_benchmark_signature(uint32_t iterations, set_power_signature_benchmark_t *result)
+{
+    return set_power_instance_benchmark_signature(&s_default_service, iterations, result);
+}
+
+esp_err_t set_power_service_get_persisted_state(set_power_service_persisted_t *state)
+{
+    return set_power_instance_get_persisted_state(&s_default_service, state);
+}
+
+uint32_t set_power_service_get_status_generation(void)
+{
+    return set_power_instance_get_status_generation(&s_default_service);
+}
+
+const char *set_power_error_class_to_name(set_power_error_class_t error_class)
+{
+    switch (error_class) {
+        case SET_POWER_ERROR_CLASS_NETWORK:
+            return "network";
+        case SET_POWER_ERROR_CLASS_HTTP_5XX:
+            return "http 5xx";
+        case SET_POWER_ERROR_CLASS_UNKNOWN_RESULT:
+            return "unknown result";
+        default:
+            return "none";
+    }
+}
+
+const char *set_power_breaker_state_to_name(set_power_breaker_state_t state)
+{
+    switch (state) {
+        case SET_POWER_BREAKER_CLOSED:
+            return "closed";
+        case SET_POWER_BREAKER_OPEN:
+            return "open";
+        case SET_POWER_BREAKER_HALF_OPEN:
+            return "half-open";
+        default:
+            return "unknown";
+    }
+}
+
+const char *set_power_op_to_name(set_power_op_t op)
+{
+    switch (op) {
+        case SET_POWER_OP_LOGIN:
+            return "login";
+        case SET_POWER_OP_SET_POWER:
+            return "set-power";
+        default:
+            return "unknown";
+    }
+}
+
+const char *set_power_phase_to_name(set_power_phase_t phase)
+{
+    switch (phase) {
+        case SET_POWER_PHASE_QUEUE_WAIT:
+            return "queue wait";
+        case SET_POWER_PHASE_DNS:
+            return "dns";
+        case SET_POWER_PHASE_CONNECT:
+            return "connect";
+        case SET_POWER_PHASE_TTFB:
+            return "ttfb";
+        case SET_POWER_PHASE_TOTAL:
+            return "total";
+        case SET_POWER_PHASE_END_TO_END:
+            return "end-to-end";
+        default:
+            return "unknown";
+    }
 }
@@ -8,9 +8,22 @@
  * Features:
  * - Automatic JSESSIONID management
  * - Session expiry detection and recovery
+ * - Proactive session refresh while idle, based on the learned session lifetime
  * - Message queue interface for command submission
  * - Thread-safe operation
- * - Configurable retry policies
+ * - Configurable retry policies (exponential backoff with jitter per error class)
+ * - Circuit breaker that fails fast while the endpoint is down
+ * - Independent instances (one per account) through set_power_service_handle_t;
+ *   the set_power_service_*() functions use a built-in default instance
+ * - Non-blocking request engine: the service task keeps taking setpoints while
+ *   requests are in flight, and sends to several devices concurrently
+ * - Pluggable transport (cloud_transport.h): sockets by default, esp_http_client,
+ *   an in-process mock or a recording can be swapped in without touching the service
+ * - Several equivalent cloud endpoints: requests go to the one with the best
+ *   measured latency and error rate, and fail over when it goes down
+ * - Optional hedged set-power requests against tail latency
+ * - Cloud host names resolved at startup and kept resolved in the background,
+ *   with the last good address used while DNS is unavailable
  * 
  * @note This service requires WiFi to be connected before initialization
  */
@@ -21,18 +34,50 @@
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "cloud_transport.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /* Service Configuration */
-#define SET_POWER_SERVICE_QUEUE_SIZE        10      // Maximum pending commands
+#define SET_POWER_SERVICE_QUEUE_SIZE        10      // Maximum pending control commands
+/*
+ * The task stack stays at its original size until it is measured on target:
+ * stack_high_water_bytes in the status reports the least free stack seen.
+ * Shrink it only to the measured peak use (TLS, failover and hedging
+ * enabled) plus SET_POWER_SERVICE_STACK_MARGIN.
+ */
+#ifndef SET_POWER_SERVICE_TASK_STACK_SIZE
 #define SET_POWER_SERVICE_TASK_STACK_SIZE   8192    // Task stack size
+#endif
+#define SET_POWER_SERVICE_STACK_MARGIN      1024    // Free stack to keep at peak use
+#ifndef SET_POWER_SERVICE_ARENA_SIZE
+#define SET_POWER_SERVICE_ARENA_SIZE        1280    // Working arena shared by login/set-power (per instance)
+#endif
 #define SET_POWER_SERVICE_TASK_PRIORITY     5       // Task priority
+#define SET_POWER_SIGNATURE_TABLE_SIZE      101     // One signature per power level 0..100
+#define SET_POWER_SERVICE_MAX_DEVICES       6       // Inverters sharing one account session
+#ifndef SET_POWER_SERVICE_MAX_CONNECTIONS
+#define SET_POWER_SERVICE_MAX_CONNECTIONS   2       // Concurrent requests (keep-alive connections) per instance
+#endif
+#ifndef SET_POWER_SERVICE_MAX_ENDPOINTS
+#define SET_POWER_SERVICE_MAX_ENDPOINTS     3       // Equivalent cloud base URLs per instance
+#endif
+
+/* Service specific error codes */
+#define ESP_ERR_SET_POWER_BASE          0x1F000
+#define ESP_ERR_SET_POWER_SUPERSEDED    (ESP_ERR_SET_POWER_BASE + 1)  /*!< Setpoint replaced by a newer one before it was sent */
+#define ESP_ERR_SET_POWER_CIRCUIT_OPEN  (ESP_ERR_SET_POWER_BASE + 2)  /*!< Rejected without sending: endpoint known down */
+#define ESP_ERR_SET_POWER_EXPIRED       (ESP_ERR_SET_POWER_BASE + 3)  /*!< Dropped because it passed its deadline */
 
 /**
  * @brief Command types for set power service
+ * 
+ * SET_POWER_CMD_SET_OUTPUT commands go to a single-slot mailbox per device
+ * where a newer setpoint replaces an older one that has not been sent yet.
+ * All other commands are queued in FIFO order and are processed before the
+ * setpoints.
  */
 typedef enum {
     SET_POWER_CMD_SET_OUTPUT,       /*!< Set output power percentage */
@@ -46,12 +91,166 @@ typedef enum {
 typedef struct {
     set_power_cmd_type_t cmd_type;  /*!< Command type */
     int output_power;                /*!< Output power percentage (0-100) for SET_OUTPUT_POWER */
+    uint8_t device;                  /*!< Device index for SET_OUTPUT_POWER (0 = first configured device) */
     void *response_sem;              /*!< Optional: Semaphore to signal completion */
     esp_err_t *result;               /*!< Optional: Pointer to store result */
+    uint32_t deadline_ms;            /*!< Optional: Drop the command if not sent within this time after
+                                          enqueueing (0 = config default_deadline_ms) */
+    int64_t enqueue_time_us;         /*!< Set by set_power_service_send() (esp_timer time) */
 } set_power_cmd_t;
 
+/**
+ * @brief Classes of retryable request failures, each with its own retry policy
+ */
+typedef enum {
+    SET_POWER_ERROR_CLASS_NETWORK,          /*!< Connect/send/receive failed or timed out */
+    SET_POWER_ERROR_CLASS_HTTP_5XX,         /*!< Server answered with HTTP 5xx */
+    SET_POWER_ERROR_CLASS_UNKNOWN_RESULT,   /*!< HTTP 200 with an unexpected "result" code */
+    SET_POWER_ERROR_CLASS_COUNT,
+} set_power_error_class_t;
+
+/**
+ * @brief Retry policy: exponential backoff with full jitter
+ * 
+ * Retry n waits a random time in [0, min(max_delay_ms, base_delay_ms * 2^(n-1))].
+ */
+typedef struct {
+    uint8_t max_retries;             /*!< Retries after the first attempt (0 = no retry) */
+    uint32_t base_delay_ms;          /*!< Backoff cap of the first retry */
+    uint32_t max_delay_ms;           /*!< Upper bound of the backoff cap (0 = use default policy) */
+} set_power_retry_policy_t;
+
+/**
+ * @brief Default retry policies, indexed by set_power_error_class_t
+ */
+#define SET_POWER_RETRY_POLICY_DEFAULT() {           \
+    { .max_retries = 3, .base_delay_ms = 1000, .max_delay_ms = 30000 },  /* network */        \
+    { .max_retries = 3, .base_delay_ms = 2000, .max_delay_ms = 60000 },  /* HTTP 5xx */       \
+    { .max_retries = 3, .base_delay_ms = 1000, .max_delay_ms = 10000 },  /* unknown result */ \
+}
+
+/**
+ * @brief Circuit breaker configuration
+ * 
+ * After failure_threshold consecutive endpoint failures (network or HTTP 5xx)
+ * the breaker opens and requests fail fast with ESP_ERR_SET_POWER_CIRCUIT_OPEN.
+ * After open_duration_ms it half-opens: one probe request is let through and
+ * closes the breaker on success or re-opens it on failure.
+ */
+typedef struct {
+    uint8_t failure_threshold;       /*!< Consecutive failures that open the breaker (0 = disabled) */
+    uint32_t open_duration_ms;       /*!< Time the breaker stays open before a probe */
+} set_power_circuit_breaker_config_t;
+
+/**
+ * @brief Rate limiter configuration (token bucket shared by login and set-power)
+ * 
+ * Every cloud request takes a token; the bucket holds up to burst tokens and
+ * gains one every refill_interval_ms. While it is empty, setpoints stay in
+ * the mailbox, so newer ones replace them and only the latest is sent once a
+ * token is available.
+ */
+typedef struct {
+    uint8_t burst;                   /*!< Bucket size: requests allowed back to back (0 = disabled) */
+    uint32_t refill_interval_ms;     /*!< Time to gain one token (sustained rate = 1 / interval) */
+} set_power_rate_limit_config_t;
+
+/**
+ * @brief Hedged set-power requests
+ * 
+ * A set-power request still unanswered after the running set-power p90
+ * (at least min_delay_ms) is sent a second time on another connection, to
+ * another endpoint if a healthy one is configured. The first successful
+ * answer wins and the other copy is cancelled. Setting the same power is
+ * idempotent, so a copy that reached the cloud anyway does no harm. Hedges
+ * are only sent while the circuit breaker is closed and a rate limit token
+ * is available, and never wait for one.
+ */
+typedef struct {
+    bool enabled;                    /*!< Send hedges (off by default: they add cloud load) */
+    uint32_t min_delay_ms;           /*!< Lower bound of the adaptive hedge delay */
+} set_power_hedge_config_t;
+
+/**
+ * @brief Circuit breaker state
+ */
+typedef enum {
+    SET_POWER_BREAKER_CLOSED,        /*!< Requests flow normally */
+    SET_POWER_BREAKER_OPEN,          /*!< Endpoint known down, requests fail fast */
+    SET_POWER_BREAKER_HALF_OPEN,     /*!< Probing whether the endpoint recovered */
+} set_power_breaker_state_t;
+
+/**
+ * @brief Cloud operations with separate latency metrics
+ */
+typedef enum {
+    SET_POWER_OP_LOGIN,              /*!< /v1/user/login */
+    SET_POWER_OP_SET_POWER,          /*!< /v1/manage/setOnGridInverterParam */
+    SET_POWER_OP_COUNT,
+} set_power_op_t;
+
+/**
+ * @brief Measured latency phases
+ */
+typedef enum {
+    SET_POWER_PHASE_QUEUE_WAIT,      /*!< Command enqueued until the service task picked it up */
+    SET_POWER_PHASE_DNS,             /*!< Name resolution (only requests that opened a new connection;
+                                          near 0 when the address was cached) */
+    SET_POWER_PHASE_CONNECT,         /*!< TCP connect after name resolution (only requests that opened
+                                          a new connection) */
+    SET_POWER_PHASE_TTFB,            /*!< Request start until the first response byte */
+    SET_POWER_PHASE_TOTAL,           /*!< Whole HTTP request, including a keep-alive replay */
+    SET_POWER_PHASE_END_TO_END,      /*!< Command enqueued until confirmed by the cloud (incl. retries) */
+    SET_POWER_PHASE_COUNT,
+} set_power_phase_t;
+
+/**
+ * @brief Latency percentiles of one phase (successful requests only)
+ * 
+ * Percentiles come from a log-bucketed histogram and are accurate to 25%.
+ */
+typedef struct {
+    uint32_t count;                  /*!< Number of samples */
+    uint32_t p50_ms;                 /*!< Median */
+    uint32_t p90_ms;                 /*!< 90th percentile */
+    uint32_t p99_ms;                 /*!< 99th percentile */
+    uint32_t max_ms;                 /*!< Largest sample */
+} set_power_latency_t;
+
+/**
+ * @brief Per-device status
+ */
+typedef struct {
+    char device_sn[32];              /*!< Device serial number */
+    int32_t confirmed_power;         /*!< Last setpoint confirmed by the cloud (-1 = none) */
+    uint32_t total_requests;         /*!< Setpoints handled (sent or skipped) */
+    uint32_t successful_requests;    /*!< Setpoints accepted by the cloud */
+    uint32_t failed_requests;        /*!< Failed set-power requests */
+    uint32_t skipped_requests;       /*!< Setpoints skipped by deduplication */
+    uint32_t superseded_setpoints;   /*!< Setpoints replaced by a newer one before being sent */
+    uint32_t expired_requests;       /*!< Setpoints dropped because they passed their deadline */
+} set_power_device_status_t;
+
+/**
+ * @brief Health of one cloud endpoint
+ * 
+ * rtt_ms and error_permille are moving averages that weigh recent requests
+ * most; requests aborted for a newer setpoint do not count.
+ */
+typedef struct {
+    char base_url[64];               /*!< Configured base URL */
+    uint32_t rtt_ms;                 /*!< Smoothed request time of successful requests (0 = not measured) */
+    uint16_t error_permille;         /*!< Smoothed failure rate (network errors, HTTP 5xx) in 1/1000 */
+    uint32_t requests;               /*!< Requests completed on this endpoint */
+    uint32_t failures;               /*!< Requests that failed with a network error or HTTP 5xx */
+    bool down;                       /*!< Skipped after consecutive failures until it is probed again */
+    bool active;                     /*!< Endpoint new requests are routed to */
+} set_power_endpoint_status_t;
+
 /**
  * @brief Service status information
+ * 
+ * Request counters are totals over all devices; devices[] has the breakdown.
  */
 typedef struct {
     bool is_authenticated;           /*!< Whether service has valid JSESSIONID */
@@ -60,20 +259,125 @@ typedef struct {
     uint32_t failed_requests;        /*!< Number of failed requests */
     uint32_t skipped_requests;       /*!< Number of requests skipped (deduplication) */
     uint32_t session_refreshes;      /*!< Number of times JSESSIONID was refreshed */
+    uint32_t proactive_refreshes;    /*!< Refreshes done while idle before the expected expiry */
+    uint32_t reactive_refreshes;     /*!< Refreshes forced by an expired or missing session */
+    uint32_t session_age_ms;         /*!< Age of the current JSESSIONID */
+    uint32_t session_lifetime_ms;    /*!< Expected session lifetime (configured or learned, 0 = unknown) */
+    bool session_restored;           /*!< Current JSESSIONID was restored from persisted state */
+    uint32_t time_to_first_accept_ms; /*!< Start to first command accepted by the cloud (0 = none yet) */
+    uint32_t persist_generation;     /*!< Changes whenever set_power_service_get_persisted_state() would */
+    uint32_t retries;                /*!< Retry attempts made after a backoff */
+    set_power_breaker_state_t breaker_state; /*!< Circuit breaker state */
+    uint32_t breaker_open_remaining_ms; /*!< Time until an open breaker half-opens */
+    uint32_t consecutive_failures;   /*!< Consecutive endpoint failures (network, HTTP 5xx) */
+    uint32_t breaker_trips;          /*!< Times the breaker opened */
+    uint32_t fast_failed_requests;   /*!< Requests rejected while the breaker was open */
+    uint32_t connection_reuses;      /*!< Requests served on an existing keep-alive connection */
+    uint32_t connection_reconnects;  /*!< Requests that opened a new connection (incl. the first) */
+    uint32_t aborted_requests;       /*!< In-flight requests aborted for a newer setpoint */
+    uint32_t max_in_flight_requests; /*!< Most requests ever in flight at the same time */
+    uint32_t hedged_requests;        /*!< Second copies sent for slow set-power requests */
+    uint32_t hedge_wins;             /*!< Setpoints confirmed by the hedge rather than the first copy */
+    uint32_t hedge_delay_ms;         /*!< Current hedge delay (0 = hedging disabled) */
+    uint32_t superseded_setpoints;   /*!< Setpoints replaced by a newer one before being sent */
+    uint32_t expired_requests;       /*!< Commands dropped because they passed their deadline */
+    uint32_t throttled_requests;     /*!< Setpoints and logins that had to wait for a rate limit token */
+    uint32_t rate_limit_tokens;      /*!< Whole tokens currently in the bucket (0 = limiter disabled) */
+    uint32_t last_queue_wait_ms;     /*!< Enqueue to start of processing, last command */
+    uint32_t max_queue_wait_ms;      /*!< Enqueue to start of processing, worst case */
+    set_power_latency_t latency[SET_POWER_OP_COUNT][SET_POWER_PHASE_COUNT]; /*!< Per-phase latency */
+    uint32_t stack_size_bytes;       /*!< Service task stack size */
+    uint32_t stack_high_water_bytes; /*!< Minimum free stack ever seen (uxTaskGetStackHighWaterMark) */
+    uint32_t arena_size_bytes;       /*!< Working arena size */
+    uint32_t arena_peak_bytes;       /*!< Peak working arena usage */
+    uint32_t endpoint_switches;      /*!< Times requests were moved to another endpoint */
+    uint8_t endpoint_count;          /*!< Configured endpoints */
+    set_power_endpoint_status_t endpoints[SET_POWER_SERVICE_MAX_ENDPOINTS]; /*!< Per-endpoint health */
     char jsessionid[64];             /*!< Current JSESSIONID (read-only) */
+    uint8_t device_count;            /*!< Configured devices */
+    set_power_device_status_t devices[SET_POWER_SERVICE_MAX_DEVICES]; /*!< Per-device status */
 } set_power_service_status_t;
 
+/**
+ * @brief State worth keeping across reboots
+ * 
+ * Saved by the application (ESPHome preferences, NVS) whenever
+ * persist_generation in the status changes, and passed back via
+ * set_power_service_config_t::restore_state on the next boot.
+ */
+typedef struct {
+    char jsessionid[64];             /*!< Session cookie (empty = none) */
+    int64_t session_issued_epoch_ms; /*!< Wall clock time the session was issued (0 = unknown) */
+    uint32_t session_lifetime_ms;    /*!< Learned session lifetime (0 = unknown) */
+    struct {
+        uint32_t device_sn_hash;     /*!< FNV-1a of the serial, matches the entry to its device */
+        int32_t confirmed_power;     /*!< Last setpoint confirmed by the cloud (-1 = none) */
+        int64_t confirmed_epoch_ms;  /*!< Wall clock time of that confirmation */
+    } devices[SET_POWER_SERVICE_MAX_DEVICES];
+} set_power_service_persisted_t;
+
+/**
+ * @brief One inverter on the account
+ */
+typedef struct {
+    const char *device_sn;           /*!< Device serial number */
+    const uint8_t (*signature_table)[16]; /*!< Optional: MD5 signature digests for power 0..100
+                                               (e.g. generated at build time), NULL = compute at init */
+} set_power_device_config_t;
+
 /**
  * @brief Service configuration
  */
 typedef struct {
     const char *email;               /*!< User email for authentication */
     const char *password;            /*!< User password for authentication */
-    const char *device_sn;           /*!< Device serial number */
+    const char *device_sn;           /*!< Device serial number (single device, ignored if device_count > 0) */
+    const char *base_url;            /*!< Cloud API base URL, "http://host[:port][/path]" (NULL = default,
+                                          ignored if base_url_count > 0) */
+    uint8_t base_url_count;          /*!< Entries in base_urls[] (0 = the single base_url) */
+    const char *base_urls[SET_POWER_SERVICE_MAX_ENDPOINTS]; /*!< Equivalent endpoints of the same cloud,
+                                                                 tried by measured health */
+    const cloud_transport_t *transport; /*!< How requests reach the cloud (NULL = cloud_transport_socket());
+                                             must outlive the instance */
+    uint32_t dns_ttl_ms;             /*!< How long a resolved endpoint address is used; endpoint hosts
+                                          are re-resolved in the background before it runs out
+                                          (0 = 5 minutes) */
     uint32_t request_timeout_ms;     /*!< HTTP request timeout in milliseconds */
-    uint8_t max_retry_count;         /*!< Maximum retry count for failed requests */
+    uint8_t max_retry_count;         /*!< Maximum retry count for failed requests (default for
+                                          retry policies left unset) */
+    const uint8_t (*signature_table)[16]; /*!< Optional: MD5 signature digests for power 0..100
+                                               (e.g. generated at build time), NULL = compute at init */
+    uint32_t session_lifetime_ms;    /*!< Expected JSESSIONID lifetime, refined from observed expiries
+                                          (0 = learn from the first expiry) */
+    const set_power_service_persisted_t *restore_state; /*!< Optional: state saved before the last reboot;
+                                                             the saved session is tried before logging in */
+    set_power_retry_policy_t retry_policy[SET_POWER_ERROR_CLASS_COUNT]; /*!< Retry policy per error class */
+    set_power_circuit_breaker_config_t circuit_breaker; /*!< Circuit breaker (failure_threshold 0 = disabled) */
+    uint32_t default_deadline_ms;    /*!< Deadline of commands that do not set their own (0 = none) */
+    set_power_rate_limit_config_t rate_limit; /*!< Cloud request rate limit (burst 0 = disabled, the default) */
+    set_power_hedge_config_t hedge;  /*!< Hedged set-power requests (disabled by default) */
+    uint8_t device_count;            /*!< Entries in devices[] (0 = the single device_sn) */
+    set_power_device_config_t devices[SET_POWER_SERVICE_MAX_DEVICES]; /*!< Inverters sharing the login
+                                                                            and session */
 } set_power_service_config_t;
 
+/**
+ * @brief Signature microbenchmark result
+ */
+typedef struct {
+    uint32_t iterations;             /*!< Number of signatures produced per variant */
+    uint32_t compute_ns_per_op;      /*!< URL-encode + MD5 + hex per request (previous hot path) */
+    uint32_t lookup_ns_per_op;       /*!< Table lookup + hex per request (current hot path) */
+} set_power_signature_benchmark_t;
+
+/**
+ * @brief Handle of a service instance
+ * 
+ * An instance holds everything of one account: login, session, connections,
+ * devices, statistics and its own service task.
+ */
+typedef struct set_power_service *set_power_service_handle_t;
+
 /**
  * @brief Default service configuration
  */
@@ -81,8 +385,30 @@ typedef struct {
     .email = NULL,                                   \
     .password = NULL,                                \
     .device_sn = NULL,                               \
+    .base_url = NULL,                                \
+    .base_url_count = 0,                             \
+    .transport = NULL,                               \
+    .dns_ttl_ms = 300000,                            \
     .request_timeout_ms = 10000,                     \
     .max_retry_count = 3,                            \
+    .signature_table = NULL,                         \
+    .session_lifetime_ms = 0,                        \
+    .restore_state = NULL,                           \
+    .retry_policy = SET_POWER_RETRY_POLICY_DEFAULT(), \
+    .circuit_breaker = {                             \
+        .failure_threshold = 5,                      \
+        .open_duration_ms = 60000,                   \
+    },                                               \
+    .default_deadline_ms = 0,                        \
+    .rate_limit = {                                  \
+        .burst = 0,                                  \
+        .refill_interval_ms = 6000,                  \
+    },                                               \
+    .hedge = {                                       \
+        .enabled = false,                            \
+        .min_delay_ms = 500,                         \
+    },                                               \
+    .device_count = 0,                               \
 }
 
 /**
@@ -117,6 +443,9 @@ esp_err_t set_power_service_deinit(void);
  * This function queues a command for processing by the service task.
  * It returns immediately without waiting for completion.
  * 
+ * SET_OUTPUT commands never wait: they overwrite the pending setpoint, whose
+ * waiter (if any) is completed with ESP_ERR_SET_POWER_SUPERSEDED.
+ * 
  * @param cmd Command to send
  * @param timeout_ms Maximum time to wait for queue space (use portMAX_DELAY to wait indefinitely)
  * @return 
@@ -132,12 +461,17 @@ esp_err_t set_power_service_send(const set_power_cmd_t *cmd, uint32_t timeout_ms
  * @brief Send a command to the service and wait for completion (blocking)
  * 
  * This function queues a command and blocks until the command is processed.
+ * Its response_sem and result are set to a waiter owned by the service, so a
+ * command still pending after the timeout completes harmlessly later.
  * 
  * @param cmd Command to send
  * @param timeout_ms Maximum time to wait for command completion
  * @return 
  *      - ESP_OK: Command completed successfully
- *      - ESP_ERR_TIMEOUT: Command processing timeout
+ *      - ESP_ERR_TIMEOUT: Command processing timeout (the command stays queued)
+ *      - ESP_ERR_NO_MEM: Too many synchronous commands outstanding
+ *      - ESP_ERR_SET_POWER_SUPERSEDED: Setpoint replaced by a newer one before it was sent
+ *      - ESP_ERR_SET_POWER_EXPIRED: Command passed its deadline before it could be sent
  *      - ESP_ERR_INVALID_STATE: Service not initialized
  *      - Other: Error code from command execution
  */
@@ -146,6 +480,8 @@ esp_err_t set_power_service_send_sync(set_power_cmd_t *cmd, uint32_t timeout_ms)
 /**
  * @brief Set output power (convenience function)
  * 
+ * Applies to the first configured device.
+ * 
  * @param output_power Output power percentage (0-100)
  * @param wait_completion If true, wait for command completion; if false, return immediately
  * @return 
@@ -155,6 +491,43 @@ esp_err_t set_power_service_send_sync(set_power_cmd_t *cmd, uint32_t timeout_ms)
  */
 esp_err_t set_power_service_set_output(int output_power, bool wait_completion);
 
+/**
+ * @brief Set output power, dropping the setpoint if it cannot be sent in time
+ * 
+ * A setpoint that is still waiting (behind retries, an open circuit breaker or
+ * a re-login) when its deadline passes is discarded instead of being sent late,
+ * and completes with ESP_ERR_SET_POWER_EXPIRED.
+ * 
+ * @param output_power Output power percentage (0-100)
+ * @param deadline_ms Time after which the setpoint is stale (0 = config default_deadline_ms)
+ * @param wait_completion If true, wait for command completion; if false, return immediately
+ * @return Same as set_power_service_set_output()
+ */
+esp_err_t set_power_service_set_output_with_deadline(int output_power, uint32_t deadline_ms, bool wait_completion);
+
+/**
+ * @brief Set the output power of one device
+ * 
+ * Each device has its own mailbox, so setpoints for different devices never
+ * replace each other; they are sent concurrently over the shared session
+ * (up to SET_POWER_SERVICE_MAX_CONNECTIONS at a time).
+ * 
+ * @param device Device index (order of set_power_service_config_t::devices)
+ * @param output_power Output power percentage (0-100)
+ * @param deadline_ms Time after which the setpoint is stale (0 = config default_deadline_ms)
+ * @param wait_completion If true, wait for command completion; if false, return immediately
+ * @return Same as set_power_service_set_output(); ESP_ERR_INVALID_ARG for an unknown device
+ */
+esp_err_t set_power_service_set_device_output(uint8_t device, int output_power, uint32_t deadline_ms,
+                                              bool wait_completion);
+
+/**
+ * @brief Find the index of a device by serial number
+ * 
+ * @return Device index, or -1 if the serial is not configured
+ */
+int set_power_service_find_device(const char *device_sn);
+
 /**
  * @brief Force service to re-authenticate
  * 
@@ -167,11 +540,26 @@ esp_err_t set_power_service_force_relogin(void);
 /**
  * @brief Get service status
  * 
+ * Reads the snapshot last published by the service task. Lock-free: never
+ * blocks, so it is safe to call from any task on either core.
+ * 
  * @param status Pointer to status structure to fill
  * @return ESP_OK on success
  */
 esp_err_t set_power_service_get_status(set_power_service_status_t *status);
 
+/**
+ * @brief Get the status generation (lock-free)
+ * 
+ * The generation changes whenever the service task changes observable state:
+ * confirmed power, authentication, counters, circuit breaker. A poller can
+ * compare it with the last value seen and skip set_power_service_get_status()
+ * (which copies the whole status snapshot) while it is unchanged.
+ * 
+ * @return Current generation (wraps around)
+ */
+uint32_t set_power_service_get_status_generation(void);
+
 /**
  * @brief Check if service is ready to accept commands
  * 
@@ -189,6 +577,121 @@ bool set_power_service_is_ready(void);
  */
 int set_power_service_get_last_successful_power(void);
 
+/**
+ * @brief Get last successfully set power value of one device
+ * 
+ * @param device Device index
+ * @return Last successful power, or -1 if none yet or the device is unknown
+ */
+int set_power_service_get_device_last_successful_power(uint8_t device);
+
+/**
+ * @brief Get the state to persist across reboots
+ * 
+ * Call when persist_generation in the status has changed and store the
+ * result; pass it as restore_state to set_power_service_init() after reboot.
+ * 
+ * @param state Pointer to state structure to fill
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the service is not initialized
+ */
+esp_err_t set_power_service_get_persisted_state(set_power_service_persisted_t *state);
+
+/**
+ * @brief Get the default instance used by the set_power_service_*() functions
+ * 
+ * @return Handle (valid between set_power_service_init() and set_power_service_deinit())
+ */
+set_power_service_handle_t set_power_service_default_instance(void);
+
+/*
+ * Instance API
+ * 
+ * Each function behaves like its set_power_service_*() counterpart, on the
+ * given instance instead of the default one. Instances share nothing, so
+ * several accounts can be served by one firmware.
+ */
+
+/**
+ * @brief Create a service instance and start its service task
+ * 
+ * @param config Service configuration (copied)
+ * @param out_handle Receives the handle on success
+ * @return Same as set_power_service_init()
+ */
+esp_err_t set_power_instance_create(const set_power_service_config_t *config, set_power_service_handle_t *out_handle);
+
+/**
+ * @brief Stop an instance and free all its resources
+ * 
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a NULL handle
+ */
+esp_err_t set_power_instance_destroy(set_power_service_handle_t handle);
+
+/** @brief See set_power_service_send() */
+esp_err_t set_power_instance_send(set_power_service_handle_t handle, const set_power_cmd_t *cmd, uint32_t timeout_ms);
+
+/** @brief See set_power_service_send_sync() */
+esp_err_t set_power_instance_send_sync(set_power_service_handle_t handle, set_power_cmd_t *cmd, uint32_t timeout_ms);
+
+/** @brief See set_power_service_set_device_output() */
+esp_err_t set_power_instance_set_output(set_power_service_handle_t handle, uint8_t device, int output_power,
+                                        uint32_t deadline_ms, bool wait_completion);
+
+/** @brief See set_power_service_find_device() */
+int set_power_instance_find_device(set_power_service_handle_t handle, const char *device_sn);
+
+/** @brief See set_power_service_force_relogin() */
+esp_err_t set_power_instance_force_relogin(set_power_service_handle_t handle);
+
+/** @brief See set_power_service_get_status() */
+esp_err_t set_power_instance_get_status(set_power_service_handle_t handle, set_power_service_status_t *status);
+
+/** @brief See set_power_service_get_status_generation() */
+uint32_t set_power_instance_get_status_generation(set_power_service_handle_t handle);
+
+/** @brief See set_power_service_is_ready() */
+bool set_power_instance_is_ready(set_power_service_handle_t handle);
+
+/** @brief See set_power_service_get_device_last_successful_power() */
+int set_power_instance_get_last_successful_power(set_power_service_handle_t handle, uint8_t device);
+
+/** @brief See set_power_service_get_persisted_state() */
+esp_err_t set_power_instance_get_persisted_state(set_power_service_handle_t handle,
+                                                 set_power_service_persisted_t *state);
+
+/** @brief See set_power_service_benchmark_signature() */
+esp_err_t set_power_instance_benchmark_signature(set_power_service_handle_t handle, uint32_t iterations,
+                                                 set_power_signature_benchmark_t *result);
+
+/**
+ * @brief Get a printable name for an error class
+ */
+const char *set_power_error_class_to_name(set_power_error_class_t error_class);
+
+/**
+ * @brief Get a printable name for a circuit breaker state
+ */
+const char *set_power_breaker_state_to_name(set_power_breaker_state_t state);
+
+/**
+ * @brief Get a printable name for an operation
+ */
+const char *set_power_op_to_name(set_power_op_t op);
+
+/**
+ * @brief Get a printable name for a latency phase
+ */
+const char *set_power_phase_to_name(set_power_phase_t phase);
+
+/**
+ * @brief Measure the per-request CPU cost of computing vs. looking up signatures
+ * 
+ * @param iterations Number of signatures to produce for each variant
+ * @param result Pointer to benchmark result to fill
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the service is not initialized
+ */
+esp_err_t set_power_service_benchmark_signature(uint32_t iterations, set_power_signature_benchmark_t *result);
+
 #ifdef __cplusplus
 }
 #endif
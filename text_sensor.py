@@ -0,0 +1,32 @@
+"""
+Status text sensors for the Tentek/MIC POWER inverter component
+"""
+
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import text_sensor
+
+from . import CONF_INVERTER_TENTEK_ID, InverterTentekComponent
+
+DEPENDENCIES = ["inverter_tentek"]
+
+CONF_CIRCUIT_BREAKER = "circuit_breaker"
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_INVERTER_TENTEK_ID): cv.use_id(InverterTentekComponent),
+        cv.Optional(CONF_CIRCUIT_BREAKER): text_sensor.text_sensor_schema(
+            icon="mdi:electric-switch",
+        ),
+    }
+)
+
+
+async def to_code(config):
+    """Generate C++ code"""
+    parent = await cg.get_variable(config[CONF_INVERTER_TENTEK_ID])
+    cg.add(parent.set_publish_statistics(True))
+
+    if CONF_CIRCUIT_BREAKER in config:
+        sens = await text_sensor.new_text_sensor(config[CONF_CIRCUIT_BREAKER])
+        cg.add(parent.set_circuit_breaker_text_sensor(sens))
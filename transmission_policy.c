@@ -0,0 +1,62 @@
+/**
+ * @file transmission_policy.c
+ * @brief When a new inverter setpoint is worth sending
+ */
+
+#include "transmission_policy.h"
+#include <stdlib.h>
+
+bool transmission_policy_should_transmit(const transmission_policy_config_t *config,
+                                         transmission_policy_state_t *state, int confirmed_power,
+                                         int power, uint32_t now_ms)
+{
+    // Tracking error is measured against what the inverter has confirmed
+    int reference = confirmed_power != -1 ? confirmed_power : state->transmitted_power;
+    if (reference == -1) {
+        state->last_check_ms = now_ms;
+        return true;  // Nothing sent or confirmed yet
+    }
+
+    int error = abs(power - reference);
+    if (error == 0) {
+        transmission_policy_settle(state, now_ms);
+        return false;
+    }
+
+    // The error held since the previous check accumulates into the integral (%·s)
+    state->error_integral += state->tracking_error * (now_ms - state->last_check_ms) / 1000.0f;
+    state->tracking_error = error;
+    state->last_check_ms = now_ms;
+
+    // Already on its way: wait for the confirmation rather than sending it twice
+    if (power == state->transmitted_power && now_ms - state->last_transmit_ms < TRANSMISSION_POLICY_RESEND_MS) {
+        return false;
+    }
+
+    if (error > config->deadband_percent) {
+        return true;
+    }
+    if (config->error_integral_threshold > 0 && state->error_integral >= config->error_integral_threshold) {
+        return true;
+    }
+    if (config->max_silent_interval_ms > 0 && now_ms - state->last_transmit_ms >= config->max_silent_interval_ms) {
+        return true;
+    }
+
+    return false;
+}
+
+void transmission_policy_settle(transmission_policy_state_t *state, uint32_t now_ms)
+{
+    state->tracking_error = 0;
+    state->error_integral = 0.0f;
+    state->last_check_ms = now_ms;
+}
+
+void transmission_policy_transmitted(transmission_policy_state_t *state, int power, uint32_t now_ms)
+{
+    state->transmitted_power = power;
+    state->last_transmit_ms = now_ms;
+    // The new setpoint is expected to close the error
+    transmission_policy_settle(state, now_ms);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file transmission_policy.h
+ * @brief When a new inverter setpoint is worth sending
+ *
+ * A setpoint is sent when it differs from the confirmed output by more than
+ * the deadband, when the integral of the tracking error since the error was
+ * last closed reaches the threshold, or when nothing was sent for the
+ * maximum silent interval. Otherwise it is held back and re-checked. The
+ * integral only covers time during which an error was actually held: once
+ * the confirmed output matches the request again it starts over from zero.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A transmitted setpoint the cloud has not confirmed is sent again after this long
+#define TRANSMISSION_POLICY_RESEND_MS   30000
+
+/**
+ * @brief Policy thresholds
+ */
+typedef struct {
+    int deadband_percent;            /*!< Errors above this are sent immediately */
+    float error_integral_threshold;  /*!< Accumulated %·s that forces a send (0 = off) */
+    uint32_t max_silent_interval_ms; /*!< Longest unsent non-zero error (0 = unbounded) */
+} transmission_policy_config_t;
+
+/**
+ * @brief Policy state of one inverter
+ */
+typedef struct {
+    int transmitted_power;           /*!< Last setpoint sent (-1 = none) */
+    uint32_t last_transmit_ms;       /*!< When it was sent */
+    uint32_t last_check_ms;          /*!< Previous evaluation */
+    int tracking_error;              /*!< |requested - confirmed| at the previous evaluation */
+    float error_integral;            /*!< Tracking error integral since the error was last closed (%·s) */
+} transmission_policy_state_t;
+
+#define TRANSMISSION_POLICY_STATE_INIT  { -1, 0, 0, 0, 0.0f }
+
+/**
+ * @brief Decide whether a setpoint is sent now
+ *
+ * Integrates the error held since the previous evaluation. A request equal
+ * to the reference (the confirmed power, or the transmitted one before any
+ * confirmation) closes the error as transmission_policy_settle() does.
+ *
+ * @param config Thresholds
+ * @param state State of the inverter
+ * @param confirmed_power Power the inverter confirmed (-1 = none yet)
+ * @param power Requested setpoint
+ * @param now_ms Current time
+ * @return True if the setpoint should be sent (then call transmission_policy_transmitted())
+ */
+bool transmission_policy_should_transmit(const transmission_policy_config_t *config,
+                                         transmission_policy_state_t *state, int confirmed_power,
+                                         int power, uint32_t now_ms);
+
+/**
+ * @brief The requested power is what the inverter already runs: no error is held any more
+ *
+ * @param state State of the inverter
+ * @param now_ms Current time
+ */
+void transmission_policy_settle(transmission_policy_state_t *state, uint32_t now_ms);
+
+/**
+ * @brief Record that a setpoint was sent
+ *
+ * @param state State of the inverter
+ * @param power Setpoint sent
+ * @param now_ms Current time
+ */
+void transmission_policy_transmitted(transmission_policy_state_t *state, int power, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif